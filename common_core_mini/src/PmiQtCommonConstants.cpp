@@ -53,6 +53,8 @@ const QString kParent_Survey_Low_CE__V_ = QStringLiteral("Parent Survey Low CE (
 const QString kPeaks = QStringLiteral("Peaks");
 const QString kPeaksId = QStringLiteral("PeaksId");
 const QString kPeaks_MS1Centroided = QStringLiteral("Peaks_MS1Centroided");
+const QString kPeaks_MS1CentroidedMzBuckets = QStringLiteral("Peaks_MS1CentroidedMzBuckets");
+const QString kPeaks_MS1CentroidedMzBucketsInfo = QStringLiteral("Peaks_MS1CentroidedMzBucketsInfo");
 const QString kPeptidesId = QStringLiteral("PeptidesId");
 const QString kPlotSettings = QStringLiteral("PlotSettings");
 const QString kPlotsColorCount = QStringLiteral("PlotsColorCount");
@@ -56,6 +56,8 @@ PMI_COMMON_CORE_MINI_EXPORT extern const QString kParent_Survey_Low_CE__V_;
 PMI_COMMON_CORE_MINI_EXPORT extern const QString kPeaks;
 PMI_COMMON_CORE_MINI_EXPORT extern const QString kPeaksId;
 PMI_COMMON_CORE_MINI_EXPORT extern const QString kPeaks_MS1Centroided;
+PMI_COMMON_CORE_MINI_EXPORT extern const QString kPeaks_MS1CentroidedMzBuckets;
+PMI_COMMON_CORE_MINI_EXPORT extern const QString kPeaks_MS1CentroidedMzBucketsInfo;
 PMI_COMMON_CORE_MINI_EXPORT extern const QString kPeptidesId;
 PMI_COMMON_CORE_MINI_EXPORT extern const QString kPlotSettings;
 PMI_COMMON_CORE_MINI_EXPORT extern const QString kPlotsColorCount;
@@ -9,6 +9,7 @@
 
 #include "ChargeDeterminatorNN.h"
 #include "CommonFunctions.h"
+#include "NeuralNetworkBatch.h"
 #include "Point2dListUtils.h"
 #include "pmi_common_core_mini_debug.h"
 
@@ -84,6 +85,7 @@ void ChargeDeterminatorNN::buildSuccessiveCombFilters()
         }
 
         m_successiveCombFilters.push_back(t_matrixByCharge);
+        m_networkInputSize += static_cast<int>(t_matrixByCharge.rows());
     }
 }
 
@@ -92,6 +94,21 @@ bool ChargeDeterminatorNN::isValid() const
     return !m_neuralNetworkWeights.empty();
 }
 
+void ChargeDeterminatorNN::extractNetworkInput(const Eigen::SparseVector<double> &scanSegment,
+                                               Eigen::Ref<Eigen::RowVectorXd> input) const
+{
+    int offset = 0;
+    for (size_t j = 0; j < m_successiveCombFilters.size(); ++j) {
+        const Eigen::SparseMatrix<double> &tsuccessiveFilter = m_successiveCombFilters[j];
+        // TODO Explore replacing this summing w/ rowwise max()
+        Eigen::VectorXd maxRowValues = tsuccessiveFilter * scanSegment;
+
+        maxRowValues /= maxRowValues.maxCoeff();
+        input.segment(offset, maxRowValues.rows()) = maxRowValues.transpose();
+        offset += static_cast<int>(maxRowValues.rows());
+    }
+}
+
 int ChargeDeterminatorNN::determineCharge(const Eigen::SparseVector<double> &scanSegment) const
 {
     if (!isValid()) {
@@ -100,22 +117,10 @@ int ChargeDeterminatorNN::determineCharge(const Eigen::SparseVector<double> &sca
 
     ////Extract points from scan vector by combfilter for input into neural network forward
     ///propagation
-    std::vector<double> passingVec;
-
-    for (size_t j = 0; j < m_successiveCombFilters.size(); ++j) {
-        const Eigen::SparseMatrix<double> &tsuccessiveFilter = m_successiveCombFilters[j];
-        // TODO Explore replacing this summing w/ rowwise max()
-        Eigen::VectorXd maxRowValues = tsuccessiveFilter * scanSegment; 
-
-        maxRowValues /= maxRowValues.maxCoeff();
-        for (int k = 0; k < maxRowValues.rows(); ++k) {
-            passingVec.push_back(maxRowValues(k, 0));
-        }
-    }
+    Eigen::RowVectorXd forwardPropagation(m_networkInputSize);
+    extractNetworkInput(scanSegment, forwardPropagation);
 
     //// Neural Network Layers Matrix Math
-    // TODO This function can probs be replaced by Eigen::Map Function
-    Eigen::RowVectorXd forwardPropagation = convertVectorToEigenRowVector(passingVec); 
     forwardPropagation = (forwardPropagation * m_neuralNetworkWeights[0]) + m_neuralNetworkWeights[1];
     forwardPropagation = relu(forwardPropagation);
     forwardPropagation = (forwardPropagation * m_neuralNetworkWeights[2]) + m_neuralNetworkWeights[3];
@@ -123,16 +128,31 @@ int ChargeDeterminatorNN::determineCharge(const Eigen::SparseVector<double> &sca
     forwardPropagation = (forwardPropagation * m_neuralNetworkWeights[4]) + m_neuralNetworkWeights[5];
     forwardPropagation = sigmoid(forwardPropagation);
 
-    //// Return index of Max value.  Max value typically = 1 or close to it.
-    int charge = 0;
-    for (int m = 0; m < forwardPropagation.cols(); ++m) {
-        if (forwardPropagation(m) == forwardPropagation.rowwise().maxCoeff()(0)) {
-            charge = m + 1;
-            break;
-        }
+    //// Return index of Max value.  Max value typically = 1 or close to it. 0 if there is none.
+    return NeuralNetworkBatch::indexOfMaxCoeff(forwardPropagation) + 1;
+}
+
+std::vector<int> ChargeDeterminatorNN::determineCharges(const Eigen::SparseMatrix<double> &scanSegments,
+                                                        NeuralNetworkBatch *batch) const
+{
+    const int segmentCount = static_cast<int>(scanSegments.cols());
+    std::vector<int> charges(segmentCount, -1);
+    if (!isValid() || segmentCount == 0) {
+        return charges;
+    }
+
+    NeuralNetworkBatch::MatrixMap input = batch->input(segmentCount, m_networkInputSize);
+    for (int i = 0; i < segmentCount; ++i) {
+        const Eigen::SparseVector<double> scanSegment = scanSegments.col(i);
+        extractNetworkInput(scanSegment, input.row(i));
+    }
+
+    const NeuralNetworkBatch::MatrixMap output = batch->propagate(m_neuralNetworkWeights);
+    for (int i = 0; i < segmentCount; ++i) {
+        charges[i] = NeuralNetworkBatch::indexOfMaxCoeff(output.row(i)) + 1;
     }
 
-    return charge;
+    return charges;
 }
 
 int ChargeDeterminatorNN::determineCharge(const point2dList &scanPart, double mz)
@@ -27,6 +27,8 @@
 
 _PMI_BEGIN
 
+class NeuralNetworkBatch;
+
 /*!
  * \brief Determines the charge for given part of the MS1 scan
  *
@@ -55,17 +57,31 @@ public:
      */
     int determineCharge(const Eigen::SparseVector<double> &scanSegment) const;
 
+    /*!
+     * \brief Determines the charge of every column of \a scanSegments
+     *
+     * Gives the same charges as determineCharge() called for each column, but the network layers
+     * run as one matrix-matrix product for all columns. \a batch keeps the buffers between calls.
+     *
+     * \return charge for each column, -1 for all columns if the class is not properly initialized
+     */
+    std::vector<int> determineCharges(const Eigen::SparseMatrix<double> &scanSegments,
+                                      NeuralNetworkBatch *batch) const;
+
     int determineCharge(const point2dList &scanPart, double mz) override;
 
 private:
     void buildSuccessiveCombFilters();
     bool isValid() const;
+    //! \brief fills \a input with the comb filtered \a scanSegment, normalized per filter
+    void extractNetworkInput(const Eigen::SparseVector<double> &scanSegment,
+                             Eigen::Ref<Eigen::RowVectorXd> input) const;
 
 private:
     std::vector<Eigen::SparseMatrix<double>> m_successiveCombFilters;
     std::vector<Eigen::MatrixXd> m_neuralNetworkWeights;
     ImmutableFeatureFinderParameters m_ffParams;
-    
+    int m_networkInputSize = 0;
 };
 
 _PMI_END
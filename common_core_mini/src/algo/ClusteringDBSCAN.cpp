@@ -16,107 +16,313 @@
 #error "nanoflann.hpp was responsible to define _USE_MATH_DEFINES here. We can remove the #undef _USE_MATH_DEFINES if this fails
 #endif
 
+#include <QFuture>
+#include <QThread>
+#include <QThreadPool>
+#include <QVector>
+#include <QtConcurrent/QtConcurrentRun>
+
+#include <algorithm>
+#include <numeric>
+
 _PMI_BEGIN
 
-ClusteringDBSCAN::ClusteringDBSCAN(double eps, int minSample)
-    : m_eps(eps)
-    , m_minSample(minSample)
-{
-}
+typedef nanoflann::KDTreeEigenMatrixAdaptor<Eigen::MatrixXd> KDTree;
 
-ClusteringDBSCAN::~ClusteringDBSCAN()
-{
-}
+static const int MAX_TREE_LEAF_SIZE = 30;
 
-Eigen::VectorXi ClusteringDBSCAN::performDBSCAN(const Eigen::MatrixXd &mat) const
-{
+// more chunks than threads balance the chunks with dense regions
+static const int CHUNKS_PER_THREAD = 4;
 
-    typedef nanoflann::KDTreeEigenMatrixAdaptor<Eigen::MatrixXd> KDTree;
-    int maxTreeLeafSize = 30;
-    KDTree index(mat.cols(), mat, maxTreeLeafSize);
-    
-    // This must be squared because NearNbrs library uses reduced distance metric
-    const double searchRadius = std::pow(m_eps, 2);
-    std::vector<std::pair<Eigen::Index, double>> matches;
-    nanoflann::SearchParams params;
+namespace {
 
-    std::vector<std::vector<int>> neighborhoods;
-    std::vector<double> query_pt(mat.cols());
-    neighborhoods.reserve(mat.rows());
-    for (int y = 0; y < mat.rows(); ++y) {
-        for (int z = 0; z < mat.cols(); ++z) {
-            query_pt[z] = mat(y, z);
-        }
+/*!
+ * \brief nanoflann result set counting the points within the radius. The search stops once
+ * @a limit points are found.
+ */
+class CountResultSet
+{
+public:
+    CountResultSet(double radius, size_t limit)
+        : m_radius(radius)
+        , m_limit(limit)
+        , m_count(0)
+    {
+    }
+
+    size_t size() const { return m_count; }
+    bool full() const { return true; }
+    double worstDist() const { return m_radius; }
 
-        const size_t nMatches
-            = index.index->radiusSearch(&query_pt[0], searchRadius, matches, params);
-        
-        std::vector<int> rowNeighbors;
-        rowNeighbors.reserve(nMatches);
-        for (size_t i = 0; i < nMatches; i++) {
-            rowNeighbors.push_back(matches[i].first);
+    bool addPoint(double dist, Eigen::Index)
+    {
+        if (dist < m_radius) {
+            ++m_count;
         }
-        
-        std::sort(rowNeighbors.begin(), rowNeighbors.end());
-        neighborhoods.push_back(rowNeighbors);
+        return m_count < m_limit;
     }
 
-    return dbscan(m_minSample, neighborhoods);
-}
+private:
+    const double m_radius;
+    const size_t m_limit;
+    size_t m_count;
+};
 
-Eigen::VectorXi ClusteringDBSCAN::dbscan(int minPoints,
-                                         const std::vector<std::vector<int>> &neighborhoods) const
+/*!
+ * \brief nanoflann result set collecting the unlabeled points within the radius
+ */
+class UnlabeledResultSet
 {
-    Eigen::VectorXi labels(neighborhoods.size());
-    labels.setOnes();
-    labels *= -1;
-
-    std::vector<int> nneighborhoods(neighborhoods.size());
-    std::vector<bool> coreSamples(neighborhoods.size());
-    for (size_t y = 0; y < neighborhoods.size(); ++y) {
-        int tvectorSize = static_cast<int>(neighborhoods[y].size());
-        nneighborhoods[y] = tvectorSize;
-        bool v = tvectorSize >= minPoints ? 1 : 0;
-        coreSamples[y] = v;
+public:
+    UnlabeledResultSet(double radius, const Eigen::VectorXi &labels, std::vector<int> *neighbors)
+        : m_radius(radius)
+        , m_labels(labels)
+        , m_neighbors(neighbors)
+    {
     }
 
-    dbscanInternal(coreSamples, neighborhoods, labels);
+    size_t size() const { return m_neighbors->size(); }
+    bool full() const { return true; }
+    double worstDist() const { return m_radius; }
 
-    return labels;
-}
+    bool addPoint(double dist, Eigen::Index index)
+    {
+        if (dist < m_radius && m_labels(index) == -1) {
+            m_neighbors->push_back(static_cast<int>(index));
+        }
+        return true;
+    }
+
+private:
+    const double m_radius;
+    const Eigen::VectorXi &m_labels;
+    std::vector<int> *m_neighbors;
+};
 
-void ClusteringDBSCAN::dbscanInternal(const std::vector<bool> &isCore,
-                                  const std::vector<std::vector<int>> &neighborhoods,
-                                  Eigen::VectorXi &labels) const
+/*!
+ * \brief Expands the clusters from the core points, the unlabeled neighbors of a core point are
+ * pushed in ascending index order.
+ *
+ * With @a legacyExpansion the scan for the next cluster resumes after the point expanded last, as
+ * the former materialized neighborhoods did by reusing the loop index as stack cursor. A core point
+ * skipped that way stays noise unless a later cluster reaches it.
+ *
+ * @a unlabeledNeighbors(i, labels, &neighbors) fills neighbors with the unlabeled points within the
+ * radius of point i, in any order.
+ */
+template<typename UnlabeledNeighbors>
+Eigen::VectorXi expandClusters(const std::vector<char> &isCore, bool legacyExpansion,
+                               UnlabeledNeighbors unlabeledNeighbors)
 {
+    const int size = static_cast<int>(isCore.size());
+    Eigen::VectorXi labels = Eigen::VectorXi::Constant(size, -1);
+
     int labelNum = 0;
     std::vector<int> stack;
-    for (int i = 0; i < labels.size(); ++i) {
-        if (labels(i) != -1 || !isCore[i]) {
+    std::vector<int> neighbors;
+    for (int start = 0; start < size; ++start) {
+        if (labels(start) != -1 || !isCore[start]) {
             continue;
         }
-        
+
+        int i = start;
         while (true) {
             if (labels(i) == -1) {
                 labels(i) = labelNum;
                 if (isCore[i]) {
-                    std::vector<int> neighb = neighborhoods[i];
-                    for (size_t j = 0; j < neighb.size(); ++j) {
-                        int v = neighb[j];
-                        if (labels[v] == -1) {
-                            stack.push_back(v);
-                        }
-                    }
+                    neighbors.clear();
+                    unlabeledNeighbors(i, labels, &neighbors);
+                    std::sort(neighbors.begin(), neighbors.end());
+                    stack.insert(stack.end(), neighbors.begin(), neighbors.end());
                 }
             }
-            if (stack.size() == 0) {
+            if (stack.empty()) {
                 break;
             }
             i = stack.back();
             stack.pop_back();
         }
         labelNum++;
+
+        if (legacyExpansion) {
+            start = i;
+        }
+    }
+
+    return labels;
+}
+
+} // namespace
+
+static void findCorePoints(const KDTree &index, const Eigen::MatrixXd &mat, double searchRadius,
+                           int minPoints, int begin, int end, std::vector<char> *isCore)
+{
+    const nanoflann::SearchParams params;
+    std::vector<double> queryPoint(mat.cols());
+    for (int y = begin; y < end; ++y) {
+        for (int z = 0; z < mat.cols(); ++z) {
+            queryPoint[z] = mat(y, z);
+        }
+
+        CountResultSet resultSet(searchRadius, static_cast<size_t>(minPoints));
+        index.index->findNeighbors(resultSet, queryPoint.data(), params);
+        (*isCore)[y] = static_cast<int>(resultSet.size()) >= minPoints;
+    }
+}
+
+ClusteringDBSCAN::ClusteringDBSCAN(double eps, int minSample)
+    : m_eps(eps)
+    , m_minSample(minSample)
+    , m_threadCount(0)
+    , m_legacyExpansion(true)
+{
+}
+
+ClusteringDBSCAN::~ClusteringDBSCAN()
+{
+}
+
+int ClusteringDBSCAN::threadCount() const
+{
+    return m_threadCount;
+}
+
+void ClusteringDBSCAN::setThreadCount(int threadCount)
+{
+    m_threadCount = threadCount;
+}
+
+bool ClusteringDBSCAN::legacyExpansion() const
+{
+    return m_legacyExpansion;
+}
+
+void ClusteringDBSCAN::setLegacyExpansion(bool legacyExpansion)
+{
+    m_legacyExpansion = legacyExpansion;
+}
+
+Eigen::VectorXi ClusteringDBSCAN::performDBSCAN(const Eigen::MatrixXd &mat) const
+{
+    // This must be squared because NearNbrs library uses reduced distance metric
+    const double searchRadius = std::pow(m_eps, 2);
+
+    // sorting needs ordered values, NaN is left to the k-d tree
+    if (mat.cols() == 1 && mat.allFinite()) {
+        return dbscan1D(mat.col(0), searchRadius);
     }
+
+    return dbscanKDTree(mat, searchRadius);
+}
+
+Eigen::VectorXi ClusteringDBSCAN::dbscanKDTree(const Eigen::MatrixXd &mat,
+                                               double searchRadius) const
+{
+    const int size = static_cast<int>(mat.rows());
+    if (size == 0) {
+        return Eigen::VectorXi();
+    }
+
+    KDTree index(static_cast<int>(mat.cols()), mat, MAX_TREE_LEAF_SIZE);
+
+    // a point is a core point if it has at least m_minSample neighbors, itself included
+    std::vector<char> isCore(size, 1);
+    if (m_minSample > 0) {
+        const int threadCount = (m_threadCount > 0) ? m_threadCount : QThread::idealThreadCount();
+        if (threadCount <= 1) {
+            findCorePoints(index, mat, searchRadius, m_minSample, 0, size, &isCore);
+        } else {
+            QThreadPool pool;
+            pool.setMaxThreadCount(threadCount);
+
+            const int chunkCount = threadCount * CHUNKS_PER_THREAD;
+            const int chunkSize = (size + chunkCount - 1) / chunkCount;
+            QVector<QFuture<void>> chunks;
+            for (int begin = 0; begin < size; begin += chunkSize) {
+                const int end = std::min(begin + chunkSize, size);
+                chunks.push_back(QtConcurrent::run(&pool, [&, begin, end]() {
+                    findCorePoints(index, mat, searchRadius, m_minSample, begin, end, &isCore);
+                }));
+            }
+            for (QFuture<void> &chunk : chunks) {
+                chunk.waitForFinished();
+            }
+        }
+    }
+
+    // the neighbors of every core point are queried once, when it is labeled
+    const nanoflann::SearchParams params;
+    std::vector<double> queryPoint(mat.cols());
+    return expandClusters(isCore, m_legacyExpansion, [&](int i, const Eigen::VectorXi &labels,
+                                                          std::vector<int> *neighbors) {
+        for (int z = 0; z < mat.cols(); ++z) {
+            queryPoint[z] = mat(i, z);
+        }
+        UnlabeledResultSet resultSet(searchRadius, labels, neighbors);
+        index.index->findNeighbors(resultSet, queryPoint.data(), params);
+    });
+}
+
+Eigen::VectorXi ClusteringDBSCAN::dbscan1D(const Eigen::VectorXd &values,
+                                           double searchRadius) const
+{
+    const int size = static_cast<int>(values.size());
+
+    std::vector<int> order(size);
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&values](int a, int b) {
+        return values(a) < values(b) || (values(a) == values(b) && a < b);
+    });
+
+    std::vector<double> sorted(size);
+    std::vector<int> position(size);
+    for (int p = 0; p < size; ++p) {
+        sorted[p] = values(order[p]);
+        position[order[p]] = p;
+    }
+
+    auto isNeighbor = [&sorted, searchRadius](int p, int q) {
+        const double diff = sorted[p] - sorted[q];
+        return diff * diff < searchRadius;
+    };
+
+    // neighborhood of the sorted position p is [low[p], high[p]), the same points the k-d tree
+    // finds. With zero radius the neighborhoods are empty.
+    std::vector<int> low(size);
+    std::vector<int> high(size);
+    int l = 0;
+    int h = 0;
+    for (int p = 0; p < size; ++p) {
+        if (searchRadius <= 0) {
+            low[p] = high[p] = p;
+            continue;
+        }
+        while (!isNeighbor(p, l)) {
+            ++l;
+        }
+        h = std::max(h, p + 1);
+        while (h < size && isNeighbor(h, p)) {
+            ++h;
+        }
+        low[p] = l;
+        high[p] = h;
+    }
+
+    std::vector<char> isCore(size);
+    for (int p = 0; p < size; ++p) {
+        isCore[order[p]] = high[p] - low[p] >= m_minSample;
+    }
+
+    // the neighborhoods are ranges of the sorted values, no index is needed
+    return expandClusters(isCore, m_legacyExpansion, [&](int i, const Eigen::VectorXi &labels,
+                                                          std::vector<int> *neighbors) {
+        const int p = position[i];
+        for (int q = low[p]; q < high[p]; ++q) {
+            if (labels(order[q]) == -1) {
+                neighbors->push_back(order[q]);
+            }
+        }
+    });
 }
 
 _PMI_END
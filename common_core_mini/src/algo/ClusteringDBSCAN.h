@@ -34,6 +34,10 @@ _PMI_BEGIN
  * ClusteringDBSCAN dbs(1.4, 2);
  * Eigen::VectorXi labels = dbs.performDBSCAN(mat);
  *
+ * Neighborhoods are never stored. Core points are found by counting neighbors in a k-d tree on
+ * threadCount() threads and clusters are expanded by querying the tree again for every core point.
+ * Matrices with a single column (e.g. m/z only) take the neighborhoods from the sorted values
+ * instead.
  */
 class PMI_COMMON_CORE_MINI_EXPORT ClusteringDBSCAN
 {
@@ -46,17 +50,34 @@ public:
 
     ~ClusteringDBSCAN();
 
-    // TODO: docs regarding mat
+    /*!
+     * @brief Clusters the rows of @a mat, every row is a point and every column a dimension.
+     * @return cluster label of every row, -1 for noise. Clusters are numbered in the order they
+     * are expanded, i.e. by their first core point when legacyExpansion() is off.
+     */
     Eigen::VectorXi performDBSCAN(const Eigen::MatrixXd &mat) const;
 
+    //! \brief threads used to find core points, 0 (default) means QThread::idealThreadCount()
+    int threadCount() const;
+    void setThreadCount(int threadCount);
+
+    /*!
+     * \brief Resumes the scan for the next cluster after the point expanded last, so core points
+     * with a lower index can be left as noise. On by default to keep the labels callers have
+     * always got, turn it off to expand every core point.
+     */
+    bool legacyExpansion() const;
+    void setLegacyExpansion(bool legacyExpansion);
+
 private:
-    Eigen::VectorXi dbscan(int minPoints, const std::vector<std::vector<int>> &neighborhoods) const;
-    void dbscanInternal(const std::vector<bool> &isCore,
-                     const std::vector<std::vector<int>> &neighborhoods, Eigen::VectorXi &labels) const;
+    Eigen::VectorXi dbscanKDTree(const Eigen::MatrixXd &mat, double searchRadius) const;
+    Eigen::VectorXi dbscan1D(const Eigen::VectorXd &values, double searchRadius) const;
 
 private:
     double m_eps;
     int m_minSample;
+    int m_threadCount;
+    bool m_legacyExpansion;
 };
 
 _PMI_END
@@ -8,6 +8,11 @@
 
 #include <QFile>
 #include <QTextStream>
+#include <QThread>
+#include <QThreadPool>
+#include <QtConcurrent/QtConcurrentRun>
+
+#include <algorithm>
 
 _PMI_BEGIN
 
@@ -457,43 +462,19 @@ void GridUniform::accumulate_binarySearch(const PlotBase & plot, ArithmeticType
 }
 
 
-bool GridUniform::CacheXList::isCacheValid(const GridUniform & grid) const
+void GridUniform::accumulate(const PlotBase & plot, ArithmeticType type)
 {
-    if (grid.start_x == start_x
-        && grid.scale_x == scale_x
-        && grid.y_array.size() == m_cachedXList.size() ) {
-        return true;
-    }
-    debugCoreMini() << "invalid cache. start_x,scale_x,y_array:\n"
-                << start_x << "," << scale_x << "," << m_cachedXList.size() << " vs\n "
-                << grid.start_x << "," << grid.scale_x << "," << grid.y_array.size();
-
-    return false;
+    accumulate_sorted(plot.getPointList(), type);
 }
 
-void GridUniform::CacheXList::makeCache(const GridUniform & grid)
-{
-    int size = grid.y_array.size();
-    m_cachedXList.resize(size);
-
-    start_x = grid.start_x;
-    scale_x = grid.scale_x;
-    for (int i = 0; i < size; i++) {
-        double x = grid.ix(i);  //converting from index space to world space; i.e. from i to m/z (which is x)
-        m_cachedXList[i] = x;
-    }
-}
-
-void GridUniform::accumulate(const PlotBase & plot, ArithmeticType type)
+void GridUniform::accumulate_with_xlist(const PlotBase & plot, const std::vector<double> & xs, ArithmeticType type)
 {
-    if (!m_cache.isCacheValid(*this)) {
-        m_cache.makeCache(*this);
-    }
+    std::vector<double> evaluated;
 
-    plot.evaluate_linear(m_cache.m_cachedXList, &m_cache.m_cachedEvaluatedValues);
+    plot.evaluate_linear(xs, &evaluated);
 
-    for (int i = 0; i < (int)m_cache.m_cachedEvaluatedValues.size(); i++) {
-        double yy = m_cache.m_cachedEvaluatedValues[i];
+    for (int i = 0; i < (int)evaluated.size(); i++) {
+        double yy = evaluated[i];
         double & y_array_at_idx = y_array[i];
         if (type == ArithmeticType_Add) {
             y_array_at_idx = y_array_at_idx + yy;
@@ -504,21 +485,148 @@ void GridUniform::accumulate(const PlotBase & plot, ArithmeticType type)
     }
 }
 
-void GridUniform::accumulate_with_xlist(const PlotBase & plot, const std::vector<double> & xs, ArithmeticType type)
+namespace {
+
+const int CHUNKS_PER_THREAD = 4;
+
+//! first index in [begin, size) with index * scale_x + start_x > x
+int upperIndex(double x, double start_x, double scale_x, int begin, int size)
 {
-    std::vector<double> evaluated;
+    // the estimate is corrected with the same arithmetic as GridUniform::ix()
+    const double fx = (x - start_x) / scale_x;
+    int index = (fx < begin) ? begin : ((fx >= size) ? size : static_cast<int>(fx) + 1);
+    while (index > begin && (double)(index - 1) * scale_x + start_x > x) {
+        --index;
+    }
+    while (index < size && (double)index * scale_x + start_x <= x) {
+        ++index;
+    }
+    return index;
+}
 
-    plot.evaluate_linear(xs, &evaluated);
+// contiguous and free of dependencies between iterations so that the compiler vectorizes it
+template<GridUniform::ArithmeticType type>
+void accumulateSegment(double * y, int begin, int end, double start_x, double scale_x,
+                       const point2d & left, const point2d & right)
+{
+    for (int i = begin; i < end; ++i) {
+        const double yy = interpolate_at(left, right, (double)i * scale_x + start_x);
+        if (type == GridUniform::ArithmeticType_Add) {
+            y[i] = y[i] + yy;
+        } else {
+            y[i] = y[i] - yy;
+        }
+    }
+}
 
-    for (int i = 0; i < (int)evaluated.size(); i++) {
-        double yy = evaluated[i];
-        double & y_array_at_idx = y_array[i];
-        if (type == ArithmeticType_Add) {
-            y_array_at_idx = y_array_at_idx + yy;
+}
+
+void GridUniform::accumulate_sorted(const point2dList & sortedPoints, ArithmeticType type)
+{
+    const int gridSize = y_array.size();
+    const int pointCount = static_cast<int>(sortedPoints.size());
+    if (gridSize <= 0 || pointCount <= 0) {
+        return;
+    }
+
+    // the segment of the first grid x is found the same way PlotBase::evaluate_linear() does
+    pt2idx leftIndex = GetIndexLessOrEqual(sortedPoints, ix(0), true);
+    if (leftIndex == OUT_OF_BOUNDS_ON_RIGHT) {
+        return;
+    }
+    if (leftIndex == OUT_OF_BOUNDS_ON_LEFT) {
+        leftIndex = 0;
+    }
+
+    // grid x before the first point evaluate to 0
+    const double first = sortedPoints.front().x();
+    int i = upperIndex(first, start_x, scale_x, 0, gridSize);
+    if (i > 0 && ix(i - 1) == first) {
+        --i;
+    }
+
+    double * y = y_array.data();
+    for (int right = leftIndex + 1; right < pointCount && i < gridSize; ++right) {
+        // grid x in (x of previous point, x of right point] are interpolated in this segment
+        const int end = upperIndex(sortedPoints[right].x(), start_x, scale_x, i, gridSize);
+        if (end > i) {
+            if (type == ArithmeticType_Add) {
+                accumulateSegment<ArithmeticType_Add>(y, i, end, start_x, scale_x,
+                                                      sortedPoints[right - 1], sortedPoints[right]);
+            } else {
+                accumulateSegment<ArithmeticType_Subtract>(y, i, end, start_x, scale_x,
+                                                           sortedPoints[right - 1], sortedPoints[right]);
+            }
+            i = end;
         }
-        else {
-            y_array_at_idx = y_array_at_idx - yy;
+    }
+}
+
+void GridUniform::accumulate_sorted(const QVector<point2dList> & scans, ArithmeticType type,
+                                    int chunkCount, int threadCount)
+{
+    chunkCount = std::min(chunkCount, scans.size());
+    if (chunkCount <= 1 || y_array.isEmpty()) {
+        for (const point2dList & scan : scans) {
+            accumulate_sorted(scan, type);
         }
+        return;
+    }
+
+    if (threadCount <= 0) {
+        threadCount = QThread::idealThreadCount();
+    }
+    threadCount = std::min(std::max(threadCount, 1), chunkCount);
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(threadCount);
+
+    // every chunk of scans is summed into its own grid
+    QVector<GridUniform> partials(chunkCount);
+    QVector<QFuture<void>> futures;
+    const int chunkSize = (scans.size() + chunkCount - 1) / chunkCount;
+    for (int chunk = 0; chunk < chunkCount; ++chunk) {
+        GridUniform * partial = &partials[chunk];
+        partial->start_x = start_x;
+        partial->scale_x = scale_x;
+        partial->y_array.resize(y_array.size());
+        const int begin = chunk * chunkSize;
+        const int end = std::min(begin + chunkSize, scans.size());
+        futures.push_back(QtConcurrent::run(&pool, [&scans, partial, begin, end]() {
+            for (int i = begin; i < end; ++i) {
+                partial->accumulate_sorted(scans[i], ArithmeticType_Add);
+            }
+        }));
+    }
+    for (QFuture<void> & future : futures) {
+        future.waitForFinished();
+    }
+    futures.clear();
+
+    // ranges of the grid sum the partial grids in chunk order
+    double * y = y_array.data();
+    const int gridSize = y_array.size();
+    const int rangeCount = threadCount * CHUNKS_PER_THREAD;
+    const int rangeSize = (gridSize + rangeCount - 1) / rangeCount;
+    for (int begin = 0; begin < gridSize; begin += rangeSize) {
+        const int end = std::min(begin + rangeSize, gridSize);
+        futures.push_back(QtConcurrent::run(&pool, [&partials, y, type, begin, end]() {
+            for (const GridUniform & partial : partials) {
+                const double * py = partial.y_array.constData();
+                if (type == ArithmeticType_Add) {
+                    for (int i = begin; i < end; ++i) {
+                        y[i] += py[i];
+                    }
+                } else {
+                    for (int i = begin; i < end; ++i) {
+                        y[i] -= py[i];
+                    }
+                }
+            }
+        }));
+    }
+    for (QFuture<void> & future : futures) {
+        future.waitForFinished();
     }
 }
 
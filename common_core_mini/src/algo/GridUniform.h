@@ -190,22 +190,32 @@ struct PMI_COMMON_CORE_MINI_EXPORT GridUniform
 
     void accumulate_with_xlist(const PlotBase & plot, const std::vector<double> & xs, ArithmeticType type = ArithmeticType_Add);
 
+    /*!
+     * \brief accumulates the linear interpolation of @a sortedPoints at every grid x
+     *
+     * Single linear pass merging the points with the grid; only the grid range covered by the
+     * points is touched. Gives the same values as accumulate(plot) for points sorted by x.
+     */
+    void accumulate_sorted(const point2dList & sortedPoints, ArithmeticType type = ArithmeticType_Add);
+
+    /*!
+     * \brief accumulates all @a scans, the points of every scan sorted by x
+     *
+     * The scans are split in @a chunkCount contiguous chunks accumulated into partial grids on
+     * @a threadCount threads (0 means QThread::idealThreadCount()). The partial grids are then
+     * summed in chunk order, in parallel over ranges of the grid.
+     *
+     * The rounding depends on @a chunkCount only, the result is bitwise the same for any thread
+     * count. With one chunk it is the same as accumulating the scans one by one; other chunk
+     * counts add the same values in another order and may differ in the last bits.
+     */
+    void accumulate_sorted(const QVector<point2dList> & scans, ArithmeticType type,
+                           int chunkCount, int threadCount = 0);
+
     void toByteArray_float(QByteArray & ba) const;
     void fromByteArray_float(const QByteArray & ba);
 
     Err accumulate(const GridUniform & grid, ArithmeticType type = ArithmeticType_Add);
-
-private:
-    struct CacheXList {
-        bool isCacheValid(const GridUniform & grid) const;
-        void makeCache(const GridUniform & grid);
-
-        double start_x=0;
-        double scale_x=1;
-        std::vector<double> m_cachedXList;
-        std::vector<double> m_cachedEvaluatedValues;
-    };
-    CacheXList m_cache;
 };
 
 /*
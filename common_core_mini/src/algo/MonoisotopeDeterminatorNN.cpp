@@ -9,11 +9,14 @@
 
 #include "MonoisotopeDeterminatorNN.h"
 #include "CommonFunctions.h"
+#include "NeuralNetworkBatch.h"
 
 #include "pmi_common_core_mini_debug.h"
 
 #include <QFileInfo>
 
+#include <algorithm>
+
 _PMI_BEGIN
 
 MonoisotopeDeterminatorNN::MonoisotopeDeterminatorNN()
@@ -44,8 +47,9 @@ Err MonoisotopeDeterminatorNN::init(const QString &nnFilePath)
     return e;
 }
 
-int MonoisotopeDeterminatorNN::determineMonoisotopeOffset(const Eigen::SparseVector<double> &scanSegment,
-                                                          double mz, int charge)
+void MonoisotopeDeterminatorNN::extractNetworkInput(const Eigen::SparseVector<double> &scanSegment,
+                                                    double mz, int charge,
+                                                    Eigen::Ref<Eigen::RowVectorXd> input) const
 {
     Eigen::SparseVector<double> scanSegmentNorm
         = scanSegment / scanSegment.coeff(m_ffParams.mzMatchIndex);
@@ -53,7 +57,8 @@ int MonoisotopeDeterminatorNN::determineMonoisotopeOffset(const Eigen::SparseVec
 
     double mwNNScalingImpact = 100.0;
     double mw = (charge * mz) / mwNNScalingImpact;
-    std::vector<double> passingVec = { (mw / mwNNScalingImpact) };
+    int offset = 0;
+    input(offset++) = mw / mwNNScalingImpact;
     const std::vector<Eigen::SparseMatrix<double>> &ttSuccessiveCombFilter = m_successiveCombFilters[charge - 1];
 
     for (size_t j = 0; j < ttSuccessiveCombFilter.size(); ++j) {
@@ -67,21 +72,25 @@ int MonoisotopeDeterminatorNN::determineMonoisotopeOffset(const Eigen::SparseVec
         for (int k = 1; k < tsuccessiveFilterTrans.cols(); ++k) {
             Eigen::VectorXd minMaxVector = scanSegmentNorm.cwiseProduct(tsuccessiveFilterTrans.col(k));
             double minMax = k == 0 ? minMaxVector.minCoeff() : minMaxVector.maxCoeff();
-            passingVec.push_back(minMax);
+            input(offset++) = minMax;
         }
 #else
         // this sums everything in the tooth instead of taking the max or min
         Eigen::VectorXd maxRowValues = tsuccessiveFilter * scanSegmentNorm;
         for (int i = 1; i < maxRowValues.rows(); ++i) {
-            passingVec.push_back(maxRowValues(i, 0));
+            input(offset++) = maxRowValues(i, 0);
         }
-#endif    
-
+#endif
+    }
+}
 
+int MonoisotopeDeterminatorNN::determineMonoisotopeOffset(const Eigen::SparseVector<double> &scanSegment,
+                                                          double mz, int charge)
+{
+    Eigen::RowVectorXd forwardPropagation(m_networkInputSizes[charge - 1]);
+    extractNetworkInput(scanSegment, mz, charge, forwardPropagation);
 
-    }
     // Neural Network Layers Matrix Math
-    Eigen::RowVectorXd forwardPropagation = convertVectorToEigenRowVector(passingVec);
     forwardPropagation = (forwardPropagation * m_neuralNetworkWeights[charge - 1][0])
         + m_neuralNetworkWeights[charge - 1][1];
     forwardPropagation = relu(forwardPropagation);
@@ -93,16 +102,49 @@ int MonoisotopeDeterminatorNN::determineMonoisotopeOffset(const Eigen::SparseVec
     forwardPropagation = sigmoid(forwardPropagation);
 
     // Return index of Max value.  Max value typically = 1 or close to it.
-    int monoisotopeOffset = 0;
+    return std::max(0, NeuralNetworkBatch::indexOfMaxCoeff(forwardPropagation));
+}
+
+std::vector<int> MonoisotopeDeterminatorNN::determineMonoisotopeOffsets(
+    const Eigen::SparseMatrix<double> &scanSegments, const std::vector<double> &mzs,
+    const std::vector<int> &charges, NeuralNetworkBatch *batch) const
+{
+    const int segmentCount = static_cast<int>(scanSegments.cols());
+    Q_ASSERT(static_cast<int>(mzs.size()) == segmentCount);
+    Q_ASSERT(static_cast<int>(charges.size()) == segmentCount);
+
+    std::vector<int> offsets(segmentCount, 0);
+    const int maxCharge = static_cast<int>(
+        std::min(m_neuralNetworkWeights.size(), m_successiveCombFilters.size()));
+
+    std::vector<int> columns;
+    columns.reserve(segmentCount);
+    for (int charge = 1; charge <= maxCharge; ++charge) {
+        columns.clear();
+        for (int i = 0; i < segmentCount; ++i) {
+            if (charges[i] == charge) {
+                columns.push_back(i);
+            }
+        }
+        if (columns.empty()) {
+            continue;
+        }
+
+        const int rowCount = static_cast<int>(columns.size());
+        NeuralNetworkBatch::MatrixMap input = batch->input(rowCount, m_networkInputSizes[charge - 1]);
+        for (int row = 0; row < rowCount; ++row) {
+            const int column = columns[row];
+            const Eigen::SparseVector<double> scanSegment = scanSegments.col(column);
+            extractNetworkInput(scanSegment, mzs[column], charge, input.row(row));
+        }
 
-    for (int m = 0; m < forwardPropagation.cols(); ++m) {
-        if (forwardPropagation(m) == forwardPropagation.rowwise().maxCoeff()(0)) {
-            monoisotopeOffset = m;
-            break;
+        const NeuralNetworkBatch::MatrixMap output = batch->propagate(m_neuralNetworkWeights[charge - 1]);
+        for (int row = 0; row < rowCount; ++row) {
+            offsets[columns[row]] = std::max(0, NeuralNetworkBatch::indexOfMaxCoeff(output.row(row)));
         }
     }
 
-    return monoisotopeOffset;
+    return offsets;
 }
 
 int MonoisotopeDeterminatorNN::determineMonoisotopeOffset(const pmi::point2dList &scanPart,
@@ -126,6 +168,8 @@ void MonoisotopeDeterminatorNN::buildSuccessiveCombFiltersMono()
 
         int chargeDistance = FeatureFinderUtils::hashMz(1.0 / charge, m_ffParams.vectorGranularity);
         std::vector<Eigen::SparseMatrix<double>> ttSuccessiveCombFilter;
+        // mass is the first network input
+        int inputSize = 1;
 
         for (int roll = 0; roll <= charge + 1; ++roll) {
             std::vector<Eigen::SparseVector<double>>
@@ -164,8 +208,11 @@ void MonoisotopeDeterminatorNN::buildSuccessiveCombFiltersMono()
                 tSuccessiveCombFilter.row(y) = tSuccessiveCombFilterPassing[y];
             }
             ttSuccessiveCombFilter.push_back(tSuccessiveCombFilter);
+            // the first row of each filter is not part of the network input
+            inputSize += std::max(0, static_cast<int>(tSuccessiveCombFilter.rows()) - 1);
         }
         m_successiveCombFilters.push_back(ttSuccessiveCombFilter);
+        m_networkInputSizes.push_back(inputSize);
     }
 }
 
@@ -28,6 +28,9 @@
 #include <vector>
 
 _PMI_BEGIN
+
+class NeuralNetworkBatch;
+
 /*!
 * @brief Determines the monoisotope using neural network
 */
@@ -44,14 +47,31 @@ public:
     int determineMonoisotopeOffset(const point2dList &fullScan, double mz, int charge,
                                    double *score) override;
 
+    /*!
+     * @brief Determines the monoisotope offsets of every column of @a scanSegments with the
+     * corresponding @a mzs and @a charges
+     *
+     * Gives the same offsets as determineMonoisotopeOffset() called for each column. Columns with
+     * the same charge run through the network of that charge together, as one matrix-matrix
+     * product per layer. @a batch keeps the buffers between calls.
+     */
+    std::vector<int> determineMonoisotopeOffsets(const Eigen::SparseMatrix<double> &scanSegments,
+                                                 const std::vector<double> &mzs,
+                                                 const std::vector<int> &charges,
+                                                 NeuralNetworkBatch *batch) const;
+
 private:
     void buildSuccessiveCombFiltersMono();
+    void extractNetworkInput(const Eigen::SparseVector<double> &scanSegment, double mz, int charge,
+                             Eigen::Ref<Eigen::RowVectorXd> input) const;
 
 
 private:
     std::vector<std::vector<Eigen::SparseMatrix<double>>> m_successiveCombFilters;
     std::vector<std::vector<Eigen::MatrixXd>> m_neuralNetworkWeights;
     ImmutableFeatureFinderParameters m_ffParams;
+    //! network input size for each charge
+    std::vector<int> m_networkInputSizes;
 };
 
 _PMI_END
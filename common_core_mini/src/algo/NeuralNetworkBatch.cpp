@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2019 Protein Metrics Inc. - All Rights Reserved.
+ * Unauthorized copying or distribution of this file, via any medium is strictly prohibited.
+ * Confidential.
+ */
+
+#include "NeuralNetworkBatch.h"
+
+#include <QtGlobal>
+
+_PMI_BEGIN
+
+NeuralNetworkBatch::MatrixMap NeuralNetworkBatch::input(int rowCount, int inputSize)
+{
+    m_rowCount = rowCount;
+    m_inputSize = inputSize;
+    return map(&m_input, rowCount, inputSize);
+}
+
+NeuralNetworkBatch::MatrixMap NeuralNetworkBatch::propagate(const std::vector<Eigen::MatrixXd> &weights)
+{
+    Q_ASSERT(weights.size() >= 6);
+    Q_ASSERT(weights[0].rows() == m_inputSize);
+
+    // same math as the per input propagation in ChargeDeterminatorNN, layer by layer
+    const MatrixMap input(m_input.data(), m_rowCount, m_inputSize);
+
+    MatrixMap hidden1 = map(&m_hidden1, m_rowCount, static_cast<int>(weights[0].cols()));
+    hidden1.noalias() = input * weights[0];
+    hidden1.rowwise() += weights[1].row(0);
+    hidden1 = (hidden1.array() < 0).select(0, hidden1);
+
+    MatrixMap hidden2 = map(&m_hidden2, m_rowCount, static_cast<int>(weights[2].cols()));
+    hidden2.noalias() = hidden1 * weights[2];
+    hidden2.rowwise() += weights[3].row(0);
+    hidden2 = (hidden2.array() < 0).select(0, hidden2);
+
+    MatrixMap output = map(&m_output, m_rowCount, static_cast<int>(weights[4].cols()));
+    output.noalias() = hidden2 * weights[4];
+    output.rowwise() += weights[5].row(0);
+    output = 1 / (Eigen::exp(-output.array()) + 1);
+
+    return output;
+}
+
+int NeuralNetworkBatch::indexOfMaxCoeff(const Eigen::Ref<const Eigen::RowVectorXd> &values)
+{
+    if (values.cols() == 0) {
+        return -1;
+    }
+
+    const double maxValue = values.maxCoeff();
+    for (int i = 0; i < values.cols(); ++i) {
+        if (values(i) == maxValue) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+NeuralNetworkBatch::MatrixMap NeuralNetworkBatch::map(std::vector<double> *buffer, int rowCount,
+                                                      int columnCount)
+{
+    const size_t size = static_cast<size_t>(rowCount) * static_cast<size_t>(columnCount);
+    if (buffer->size() < size) {
+        buffer->resize(size);
+    }
+    return MatrixMap(buffer->data(), rowCount, columnCount);
+}
+
+_PMI_END
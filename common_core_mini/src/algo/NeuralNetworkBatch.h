@@ -0,0 +1,69 @@
+/*
+ * Copyright (C) 2019 Protein Metrics Inc. - All Rights Reserved.
+ * Unauthorized copying or distribution of this file, via any medium is strictly prohibited.
+ * Confidential.
+ */
+
+#ifndef NEURAL_NETWORK_BATCH_H
+#define NEURAL_NETWORK_BATCH_H
+
+#include "pmi_common_core_mini_export.h"
+
+#include <pmi_core_defs.h>
+
+#include <Eigen/Core>
+
+#include <vector>
+
+_PMI_BEGIN
+
+/*!
+ * \brief Forward propagation of many inputs at once through the feature finder neural networks
+ *
+ * The networks have three dense layers with relu, relu and sigmoid activations; the weights are
+ * stored as (matrix, bias) pairs as read by readNeuralNetworkWeightsSqlQT. Each input is one row
+ * of input() and every layer is a single matrix-matrix product for all rows.
+ *
+ * Buffers only grow, so an instance reused for the batches of one scan or file does not allocate.
+ */
+class PMI_COMMON_CORE_MINI_EXPORT NeuralNetworkBatch
+{
+public:
+    typedef Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> RowMajorMatrixXd;
+    typedef Eigen::Map<RowMajorMatrixXd> MatrixMap;
+
+    /*!
+     * \brief Returns @a rowCount x @a inputSize buffer for the network inputs, one row per input
+     *
+     * Content of the buffer is undefined until filled by the caller.
+     */
+    MatrixMap input(int rowCount, int inputSize);
+
+    /*!
+     * \brief Propagates all rows of input() through the network given by @a weights
+     *
+     * \return row of network outputs for each input row, valid until the next call
+     */
+    MatrixMap propagate(const std::vector<Eigen::MatrixXd> &weights);
+
+    /*!
+     * \brief Index of the first maximal value in @a values, -1 if no value equals the maximum
+     * (e.g. NaN outputs)
+     */
+    static int indexOfMaxCoeff(const Eigen::Ref<const Eigen::RowVectorXd> &values);
+
+private:
+    static MatrixMap map(std::vector<double> *buffer, int rowCount, int columnCount);
+
+private:
+    std::vector<double> m_input;
+    std::vector<double> m_hidden1;
+    std::vector<double> m_hidden2;
+    std::vector<double> m_output;
+    int m_rowCount = 0;
+    int m_inputSize = 0;
+};
+
+_PMI_END
+
+#endif // NEURAL_NETWORK_BATCH_H
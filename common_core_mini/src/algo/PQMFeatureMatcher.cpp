@@ -12,6 +12,7 @@
 #include <common_constants.h>
 #include <QtSqlUtils.h>
 
+#include <QAtomicInt>
 #include <QFileInfo>
 #include <QSqlDatabase>
 #include "ScopedQSqlDatabase.h"
@@ -64,14 +65,17 @@ Err PQMFeatureMatcher::startMatching() const
 {
     Err e = kNoErr;
 
+    // samples are matched on several threads at once and their file names alone may repeat
+    static QAtomicInt count;
+    const int id = count.fetchAndAddOrdered(1);
+
     QSqlDatabase featuresDB;
-    QString featuresConnectionName = QStringLiteral("PQMFeatureMatcher_ftrs_%1")
-                                         .arg(QFileInfo(m_featureDBMsFilePath).completeBaseName());
+    QString featuresConnectionName = QStringLiteral("PQMFeatureMatcher_ftrs_%1").arg(id);
     ScopedQSqlDatabase featuresGuard(&featuresDB, m_featureDBMsFilePath, featuresConnectionName);
     e = featuresGuard.init(); ree;
 
     QSqlDatabase byrsltDB;
-    QString byrsltConnectionName = QString("PQMFeatureMatcher_msms_%1").arg(QFileInfo(m_byrsltFilePath).completeBaseName());
+    QString byrsltConnectionName = QString("PQMFeatureMatcher_msms_%1").arg(id);
     ScopedQSqlDatabase byrsltDBGuard(&byrsltDB, m_byrsltFilePath, byrsltConnectionName);
     e = byrsltDBGuard.init(); ree;
 
@@ -29,6 +29,12 @@ ScopedQSqlDatabase::~ScopedQSqlDatabase()
     if (m_db->isOpen()) {
         m_db->close();
     }
+
+    // the connection added by init() is removed, so unique connection names do not pile up
+    if (m_db->connectionName() == m_connectionName) {
+        *m_db = QSqlDatabase();
+        QSqlDatabase::removeDatabase(m_connectionName);
+    }
 }
 
 Err pmi::ScopedQSqlDatabase::init()
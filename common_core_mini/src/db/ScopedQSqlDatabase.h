@@ -38,7 +38,8 @@ public:
 
     ~ScopedQSqlDatabase();
     
-    //! init() call opens the database and then database is closed in destructor if it was opened.
+    //! init() call opens the database and then database is closed and its connection removed in
+    //! destructor if it was opened.
     Err init();
 
 private:
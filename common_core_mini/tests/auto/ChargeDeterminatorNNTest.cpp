@@ -9,6 +9,9 @@
 
 #include "AveragineGenerator.h"
 #include "ChargeDeterminatorNN.h"
+#include "CommonFunctions.h"
+#include "FeatureFinderParameters.h"
+#include "NeuralNetworkBatch.h"
 
 #include <pmi_core_defs.h>
 
@@ -27,8 +30,55 @@ private Q_SLOTS:
     // sophisticated generator generates scans with pre-determined/known charge and charge
     // determination is verified
     void testDetermineChargeGenerated();
+
+    // batched determination gives the same charges as the per segment one
+    void testDetermineChargesBatch();
+
+    void benchmarkDetermineCharges_data();
+    void benchmarkDetermineCharges();
+
+private:
+    // generated averagine signals of all charges with noise, one segment per column
+    static Eigen::SparseMatrix<double> generateScanSegments();
 };
 
+Eigen::SparseMatrix<double> ChargeDeterminatorNNTest::generateScanSegments()
+{
+    ImmutableFeatureFinderParameters ffParams;
+
+    const int massStart = 600;
+    const int massEnd = 10000;
+    const int massStep = 50;
+
+    AveragineGenerator generator(massStart);
+
+    std::vector<Eigen::Triplet<double>> triplets;
+    int column = 0;
+    for (int mass = massStart; mass < massEnd; mass += massStep) {
+        generator.setMass(mass);
+
+        for (int charge = 1; charge <= 10; ++charge) {
+            const double monoIsotopeMz = generator.computeMonoisotopeMz(mass, charge);
+            const point2dList data = generator.generateSignal(charge);
+            const std::vector<double> segment = FeatureFinderUtils::extractUniformIntensity(
+                data, monoIsotopeMz, ffParams.apexChargeClustering);
+
+            for (size_t y = 0; y < segment.size() && static_cast<int>(y) < ffParams.vectorArrayLength; ++y) {
+                // deterministic noise, so some segments are not clean clusters
+                const double noise = ((column * 31 + static_cast<int>(y) * 17) % 97) * 10.0;
+                if (segment[y] + noise != 0.0) {
+                    triplets.push_back(Eigen::Triplet<double>(static_cast<int>(y), column, segment[y] + noise));
+                }
+            }
+            ++column;
+        }
+    }
+
+    Eigen::SparseMatrix<double> segments(ffParams.vectorArrayLength, column);
+    segments.setFromTriplets(triplets.begin(), triplets.end());
+    return segments;
+}
+
 void pmi::ChargeDeterminatorNNTest::testDetermineChargeStatic()
 {
     QString neuralNetworkDbFilePath = QDir(qApp->applicationDirPath()).filePath("nn_weights.db");
@@ -85,6 +135,75 @@ void ChargeDeterminatorNNTest::testDetermineChargeGenerated()
     }
 }
 
+void ChargeDeterminatorNNTest::testDetermineChargesBatch()
+{
+    QString neuralNetworkDbFilePath = QDir(qApp->applicationDirPath()).filePath("nn_weights.db");
+    QVERIFY(QFileInfo::exists(neuralNetworkDbFilePath));
+
+    ChargeDeterminatorNN chargeDeterminator;
+    QCOMPARE(chargeDeterminator.init(neuralNetworkDbFilePath), kNoErr);
+
+    const Eigen::SparseMatrix<double> segments = generateScanSegments();
+    QVERIFY(segments.cols() > 0);
+
+    // the buffers are reused by the smaller batches
+    NeuralNetworkBatch batch;
+    for (int segmentCount : { static_cast<int>(segments.cols()), 1, 17 }) {
+        const Eigen::SparseMatrix<double> part = segments.leftCols(segmentCount);
+        const std::vector<int> charges = chargeDeterminator.determineCharges(part, &batch);
+        QCOMPARE(static_cast<int>(charges.size()), segmentCount);
+
+        for (int i = 0; i < segmentCount; ++i) {
+            const Eigen::SparseVector<double> segment = part.col(i);
+            QCOMPARE(charges[i], chargeDeterminator.determineCharge(segment));
+        }
+    }
+
+    // not initialized
+    ChargeDeterminatorNN invalid;
+    QCOMPARE(invalid.determineCharges(segments.leftCols(3), &batch), std::vector<int>(3, -1));
+}
+
+void ChargeDeterminatorNNTest::benchmarkDetermineCharges_data()
+{
+    QTest::addColumn<bool>("batched");
+
+    QTest::newRow("per-segment") << false;
+    QTest::newRow("batched") << true;
+}
+
+void ChargeDeterminatorNNTest::benchmarkDetermineCharges()
+{
+    QFETCH(bool, batched);
+
+    QString neuralNetworkDbFilePath = QDir(qApp->applicationDirPath()).filePath("nn_weights.db");
+    QVERIFY(QFileInfo::exists(neuralNetworkDbFilePath));
+
+    ChargeDeterminatorNN chargeDeterminator;
+    QCOMPARE(chargeDeterminator.init(neuralNetworkDbFilePath), kNoErr);
+
+    const Eigen::SparseMatrix<double> segments = generateScanSegments();
+    std::vector<Eigen::SparseVector<double>> columns;
+    for (int i = 0; i < segments.cols(); ++i) {
+        columns.push_back(segments.col(i));
+    }
+
+    NeuralNetworkBatch batch;
+    std::vector<int> charges;
+    QBENCHMARK {
+        if (batched) {
+            charges = chargeDeterminator.determineCharges(segments, &batch);
+        } else {
+            charges.clear();
+            for (const Eigen::SparseVector<double> &segment : columns) {
+                charges.push_back(chargeDeterminator.determineCharge(segment));
+            }
+        }
+    }
+
+    QCOMPARE(static_cast<int>(charges.size()), static_cast<int>(segments.cols()));
+}
+
 _PMI_END
 
 QTEST_MAIN(pmi::ChargeDeterminatorNNTest)
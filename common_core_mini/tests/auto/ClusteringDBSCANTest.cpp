@@ -0,0 +1,262 @@
+/*
+ * Copyright (C) 2018 Protein Metrics Inc. - All Rights Reserved.
+ * Unauthorized copying or distribution of this file, via any medium is strictly prohibited.
+ * Confidential.
+ */
+
+#include "ClusteringDBSCAN.h"
+
+#include <pmi_core_defs.h>
+
+#include <QtTest>
+
+#include <random>
+
+_PMI_BEGIN
+
+class ClusteringDBSCANTest : public QObject
+{
+    Q_OBJECT
+private Q_SLOTS:
+    void testSmallExample();
+
+    // the former expansion leaves the core points before the last expanded point as noise
+    void testLegacyExpansion();
+
+    // labels are the same as with materialized neighborhoods, for any thread count
+    void testReference_data();
+    void testReference();
+
+    // m/z only clustering on sorted values gives the same labels as the k-d tree
+    void testOneDimensional();
+
+    void benchmarkPerformDBSCAN_data();
+    void benchmarkPerformDBSCAN();
+
+private:
+    static Eigen::MatrixXd randomPoints(int rows, int cols, int seed);
+    static Eigen::VectorXi referenceDBSCAN(const Eigen::MatrixXd &mat, double eps, int minSample,
+                                           bool legacyExpansion);
+};
+
+Eigen::MatrixXd ClusteringDBSCANTest::randomPoints(int rows, int cols, int seed)
+{
+    // points on a coarse grid, so there are duplicates and distances equal to eps
+    std::mt19937 generator(seed);
+    std::uniform_int_distribution<int> distribution(0, 199);
+
+    Eigen::MatrixXd mat(rows, cols);
+    for (int y = 0; y < rows; ++y) {
+        for (int z = 0; z < cols; ++z) {
+            mat(y, z) = distribution(generator) * 0.25;
+        }
+    }
+    return mat;
+}
+
+Eigen::VectorXi ClusteringDBSCANTest::referenceDBSCAN(const Eigen::MatrixXd &mat, double eps,
+                                                      int minSample, bool legacyExpansion)
+{
+    const double searchRadius = eps * eps;
+    const int size = static_cast<int>(mat.rows());
+
+    std::vector<std::vector<int>> neighborhoods(size);
+    for (int i = 0; i < size; ++i) {
+        for (int j = 0; j < size; ++j) {
+            if ((mat.row(i) - mat.row(j)).squaredNorm() < searchRadius) {
+                neighborhoods[i].push_back(j);
+            }
+        }
+    }
+
+    Eigen::VectorXi labels = Eigen::VectorXi::Constant(size, -1);
+    int labelNum = 0;
+    std::vector<int> stack;
+    for (int start = 0; start < size; ++start) {
+        if (labels(start) != -1 || static_cast<int>(neighborhoods[start].size()) < minSample) {
+            continue;
+        }
+        int i = start;
+        while (true) {
+            if (labels(i) == -1) {
+                labels(i) = labelNum;
+                if (static_cast<int>(neighborhoods[i].size()) >= minSample) {
+                    for (int v : neighborhoods[i]) {
+                        if (labels(v) == -1) {
+                            stack.push_back(v);
+                        }
+                    }
+                }
+            }
+            if (stack.empty()) {
+                break;
+            }
+            i = stack.back();
+            stack.pop_back();
+        }
+        labelNum++;
+        // the former expansion reused the loop index as stack cursor
+        if (legacyExpansion) {
+            start = i;
+        }
+    }
+    return labels;
+}
+
+void ClusteringDBSCANTest::testSmallExample()
+{
+    Eigen::MatrixXd mat(8, 2);
+    mat << 10.0, 10.0,  //
+        0.0, 0.0,       //
+        0.0, 1.0,       //
+        0.0, 2.0,       //
+        10.0, 11.0,     //
+        10.0, 12.0,     //
+        50.0, 50.0,     //
+        0.0, 3.0;       //
+
+    ClusteringDBSCAN dbs(1.5, 3);
+    const Eigen::VectorXi labels = dbs.performDBSCAN(mat);
+
+    Eigen::VectorXi expected(8);
+    // clusters are numbered in the order they are expanded (from rows 2 and 4), the first row is a
+    // border point and the lonely point is noise
+    expected << 1, 0, 0, 0, 1, 1, -1, 0;
+    QCOMPARE(labels, expected);
+
+    QCOMPARE(dbs.performDBSCAN(Eigen::MatrixXd(0, 2)).size(), Eigen::Index(0));
+}
+
+void ClusteringDBSCANTest::testLegacyExpansion()
+{
+    Eigen::MatrixXd mz(7, 1);
+    mz << 1.0, 4.0, 7.0, 5.0, 4.0, 6.0, 1.0;
+    Eigen::MatrixXd mzWithZeros(mz.rows(), 2);
+    mzWithZeros.col(0) = mz.col(0);
+    mzWithZeros.col(1).setZero();
+
+    Eigen::VectorXi expected(7);
+    expected << 0, 1, 1, 1, 1, 1, 0;
+    // the first cluster ends with the last row, so the scan for the next cluster ends there too
+    Eigen::VectorXi expectedLegacy(7);
+    expectedLegacy << 0, -1, -1, -1, -1, -1, 0;
+
+    ClusteringDBSCAN dbs(1.5, 2);
+    QVERIFY(dbs.legacyExpansion());
+    QCOMPARE(dbs.performDBSCAN(mz), expectedLegacy);
+    QCOMPARE(dbs.performDBSCAN(mzWithZeros), expectedLegacy);
+
+    dbs.setLegacyExpansion(false);
+    QCOMPARE(dbs.performDBSCAN(mz), expected);
+    QCOMPARE(dbs.performDBSCAN(mzWithZeros), expected);
+}
+
+void ClusteringDBSCANTest::testReference_data()
+{
+    QTest::addColumn<int>("cols");
+    QTest::addColumn<double>("eps");
+    QTest::addColumn<int>("minSample");
+    QTest::addColumn<int>("threadCount");
+    QTest::addColumn<bool>("legacyExpansion");
+
+    for (int cols : { 1, 2, 3 }) {
+        for (double eps : { 0.0, 0.5, 1.0, 2.5 }) {
+            for (int minSample : { 0, 2, 5 }) {
+                for (int threadCount : { 1, 4 }) {
+                    for (bool legacyExpansion : { false, true }) {
+                        QTest::newRow(qPrintable(QString("cols%1_eps%2_min%3_threads%4%5")
+                                                     .arg(cols)
+                                                     .arg(eps)
+                                                     .arg(minSample)
+                                                     .arg(threadCount)
+                                                     .arg(legacyExpansion ? "_legacy" : "")))
+                            << cols << eps << minSample << threadCount << legacyExpansion;
+                    }
+                }
+            }
+        }
+    }
+}
+
+void ClusteringDBSCANTest::testReference()
+{
+    QFETCH(int, cols);
+    QFETCH(double, eps);
+    QFETCH(int, minSample);
+    QFETCH(int, threadCount);
+    QFETCH(bool, legacyExpansion);
+
+    const Eigen::MatrixXd mat = randomPoints(500, cols, cols * 100 + minSample);
+
+    ClusteringDBSCAN dbs(eps, minSample);
+    dbs.setThreadCount(threadCount);
+    dbs.setLegacyExpansion(legacyExpansion);
+    QCOMPARE(dbs.performDBSCAN(mat), referenceDBSCAN(mat, eps, minSample, legacyExpansion));
+}
+
+void ClusteringDBSCANTest::testOneDimensional()
+{
+    const Eigen::MatrixXd mz = randomPoints(2000, 1, 42);
+    Eigen::MatrixXd mzWithZeros(mz.rows(), 2);
+    mzWithZeros.col(0) = mz.col(0);
+    mzWithZeros.col(1).setZero();
+
+    for (double eps : { 0.3, 0.6, 1.4 }) {
+        ClusteringDBSCAN dbs(eps, 4);
+        QCOMPARE(dbs.performDBSCAN(mz), dbs.performDBSCAN(mzWithZeros));
+    }
+}
+
+void ClusteringDBSCANTest::benchmarkPerformDBSCAN_data()
+{
+    QTest::addColumn<int>("rows");
+    QTest::addColumn<int>("cols");
+    QTest::addColumn<int>("threadCount");
+
+    // 10M points take minutes, they are only run on request
+    QVector<int> rowCounts({ 1000000 });
+    if (qEnvironmentVariableIsSet("PMI_BENCHMARK_DBSCAN_10M")) {
+        rowCounts.push_back(10000000);
+    }
+
+    for (int rows : rowCounts) {
+        for (int cols : { 1, 2 }) {
+            for (int threadCount : { 1, 0 }) {
+                if (cols == 1 && threadCount != 1) {
+                    continue;
+                }
+                QTest::newRow(qPrintable(QString("%1M_cols%2_threads%3")
+                                             .arg(rows / 1000000)
+                                             .arg(cols)
+                                             .arg(threadCount)))
+                    << rows << cols << threadCount;
+            }
+        }
+    }
+}
+
+void ClusteringDBSCANTest::benchmarkPerformDBSCAN()
+{
+    QFETCH(int, rows);
+    QFETCH(int, cols);
+    QFETCH(int, threadCount);
+
+    // the example from the ClusteringDBSCAN docs
+    Eigen::MatrixXd mat = Eigen::MatrixXd::Random(rows, cols);
+    mat *= 10000;
+
+    ClusteringDBSCAN dbs(1.4, 2);
+    dbs.setThreadCount(threadCount);
+
+    Eigen::VectorXi labels;
+    QBENCHMARK_ONCE {
+        labels = dbs.performDBSCAN(mat);
+    }
+    QCOMPARE(labels.size(), Eigen::Index(rows));
+}
+
+_PMI_END
+
+QTEST_MAIN(pmi::ClusteringDBSCANTest)
+
+#include "ClusteringDBSCANTest.moc"
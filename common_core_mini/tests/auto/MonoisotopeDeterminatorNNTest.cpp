@@ -20,6 +20,8 @@
 #include <QtTest>
 #include "ChargeDeterminatorNN.h"
 #include "AveragineGenerator.h"
+#include "CommonFunctions.h"
+#include "NeuralNetworkBatch.h"
 
 _PMI_BEGIN
 
@@ -39,6 +41,7 @@ private Q_SLOTS :
     void testDetermineMonoisotope_data();
 
     void testDetermineMonoisotopeFromAveragine();
+    void testDetermineMonoisotopeOffsetsBatch();
 
 private:
     QDir m_testDataBasePath;
@@ -190,6 +193,63 @@ void MonoisotopeDeterminatorNNTest::testDetermineMonoisotopeFromAveragine()
     qDebug() << testCombinations << "mass/charge combinations verified!";
 }
 
+void MonoisotopeDeterminatorNNTest::testDetermineMonoisotopeOffsetsBatch()
+{
+    QString neuralNetworkDbFilePath = QDir(qApp->applicationDirPath()).filePath("nn_weights.db");
+    QVERIFY(QFileInfo::exists(neuralNetworkDbFilePath));
+
+    MonoisotopeDeterminatorNN monoDeterminator;
+    Err e = monoDeterminator.init(neuralNetworkDbFilePath);
+    QCOMPARE(e, kNoErr);
+
+    ImmutableFeatureFinderParameters ffParams;
+
+    const int massStart = 400;
+    const int massEnd = 9000;
+    const int massStep = 100;
+
+    AveragineGenerator generator(massStart);
+
+    // segments of all charges interleaved, so each batch mixes the networks
+    std::vector<Eigen::Triplet<double>> triplets;
+    std::vector<double> mzs;
+    std::vector<int> charges;
+    for (int mass = massStart; mass < massEnd; mass += massStep) {
+        generator.setMass(mass);
+
+        for (int charge = 1; charge <= 10; ++charge) {
+            double maxMz;
+            int expectedMonoisotopeOffset;
+            generator.getMaxMzAndMonoisotopeOffset(charge, &maxMz, &expectedMonoisotopeOffset);
+
+            const point2dList data = generator.generateSignal(charge);
+            const std::vector<double> segment = FeatureFinderUtils::extractUniformIntensity(
+                data, maxMz, ffParams.apexChargeClustering);
+            for (size_t y = 0; y < segment.size() && static_cast<int>(y) < ffParams.vectorArrayLength; ++y) {
+                if (segment[y] != 0.0) {
+                    triplets.push_back(Eigen::Triplet<double>(static_cast<int>(y),
+                                                              static_cast<int>(mzs.size()), segment[y]));
+                }
+            }
+            mzs.push_back(maxMz);
+            charges.push_back(charge);
+        }
+    }
+
+    Eigen::SparseMatrix<double> segments(ffParams.vectorArrayLength, static_cast<int>(mzs.size()));
+    segments.setFromTriplets(triplets.begin(), triplets.end());
+
+    NeuralNetworkBatch batch;
+    const std::vector<int> offsets
+        = monoDeterminator.determineMonoisotopeOffsets(segments, mzs, charges, &batch);
+    QCOMPARE(offsets.size(), mzs.size());
+
+    for (int i = 0; i < segments.cols(); ++i) {
+        const Eigen::SparseVector<double> segment = segments.col(i);
+        QCOMPARE(offsets[i], monoDeterminator.determineMonoisotopeOffset(segment, mzs[i], charges[i]));
+    }
+}
+
 _PMI_END
 
 PMI_TEST_GUILESS_MAIN_WITH_ARGS(pmi::MonoisotopeDeterminatorNNTest,
@@ -12,6 +12,8 @@
 #include "pmi_core_defs.h"
 
 #include <QVector>
+
+#include <utility>
 #include "common_math_types.h"
 #include "pmi_common_tiles_export.h"
 
@@ -26,8 +28,15 @@ public:
     QPoint position() const { return m_pos; }
 
     void setData(const QVector<T> &data) { m_data = data; }
+    void setData(QVector<T> &&data) { m_data = std::move(data); }
+
+    //! \brief payload of the tile; QVector is implicitly shared, so copies of the tile (e.g. the
+    // ones handed out by the tile cache) share the points until somebody writes to them
     QVector<T> data() const { return m_data; }
 
+    //! \brief read-only access to the payload, does not even touch the reference count
+    const QVector<T> &items() const { return m_data; }
+
     // return the complete mz content in the tile for given tileY
     // tileY value is computed from scan index and converted to local coordinate of the tile
     // @see NonUniformTileRange::tileOffset
@@ -52,8 +61,8 @@ public:
         return (tileOffset >= 0 && tileOffset < m_data.size());
     }
 
-    // todo: some move semantics could be used here, swap(), so far we copy data here
     void append(const T &data) { m_data.append(data); }
+    void append(T &&data) { m_data.append(std::move(data)); }
 
     bool isNull() const { return m_pos.isNull() && m_data.isEmpty(); }
 
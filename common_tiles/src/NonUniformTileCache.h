@@ -0,0 +1,253 @@
+/*
+* Copyright (C) 2019 Protein Metrics Inc. - All Rights Reserved.
+* Unauthorized copying or distribution of this file, via any medium is strictly prohibited.
+* Confidential.
+*/
+
+#ifndef NONUNIFORM_TILE_CACHE_H
+#define NONUNIFORM_TILE_CACHE_H
+
+#include "NonUniformTileBase.h"
+#include "NonUniformTileStoreBase.h"
+#include "NonUniformTileStoreMemory.h"
+
+#include "pmi_common_tiles_export.h"
+
+#include <pmi_core_defs.h>
+
+#include <QBitArray>
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QPair>
+#include <QVector>
+
+#include <algorithm>
+#include <atomic>
+#include <list>
+#include <vector>
+
+_PMI_BEGIN
+
+//! \brief approximate memory footprint of one tile row, used to size the tile cache
+template <class T>
+inline qint64 nonUniformTileItemBytes(const T &item)
+{
+    return static_cast<qint64>(sizeof(T))
+        + static_cast<qint64>(item.size()) * static_cast<qint64>(sizeof(typename T::value_type));
+}
+
+inline qint64 nonUniformTileItemBytes(const QBitArray &item)
+{
+    return static_cast<qint64>(sizeof(QBitArray)) + (item.size() + 7) / 8;
+}
+
+template <class T>
+inline qint64 nonUniformTileBytes(const NonUniformTileBase<T> &tile)
+{
+    qint64 bytes = static_cast<qint64>(sizeof(NonUniformTileBase<T>));
+    for (const T &item : tile.items()) {
+        bytes += nonUniformTileItemBytes(item);
+    }
+    return bytes;
+}
+
+/*!
+ * \brief LRU cache of NonUniformTiles limited by the memory held by the tiles.
+ *
+ * The cache is split into shards selected by tile position. Every shard has its own lock, LRU list
+ * and an equal part of the byte budget, so threads working on different tiles do not contend.
+ * One cache is shared by a NonUniformTileManagerBase and all its clones.
+ *
+ * Hit and miss counters are always maintained.
+ */
+template <class T>
+class NonUniformTileCacheBase
+{
+public:
+    typedef NonUniformTileStoreType::ContentType ContentType;
+
+    static const qint64 DEFAULT_MAX_BYTES = 64 * 1024 * 1024;
+    static const int DEFAULT_SHARD_COUNT = 16;
+
+    explicit NonUniformTileCacheBase(qint64 maxBytes = DEFAULT_MAX_BYTES,
+                                     int shardCount = DEFAULT_SHARD_COUNT)
+        : m_shards(std::max(1, shardCount))
+    {
+        setMaxBytes(maxBytes);
+    }
+
+    //! \brief @return true and the tile if it is cached, the tile becomes the most recently used
+    bool find(const QPoint &pos, ContentType type, NonUniformTileBase<T> *tile)
+    {
+        Q_ASSERT(tile);
+        const Key key(pos, type);
+        Shard &shard = shardFor(pos);
+
+        QMutexLocker locker(&shard.mutex);
+        auto it = shard.index.constFind(key);
+        if (it == shard.index.constEnd()) {
+            m_missCount++;
+            return false;
+        }
+
+        // move to the front of the LRU list
+        shard.entries.splice(shard.entries.begin(), shard.entries, it.value());
+        *tile = it.value()->tile;
+        m_hitCount++;
+        return true;
+    }
+
+    //! \brief inserts or replaces the tile, least recently used tiles of the shard are evicted
+    //! until the shard fits its budget again. The newest tile is always kept.
+    void insert(const NonUniformTileBase<T> &tile, ContentType type)
+    {
+        const qint64 shardMaxBytes = m_shardMaxBytes.load();
+        if (shardMaxBytes <= 0) {
+            return;
+        }
+
+        const Key key(tile.position(), type);
+        Shard &shard = shardFor(tile.position());
+
+        QMutexLocker locker(&shard.mutex);
+        auto it = shard.index.find(key);
+        if (it != shard.index.end()) {
+            shard.bytes -= it.value()->bytes;
+            shard.entries.erase(it.value());
+            shard.index.erase(it);
+        }
+
+        Entry entry;
+        entry.key = key;
+        entry.tile = tile;
+        entry.bytes = nonUniformTileBytes(tile);
+
+        shard.entries.push_front(entry);
+        shard.index.insert(key, shard.entries.begin());
+        shard.bytes += entry.bytes;
+
+        evict(&shard, shardMaxBytes);
+    }
+
+    bool contains(const QPoint &pos, ContentType type) const
+    {
+        const Shard &shard = shardFor(pos);
+        QMutexLocker locker(&shard.mutex);
+        return shard.index.contains(Key(pos, type));
+    }
+
+    void clear()
+    {
+        for (Shard &shard : m_shards) {
+            QMutexLocker locker(&shard.mutex);
+            shard.entries.clear();
+            shard.index.clear();
+            shard.bytes = 0;
+        }
+    }
+
+    //! \brief sets the byte budget, 0 disables caching
+    void setMaxBytes(qint64 maxBytes)
+    {
+        m_maxBytes = std::max<qint64>(0, maxBytes);
+        m_shardMaxBytes = m_maxBytes.load() / static_cast<qint64>(m_shards.size());
+
+        const qint64 shardMaxBytes = m_shardMaxBytes.load();
+        for (Shard &shard : m_shards) {
+            QMutexLocker locker(&shard.mutex);
+            if (shardMaxBytes <= 0) {
+                shard.entries.clear();
+                shard.index.clear();
+                shard.bytes = 0;
+            } else {
+                evict(&shard, shardMaxBytes);
+            }
+        }
+    }
+
+    qint64 maxBytes() const { return m_maxBytes.load(); }
+
+    qint64 bytes() const
+    {
+        qint64 sum = 0;
+        for (const Shard &shard : m_shards) {
+            QMutexLocker locker(&shard.mutex);
+            sum += shard.bytes;
+        }
+        return sum;
+    }
+
+    int count() const
+    {
+        int sum = 0;
+        for (const Shard &shard : m_shards) {
+            QMutexLocker locker(&shard.mutex);
+            sum += shard.index.size();
+        }
+        return sum;
+    }
+
+    int shardCount() const { return static_cast<int>(m_shards.size()); }
+
+    qint64 hitCount() const { return m_hitCount.load(); }
+    qint64 missCount() const { return m_missCount.load(); }
+
+    void resetCounters()
+    {
+        m_hitCount = 0;
+        m_missCount = 0;
+    }
+
+private:
+    typedef QPair<QPoint, int> Key;
+
+    struct Entry {
+        Key key;
+        NonUniformTileBase<T> tile;
+        qint64 bytes = 0;
+    };
+
+    struct Shard {
+        mutable QMutex mutex;
+        // front is the most recently used tile
+        std::list<Entry> entries;
+        QHash<Key, typename std::list<Entry>::iterator> index;
+        qint64 bytes = 0;
+    };
+
+    Shard &shardFor(const QPoint &pos) { return m_shards[shardIndex(pos)]; }
+    const Shard &shardFor(const QPoint &pos) const { return m_shards[shardIndex(pos)]; }
+
+    int shardIndex(const QPoint &pos) const
+    {
+        return static_cast<int>(qHash(pos, 0) % static_cast<uint>(m_shards.size()));
+    }
+
+    //! \brief shard lock has to be held
+    static void evict(Shard *shard, qint64 shardMaxBytes)
+    {
+        while (shard->bytes > shardMaxBytes && shard->entries.size() > 1) {
+            const Entry &last = shard->entries.back();
+            shard->bytes -= last.bytes;
+            shard->index.remove(last.key);
+            shard->entries.pop_back();
+        }
+    }
+
+private:
+    Q_DISABLE_COPY(NonUniformTileCacheBase)
+
+    // std::vector as QVector requires copyable elements and QMutex is not
+    std::vector<Shard> m_shards;
+    std::atomic<qint64> m_maxBytes{ 0 };
+    std::atomic<qint64> m_shardMaxBytes{ 0 };
+    std::atomic<qint64> m_hitCount{ 0 };
+    std::atomic<qint64> m_missCount{ 0 };
+};
+
+typedef NonUniformTileCacheBase<point2dList> NonUniformTileCache;
+
+_PMI_END
+
+#endif // NONUNIFORM_TILE_CACHE_H
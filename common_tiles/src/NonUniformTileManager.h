@@ -9,33 +9,17 @@
 #ifndef NONUNIFORM_TILE_MANAGER_H
 #define NONUNIFORM_TILE_MANAGER_H
 
+#include "NonUniformTileCache.h"
 #include "NonUniformTileStoreBase.h"
-#include "NonUniformTileStoreMemory.h"
 
 #include "pmi_common_tiles_export.h"
 
 #include <pmi_core_defs.h>
 
-#include <QScopedPointer>
+#include <QSharedPointer>
 
 _PMI_BEGIN
 
-#define PROFILE_TILE_FETCHING
-#ifdef PROFILE_TILE_FETCHING
-
-class TileFetchCounter
-{
-public:
-    void increase() { m_count++; }
-    void reset() { m_count = 0; }
-    int value() const { return m_count; }
-
-private:
-    int m_count = 0;
-};
-
-#endif
-
 template <class T>
 class PMI_COMMON_TILES_EXPORT NonUniformTileManagerBase
 {
@@ -44,6 +28,7 @@ public:
     explicit NonUniformTileManagerBase(NonUniformTileStoreBase<T> *store, bool ownStore = false)
         : m_store(store)
         , m_ownStore(ownStore)
+        , m_cache(QSharedPointer<NonUniformTileCacheBase<T>>::create())
     {
     }
 
@@ -56,63 +41,47 @@ public:
 
     NonUniformTileBase<T> loadTile(const QPoint &tilePos, NonUniformTileStoreType::ContentType type)
     {
-        bool useCache = m_cache.contains(tilePos, type);
-
-#ifdef PROFILE_TILE_FETCHING
-        if (useCache) {
-            m_cacheCounter.increase();
-        } else {
-            m_DbCounter.increase();
+        NonUniformTileBase<T> tile;
+        if (m_cache->find(tilePos, type, &tile)) {
+            return tile;
         }
-#endif
-
-        NonUniformTileBase<T> tile
-            = useCache ? m_cache.loadTile(tilePos, type) : m_store->loadTile(tilePos, type);
 
-        if (!useCache && (m_maxCacheItems > 0)) {
-            if (m_cache.count(type) >= m_maxCacheItems) {
-                m_cache.clear();
-            }
-            m_cache.saveTile(tile, type);
+        tile = m_store->loadTile(tilePos, type);
+        if (!tile.isNull()) {
+            m_cache->insert(tile, type);
         }
 
         return tile;
     }
 
-    void setCacheSize(int cacheSize) {
-        m_maxCacheItems = cacheSize;
-        if (cacheSize == 0) {
-            m_cache.clear();
-        }
-    }
+    //! \brief sets the memory budget of the tile cache in bytes, 0 disables the cache
+    //! @note the cache is shared with the clones, @see clone()
+    void setCacheSizeBytes(qint64 bytes) { m_cache->setMaxBytes(bytes); }
 
-    int cacheSize() const { return m_maxCacheItems; }
+    qint64 cacheSizeBytes() const { return m_cache->maxBytes(); }
 
-#ifdef PROFILE_TILE_FETCHING
-    void resetFetchCounters()
-    {
-        m_DbCounter.reset();
-        m_cacheCounter.reset();
-    }
+    void resetFetchCounters() { m_cache->resetCounters(); }
 
-    void fetchCounts(int *dbTileCount, int *cacheTileCount)
+    //! \brief @return tiles fetched from the store and from the cache since last reset
+    void fetchCounts(int *dbTileCount, int *cacheTileCount) const
     {
         if (dbTileCount) {
-            *dbTileCount = m_DbCounter.value();
+            *dbTileCount = static_cast<int>(m_cache->missCount());
         }
 
         if (cacheTileCount) {
-            *cacheTileCount = m_cacheCounter.value();
+            *cacheTileCount = static_cast<int>(m_cache->hitCount());
         }
     }
-#endif
 
+    NonUniformTileCacheBase<T> *cache() const { return m_cache.data(); }
+
+    //! \brief clones the store, the tile cache is shared between this manager and the clone
     virtual NonUniformTileManagerBase<T> *clone() const
     {
         NonUniformTileStoreBase<T> *store = m_store->clone();
 
         NonUniformTileManagerBase<T> *clonedManager = new NonUniformTileManagerBase<T>(store, true);
-        clonedManager->m_maxCacheItems = m_maxCacheItems;
         clonedManager->m_cache = m_cache;
         return clonedManager;
     }
@@ -124,13 +93,7 @@ private:
     NonUniformTileStoreBase<T> *m_store;
     bool m_ownStore;
 
-    int m_maxCacheItems = 9;
-    NonUniformTileStoreMemoryBase<T> m_cache;
-
-#ifdef PROFILE_TILE_FETCHING
-    TileFetchCounter m_cacheCounter;
-    TileFetchCounter m_DbCounter;
-#endif
+    QSharedPointer<NonUniformTileCacheBase<T>> m_cache;
 };
 
 typedef NonUniformTileManagerBase<point2dList> NonUniformTileManager;
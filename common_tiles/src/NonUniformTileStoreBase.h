@@ -29,7 +29,7 @@ public:
     virtual ~NonUniformTileStoreBase() {}
     
     virtual bool saveTile(const NonUniformTileBase<T> &t, ContentType type) = 0;
-    virtual const NonUniformTileBase<T> loadTile(const QPoint &pos, ContentType type) = 0;
+    virtual NonUniformTileBase<T> loadTile(const QPoint &pos, ContentType type) = 0;
 
     // returns true if the store contains the tile at the position, false otherwise
     virtual bool contains(const QPoint &pos, ContentType type) = 0;
@@ -48,7 +48,19 @@ public:
         return true;
     }
 
-    const NonUniformTileBase<T> loadTile(const QPoint &pos, ContentType type) override {
+    //! \brief moves the tile into the store, @see saveTile
+    bool saveTile(NonUniformTileBase<T> &&t, ContentType type) {
+        QHash <QPoint, NonUniformTileBase<T>> &backend = contentTypeToStorage(type);
+        if (backend.contains(t.position())) {
+            return false;
+        }
+
+        const QPoint pos = t.position();
+        backend.insert(pos, std::move(t));
+        return true;
+    }
+
+    NonUniformTileBase<T> loadTile(const QPoint &pos, ContentType type) override {
         QHash <QPoint, NonUniformTileBase<T>> &backend = contentTypeToStorage(type);
         return backend.value(pos);
     }
@@ -0,0 +1,406 @@
+/*
+* Copyright (C) 2019 Protein Metrics Inc. - All Rights Reserved.
+* Unauthorized copying or distribution of this file, via any medium is strictly prohibited.
+* Confidential.
+*/
+
+#include "NonUniformTileStoreMmap.h"
+#include "NonUniformTileStoreSqlite.h"
+
+#include "pmi_common_tiles_debug.h"
+
+#include <QFile>
+#include <QSaveFile>
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <tuple>
+
+_PMI_BEGIN
+
+namespace {
+
+const char FILE_MAGIC[8] = { 'P', 'M', 'I', 'N', 'U', 'T', 'M', 'M' };
+const quint32 FILE_VERSION = 1;
+// the file is written in the native byte order, the mark detects files from other platforms
+const quint32 BYTE_ORDER_MARK = 0x01020304;
+
+struct FileHeader {
+    char magic[8];
+    quint32 version;
+    quint32 headerSize;
+    quint32 byteOrderMark;
+    quint32 entryCount;
+    quint64 indexOffset;
+    quint64 fileSize;
+    quint64 reserved[3];
+};
+
+static_assert(sizeof(FileHeader) == 64, "FileHeader is part of the file format");
+
+quint64 alignTo8(quint64 value)
+{
+    return (value + 7) & ~quint64(7);
+}
+
+//! \brief scan sizes padded to 8 bytes followed by the m/z and the intensity column
+quint64 tileBlockSize(quint32 scanCount, quint64 pointCount)
+{
+    return alignTo8(scanCount * sizeof(quint32)) + pointCount * 2 * sizeof(double);
+}
+
+}
+
+struct NonUniformTileStoreMmap::IndexEntry {
+    qint32 contentType;
+    qint32 posY;
+    qint32 posX;
+    quint32 scanCount;
+    quint64 offset;
+    quint64 pointCount;
+
+    std::tuple<qint32, qint32, qint32> key() const
+    {
+        return std::make_tuple(contentType, posY, posX);
+    }
+};
+
+class NonUniformTileStoreMmap::MappedFile
+{
+public:
+    ~MappedFile()
+    {
+        if (data) {
+            file.unmap(data);
+        }
+    }
+
+    QFile file;
+    uchar *data = nullptr;
+    qint64 size = 0;
+
+    const IndexEntry *entries = nullptr;
+    int entryCount = 0;
+};
+
+NonUniformTileStoreMmap::NonUniformTileStoreMmap()
+{
+}
+
+NonUniformTileStoreMmap::~NonUniformTileStoreMmap()
+{
+}
+
+bool NonUniformTileStoreMmap::open(const QString &filePath)
+{
+    static_assert(sizeof(IndexEntry) == 32, "IndexEntry is part of the file format");
+
+    close();
+
+    QSharedPointer<MappedFile> mapped(new MappedFile);
+    mapped->file.setFileName(filePath);
+    if (!mapped->file.open(QIODevice::ReadOnly)) {
+        warningTiles() << "Cannot open tile file" << filePath;
+        return false;
+    }
+
+    mapped->size = mapped->file.size();
+    if (mapped->size < static_cast<qint64>(sizeof(FileHeader))) {
+        warningTiles() << "Tile file is too small" << filePath;
+        return false;
+    }
+
+    mapped->data = mapped->file.map(0, mapped->size);
+    if (!mapped->data) {
+        warningTiles() << "Cannot map tile file" << filePath << mapped->file.errorString();
+        return false;
+    }
+
+    const FileHeader *header = reinterpret_cast<const FileHeader *>(mapped->data);
+    const quint64 fileSize = static_cast<quint64>(mapped->size);
+    if (std::memcmp(header->magic, FILE_MAGIC, sizeof(FILE_MAGIC)) != 0
+        || header->version != FILE_VERSION
+        || header->headerSize != sizeof(FileHeader)
+        || header->byteOrderMark != BYTE_ORDER_MARK
+        || header->fileSize != fileSize
+        || header->indexOffset % 8 != 0
+        || header->indexOffset < sizeof(FileHeader)
+        || header->indexOffset > fileSize
+        || (fileSize - header->indexOffset) / sizeof(IndexEntry) < header->entryCount) {
+        warningTiles() << "Invalid tile file header" << filePath;
+        return false;
+    }
+
+    mapped->entries = reinterpret_cast<const IndexEntry *>(mapped->data + header->indexOffset);
+    mapped->entryCount = static_cast<int>(header->entryCount);
+
+    // validate the index once, loadTile() relies on it
+    for (int i = 0; i < mapped->entryCount; ++i) {
+        const IndexEntry &entry = mapped->entries[i];
+        const bool sorted = (i == 0) || (mapped->entries[i - 1].key() < entry.key());
+        const bool pointCountOk = entry.pointCount <= header->indexOffset / (2 * sizeof(double));
+        if (!sorted || !pointCountOk
+            || entry.offset % 8 != 0
+            || entry.offset < sizeof(FileHeader)
+            || entry.offset > header->indexOffset
+            || header->indexOffset - entry.offset < tileBlockSize(entry.scanCount, entry.pointCount)) {
+            warningTiles() << "Invalid tile file index entry" << i << filePath;
+            return false;
+        }
+    }
+
+    m_file = mapped;
+    return true;
+}
+
+void NonUniformTileStoreMmap::close()
+{
+    m_file.reset();
+}
+
+bool NonUniformTileStoreMmap::isOpen() const
+{
+    return !m_file.isNull();
+}
+
+QString NonUniformTileStoreMmap::filePath() const
+{
+    return m_file ? m_file->file.fileName() : QString();
+}
+
+const NonUniformTileStoreMmap::IndexEntry *NonUniformTileStoreMmap::findEntry(const QPoint &pos,
+                                                                              ContentType type) const
+{
+    if (!m_file) {
+        return nullptr;
+    }
+
+    const IndexEntry *begin = m_file->entries;
+    const IndexEntry *end = m_file->entries + m_file->entryCount;
+    const auto key = std::make_tuple(static_cast<qint32>(type), static_cast<qint32>(pos.y()),
+                                     static_cast<qint32>(pos.x()));
+
+    const IndexEntry *it = std::lower_bound(
+        begin, end, key,
+        [](const IndexEntry &entry, const std::tuple<qint32, qint32, qint32> &value) {
+            return entry.key() < value;
+        });
+
+    if (it == end || it->key() != key) {
+        return nullptr;
+    }
+    return it;
+}
+
+NonUniformTile NonUniformTileStoreMmap::loadTile(const QPoint &pos, ContentType type)
+{
+    NonUniformTile result;
+
+    const IndexEntry *entry = findEntry(pos, type);
+    if (!entry) {
+        //return null tile
+        return result;
+    }
+
+    const uchar *block = m_file->data + entry->offset;
+    const quint32 *scanSizes = reinterpret_cast<const quint32 *>(block);
+    const double *mz = reinterpret_cast<const double *>(
+        block + alignTo8(entry->scanCount * sizeof(quint32)));
+    const double *intensity = mz + entry->pointCount;
+
+    QVector<point2dList> tileContent;
+    tileContent.reserve(static_cast<int>(entry->scanCount));
+
+    quint64 position = 0;
+    for (quint32 i = 0; i < entry->scanCount; ++i) {
+        const quint32 size = scanSizes[i];
+        if (size > entry->pointCount - position) {
+            warningTiles() << "Corrupted tile" << pos << "in" << m_file->file.fileName();
+            return NonUniformTile();
+        }
+
+        point2dList scanNumber;
+        scanNumber.reserve(size);
+        for (quint64 end = position + size; position < end; ++position) {
+            scanNumber.push_back(QPointF(mz[position], intensity[position]));
+        }
+        tileContent.push_back(std::move(scanNumber));
+    }
+
+    result.setPosition(pos);
+    result.setData(std::move(tileContent));
+    return result;
+}
+
+bool NonUniformTileStoreMmap::contains(const QPoint &pos, ContentType type)
+{
+    return findEntry(pos, type) != nullptr;
+}
+
+bool NonUniformTileStoreMmap::saveTile(const NonUniformTile &t, ContentType type)
+{
+    Q_UNUSED(type);
+    warningTiles() << "NonUniformTileStoreMmap is read-only, tile" << t.position() << "not saved";
+    return false;
+}
+
+bool NonUniformTileStoreMmap::startPartial()
+{
+    throw std::logic_error("The method or operation is not implemented.");
+}
+
+bool NonUniformTileStoreMmap::endPartial()
+{
+    throw std::logic_error("The method or operation is not implemented.");
+}
+
+bool NonUniformTileStoreMmap::savePartialTile(const NonUniformTile &t, ContentType type,
+                                              quint32 writePass)
+{
+    throw std::logic_error("The method or operation is not implemented.");
+}
+
+bool NonUniformTileStoreMmap::initTilePartCache()
+{
+    throw std::logic_error("The method or operation is not implemented.");
+}
+
+bool NonUniformTileStoreMmap::dropTilePartCache()
+{
+    throw std::logic_error("The method or operation is not implemented.");
+}
+
+bool NonUniformTileStoreMmap::defragmentTiles(NonUniformTileStore *dstStore)
+{
+    throw std::logic_error("The method or operation is not implemented.");
+}
+
+NonUniformTileStore *NonUniformTileStoreMmap::clone() const
+{
+    if (!m_file) {
+        return nullptr;
+    }
+
+    NonUniformTileStoreMmap *store = new NonUniformTileStoreMmap;
+    store->m_file = m_file;
+    return store;
+}
+
+int NonUniformTileStoreMmap::count(ContentType type) const
+{
+    if (!m_file) {
+        return 0;
+    }
+
+    const IndexEntry *begin = m_file->entries;
+    const IndexEntry *end = m_file->entries + m_file->entryCount;
+    return static_cast<int>(std::count_if(begin, end, [type](const IndexEntry &entry) {
+        return entry.contentType == static_cast<qint32>(type);
+    }));
+}
+
+quint64 NonUniformTileStoreMmap::pointCount(ContentType type) const
+{
+    quint64 sum = 0;
+    if (!m_file) {
+        return sum;
+    }
+
+    for (int i = 0; i < m_file->entryCount; ++i) {
+        const IndexEntry &entry = m_file->entries[i];
+        if (entry.contentType == static_cast<qint32>(type)) {
+            sum += entry.pointCount;
+        }
+    }
+    return sum;
+}
+
+bool NonUniformTileStoreMmap::exportFromSqlite(NonUniformTileStoreSqlite *source,
+                                               const QString &filePath)
+{
+    QSaveFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        warningTiles() << "Cannot create tile file" << filePath;
+        return false;
+    }
+
+    // header is written again once the index is known
+    FileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, FILE_MAGIC, sizeof(FILE_MAGIC));
+    header.version = FILE_VERSION;
+    header.headerSize = sizeof(FileHeader);
+    header.byteOrderMark = BYTE_ORDER_MARK;
+
+    if (file.write(reinterpret_cast<const char *>(&header), sizeof(header)) != sizeof(header)) {
+        warningTiles() << "Cannot write tile file" << filePath;
+        return false;
+    }
+
+    // entries have to be sorted by content type, y and x; positions come sorted by y and x
+    const ContentType types[] = { ContentMS1Raw, ContentMS1Centroided };
+
+    QVector<IndexEntry> entries;
+    quint64 offset = sizeof(FileHeader);
+    QByteArray block;
+    for (ContentType type : types) {
+        for (const QPoint &pos : source->tilePositions(type)) {
+            const NonUniformTile tile = source->loadTile(pos, type);
+            const QVector<point2dList> &tileContent = tile.items();
+
+            IndexEntry entry;
+            entry.contentType = static_cast<qint32>(type);
+            entry.posY = pos.y();
+            entry.posX = pos.x();
+            entry.scanCount = static_cast<quint32>(tileContent.size());
+            entry.offset = offset;
+            entry.pointCount = 0;
+            for (const point2dList &scanNumber : tileContent) {
+                entry.pointCount += scanNumber.size();
+            }
+
+            block.fill(0, static_cast<int>(tileBlockSize(entry.scanCount, entry.pointCount)));
+            quint32 *scanSizes = reinterpret_cast<quint32 *>(block.data());
+            double *mz = reinterpret_cast<double *>(
+                block.data() + alignTo8(entry.scanCount * sizeof(quint32)));
+            double *intensity = mz + entry.pointCount;
+
+            for (const point2dList &scanNumber : tileContent) {
+                *scanSizes++ = static_cast<quint32>(scanNumber.size());
+                for (const QPointF &mzIntensity : scanNumber) {
+                    *mz++ = mzIntensity.x();
+                    *intensity++ = mzIntensity.y();
+                }
+            }
+
+            if (file.write(block) != block.size()) {
+                warningTiles() << "Cannot write tile file" << filePath;
+                return false;
+            }
+
+            entries.push_back(entry);
+            offset += block.size();
+        }
+    }
+
+    const qint64 indexBytes = entries.size() * static_cast<qint64>(sizeof(IndexEntry));
+    if (file.write(reinterpret_cast<const char *>(entries.constData()), indexBytes) != indexBytes) {
+        warningTiles() << "Cannot write tile file" << filePath;
+        return false;
+    }
+
+    header.entryCount = static_cast<quint32>(entries.size());
+    header.indexOffset = offset;
+    header.fileSize = offset + indexBytes;
+
+    if (!file.seek(0)
+        || file.write(reinterpret_cast<const char *>(&header), sizeof(header)) != sizeof(header)) {
+        warningTiles() << "Cannot write tile file" << filePath;
+        return false;
+    }
+
+    return file.commit();
+}
+
+_PMI_END
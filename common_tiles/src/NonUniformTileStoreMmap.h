@@ -0,0 +1,89 @@
+/*
+* Copyright (C) 2019 Protein Metrics Inc. - All Rights Reserved.
+* Unauthorized copying or distribution of this file, via any medium is strictly prohibited.
+* Confidential.
+*/
+
+#ifndef NON_UNIFORM_TILESTORE_MMAP_H
+#define NON_UNIFORM_TILESTORE_MMAP_H
+
+#include "pmi_core_defs.h"
+
+#include "NonUniformTileStore.h"
+#include "pmi_common_tiles_export.h"
+
+#include <QSharedPointer>
+#include <QString>
+
+_PMI_BEGIN
+
+class NonUniformTileStoreSqlite;
+
+/*!
+ * \brief Read-only NonUniformTileStore backed by a memory mapped file
+ *
+ * The file is a fixed header, the index of tile positions sorted by content, y and x and the tile
+ * data. Every tile is stored as its scan sizes followed by the m/z column and the intensity column.
+ * Loading a tile is a binary search in the mapped index and a copy of the columns into the tile;
+ * no query or blob decoding is involved.
+ *
+ * The file is created from the sqlite store with exportFromSqlite(). Tiles are loaded as the
+ * sqlite store loads them. Clones share the mapping and can be used from other threads.
+ */
+class PMI_COMMON_TILES_EXPORT NonUniformTileStoreMmap : public NonUniformTileStore
+{
+
+public:
+    NonUniformTileStoreMmap();
+    ~NonUniformTileStoreMmap();
+
+    //! \brief maps the file, @return false if the file can't be mapped or is not valid
+    bool open(const QString &filePath);
+    void close();
+    bool isOpen() const;
+    QString filePath() const;
+
+    //! \brief the store is read-only, saving always fails
+    bool saveTile(const NonUniformTile &t, ContentType type) override;
+    NonUniformTile loadTile(const QPoint &pos, ContentType type) override;
+    bool contains(const QPoint &pos, ContentType type) override;
+
+    bool start() override { return true; }
+    bool end() override { return true; }
+    //! \brief nothing is cached, the mapped pages are managed by the OS
+    void clear() override {}
+
+    bool startPartial() override;
+    bool endPartial() override;
+    bool savePartialTile(const NonUniformTile &t, ContentType type, quint32 writePass) override;
+    bool initTilePartCache() override;
+    bool dropTilePartCache() override;
+    bool defragmentTiles(NonUniformTileStore *dstStore) override;
+
+    //! \brief new store sharing the mapping, nullptr if this store is not open
+    NonUniformTileStore *clone() const override;
+
+    //! \brief number of tiles of given type
+    int count(ContentType type) const;
+
+    //! \brief number of points in all tiles of given type
+    quint64 pointCount(ContentType type) const;
+
+    //! \brief writes all tiles of @a source to @a filePath in the format mapped by this store
+    //
+    // The file is written to a temporary file first and replaces @a filePath when complete
+    static bool exportFromSqlite(NonUniformTileStoreSqlite *source, const QString &filePath);
+
+private:
+    class MappedFile;
+    struct IndexEntry;
+
+    const IndexEntry *findEntry(const QPoint &pos, ContentType type) const;
+
+private:
+    QSharedPointer<MappedFile> m_file;
+};
+
+_PMI_END
+
+#endif // NON_UNIFORM_TILESTORE_MMAP_H
@@ -38,7 +38,7 @@ NonUniformTileStoreSqlite::~NonUniformTileStoreSqlite()
     }
 }
 
-const NonUniformTile NonUniformTileStoreSqlite::loadTile(const QPoint &pos, ContentType type)
+NonUniformTile NonUniformTileStoreSqlite::loadTile(const QPoint &pos, ContentType type)
 {
     NonUniformTile result;
 
@@ -140,6 +140,12 @@ bool NonUniformTileStoreSqlite::dropTilePartCache()
 
 
 bool NonUniformTileStoreSqlite::saveTile(const NonUniformTile &t, ContentType type)
+{
+    return saveEncodedTile(encodeTile(t, type));
+}
+
+NonUniformTilesEncodedEntry NonUniformTileStoreSqlite::encodeTile(const NonUniformTile &t,
+                                                                  ContentType type) const
 {
     // convert in-memory representation into db representation 
     NonUniformTilesDaoEntry entry;
@@ -157,8 +163,13 @@ bool NonUniformTileStoreSqlite::saveTile(const NonUniformTile &t, ContentType ty
         entry.index.clear();
     }
 
+    return NonUniformTilesDao::encodeTile(entry, m_encoding);
+}
+
+bool NonUniformTileStoreSqlite::saveEncodedTile(const NonUniformTilesEncodedEntry &entry)
+{
     NonUniformTilesDao dao(m_db);
-    return (dao.saveTile(entry) == kNoErr);
+    return (dao.saveEncodedTile(entry) == kNoErr);
 }
 
 NonUniformTileStore::ContentType NonUniformTileStoreSqlite::contentTypeFromDaoString(const QString& daoString) const
@@ -173,7 +184,7 @@ NonUniformTileStore::ContentType NonUniformTileStoreSqlite::contentTypeFromDaoSt
     return NonUniformTileStore::ContentMS1Raw;
 }
 
-void NonUniformTileStoreSqlite::serializeTilePart(const NonUniformTile &t, QVector<int> * indexes, QVector<double> * mz, QVector<double> * intensity, qint32 * pointCount)
+void NonUniformTileStoreSqlite::serializeTilePart(const NonUniformTile &t, QVector<int> * indexes, QVector<double> * mz, QVector<double> * intensity, qint32 * pointCount) const
 {
     if (!indexes || !mz || !intensity || !pointCount) {
         return;
@@ -183,7 +194,7 @@ void NonUniformTileStoreSqlite::serializeTilePart(const NonUniformTile &t, QVect
     mz->clear();
     intensity->clear();
 
-    const QVector<point2dList> &tileContent = t.data();
+    const QVector<point2dList> &tileContent = t.items();
     
     indexes->reserve(tileContent.size());
     for (const point2dList& scanNumber : tileContent) {
@@ -218,12 +229,12 @@ void NonUniformTileStoreSqlite::deserializePartTile(const QVector<int> &indexes,
             double currIntensity = intensity.at(startPos);
             scanNumber.push_back(QPointF(currMz, currIntensity));
         }
-        tileContent.push_back(scanNumber);
+        tileContent.push_back(std::move(scanNumber));
 
         indexPosition += size;
     }
 
-    tile->setData(tileContent);
+    tile->setData(std::move(tileContent));
 }
 
 QSharedPointer<QSqlDatabase> NonUniformTileStoreSqlite::createTilePartDbConnection(const QString &dbFilePath, bool * ok)
@@ -340,7 +351,9 @@ NonUniformTileStore *NonUniformTileStoreSqlite::clone() const
     }
 
     bool ownDb = true;
-    return new NonUniformTileStoreSqlite(db.take(), ownDb);
+    NonUniformTileStoreSqlite *store = new NonUniformTileStoreSqlite(db.take(), ownDb);
+    store->setEncoding(m_encoding);
+    return store;
 }
 
 quint32 NonUniformTileStoreSqlite::pointCount(ContentType type, const QRect &tileRect)
@@ -351,6 +364,45 @@ quint32 NonUniformTileStoreSqlite::pointCount(ContentType type, const QRect &til
     return (e == kNoErr) ? count : -1;
 }
 
+QVector<QPoint> NonUniformTileStoreSqlite::tilePositions(ContentType type)
+{
+    NonUniformTilesDao dao(m_db);
+    QVector<QPoint> result;
+    Err e = dao.positions(contentTypeToDaoString(type), &result); eee_absorb;
+    return result;
+}
+
+bool NonUniformTileStoreSqlite::convertEncoding(const NonUniformTilesEncoding &encoding)
+{
+    Err e = kNoErr;
+    {
+        TransactionInstance ta(m_db);
+        ta.setRollbackOnDestruction(true);
+        e = ta.beginTransaction(); eee_absorb;
+        if (e != kNoErr) {
+            return false;
+        }
+
+        NonUniformTilesDao dao(m_db);
+        e = dao.reencodeTiles(encoding); eee_absorb;
+        if (e != kNoErr) {
+            return false;
+        }
+
+        e = ta.endTransaction(); eee_absorb;
+        if (e != kNoErr) {
+            return false;
+        }
+    }
+
+    m_encoding = encoding;
+
+    // give the space of the re-encoded blobs back to the file system
+    QSqlQuery q = makeQuery(m_db, true);
+    e = QEXEC_CMD(q, "VACUUM;"); eee_absorb;
+    return e == kNoErr;
+}
+
 bool NonUniformTileStoreSqlite::startPartial()
 {
     return m_partsDb->transaction();
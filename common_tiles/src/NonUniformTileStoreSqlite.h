@@ -12,6 +12,8 @@
 #include "pmi_core_defs.h"
 
 #include "NonUniformTileStore.h"
+#include "NonUniformTilesDao.h"
+#include "NonUniformTilesSerialization.h"
 #include "pmi_common_tiles_export.h"
 
 #include <QRect>
@@ -28,7 +30,14 @@ public:
     ~NonUniformTileStoreSqlite();
 
     bool saveTile(const NonUniformTile &t, ContentType type) override;
-    const NonUniformTile loadTile(const QPoint &pos, ContentType type) override;
+
+    //! \brief serializes the tile the same way saveTile() does without touching the database
+    //
+    // Thread-safe, the result is written by saveEncodedTile() which can run on another connection
+    NonUniformTilesEncodedEntry encodeTile(const NonUniformTile &t, ContentType type) const;
+    bool saveEncodedTile(const NonUniformTilesEncodedEntry &entry);
+
+    NonUniformTile loadTile(const QPoint &pos, ContentType type) override;
     bool contains(const QPoint &pos, ContentType type) override;
 
     // partial tiles
@@ -59,12 +68,25 @@ public:
     //! \brief if tileRect is null, than count for all tiles is provided
     quint32 pointCount(ContentType type, const QRect &tileRect = QRect());
 
+    //! \brief positions of all stored tiles of given type, row by row
+    QVector<QPoint> tilePositions(ContentType type);
+
+    //! \brief encoding of the tiles written by saveTile(), tiles of any encoding can be loaded
+    // By default NonUniformTilesEncoding::legacy() is used
+    void setEncoding(const NonUniformTilesEncoding &encoding) { m_encoding = encoding; }
+    NonUniformTilesEncoding encoding() const { return m_encoding; }
+
+    //! \brief rewrites all tiles of the store with @a encoding and compacts the database file
+    //
+    // The encoding of the store is set to @a encoding as well
+    bool convertEncoding(const NonUniformTilesEncoding &encoding);
+
 private:
     QString contentTypeToDaoString(ContentType type) const;
     ContentType contentTypeFromDaoString(const QString& daoString) const;
 
     //! \brief transform tile part to memory representation close to the database memory layout 
-    void serializeTilePart(const NonUniformTile &t, QVector<int> * indexes, QVector<double> * mz, QVector<double> * intensity, qint32 * pointCount);
+    void serializeTilePart(const NonUniformTile &t, QVector<int> * indexes, QVector<double> * mz, QVector<double> * intensity, qint32 * pointCount) const;
 
     //! \brief transform tile part from database memory layout to tile memory layout
     void deserializePartTile(const QVector<int> &indexes, const QVector<double> &mz, const QVector<double> &intensity, qint32 pointCount, NonUniformTile * tile);
@@ -78,6 +100,7 @@ private:
     QSqlDatabase * m_db;
     QSharedPointer<QSqlDatabase> m_partsDb;
     bool m_ownDb;
+    NonUniformTilesEncoding m_encoding;
 };
 
 _PMI_END
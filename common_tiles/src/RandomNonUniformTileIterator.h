@@ -54,18 +54,26 @@ public:
         moveTo(tileX, tileY, scanIndex);
     }
 
-    const T &value() const { 
-        // tile is QVector-based, so the copy is "free"
-        const NonUniformTileBase<T> tile = m_tileManager->loadTile(m_lastValue.tilePos, m_contentType);
-        if (tile.isNull() || tile.isEmpty()) {
-            if (tile.isNull()) {
+    //! \brief value at the current position
+    //
+    // The iterator keeps the tile it read the value from, so the reference stays valid until the
+    // iterator moves to another tile. Moving within the same tile does not touch the tile manager
+    // unless the tile cache is disabled; then the tile is reloaded on every call so that changes
+    // written to the store are visible (e.g. selection tiles).
+    const T &value() const {
+        if (!m_tileLoaded || m_tile.position() != m_lastValue.tilePos
+            || m_tileManager->cacheSizeBytes() == 0) {
+            m_tile = m_tileManager->loadTile(m_lastValue.tilePos, m_contentType);
+            m_tileLoaded = true;
+            if (m_tile.isNull()) {
                 qWarning() << "Null tile!" << m_lastValue.tilePos << "contentType" << m_contentType;
             }
+        }
 
+        if (m_tile.isNull() || m_tile.isEmpty()) {
             return NonUniformTileBase<T>::defaultTileValue();
-        } else {
-            return tile.value(m_lastValue.internalIndex);
         }
+        return m_tile.value(m_lastValue.internalIndex);
     }
 
     //! \brief how many scan indexes are stored contiguously in the tile
@@ -74,8 +82,9 @@ public:
         return m_range.scanIndexTileLength() - offset;
     }
 
-    void setCacheSize(int cacheSize) { 
-        m_tileManager->setCacheSize(cacheSize); 
+    //! \brief sets the tile cache budget of the tile manager in bytes, 0 disables it
+    void setCacheSizeBytes(qint64 bytes) {
+        m_tileManager->setCacheSizeBytes(bytes);
     }
 
 private:
@@ -85,6 +94,10 @@ private:
     NonUniformTilePoint m_lastValue;
     
     NonUniformTileStoreType::ContentType m_contentType;
+
+    // tile of the last value(), shares the payload with the tile cache
+    mutable NonUniformTileBase<T> m_tile;
+    mutable bool m_tileLoaded = false;
 };
 
 typedef RandomNonUniformTileIteratorBase<point2dList> RandomNonUniformTileIterator;
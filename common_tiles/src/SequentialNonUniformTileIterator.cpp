@@ -19,6 +19,7 @@ SequentialNonUniformTileIterator::SequentialNonUniformTileIterator(NonUniformTil
                                                                    bool doCentroiding,
                                                                    const QRect &tileArea)
     : m_range(range)
+    , m_lastScanPart(&NonUniformTile::defaultTileValue())
     , m_tileIterator(tileManager, range, doCentroiding)
     , m_firstDone(false)
     , m_tileArea(tileArea)
@@ -63,10 +64,10 @@ bool SequentialNonUniformTileIterator::isInLastTile() const
     return (m_tileX == m_tileArea.right() && m_tileY == m_tileArea.bottom());
 }
 
-point2dList SequentialNonUniformTileIterator::next()
+const point2dList &SequentialNonUniformTileIterator::next()
 {
     advance();
-    return m_lastScanPart;
+    return *m_lastScanPart;
 }
 
 void SequentialNonUniformTileIterator::skipRows(int rowCount)
@@ -120,12 +121,12 @@ void SequentialNonUniformTileIterator::rewind()
     m_tileY = m_tileArea.y();
     restrictScanIndexInterval(ScanIndexInterval(m_firstScanIndex, m_lastScanIndex));
 
-    m_lastScanPart.clear();
+    m_lastScanPart = &NonUniformTile::defaultTileValue();
 }
 
-void SequentialNonUniformTileIterator::setCacheSize(int tileCount)
+void SequentialNonUniformTileIterator::setCacheSizeBytes(qint64 bytes)
 {
-    m_tileIterator.setCacheSize(tileCount);
+    m_tileIterator.setCacheSizeBytes(bytes);
 }
 
 bool SequentialNonUniformTileIterator::isLastVisitedScanIndexInTile() const
@@ -150,7 +151,7 @@ void SequentialNonUniformTileIterator::advance()
 {
     if (!m_firstDone) {
         moveTo(m_tileX, m_tileY, m_scanIndex);
-        m_lastScanPart = m_tileIterator.value();
+        m_lastScanPart = &m_tileIterator.value();
         m_firstDone = true;
         return;
     }
@@ -180,7 +181,7 @@ void SequentialNonUniformTileIterator::advance()
     }
 
     moveTo(m_tileX, m_tileY, m_scanIndex);
-    m_lastScanPart = m_tileIterator.value();
+    m_lastScanPart = &m_tileIterator.value();
 }
 
 _PMI_END
\ No newline at end of file
@@ -69,10 +69,13 @@ public:
     bool hasNext() const;
 
     //! \brief Move to next tile element and provide it's value
-    point2dList next();
+    //
+    // The reference points into the tile held by the iterator and is valid until the next call
+    // to next() or rewind(); copy the points if you need them longer.
+    const point2dList &next();
 
     //! \brief Value of the last tile element visited
-    point2dList value() const { return m_lastScanPart; }
+    const point2dList &value() const { return *m_lastScanPart; }
 
     NonUniformTileRange range() const { return m_range; }
 
@@ -85,11 +88,11 @@ public:
     //! \brief allows you to restart the iteration from beginning
     void rewind();
 
-    //! \brief used for optimization: allows you to set how many tiles
+    //! \brief used for optimization: allows you to set how many bytes of tiles
     // will be cached by iterator: useful only in use-case if you rewind
     // The sole purpose of this function is to provide a means of fine tuning performance
     // In general, you will rarely ever need to call this function. 
-    void setCacheSize(int tileCount);
+    void setCacheSizeBytes(qint64 bytes);
 
     //! \brief return true if iterator's  currently visited scan index is the last in the tile
     // can be used to signalize that we switch to next tile
@@ -111,7 +114,8 @@ private:
 private:
     NonUniformTileRange m_range;
 
-    point2dList m_lastScanPart;
+    // points into the tile held by m_tileIterator, never null
+    const point2dList *m_lastScanPart;
 
     RandomNonUniformTileIterator m_tileIterator;
 
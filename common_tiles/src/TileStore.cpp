@@ -1,3 +1,14 @@
-
 #include "TileStore.h"
 
+_PMI_BEGIN
+
+bool TileStore::saveTiles(const QVector<Tile> &tiles)
+{
+    bool saved = true;
+    for (const Tile &t : tiles) {
+        saved = saveTile(t) && saved;
+    }
+    return saved;
+}
+
+_PMI_END
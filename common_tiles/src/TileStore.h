@@ -6,12 +6,18 @@
 #include "pmi_common_tiles_export.h"
 
 #include <QPoint>
+#include <QVector>
 
 _PMI_BEGIN
 
 class PMI_COMMON_TILES_EXPORT TileStore {
 public:
     virtual bool saveTile(const Tile &t) = 0;
+
+    // saves all tiles, returns false if any of them was not saved
+    // the default saves them one by one, stores can batch the inserts
+    virtual bool saveTiles(const QVector<Tile> &tiles);
+
     virtual Tile loadTile(const QPoint &level, const QPoint &pos) = 0;
     
     // returns true if the store contains the tile at the position, false otherwise
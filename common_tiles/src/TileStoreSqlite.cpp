@@ -55,6 +55,24 @@ bool TileStoreSqlite::saveTile(const Tile &t)
     return saveToDb(t) == kNoErr;
 }
 
+bool TileStoreSqlite::saveTiles(const QVector<Tile> &tiles)
+{
+    QSqlQuery q = makeQuery(&m_db, true);
+    Err e = QPREPARE(q, "INSERT INTO Tiles(LevelX, LevelY, PosX, PosY, Data) VALUES(?,?,?,?,?);");
+    if (e != kNoErr) {
+        return false;
+    }
+
+    bool saved = true;
+    for (const Tile &t : tiles) {
+        if (saveToDb(&q, t) != kNoErr) {
+            qWarning() << "Cannot save tile" << t.tileInfo();
+            saved = false;
+        }
+    }
+    return saved;
+}
+
 Tile TileStoreSqlite::loadTile(const QPoint &level, const QPoint &pos)
 {
     QSqlQuery q = makeQuery(&m_db, true);
@@ -252,17 +270,22 @@ Err TileStoreSqlite::saveToDb(const Tile &t)
     Err e = kNoErr;
     QSqlQuery q = makeQuery(&m_db, true);
     e = QPREPARE(q, "INSERT INTO Tiles(LevelX, LevelY, PosX, PosY, Data) VALUES(?,?,?,?,?);"); ree;
-    
+    return saveToDb(&q, t);
+}
+
+Err TileStoreSqlite::saveToDb(QSqlQuery *q, const Tile &t)
+{
+    Err e = kNoErr;
     const TileInfo &ti = t.tileInfo();
-    q.bindValue(0, ti.level().x() );
-    q.bindValue(1, ti.level().y());
-    q.bindValue(2, ti.pos().x() );
-    q.bindValue(3, ti.pos().y());
+    q->bindValue(0, ti.level().x() );
+    q->bindValue(1, ti.level().y());
+    q->bindValue(2, ti.pos().x() );
+    q->bindValue(3, ti.pos().y());
 
     QByteArray compressedBlob = t.serializedData(Tile::COMPRESSED_BYTES);
 
-    q.bindValue(4, compressedBlob);
-    e = QEXEC_NOARG(q);
+    q->bindValue(4, compressedBlob);
+    e = QEXEC_NOARG((*q));
     return e;
 }
 
@@ -7,6 +7,8 @@
 #include "common_errors.h"
 #include "pmi_common_tiles_export.h"
 
+class QSqlQuery;
+
 _PMI_BEGIN
 
 class PMI_COMMON_TILES_EXPORT TileStoreSqlite : public TileStore {
@@ -19,6 +21,9 @@ public:
     Err dropTable();
 
     virtual bool saveTile(const Tile &t) override;
+    // inserts all tiles with one prepared statement, call inside start() / end() to commit them
+    // at once
+    virtual bool saveTiles(const QVector<Tile> &tiles) override;
     // pos is column, row otherwise store will not be able to find it 
     virtual Tile loadTile(const QPoint &level, const QPoint &pos) override;
 
@@ -40,6 +45,7 @@ public:
 
 private:
     Err saveToDb(const Tile &t);
+    static Err saveToDb(QSqlQuery *q, const Tile &t);
 
     virtual void clear() override;
 
@@ -91,6 +91,11 @@ Err NonUniformTilesDao::loadTile(const QPoint &position, const QString &contentT
 }
 
 Err NonUniformTilesDao::saveTile(const NonUniformTilesDaoEntry &entry)
+{
+    return saveEncodedTile(encodeTile(entry, m_encoding));
+}
+
+Err NonUniformTilesDao::saveEncodedTile(const NonUniformTilesEncodedEntry &entry)
 {
     QSqlQuery q = makeQuery(m_db, true);
     static QString sql = R"(INSERT INTO NonUniformTiles(PositionX, PositionY, Indexes, Mz, Intensity, ContentType, PointCount, DebugText) 
@@ -100,9 +105,9 @@ Err NonUniformTilesDao::saveTile(const NonUniformTilesDaoEntry &entry)
 
     q.bindValue(":PositionX", entry.posX);
     q.bindValue(":PositionY", entry.posY);
-    q.bindValue(":Indexes", NonUniformTilesSerialization::serializeIndex(entry.index));
-    q.bindValue(":Mz", NonUniformTilesSerialization::serializeMz(entry.mz));
-    q.bindValue(":Intensity", NonUniformTilesSerialization::serializeIntensity(entry.intensity));
+    q.bindValue(":Indexes", entry.index);
+    q.bindValue(":Mz", entry.mz);
+    q.bindValue(":Intensity", entry.intensity);
     q.bindValue(":ContentType", entry.contentType);
     q.bindValue(":PointCount", entry.pointCount);
     q.bindValue(":DebugText", entry.debugText);
@@ -110,6 +115,21 @@ Err NonUniformTilesDao::saveTile(const NonUniformTilesDaoEntry &entry)
     return QEXEC_NOARG(q);
 }
 
+NonUniformTilesEncodedEntry NonUniformTilesDao::encodeTile(const NonUniformTilesDaoEntry &entry,
+                                                          const NonUniformTilesEncoding &encoding)
+{
+    NonUniformTilesEncodedEntry result;
+    result.posX = entry.posX;
+    result.posY = entry.posY;
+    result.contentType = entry.contentType;
+    result.index = NonUniformTilesSerialization::serializeIndex(entry.index, encoding);
+    result.mz = NonUniformTilesSerialization::serializeMz(entry.mz, encoding);
+    result.intensity = NonUniformTilesSerialization::serializeIntensity(entry.intensity, encoding);
+    result.pointCount = entry.pointCount;
+    result.debugText = entry.debugText;
+    return result;
+}
+
 Err NonUniformTilesDao::count(const QString &contentType, int * count)
 {
     if (!count) {
@@ -213,6 +233,73 @@ bool NonUniformTilesDao::contains(const QPoint &position, const QString &content
     return hasFirst;
 }
 
+Err NonUniformTilesDao::positions(const QString &contentType, QVector<QPoint> *positions)
+{
+    if (!positions) {
+        return kBadParameterError;
+    }
+
+    positions->clear();
+
+    QSqlQuery q = makeQuery(m_db, true);
+    Err e = QPREPARE(q, "SELECT PositionX, PositionY FROM NonUniformTiles WHERE ContentType = ? "
+                        "ORDER BY PositionY, PositionX;"); ree;
+    q.bindValue(0, contentType);
+    e = QEXEC_NOARG(q); ree;
+
+    while (q.next()) {
+        positions->push_back(QPoint(q.value(0).toInt(), q.value(1).toInt()));
+    }
+
+    return e;
+}
+
+Err NonUniformTilesDao::reencodeTiles(const NonUniformTilesEncoding &encoding)
+{
+    QSqlQuery q = makeQuery(m_db, true);
+    Err e = QEXEC_CMD(q, "SELECT rowid FROM NonUniformTiles;"); ree;
+
+    QVector<qlonglong> rowIds;
+    while (q.next()) {
+        rowIds.push_back(q.value(0).toLongLong());
+    }
+
+    QSqlQuery select = makeQuery(m_db, true);
+    e = QPREPARE(select, "SELECT Indexes, Mz, Intensity, PointCount FROM NonUniformTiles WHERE rowid = ?;"); ree;
+
+    QSqlQuery update = makeQuery(m_db, true);
+    e = QPREPARE(update, "UPDATE NonUniformTiles SET Indexes = ?, Mz = ?, Intensity = ? WHERE rowid = ?;"); ree;
+
+    for (qlonglong rowId : rowIds) {
+        select.bindValue(0, rowId);
+        e = QEXEC_NOARG(select); ree;
+        if (!select.first()) {
+            return kSQLiteMissingContentError;
+        }
+
+        bool ok;
+        const int pointCount = select.value(3).toInt(&ok); Q_ASSERT(ok);
+        const QVector<int> index = NonUniformTilesSerialization::deserializeIndex(select.value(0).toByteArray(), pointCount);
+        const QVector<double> mz = NonUniformTilesSerialization::deserializeMz(select.value(1).toByteArray(), pointCount);
+        const QVector<double> intensity = NonUniformTilesSerialization::deserializeIntensity(select.value(2).toByteArray(), pointCount);
+        select.finish();
+
+        if (mz.size() != pointCount || intensity.size() != pointCount) {
+            qWarning() << "Inconsistent NonUniform tile" << rowId << "point count" << pointCount
+                       << "mz" << mz.size() << "intensity" << intensity.size();
+            return kBadParameterError;
+        }
+
+        update.bindValue(0, NonUniformTilesSerialization::serializeIndex(index, encoding));
+        update.bindValue(1, NonUniformTilesSerialization::serializeMz(mz, encoding));
+        update.bindValue(2, NonUniformTilesSerialization::serializeIntensity(intensity, encoding));
+        update.bindValue(3, rowId);
+        e = QEXEC_NOARG(update); ree;
+    }
+
+    return e;
+}
+
 bool NonUniformTilesDao::isSchemaValid() const
 {
     QSqlRecord record = m_db->record("NonUniformTiles");
@@ -14,6 +14,7 @@
 #include "common_errors.h"
 #include <QBuffer>
 #include "pmi_common_tiles_export.h"
+#include "NonUniformTilesSerialization.h"
 
 #include <QVector>
 
@@ -37,6 +38,23 @@ struct PMI_COMMON_TILES_EXPORT NonUniformTilesDaoEntry {
     static const QString CONTENT_MS1_CENTROIDED;
 };
 
+//! \brief NonUniformTilesDaoEntry with the columns already serialized into blobs
+//
+// Encoding is the expensive part of saving a tile and does not touch the database, so it can be
+// done on a worker thread while another thread does the writing
+struct PMI_COMMON_TILES_EXPORT NonUniformTilesEncodedEntry {
+    int posX = 0;
+    int posY = 0;
+    QString contentType;
+
+    QByteArray index;
+    QByteArray mz;
+    QByteArray intensity;
+    int pointCount = 0;
+
+    QString debugText;
+};
+
 class PMI_COMMON_TILES_EXPORT NonUniformTilesDao {
 
 public:    
@@ -47,6 +65,11 @@ public:
 
     Err loadTile(const QPoint &position, const QString &contentType, NonUniformTilesDaoEntry * entry);
     Err saveTile(const NonUniformTilesDaoEntry &entry);
+    Err saveEncodedTile(const NonUniformTilesEncodedEntry &entry);
+
+    //! \brief serializes the columns of @a entry, thread-safe
+    static NonUniformTilesEncodedEntry encodeTile(const NonUniformTilesDaoEntry &entry,
+                                                  const NonUniformTilesEncoding &encoding);
 
     // number of tiles of given type
     Err count(const QString &contentType, int * count);
@@ -55,10 +78,23 @@ public:
     Err pointCount(const QString &contentType, const QRect &tileRect, quint32 *count);
 
     bool contains(const QPoint &position, const QString &contentType);
+
+    //! \brief positions of all tiles of given content type, sorted by PositionY and PositionX
+    Err positions(const QString &contentType, QVector<QPoint> *positions);
     bool isSchemaValid() const;
 
+    //! \brief encoding used by saveTile(), loadTile() reads any encoding
+    void setEncoding(const NonUniformTilesEncoding &encoding) { m_encoding = encoding; }
+    NonUniformTilesEncoding encoding() const { return m_encoding; }
+
+    //! \brief rewrites all stored tiles with @a encoding
+    //
+    // Should run in a transaction. The file does not shrink until it is vacuumed.
+    Err reencodeTiles(const NonUniformTilesEncoding &encoding);
+
 private:
     QSqlDatabase * m_db;
+    NonUniformTilesEncoding m_encoding;
 };
 
 
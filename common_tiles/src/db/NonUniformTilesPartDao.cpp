@@ -15,6 +15,17 @@
 
 _PMI_BEGIN
 
+// parts are temporary and get merged into the final tiles, they are always stored without loss
+// and without compression to keep the build fast
+static NonUniformTilesEncoding partsEncoding()
+{
+    NonUniformTilesEncoding encoding = NonUniformTilesEncoding::lossless();
+    encoding.compress = false;
+    return encoding;
+}
+
+static const NonUniformTilesEncoding PARTS_ENCODING = partsEncoding();
+
 NonUniformTilesPartDao::NonUniformTilesPartDao(QSqlDatabase * db) : m_db(db)
 {
 
@@ -74,9 +85,9 @@ Err NonUniformTilesPartDao::saveTilePart(const NonUniformTilesPartEntry &entry)
 
     q.bindValue(":NonUniformTilesPartInfoId", entry.nonUniformTilesPartInfoId);
     q.bindValue(":WriteOrder", entry.id);
-    q.bindValue(":Indexes", NonUniformTilesSerialization::serializeIndex(entry.index));
-    q.bindValue(":Mz", NonUniformTilesSerialization::serializeMz(entry.mz));
-    q.bindValue(":Intensity", NonUniformTilesSerialization::serializeIntensity(entry.intensity));
+    q.bindValue(":Indexes", NonUniformTilesSerialization::serializeIndex(entry.index, PARTS_ENCODING));
+    q.bindValue(":Mz", NonUniformTilesSerialization::serializeMz(entry.mz, PARTS_ENCODING));
+    q.bindValue(":Intensity", NonUniformTilesSerialization::serializeIntensity(entry.intensity, PARTS_ENCODING));
     q.bindValue(":PointCount", entry.pointCount);
     q.bindValue(":ScanCount", entry.scanCount);
 
@@ -9,36 +9,462 @@
 
 #include "NonUniformTilesSerialization.h"
 
+#include "pmi_common_tiles_debug.h"
+
+#include <QtEndian>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
 _PMI_BEGIN
 
+// Columnar blob header: 'N' 'U' 'C' <version> <codec> <flags>
+// The magic can't start a legacy blob: as a big-endian int it is a scan with more than 10^9 points,
+// as a big-endian double it is larger than 10^69.
+static const char COLUMNAR_MAGIC[] = { 'N', 'U', 'C' };
+static const int COLUMNAR_MAGIC_SIZE = 3;
+static const int COLUMNAR_HEADER_SIZE = 6;
+static const quint8 COLUMNAR_VERSION = 1;
+
+enum ColumnCodec : quint8 {
+    CodecIndexDeltaVarint = 1,
+    CodecMzBitsDeltaVarint = 2,
+    CodecMzQuantizedDeltaVarint = 3,
+    CodecIntensityDouble = 4,
+    CodecIntensityFloat = 5,
+    CodecIntensityLogQuantized = 6
+};
+
+enum ColumnFlag : quint8 {
+    FlagZlib = 0x1
+};
+
+static const double LOG_QUANTIZED_MAX = 65535.0;
+
+static inline quint64 zigZagEncode(qint64 value)
+{
+    return (static_cast<quint64>(value) << 1) ^ static_cast<quint64>(value >> 63);
+}
+
+static inline qint64 zigZagDecode(quint64 value)
+{
+    return static_cast<qint64>(value >> 1) ^ -static_cast<qint64>(value & 1);
+}
+
+static void appendVarint(quint64 value, QByteArray *out)
+{
+    while (value >= 0x80) {
+        out->append(static_cast<char>((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    out->append(static_cast<char>(value));
+}
+
+//! \brief @return false if the data ended in the middle of the varint
+static bool readVarint(const uchar **pos, const uchar *end, quint64 *value)
+{
+    quint64 result = 0;
+    int shift = 0;
+    while (*pos < end && shift < 64) {
+        const uchar byte = **pos;
+        ++(*pos);
+        result |= static_cast<quint64>(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            *value = result;
+            return true;
+        }
+        shift += 7;
+    }
+    return false;
+}
+
+template <typename T>
+static void appendLittleEndian(T value, QByteArray *out)
+{
+    uchar buffer[sizeof(T)];
+    qToLittleEndian<T>(value, buffer);
+    out->append(reinterpret_cast<const char *>(buffer), sizeof(T));
+}
+
+static void appendDouble(double value, QByteArray *out)
+{
+    quint64 bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    appendLittleEndian<quint64>(bits, out);
+}
+
+static double readDouble(const uchar *pos)
+{
+    const quint64 bits = qFromLittleEndian<quint64>(pos);
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+static QByteArray makeColumn(ColumnCodec codec, const QByteArray &payload, bool compress)
+{
+    QByteArray blob;
+    quint8 flags = 0;
+    QByteArray compressed;
+    if (compress && !payload.isEmpty()) {
+        compressed = qCompress(payload);
+        if (compressed.size() < payload.size()) {
+            flags |= FlagZlib;
+        }
+    }
+
+    const QByteArray &body = (flags & FlagZlib) ? compressed : payload;
+    blob.reserve(COLUMNAR_HEADER_SIZE + body.size());
+    blob.append(COLUMNAR_MAGIC, COLUMNAR_MAGIC_SIZE);
+    blob.append(static_cast<char>(COLUMNAR_VERSION));
+    blob.append(static_cast<char>(codec));
+    blob.append(static_cast<char>(flags));
+    blob.append(body);
+    return blob;
+}
+
+//! \brief strips the header and decompresses the payload
+static bool readColumn(const QByteArray &blob, ColumnCodec *codec, QByteArray *payload)
+{
+    const quint8 version = static_cast<quint8>(blob.at(COLUMNAR_MAGIC_SIZE));
+    if (version != COLUMNAR_VERSION) {
+        warningTiles() << "Unsupported non-uniform tile column version" << static_cast<int>(version);
+        return false;
+    }
+
+    *codec = static_cast<ColumnCodec>(static_cast<quint8>(blob.at(COLUMNAR_MAGIC_SIZE + 1)));
+    const quint8 flags = static_cast<quint8>(blob.at(COLUMNAR_MAGIC_SIZE + 2));
+    const QByteArray body = blob.mid(COLUMNAR_HEADER_SIZE);
+
+    if (flags & FlagZlib) {
+        *payload = qUncompress(body);
+        if (payload->isEmpty() && !body.isEmpty()) {
+            warningTiles() << "Corrupted compressed non-uniform tile column";
+            return false;
+        }
+    } else {
+        *payload = body;
+    }
+    return true;
+}
+
+//! \brief decodes zig-zag varint deltas into @a values, @see appendDeltaVarint
+static bool readDeltaVarints(const uchar *pos, const uchar *end, QVector<qint64> *values)
+{
+    qint64 previous = 0;
+    while (pos < end) {
+        quint64 encoded = 0;
+        if (!readVarint(&pos, end, &encoded)) {
+            return false;
+        }
+        // wrapping arithmetic, deltas of the double bit patterns can use the full 64 bits
+        previous = static_cast<qint64>(static_cast<quint64>(previous)
+                                       + static_cast<quint64>(zigZagDecode(encoded)));
+        values->push_back(previous);
+    }
+    return true;
+}
+
+static void appendDeltaVarint(qint64 value, qint64 *previous, QByteArray *out)
+{
+    const quint64 delta = static_cast<quint64>(value) - static_cast<quint64>(*previous);
+    appendVarint(zigZagEncode(static_cast<qint64>(delta)), out);
+    *previous = value;
+}
+
+bool NonUniformTilesEncoding::isLossless() const
+{
+    return format == FormatLegacy || (mzQuantum <= 0.0 && intensity == IntensityDouble);
+}
+
+NonUniformTilesEncoding NonUniformTilesEncoding::legacy()
+{
+    NonUniformTilesEncoding encoding;
+    encoding.format = FormatLegacy;
+    encoding.compress = false;
+    return encoding;
+}
+
+NonUniformTilesEncoding NonUniformTilesEncoding::lossless()
+{
+    NonUniformTilesEncoding encoding;
+    encoding.format = FormatColumnar;
+    return encoding;
+}
+
+NonUniformTilesEncoding NonUniformTilesEncoding::compact()
+{
+    NonUniformTilesEncoding encoding = lossless();
+    encoding.mzQuantum = 1e-5;
+    encoding.intensity = IntensityFloat;
+    return encoding;
+}
+
+bool NonUniformTilesEncoding::fromName(const QString &name, NonUniformTilesEncoding *encoding)
+{
+    Q_ASSERT(encoding);
+    const QString lower = name.trimmed().toLower();
+    if (lower == QLatin1String("legacy")) {
+        *encoding = legacy();
+    } else if (lower == QLatin1String("lossless")) {
+        *encoding = lossless();
+    } else if (lower == QLatin1String("compact")) {
+        *encoding = compact();
+    } else {
+        return false;
+    }
+    return true;
+}
+
+bool NonUniformTilesSerialization::isColumnar(const QByteArray &blob)
+{
+    return blob.size() >= COLUMNAR_HEADER_SIZE
+        && std::memcmp(blob.constData(), COLUMNAR_MAGIC, COLUMNAR_MAGIC_SIZE) == 0;
+}
+
 QVector<int> NonUniformTilesSerialization::deserializeIndex(const QByteArray &index, qint32 pointCount)
 {
-    return deserializeVector<int>(index, pointCount);
+    if (!isColumnar(index)) {
+        return deserializeVector<int>(index, pointCount);
+    }
+
+    QVector<int> result;
+    ColumnCodec codec;
+    QByteArray payload;
+    if (!readColumn(index, &codec, &payload)) {
+        return result;
+    }
+
+    if (codec != CodecIndexDeltaVarint) {
+        warningTiles() << "Unexpected codec of the index column" << static_cast<int>(codec);
+        return result;
+    }
+
+    QVector<qint64> values;
+    values.reserve(pointCount);
+    const uchar *pos = reinterpret_cast<const uchar *>(payload.constData());
+    if (!readDeltaVarints(pos, pos + payload.size(), &values)) {
+        warningTiles() << "Truncated index column";
+        return result;
+    }
+
+    result.reserve(values.size());
+    for (qint64 value : values) {
+        result.push_back(static_cast<int>(value));
+    }
+    return result;
 }
 
 QVector<double> NonUniformTilesSerialization::deserializeMz(const QByteArray &mz, qint32 pointCount)
 {
-    return deserializeVector<double>(mz, pointCount);
+    if (!isColumnar(mz)) {
+        return deserializeVector<double>(mz, pointCount);
+    }
+
+    QVector<double> result;
+    ColumnCodec codec;
+    QByteArray payload;
+    if (!readColumn(mz, &codec, &payload)) {
+        return result;
+    }
+
+    const uchar *pos = reinterpret_cast<const uchar *>(payload.constData());
+    const uchar *end = pos + payload.size();
+
+    QVector<qint64> values;
+    values.reserve(pointCount);
+    result.reserve(pointCount);
+
+    if (codec == CodecMzBitsDeltaVarint) {
+        if (!readDeltaVarints(pos, end, &values)) {
+            warningTiles() << "Truncated m/z column";
+            return QVector<double>();
+        }
+        for (qint64 bits : values) {
+            double value;
+            std::memcpy(&value, &bits, sizeof(value));
+            result.push_back(value);
+        }
+    } else if (codec == CodecMzQuantizedDeltaVarint) {
+        if (end - pos < 2 * static_cast<int>(sizeof(double))) {
+            warningTiles() << "Truncated m/z column";
+            return result;
+        }
+        const double origin = readDouble(pos);
+        const double quantum = readDouble(pos + sizeof(double));
+        pos += 2 * sizeof(double);
+
+        if (!readDeltaVarints(pos, end, &values)) {
+            warningTiles() << "Truncated m/z column";
+            return result;
+        }
+        for (qint64 quantized : values) {
+            result.push_back(origin + quantized * quantum);
+        }
+    } else {
+        warningTiles() << "Unexpected codec of the m/z column" << static_cast<int>(codec);
+    }
+
+    return result;
 }
 
 QVector<double> NonUniformTilesSerialization::deserializeIntensity(const QByteArray &intensity, qint32 pointCount)
 {
-    return deserializeVector<double>(intensity, pointCount);
+    if (!isColumnar(intensity)) {
+        return deserializeVector<double>(intensity, pointCount);
+    }
+
+    QVector<double> result;
+    ColumnCodec codec;
+    QByteArray payload;
+    if (!readColumn(intensity, &codec, &payload)) {
+        return result;
+    }
+
+    const uchar *pos = reinterpret_cast<const uchar *>(payload.constData());
+    const int size = payload.size();
+
+    switch (codec) {
+    case CodecIntensityDouble: {
+        const int count = size / static_cast<int>(sizeof(double));
+        result.resize(count);
+        for (int i = 0; i < count; ++i) {
+            result[i] = readDouble(pos + i * sizeof(double));
+        }
+        break;
+    }
+    case CodecIntensityFloat: {
+        const int count = size / static_cast<int>(sizeof(float));
+        result.resize(count);
+        for (int i = 0; i < count; ++i) {
+            const quint32 bits = qFromLittleEndian<quint32>(pos + i * sizeof(float));
+            float value;
+            std::memcpy(&value, &bits, sizeof(value));
+            result[i] = value;
+        }
+        break;
+    }
+    case CodecIntensityLogQuantized: {
+        if (size < static_cast<int>(sizeof(double))) {
+            warningTiles() << "Truncated intensity column";
+            break;
+        }
+        const double maxLog = readDouble(pos);
+        pos += sizeof(double);
+        const int count = (size - static_cast<int>(sizeof(double))) / static_cast<int>(sizeof(quint16));
+        result.resize(count);
+        for (int i = 0; i < count; ++i) {
+            const quint16 code = qFromLittleEndian<quint16>(pos + i * sizeof(quint16));
+            result[i] = std::expm1(code / LOG_QUANTIZED_MAX * maxLog);
+        }
+        break;
+    }
+    default: {
+        warningTiles() << "Unexpected codec of the intensity column" << static_cast<int>(codec);
+        break;
+    }
+    }
+
+    return result;
 }
 
-QByteArray NonUniformTilesSerialization::serializeIndex(const QVector<int> &index)
+QByteArray NonUniformTilesSerialization::serializeIndex(const QVector<int> &index,
+                                                        const NonUniformTilesEncoding &encoding)
 {
-    return serializeVector(index);
+    if (encoding.format == NonUniformTilesEncoding::FormatLegacy) {
+        return serializeVector(index);
+    }
+
+    // consecutive scans have similar point counts, so the deltas are small
+    QByteArray payload;
+    payload.reserve(index.size());
+    qint64 previous = 0;
+    for (int count : index) {
+        appendDeltaVarint(count, &previous, &payload);
+    }
+
+    return makeColumn(CodecIndexDeltaVarint, payload, encoding.compress);
 }
 
-QByteArray NonUniformTilesSerialization::serializeMz(const QVector<double> &mz)
+QByteArray NonUniformTilesSerialization::serializeMz(const QVector<double> &mz,
+                                                     const NonUniformTilesEncoding &encoding)
 {
-    return serializeVector(mz);
+    if (encoding.format == NonUniformTilesEncoding::FormatLegacy) {
+        return serializeVector(mz);
+    }
+
+    QByteArray payload;
+    payload.reserve(mz.size() * 4);
+    qint64 previous = 0;
+
+    if (encoding.mzQuantum <= 0.0) {
+        // bit patterns of positive doubles are ordered as the values, m/z within the scan is
+        // ascending and the deltas fit into fewer bytes than the full double
+        for (double value : mz) {
+            qint64 bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+            appendDeltaVarint(bits, &previous, &payload);
+        }
+        return makeColumn(CodecMzBitsDeltaVarint, payload, encoding.compress);
+    }
+
+    const double origin = mz.isEmpty() ? 0.0 : *std::min_element(mz.cbegin(), mz.cend());
+    appendDouble(origin, &payload);
+    appendDouble(encoding.mzQuantum, &payload);
+    for (double value : mz) {
+        const qint64 quantized = std::llround((value - origin) / encoding.mzQuantum);
+        appendDeltaVarint(quantized, &previous, &payload);
+    }
+    return makeColumn(CodecMzQuantizedDeltaVarint, payload, encoding.compress);
 }
 
-QByteArray NonUniformTilesSerialization::serializeIntensity(const QVector<double> &intensity)
+QByteArray NonUniformTilesSerialization::serializeIntensity(const QVector<double> &intensity,
+                                                            const NonUniformTilesEncoding &encoding)
 {
-    return serializeVector(intensity);
+    if (encoding.format == NonUniformTilesEncoding::FormatLegacy) {
+        return serializeVector(intensity);
+    }
+
+    QByteArray payload;
+    switch (encoding.intensity) {
+    case NonUniformTilesEncoding::IntensityFloat: {
+        payload.reserve(intensity.size() * static_cast<int>(sizeof(float)));
+        for (double value : intensity) {
+            const float single = static_cast<float>(value);
+            quint32 bits;
+            std::memcpy(&bits, &single, sizeof(bits));
+            appendLittleEndian<quint32>(bits, &payload);
+        }
+        return makeColumn(CodecIntensityFloat, payload, encoding.compress);
+    }
+    case NonUniformTilesEncoding::IntensityLogQuantized: {
+        double maxLog = 0.0;
+        for (double value : intensity) {
+            maxLog = std::max(maxLog, std::log1p(std::max(0.0, value)));
+        }
+
+        payload.reserve(static_cast<int>(sizeof(double)) + intensity.size() * static_cast<int>(sizeof(quint16)));
+        appendDouble(maxLog, &payload);
+        for (double value : intensity) {
+            quint16 code = 0;
+            if (maxLog > 0.0) {
+                const double scaled = std::log1p(std::max(0.0, value)) / maxLog * LOG_QUANTIZED_MAX;
+                code = static_cast<quint16>(std::min(LOG_QUANTIZED_MAX, std::round(scaled)));
+            }
+            appendLittleEndian<quint16>(code, &payload);
+        }
+        return makeColumn(CodecIntensityLogQuantized, payload, encoding.compress);
+    }
+    case NonUniformTilesEncoding::IntensityDouble:
+    default: {
+        payload.reserve(intensity.size() * static_cast<int>(sizeof(double)));
+        for (double value : intensity) {
+            appendDouble(value, &payload);
+        }
+        return makeColumn(CodecIntensityDouble, payload, encoding.compress);
+    }
+    }
 }
 
 
@@ -11,25 +11,86 @@
 #define NONUNIFORM_TILES_SERIALIZATION_H
 
 #include "pmi_core_defs.h"
+#include "pmi_common_tiles_export.h"
 
 #include <QVector>
 #include <QByteArray>
 #include <QDataStream>
 #include <QBuffer>
+#include <QString>
 
 _PMI_BEGIN
 
-class NonUniformTilesSerialization 
+/*!
+ * \brief Describes how the columns (Indexes, Mz, Intensity) of the non-uniform tiles are stored.
+ *
+ * FormatLegacy writes the raw QDataStream values. FormatColumnar blobs start with a small header
+ * (magic, version, codec, flags) so that the reader can tell both formats apart per blob:
+ * - Indexes (point count per scan) are delta encoded varints
+ * - Mz values are delta encoded varints, either of the exact double bit patterns (lossless) or of
+ *   the values quantized by mzQuantum relative to the smallest m/z of the blob (the tile origin)
+ * - Intensity is stored as double, float or 16-bit log-quantized value
+ * Columnar payload is optionally zlib compressed.
+ *
+ * FormatLegacy is the default because the builds before FormatColumnar read the caches with the
+ * same name and can't tell the formats apart. Columnar is opt-in, e.g. with --encoding.
+ */
+struct PMI_COMMON_TILES_EXPORT NonUniformTilesEncoding
+{
+    enum Format {
+        FormatLegacy = 0,
+        FormatColumnar = 1
+    };
+
+    enum IntensityEncoding {
+        IntensityDouble = 0,
+        IntensityFloat = 1,
+        //! log1p(intensity) quantized to 16 bits, negative intensities are stored as 0
+        IntensityLogQuantized = 2
+    };
+
+    Format format = FormatLegacy;
+
+    //! \brief quantization step of m/z in Da, 0 keeps the exact values
+    double mzQuantum = 0.0;
+
+    IntensityEncoding intensity = IntensityDouble;
+
+    //! \brief zlib compression of the columnar payload, FormatLegacy is never compressed
+    bool compress = true;
+
+    bool isLossless() const;
+
+    //! \brief raw QDataStream columns readable by all versions, used by default
+    static NonUniformTilesEncoding legacy();
+
+    //! \brief columnar encoding which restores exactly the stored values
+    static NonUniformTilesEncoding lossless();
+
+    //! \brief columnar encoding with m/z quantized to 1e-5 Da and float intensities
+    static NonUniformTilesEncoding compact();
+
+    //! \brief parses "legacy", "lossless" or "compact"
+    static bool fromName(const QString &name, NonUniformTilesEncoding *encoding);
+};
+
+class PMI_COMMON_TILES_EXPORT NonUniformTilesSerialization
 {
 
 public:
+    //! \brief deserializes both legacy and columnar blobs
+    // @param pointCount - expected number of values, used to reserve memory
     static QVector<int> deserializeIndex(const QByteArray &index, qint32 pointCount);
     static QVector<double> deserializeMz(const QByteArray &mz, qint32 pointCount);
     static QVector<double> deserializeIntensity(const QByteArray &intensity, qint32 pointCount);
 
-    static QByteArray serializeIndex(const QVector<int> &index);
-    static QByteArray serializeMz(const QVector<double> &mz);
-    static QByteArray serializeIntensity(const QVector<double> &intensity);
+    static QByteArray serializeIndex(const QVector<int> &index, const NonUniformTilesEncoding &encoding);
+    static QByteArray serializeMz(const QVector<double> &mz, const NonUniformTilesEncoding &encoding);
+    static QByteArray serializeIntensity(const QVector<double> &intensity,
+                                         const NonUniformTilesEncoding &encoding);
+
+    //! \brief true if the blob was written with FormatColumnar
+    static bool isColumnar(const QByteArray &blob);
 
     template <typename T>
     static QByteArray serializeVector(const QVector<T> &data)
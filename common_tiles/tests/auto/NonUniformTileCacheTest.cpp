@@ -0,0 +1,231 @@
+#include <QtTest>
+#include "pmi_core_defs.h"
+#include "NonUniformTileCache.h"
+#include "NonUniformTileManager.h"
+#include "NonUniformTileStoreMemory.h"
+
+#include <QScopedPointer>
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+_PMI_BEGIN
+
+class NonUniformTileCacheTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void testLruEviction();
+    void testReplace();
+    void testZeroSizeDisablesCache();
+    void testTileBoundaryDoesNotThrash();
+    void testCacheSharedWithClone();
+    void testConcurrentAccess();
+};
+
+static const NonUniformTileStoreType::ContentType CONTENT = NonUniformTileStoreType::ContentMS1Centroided;
+
+static NonUniformTile makeTile(const QPoint &pos, int pointCount)
+{
+    NonUniformTile tile;
+    tile.setPosition(pos);
+
+    point2dList scan;
+    for (int i = 0; i < pointCount; ++i) {
+        scan.push_back(point2d(100.0 + i, 10.0 * i));
+    }
+    tile.append(scan);
+    return tile;
+}
+
+void NonUniformTileCacheTest::testLruEviction()
+{
+    const NonUniformTile a = makeTile(QPoint(0, 0), 100);
+    const NonUniformTile b = makeTile(QPoint(1, 0), 100);
+    const NonUniformTile c = makeTile(QPoint(2, 0), 100);
+    const NonUniformTile d = makeTile(QPoint(3, 0), 100);
+    const qint64 tileBytes = nonUniformTileBytes(a);
+
+    // single shard so that the LRU order is global
+    NonUniformTileCache cache(3 * tileBytes, 1);
+
+    cache.insert(a, CONTENT);
+    cache.insert(b, CONTENT);
+    cache.insert(c, CONTENT);
+    QCOMPARE(cache.count(), 3);
+    QCOMPARE(cache.bytes(), 3 * tileBytes);
+
+    // a becomes the most recently used one, b is the oldest now
+    NonUniformTile found;
+    QVERIFY(cache.find(a.position(), CONTENT, &found));
+    QCOMPARE(found, a);
+
+    cache.insert(d, CONTENT);
+    QCOMPARE(cache.count(), 3);
+    QVERIFY(cache.contains(a.position(), CONTENT));
+    QVERIFY(!cache.contains(b.position(), CONTENT));
+    QVERIFY(cache.contains(c.position(), CONTENT));
+    QVERIFY(cache.contains(d.position(), CONTENT));
+
+    // content types do not collide
+    QVERIFY(!cache.contains(a.position(), NonUniformTileStoreType::ContentMS1Raw));
+
+    QCOMPARE(cache.hitCount(), qint64(1));
+    QVERIFY(!cache.find(b.position(), CONTENT, &found));
+    QCOMPARE(cache.missCount(), qint64(1));
+
+    cache.resetCounters();
+    QCOMPARE(cache.hitCount(), qint64(0));
+    QCOMPARE(cache.missCount(), qint64(0));
+
+    // shrinking the budget evicts right away
+    cache.setMaxBytes(tileBytes);
+    QCOMPARE(cache.count(), 1);
+}
+
+void NonUniformTileCacheTest::testReplace()
+{
+    NonUniformTileCache cache(1024 * 1024, 1);
+
+    cache.insert(makeTile(QPoint(0, 0), 10), CONTENT);
+    const NonUniformTile bigger = makeTile(QPoint(0, 0), 20);
+    cache.insert(bigger, CONTENT);
+
+    QCOMPARE(cache.count(), 1);
+    QCOMPARE(cache.bytes(), nonUniformTileBytes(bigger));
+
+    NonUniformTile found;
+    QVERIFY(cache.find(QPoint(0, 0), CONTENT, &found));
+    QCOMPARE(found, bigger);
+}
+
+void NonUniformTileCacheTest::testZeroSizeDisablesCache()
+{
+    NonUniformTileCache cache(0);
+    cache.insert(makeTile(QPoint(0, 0), 10), CONTENT);
+    QCOMPARE(cache.count(), 0);
+
+    cache.setMaxBytes(1024 * 1024);
+    cache.insert(makeTile(QPoint(0, 0), 10), CONTENT);
+    QCOMPARE(cache.count(), 1);
+
+    cache.setMaxBytes(0);
+    QCOMPARE(cache.count(), 0);
+    QCOMPARE(cache.bytes(), qint64(0));
+}
+
+void NonUniformTileCacheTest::testTileBoundaryDoesNotThrash()
+{
+    NonUniformTileStoreMemory store;
+    const int tileCount = 20;
+    for (int x = 0; x < tileCount; ++x) {
+        QVERIFY(store.saveTile(makeTile(QPoint(x, 0), 50), CONTENT));
+    }
+
+    NonUniformTileManager manager(&store);
+    manager.resetFetchCounters();
+
+    // iterator moving along the boundary of two tiles over and over again
+    for (int i = 0; i < 1000; ++i) {
+        const NonUniformTile tile = manager.loadTile(QPoint(9 + (i % 2), 0), CONTENT);
+        QVERIFY(!tile.isEmpty());
+    }
+
+    int dbTiles = -1;
+    int cachedTiles = -1;
+    manager.fetchCounts(&dbTiles, &cachedTiles);
+    QCOMPARE(dbTiles, 2);
+    QCOMPARE(cachedTiles, 998);
+
+    // the previous cache dropped all tiles once it reached 9 of them; touching all tiles and
+    // coming back must still hit the cache
+    for (int x = 0; x < tileCount; ++x) {
+        manager.loadTile(QPoint(x, 0), CONTENT);
+    }
+    manager.resetFetchCounters();
+    manager.loadTile(QPoint(9, 0), CONTENT);
+    manager.fetchCounts(&dbTiles, &cachedTiles);
+    QCOMPARE(dbTiles, 0);
+    QCOMPARE(cachedTiles, 1);
+}
+
+void NonUniformTileCacheTest::testCacheSharedWithClone()
+{
+    NonUniformTileStoreMemory store;
+    QVERIFY(store.saveTile(makeTile(QPoint(0, 0), 50), CONTENT));
+
+    NonUniformTileManager manager(&store);
+    manager.loadTile(QPoint(0, 0), CONTENT);
+
+    QScopedPointer<NonUniformTileManager> cloned(manager.clone());
+    QCOMPARE(cloned->cache(), manager.cache());
+
+    manager.resetFetchCounters();
+    cloned->loadTile(QPoint(0, 0), CONTENT);
+
+    int dbTiles = -1;
+    int cachedTiles = -1;
+    manager.fetchCounts(&dbTiles, &cachedTiles);
+    QCOMPARE(dbTiles, 0);
+    QCOMPARE(cachedTiles, 1);
+
+    cloned->setCacheSizeBytes(0);
+    QCOMPARE(manager.cacheSizeBytes(), qint64(0));
+}
+
+void NonUniformTileCacheTest::testConcurrentAccess()
+{
+    const int tileCount = 64;
+    const int threadCount = 8;
+    const int loadsPerThread = 2000;
+
+    NonUniformTileStoreMemory store;
+    for (int x = 0; x < tileCount; ++x) {
+        QVERIFY(store.saveTile(makeTile(QPoint(x, x % 4), 20), CONTENT));
+    }
+
+    NonUniformTileManager manager(&store);
+    manager.resetFetchCounters();
+
+    // every thread works with its own clone (own store), all of them share one cache
+    std::vector<std::unique_ptr<NonUniformTileManager>> clones;
+    for (int t = 0; t < threadCount; ++t) {
+        clones.emplace_back(manager.clone());
+    }
+
+    std::atomic<int> failures{ 0 };
+    std::vector<std::thread> threads;
+    for (int t = 0; t < threadCount; ++t) {
+        NonUniformTileManager *clone = clones[t].get();
+        threads.emplace_back([clone, t, &failures]() {
+            for (int i = 0; i < loadsPerThread; ++i) {
+                const int x = (i * 7 + t) % tileCount;
+                const NonUniformTile tile = clone->loadTile(QPoint(x, x % 4), CONTENT);
+                if (tile.position() != QPoint(x, x % 4) || tile.pointCount() != 20) {
+                    failures++;
+                }
+            }
+        });
+    }
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+
+    QCOMPARE(failures.load(), 0);
+
+    int dbTiles = -1;
+    int cachedTiles = -1;
+    manager.fetchCounts(&dbTiles, &cachedTiles);
+    QCOMPARE(dbTiles + cachedTiles, threadCount * loadsPerThread);
+    QVERIFY(dbTiles >= tileCount);
+    QCOMPARE(manager.cache()->count(), tileCount);
+}
+
+_PMI_END
+
+QTEST_MAIN(pmi::NonUniformTileCacheTest)
+
+#include "NonUniformTileCacheTest.moc"
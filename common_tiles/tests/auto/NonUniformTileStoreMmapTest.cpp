@@ -0,0 +1,242 @@
+#include <QtTest>
+#include "pmi_core_defs.h"
+#include "NonUniformTile.h"
+#include "QSqlDatabase"
+#include "NonUniformTileStoreMmap.h"
+#include "NonUniformTileStoreSqlite.h"
+
+#include <PmiQtStablesConstants.h>
+
+#include <QScopedPointer>
+
+#include <cmath>
+
+_PMI_BEGIN
+
+class NonUniformTileStoreMmapTest : public QObject
+{
+    Q_OBJECT
+public:
+    NonUniformTileStoreMmapTest();
+
+private Q_SLOTS:
+    void initTestCase();
+    void cleanupTestCase();
+
+    void testExportRoundTrip();
+    void testMissingTile();
+    void testClone();
+    void testReadOnly();
+    void testInvalidFile_data();
+    void testInvalidFile();
+
+private:
+    static NonUniformTile createTile(const QPoint &position, int scanCount, int seed);
+
+private:
+    QSqlDatabase m_db;
+    QDir m_testOutputDir;
+    QString m_dbFilePath;
+    QString m_mmapFilePath;
+};
+
+static const int TILE_COUNT_X = 6;
+static const int TILE_COUNT_Y = 4;
+static const int SCAN_COUNT = 8;
+
+NonUniformTileStoreMmapTest::NonUniformTileStoreMmapTest()
+{
+    QString testName = "NonUniformTileStoreMmapTest";
+    m_testOutputDir = QString(PMI_TEST_FILES_OUTPUT_DIR) + "/" + testName;
+    if (!m_testOutputDir.exists()) {
+        m_testOutputDir.mkpath(m_testOutputDir.absolutePath());
+    }
+}
+
+void NonUniformTileStoreMmapTest::initTestCase()
+{
+    m_dbFilePath = m_testOutputDir.filePath("tiles.db3");
+    m_mmapFilePath = m_testOutputDir.filePath("tiles.mmap");
+    if (QFileInfo(m_dbFilePath).exists()) {
+        QVERIFY(QFile::remove(m_dbFilePath));
+    }
+
+    m_db = QSqlDatabase::addDatabase(kQSQLITE, QString("NonUniformTileStoreMmapTest"));
+    m_db.setDatabaseName(m_dbFilePath);
+    QVERIFY(m_db.open());
+
+    NonUniformTileStoreSqlite store(&m_db);
+    QVERIFY(store.init());
+
+    QVERIFY(store.start());
+    for (int y = 0; y < TILE_COUNT_Y; ++y) {
+        for (int x = 0; x < TILE_COUNT_X; ++x) {
+            const QPoint pos(x, y);
+            QVERIFY(store.saveTile(createTile(pos, SCAN_COUNT, x + y * TILE_COUNT_X),
+                                   NonUniformTileStore::ContentMS1Raw));
+            // centroided content has a hole and an empty tile
+            if (pos == QPoint(2, 1)) {
+                continue;
+            }
+            const int scanCount = (pos == QPoint(3, 3)) ? 0 : SCAN_COUNT;
+            QVERIFY(store.saveTile(createTile(pos, scanCount, 100 + x + y * TILE_COUNT_X),
+                                   NonUniformTileStore::ContentMS1Centroided));
+        }
+    }
+    QVERIFY(store.end());
+
+    QVERIFY(NonUniformTileStoreMmap::exportFromSqlite(&store, m_mmapFilePath));
+}
+
+void NonUniformTileStoreMmapTest::cleanupTestCase()
+{
+    m_db.close();
+    QFile::remove(m_dbFilePath);
+    QFile::remove(m_mmapFilePath);
+}
+
+void NonUniformTileStoreMmapTest::testExportRoundTrip()
+{
+    NonUniformTileStoreSqlite sqliteStore(&m_db);
+    NonUniformTileStoreMmap store;
+    QVERIFY(store.open(m_mmapFilePath));
+    QVERIFY(store.isOpen());
+
+    for (NonUniformTileStore::ContentType type : { NonUniformTileStore::ContentMS1Raw, NonUniformTileStore::ContentMS1Centroided }) {
+        QCOMPARE(store.count(type), sqliteStore.count(type));
+        QCOMPARE(store.pointCount(type), quint64(sqliteStore.pointCount(type)));
+
+        for (int y = 0; y < TILE_COUNT_Y; ++y) {
+            for (int x = 0; x < TILE_COUNT_X; ++x) {
+                const QPoint pos(x, y);
+                QCOMPARE(store.contains(pos, type), sqliteStore.contains(pos, type));
+                // tiles are loaded exactly as the sqlite store loads them
+                QCOMPARE(store.loadTile(pos, type), sqliteStore.loadTile(pos, type));
+            }
+        }
+    }
+
+    QCOMPARE(store.count(NonUniformTileStore::ContentMS1Raw), TILE_COUNT_X * TILE_COUNT_Y);
+    QCOMPARE(store.count(NonUniformTileStore::ContentMS1Centroided), TILE_COUNT_X * TILE_COUNT_Y - 1);
+}
+
+void NonUniformTileStoreMmapTest::testMissingTile()
+{
+    NonUniformTileStoreMmap store;
+    QVERIFY(store.open(m_mmapFilePath));
+
+    const NonUniformTileStore::ContentType type = NonUniformTileStore::ContentMS1Centroided;
+    QVERIFY(!store.contains(QPoint(2, 1), type));
+    QCOMPARE(store.loadTile(QPoint(2, 1), type), NonUniformTile());
+    QVERIFY(!store.contains(QPoint(TILE_COUNT_X, 0), type));
+    QVERIFY(!store.contains(QPoint(-1, 0), type));
+
+    // tiles with no points are stored without scans
+    QVERIFY(store.contains(QPoint(3, 3), type));
+    QCOMPARE(store.loadTile(QPoint(3, 3), type).pointCount(), 0);
+
+    store.close();
+    QVERIFY(!store.isOpen());
+    QVERIFY(!store.contains(QPoint(0, 0), NonUniformTileStore::ContentMS1Raw));
+    QCOMPARE(store.count(NonUniformTileStore::ContentMS1Raw), 0);
+}
+
+void NonUniformTileStoreMmapTest::testClone()
+{
+    QScopedPointer<NonUniformTileStoreMmap> store(new NonUniformTileStoreMmap);
+    QVERIFY(store->open(m_mmapFilePath));
+
+    const QPoint pos(1, 2);
+    const NonUniformTile expected = store->loadTile(pos, NonUniformTileStore::ContentMS1Raw);
+    QVERIFY(expected.pointCount() > 0);
+
+    // the mapping stays alive as long as any clone uses it
+    QScopedPointer<NonUniformTileStore> cloned(store->clone());
+    QVERIFY(cloned);
+    store.reset();
+    QCOMPARE(cloned->loadTile(pos, NonUniformTileStore::ContentMS1Raw), expected);
+
+    NonUniformTileStoreMmap closed;
+    QVERIFY(closed.clone() == nullptr);
+}
+
+void NonUniformTileStoreMmapTest::testReadOnly()
+{
+    NonUniformTileStoreMmap store;
+    QVERIFY(store.open(m_mmapFilePath));
+
+    const NonUniformTile tile = createTile(QPoint(100, 100), SCAN_COUNT, 0);
+    QVERIFY(!store.saveTile(tile, NonUniformTileStore::ContentMS1Raw));
+    QVERIFY(!store.contains(tile.position(), NonUniformTileStore::ContentMS1Raw));
+}
+
+void NonUniformTileStoreMmapTest::testInvalidFile_data()
+{
+    QTest::addColumn<int>("truncateTo");
+    QTest::addColumn<int>("corruptAt");
+
+    // -1 keeps the file as it is
+    QTest::newRow("empty") << 0 << -1;
+    QTest::newRow("headerOnly") << 64 << -1;
+    QTest::newRow("truncated") << 1000 << -1;
+    QTest::newRow("magic") << -1 << 0;
+    QTest::newRow("version") << -1 << 8;
+    QTest::newRow("indexOffset") << -1 << 30;
+}
+
+void NonUniformTileStoreMmapTest::testInvalidFile()
+{
+    QFETCH(int, truncateTo);
+    QFETCH(int, corruptAt);
+
+    QFile source(m_mmapFilePath);
+    QVERIFY(source.open(QIODevice::ReadOnly));
+    QByteArray content = source.readAll();
+    QVERIFY(content.size() > 1000);
+
+    if (truncateTo >= 0) {
+        content.truncate(truncateTo);
+    }
+    if (corruptAt >= 0) {
+        content[corruptAt] = static_cast<char>(content.at(corruptAt) ^ 0x5a);
+    }
+
+    const QString filePath = m_testOutputDir.filePath("invalid.mmap");
+    {
+        QFile invalid(filePath);
+        QVERIFY(invalid.open(QIODevice::WriteOnly | QIODevice::Truncate));
+        QCOMPARE(invalid.write(content), qint64(content.size()));
+    }
+
+    NonUniformTileStoreMmap store;
+    QVERIFY(!store.open(filePath));
+    QVERIFY(!store.isOpen());
+
+    QVERIFY(QFile::remove(filePath));
+}
+
+NonUniformTile NonUniformTileStoreMmapTest::createTile(const QPoint &position, int scanCount, int seed)
+{
+    NonUniformTile t;
+
+    QVector<point2dList> tileData;
+    for (int i = 0; i < scanCount; ++i) {
+        // some scans are empty
+        const int mzSize = (i * 7 + seed) % 23;
+        point2dList mzIntensity;
+        for (int j = 0; j < mzSize; ++j) {
+            mzIntensity.push_back(QPointF(position.x() * 10.0 + j * 0.37, std::fabs(std::sin(j + seed))));
+        }
+        tileData.push_back(mzIntensity);
+    }
+
+    t.setPosition(position);
+    t.setData(tileData);
+    return t;
+}
+
+_PMI_END
+
+QTEST_MAIN(pmi::NonUniformTileStoreMmapTest)
+
+#include "NonUniformTileStoreMmapTest.moc"
@@ -20,6 +20,7 @@ private:
 private Q_SLOTS:
     void testRoundTrip();
     void testSaveEmptyTile();
+    void testConvertEncoding();
 
 private:
     QSqlDatabase m_db;
@@ -108,6 +109,56 @@ void NonUniformTileStoreSqliteTest::testSaveEmptyTile()
     QFile::remove(filePath);
 }
 
+void NonUniformTileStoreSqliteTest::testConvertEncoding()
+{
+    QString filePath = m_testOutputDir.filePath("testConvertEncoding.db3");
+    if (QFileInfo(filePath).exists()) {
+        QFile::remove(filePath);
+    }
+
+    m_db = QSqlDatabase::addDatabase(kQSQLITE, QString("NonUniformTileStoreSqliteTest_testConvertEncoding"));
+    m_db.setDatabaseName(filePath);
+    QVERIFY(m_db.open());
+
+    NonUniformTileStoreSqlite store(&m_db);
+    QVERIFY(store.init());
+
+    // cache written by the previous versions, still the default so that they can read it
+    QCOMPARE(store.encoding().format, NonUniformTilesEncoding::FormatLegacy);
+    const NonUniformTile t = createSinTile(QPoint(0, 0));
+    const NonUniformTile t2 = createSinTile(QPoint(1, 0));
+    QVERIFY(store.saveTile(t, NonUniformTileStore::ContentMS1Raw));
+    QVERIFY(store.saveTile(t2, NonUniformTileStore::ContentMS1Centroided));
+    QCOMPARE(store.loadTile(t.position(), NonUniformTileStore::ContentMS1Raw), t);
+
+    QVERIFY(store.convertEncoding(NonUniformTilesEncoding::lossless()));
+    QCOMPARE(store.encoding().format, NonUniformTilesEncoding::FormatColumnar);
+    QCOMPARE(store.loadTile(t.position(), NonUniformTileStore::ContentMS1Raw), t);
+    QCOMPARE(store.loadTile(t2.position(), NonUniformTileStore::ContentMS1Centroided), t2);
+    QCOMPARE(store.pointCount(NonUniformTileStore::ContentMS1Raw), quint32(t.pointCount()));
+
+    // lossy conversion keeps the values within the quantization
+    const NonUniformTilesEncoding compact = NonUniformTilesEncoding::compact();
+    QVERIFY(store.convertEncoding(compact));
+    const NonUniformTile compactTile = store.loadTile(t.position(), NonUniformTileStore::ContentMS1Raw);
+    QCOMPARE(compactTile.items().size(), t.items().size());
+    for (int i = 0; i < t.items().size(); ++i) {
+        const point2dList &expected = t.value(i);
+        const point2dList &actual = compactTile.value(i);
+        QCOMPARE(actual.size(), expected.size());
+        for (size_t j = 0; j < expected.size(); ++j) {
+            QVERIFY(qAbs(actual[j].x() - expected[j].x()) <= compact.mzQuantum);
+            QVERIFY(qAbs(actual[j].y() - expected[j].y()) <= 1e-6);
+        }
+    }
+
+    // and back to the format readable by the previous versions
+    QVERIFY(store.convertEncoding(NonUniformTilesEncoding::legacy()));
+    QCOMPARE(store.loadTile(t.position(), NonUniformTileStore::ContentMS1Raw).pointCount(), t.pointCount());
+
+    m_db.close();
+    QFile::remove(filePath);
+}
 
 pmi::NonUniformTile NonUniformTileStoreSqliteTest::createSinTile(const QPoint& position)
 {
@@ -0,0 +1,198 @@
+#include <QtTest>
+#include "pmi_core_defs.h"
+#include "NonUniformTilesSerialization.h"
+
+#include <cmath>
+
+_PMI_BEGIN
+
+class NonUniformTilesSerializationTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void testIndexRoundTrip_data();
+    void testIndexRoundTrip();
+    void testLosslessRoundTrip();
+    void testCompactRoundTrip();
+    void testLogQuantizedIntensity();
+    void testLegacyBlobsAreReadable();
+    void testEmptyColumns();
+    void testColumnarIsSmaller();
+};
+
+static void createScans(QVector<int> *index, QVector<double> *mz, QVector<double> *intensity)
+{
+    for (int scan = 0; scan < 64; ++scan) {
+        const int count = 150 + (scan * 7) % 40;
+        index->push_back(count);
+        double currentMz = 400.0 + scan * 0.001;
+        for (int i = 0; i < count; ++i) {
+            currentMz += 0.0123 + 0.0001 * (i % 13);
+            mz->push_back(currentMz);
+            intensity->push_back(1000.0 * std::fabs(std::sin(i * 0.37 + scan)) + i);
+        }
+    }
+}
+
+void NonUniformTilesSerializationTest::testIndexRoundTrip_data()
+{
+    QTest::addColumn<QString>("encodingName");
+
+    QTest::newRow("legacy") << QString("legacy");
+    QTest::newRow("lossless") << QString("lossless");
+    QTest::newRow("compact") << QString("compact");
+}
+
+void NonUniformTilesSerializationTest::testIndexRoundTrip()
+{
+    QFETCH(QString, encodingName);
+
+    NonUniformTilesEncoding encoding;
+    QVERIFY(NonUniformTilesEncoding::fromName(encodingName, &encoding));
+
+    const QVector<int> index = { 0, 5, 5, 1000, 3, 0, 0, 70000, 1 };
+    const QByteArray blob = NonUniformTilesSerialization::serializeIndex(index, encoding);
+    QCOMPARE(NonUniformTilesSerialization::isColumnar(blob),
+             encoding.format == NonUniformTilesEncoding::FormatColumnar);
+    QCOMPARE(NonUniformTilesSerialization::deserializeIndex(blob, index.size()), index);
+}
+
+void NonUniformTilesSerializationTest::testLosslessRoundTrip()
+{
+    QVector<int> index;
+    QVector<double> mz;
+    QVector<double> intensity;
+    createScans(&index, &mz, &intensity);
+
+    // values which do not come from the test generator
+    mz.push_back(0.0);
+    mz.push_back(1e-300);
+    intensity.push_back(-12.5);
+    intensity.push_back(0.0);
+
+    const NonUniformTilesEncoding encoding = NonUniformTilesEncoding::lossless();
+    QVERIFY(encoding.isLossless());
+
+    const QVector<double> actualMz = NonUniformTilesSerialization::deserializeMz(
+        NonUniformTilesSerialization::serializeMz(mz, encoding), mz.size());
+    const QVector<double> actualIntensity = NonUniformTilesSerialization::deserializeIntensity(
+        NonUniformTilesSerialization::serializeIntensity(intensity, encoding), intensity.size());
+
+    QCOMPARE(actualMz.size(), mz.size());
+    QCOMPARE(actualIntensity.size(), intensity.size());
+    for (int i = 0; i < mz.size(); ++i) {
+        // bitwise equality
+        QVERIFY(actualMz.at(i) == mz.at(i));
+        QVERIFY(actualIntensity.at(i) == intensity.at(i));
+    }
+}
+
+void NonUniformTilesSerializationTest::testCompactRoundTrip()
+{
+    QVector<int> index;
+    QVector<double> mz;
+    QVector<double> intensity;
+    createScans(&index, &mz, &intensity);
+
+    const NonUniformTilesEncoding encoding = NonUniformTilesEncoding::compact();
+    QVERIFY(!encoding.isLossless());
+
+    const QVector<double> actualMz = NonUniformTilesSerialization::deserializeMz(
+        NonUniformTilesSerialization::serializeMz(mz, encoding), mz.size());
+    const QVector<double> actualIntensity = NonUniformTilesSerialization::deserializeIntensity(
+        NonUniformTilesSerialization::serializeIntensity(intensity, encoding), intensity.size());
+
+    QCOMPARE(actualMz.size(), mz.size());
+    QCOMPARE(actualIntensity.size(), intensity.size());
+    for (int i = 0; i < mz.size(); ++i) {
+        QVERIFY(std::fabs(actualMz.at(i) - mz.at(i)) <= encoding.mzQuantum / 2 + 1e-9);
+        QVERIFY(std::fabs(actualIntensity.at(i) - intensity.at(i)) <= 1e-6 * intensity.at(i) + 1e-6);
+    }
+}
+
+void NonUniformTilesSerializationTest::testLogQuantizedIntensity()
+{
+    const QVector<double> intensity = { 0.0, 1.0, 10.0, 1234.5, 1e6, 3.3e7, -5.0 };
+
+    NonUniformTilesEncoding encoding = NonUniformTilesEncoding::lossless();
+    encoding.intensity = NonUniformTilesEncoding::IntensityLogQuantized;
+
+    const QVector<double> actual = NonUniformTilesSerialization::deserializeIntensity(
+        NonUniformTilesSerialization::serializeIntensity(intensity, encoding), intensity.size());
+
+    QCOMPARE(actual.size(), intensity.size());
+    QCOMPARE(actual.at(0), 0.0);
+    // negative intensities are not representable
+    QCOMPARE(actual.last(), 0.0);
+    for (int i = 1; i < intensity.size() - 1; ++i) {
+        // 16 bits over log1p(3.3e7) ~ 17.3 give relative error below 0.02 %
+        QVERIFY2(std::fabs(actual.at(i) - intensity.at(i)) <= 2e-4 * intensity.at(i) + 1e-3,
+                 qPrintable(QString("%1 vs %2").arg(actual.at(i)).arg(intensity.at(i))));
+    }
+}
+
+void NonUniformTilesSerializationTest::testLegacyBlobsAreReadable()
+{
+    QVector<int> index;
+    QVector<double> mz;
+    QVector<double> intensity;
+    createScans(&index, &mz, &intensity);
+
+    // blobs as written by the previous versions of the cache
+    const QByteArray indexBlob = NonUniformTilesSerialization::serializeVector(index);
+    const QByteArray mzBlob = NonUniformTilesSerialization::serializeVector(mz);
+    const QByteArray intensityBlob = NonUniformTilesSerialization::serializeVector(intensity);
+
+    QVERIFY(!NonUniformTilesSerialization::isColumnar(indexBlob));
+    QVERIFY(!NonUniformTilesSerialization::isColumnar(mzBlob));
+    QVERIFY(!NonUniformTilesSerialization::isColumnar(intensityBlob));
+
+    QCOMPARE(NonUniformTilesSerialization::deserializeIndex(indexBlob, index.size()), index);
+    QCOMPARE(NonUniformTilesSerialization::deserializeMz(mzBlob, mz.size()), mz);
+    QCOMPARE(NonUniformTilesSerialization::deserializeIntensity(intensityBlob, intensity.size()), intensity);
+}
+
+void NonUniformTilesSerializationTest::testEmptyColumns()
+{
+    const NonUniformTilesEncoding encoding = NonUniformTilesEncoding::compact();
+
+    QVERIFY(NonUniformTilesSerialization::deserializeIndex(
+        NonUniformTilesSerialization::serializeIndex(QVector<int>(), encoding), 0).isEmpty());
+    QVERIFY(NonUniformTilesSerialization::deserializeMz(
+        NonUniformTilesSerialization::serializeMz(QVector<double>(), encoding), 0).isEmpty());
+    QVERIFY(NonUniformTilesSerialization::deserializeIntensity(
+        NonUniformTilesSerialization::serializeIntensity(QVector<double>(), encoding), 0).isEmpty());
+
+    // tiles saved with no points have empty blobs
+    QVERIFY(NonUniformTilesSerialization::deserializeMz(QByteArray(), 0).isEmpty());
+}
+
+void NonUniformTilesSerializationTest::testColumnarIsSmaller()
+{
+    QVector<int> index;
+    QVector<double> mz;
+    QVector<double> intensity;
+    createScans(&index, &mz, &intensity);
+
+    auto blobSize = [&](const NonUniformTilesEncoding &encoding) {
+        return NonUniformTilesSerialization::serializeIndex(index, encoding).size()
+            + NonUniformTilesSerialization::serializeMz(mz, encoding).size()
+            + NonUniformTilesSerialization::serializeIntensity(intensity, encoding).size();
+    };
+
+    const int legacySize = blobSize(NonUniformTilesEncoding::legacy());
+    const int losslessSize = blobSize(NonUniformTilesEncoding::lossless());
+    const int compactSize = blobSize(NonUniformTilesEncoding::compact());
+
+    qDebug() << "legacy" << legacySize << "lossless" << losslessSize << "compact" << compactSize;
+
+    QVERIFY(losslessSize < legacySize);
+    QVERIFY(compactSize * 2 < legacySize);
+}
+
+_PMI_END
+
+QTEST_MAIN(pmi::NonUniformTilesSerializationTest)
+
+#include "NonUniformTilesSerializationTest.moc"
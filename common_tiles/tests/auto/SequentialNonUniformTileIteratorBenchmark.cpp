@@ -0,0 +1,129 @@
+#include <QtTest>
+#include "pmi_core_defs.h"
+#include "MzScanIndexRect.h"
+#include "NonUniformTileManager.h"
+#include "NonUniformTileRange.h"
+#include "NonUniformTileStoreMemory.h"
+#include "SequentialNonUniformTileIterator.h"
+
+_PMI_BEGIN
+
+class SequentialNonUniformTileIteratorBenchmark : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+
+    void testValuesAreNotCopied();
+    void benchmarkIterate_data();
+    void benchmarkIterate();
+
+private:
+    NonUniformTileRange m_range;
+    NonUniformTileStoreMemory m_store;
+    int m_pointCount = 0;
+};
+
+static const NonUniformTileStoreType::ContentType CONTENT = NonUniformTileStoreType::ContentMS1Centroided;
+static const int TILE_COUNT = 20;
+static const int POINTS_PER_ROW = 200;
+
+void SequentialNonUniformTileIteratorBenchmark::initTestCase()
+{
+    m_range.setMzTileLength(10.0);
+    m_range.setMz(0.0, TILE_COUNT * 10.0 - 1.0);
+    m_range.setScanIndexLength(50);
+    m_range.setScanIndex(0, TILE_COUNT * 50 - 1);
+
+    QCOMPARE(m_range.tileCountX(), TILE_COUNT);
+    QCOMPARE(m_range.tileCountY(), TILE_COUNT);
+
+    for (int tileY = 0; tileY < m_range.tileCountY(); ++tileY) {
+        for (int tileX = 0; tileX < m_range.tileCountX(); ++tileX) {
+            NonUniformTile tile;
+            tile.setPosition(QPoint(tileX, tileY));
+
+            const double mzStart = m_range.mzAt(tileX);
+            const double mzStep = m_range.mzTileLength() / POINTS_PER_ROW;
+            for (int row = 0; row < m_range.scanIndexTileLength(); ++row) {
+                point2dList scanPart;
+                scanPart.reserve(POINTS_PER_ROW);
+                for (int i = 0; i < POINTS_PER_ROW; ++i) {
+                    scanPart.push_back(point2d(mzStart + i * mzStep, row + i));
+                }
+                tile.append(std::move(scanPart));
+                m_pointCount += POINTS_PER_ROW;
+            }
+
+            QVERIFY(m_store.saveTile(std::move(tile), CONTENT));
+        }
+    }
+}
+
+void SequentialNonUniformTileIteratorBenchmark::testValuesAreNotCopied()
+{
+    NonUniformTileManager manager(&m_store);
+    const QRect tileArea = m_range.tileRect(MzScanIndexRect::fromQRectF(m_range.area()));
+
+    SequentialNonUniformTileIterator iterator(&manager, m_range, true, tileArea);
+    while (iterator.hasNext()) {
+        const point2dList &scanPart = iterator.next();
+
+        // the iterator hands out the rows stored in the tile, not copies of them
+        const NonUniformTile tile = m_store.loadTile(QPoint(iterator.x(), iterator.y()), CONTENT);
+        const point2dList &stored = tile.value(m_range.tileOffset(iterator.scanIndex()));
+        QCOMPARE(scanPart.data(), stored.data());
+        QCOMPARE(&iterator.value(), &scanPart);
+    }
+
+    // every tile is fetched from the store once, the rest of the rows come from the held tile
+    int dbTiles = -1;
+    int cachedTiles = -1;
+    manager.fetchCounts(&dbTiles, &cachedTiles);
+    QCOMPARE(dbTiles, TILE_COUNT * TILE_COUNT);
+    QCOMPARE(cachedTiles, 0);
+}
+
+void SequentialNonUniformTileIteratorBenchmark::benchmarkIterate_data()
+{
+    QTest::addColumn<qint64>("cacheSizeBytes");
+
+    // without the cache every row reloads its tile from the store
+    QTest::newRow("noCache") << qint64(0);
+    QTest::newRow("defaultCache") << qint64(NonUniformTileCache::DEFAULT_MAX_BYTES);
+}
+
+void SequentialNonUniformTileIteratorBenchmark::benchmarkIterate()
+{
+    QFETCH(qint64, cacheSizeBytes);
+
+    NonUniformTileManager manager(&m_store);
+    const QRect tileArea = m_range.tileRect(MzScanIndexRect::fromQRectF(m_range.area()));
+    SequentialNonUniformTileIterator iterator(&manager, m_range, true, tileArea);
+    iterator.setCacheSizeBytes(cacheSizeBytes);
+
+    int pointCount = 0;
+    double intensitySum = 0.0;
+    QBENCHMARK {
+        pointCount = 0;
+        intensitySum = 0.0;
+        iterator.rewind();
+        while (iterator.hasNext()) {
+            const point2dList &scanPart = iterator.next();
+            pointCount += static_cast<int>(scanPart.size());
+            for (const point2d &pt : scanPart) {
+                intensitySum += pt.y();
+            }
+        }
+    }
+
+    QCOMPARE(pointCount, m_pointCount);
+    QVERIFY(intensitySum > 0.0);
+}
+
+_PMI_END
+
+QTEST_MAIN(pmi::SequentialNonUniformTileIteratorBenchmark)
+
+#include "SequentialNonUniformTileIteratorBenchmark.moc"
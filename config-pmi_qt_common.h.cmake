@@ -78,10 +78,6 @@
 //! @brief Output Centroid smoothing to file to debug it
 #cmakedefine PMI_MS_OUTPUT_DEBUG_CENTROID_SMOOTHING_TO_FILE
 
-//! @def PMI_MS_ENABLE_CENTROID_CACHE
-//! @brief Enable Centroid cache
-#cmakedefine PMI_MS_ENABLE_CENTROID_CACHE
-
 //! @def PMI_MS_ENABLE_SHIMADZU_API
 //! @brief Enable support for Shimadzu MS Reader
 #cmakedefine PMI_MS_ENABLE_SHIMADZU_API
@@ -55,6 +55,14 @@ MSTestCommandLineParser::MSTestCommandLineParser()
     addOption(QCommandLineOption(QStringList() << QString(PRESET_CHAR) << PRESET_STRING,
                                  QObject::tr("preset file path (.json)"),
                                  "Preset"));
+    addOption(QCommandLineOption(QStringList() << QString(ENCODING_STRING),
+                                 QObject::tr("Non-uniform cache tile encoding (when using --command 5)\n"
+                                             "legacy (default, readable by older versions)\n"
+                                             "lossless\n"
+                                             "compact (m/z rounded to 1e-5 Da, float intensities)\n"
+                                             "Existing cache is converted to the encoding"),
+                                 "encoding"));
+
     addOption(QCommandLineOption(QStringList() << QString(COMPARE_BY_INDEX_CHAR) << COMPARE_BY_INDEX_STRING,
         QObject::tr("Compare scan x-y data by index (when using --command 6); Default is comparing by co - ordinate")));
     
@@ -29,18 +29,34 @@ pmi::Err NonUniformCacheCommand::execute()
     QElapsedTimer et;
     et.start();
 
+    pmi::NonUniformTilesEncoding encoding = pmi::NonUniformTilesEncoding::legacy();
+    const bool hasEncoding = !m_parser->encoding().isEmpty();
+    if (hasEncoding && !pmi::NonUniformTilesEncoding::fromName(m_parser->encoding(), &encoding)) {
+        qWarning() << "Unknown encoding" << m_parser->encoding();
+        return pmi::kBadParameterError;
+    }
+
     QString dstFilePath;
     e = pmi::MSDataNonUniformGenerator::defaultCacheLocation(m_parser->sourceFile(), &dstFilePath); ree;
 
-    pmi::MSDataNonUniformGenerator generator(m_parser->sourceFile());
-    generator.setOutputFilePath(dstFilePath);
-
     if (QFileInfo(dstFilePath).exists()) {
-        qWarning() << "Destination file" << dstFilePath << "exists! Cache generation stopped!";
-        e = pmi::kError; ree;
+        if (!hasEncoding) {
+            qWarning() << "Destination file" << dstFilePath << "exists! Cache generation stopped!";
+            e = pmi::kError; ree;
+        }
+
+        const qint64 sizeBefore = QFileInfo(dstFilePath).size();
+        e = pmi::MSDataNonUniformGenerator::convertEncoding(dstFilePath, encoding); ree;
+
+        qInfo() << "NonUniform cache converted to" << m_parser->encoding() << "in" << et.elapsed()
+                << "ms, size" << sizeBefore << "->" << QFileInfo(dstFilePath).size() << "bytes";
+        return e;
     }
 
+    pmi::MSDataNonUniformGenerator generator(m_parser->sourceFile());
+    generator.setOutputFilePath(dstFilePath);
     generator.setDoCentroiding(m_parser->doCentroiding());
+    generator.setEncoding(encoding);
     e = generator.generate(); ree;
 
     qInfo() << "NonUniform cache created in" << et.elapsed() << "ms";
@@ -20,6 +20,7 @@ const char *PMCommandLineParser::TOLERANCE_STRING = "tolerance";
 const char *PMCommandLineParser::MS_CONVERT_OPTIONS = "msconvertoptions";
 const char *PMCommandLineParser::FORMAT_STRING = "format";
 const char *PMCommandLineParser::PRESET_STRING = "preset";
+const char *PMCommandLineParser::ENCODING_STRING = "encoding";
 
 const char *PMCommandLineParser::IMO_SUMMING_TOLERANCE_STRING = "imo.summingTolerance";
 const char *PMCommandLineParser::IMO_MERGING_TOLERANCE_STRING = "imo.mergingTolerance";
@@ -161,6 +162,16 @@ bool PMCommandLineParser::validateAndParseForNonUniformCacheCommand()
     }
 
     m_doCentroid = isSet(QString(CENTROID_CHAR));
+
+    m_encoding.clear();
+    if (isSet(ENCODING_STRING)) {
+        m_encoding = value(ENCODING_STRING);
+        if (m_encoding.isEmpty()) {
+            qWarning() << "Encoding not specified";
+            return false;
+        }
+    }
+
     return true;
 }
 
@@ -387,6 +398,11 @@ bool PMCommandLineParser::writeFullXYDiff() const
     return m_writeFullXYDiff;
 }
 
+QString PMCommandLineParser::encoding() const
+{
+    return m_encoding;
+}
+
 void PMCommandLineParser::addConvertOption()
 {
     addOption(
@@ -50,6 +50,7 @@ public:
     bool doCentroiding() const;
     bool compareByIndex() const;
     bool writeFullXYDiff() const;
+    QString encoding() const;
 
 protected:
     void addConvertOption();
@@ -68,6 +69,7 @@ protected:
     static const char *MS_CONVERT_OPTIONS;
     static const char *FORMAT_STRING;
     static const char *PRESET_STRING;
+    static const char *ENCODING_STRING;
 
     static const char *IMO_SUMMING_TOLERANCE_STRING;
     static const char *IMO_MERGING_TOLERANCE_STRING;
@@ -102,6 +104,7 @@ private:
     QString m_outputFolderPath;
     QString m_format;
     QString m_presetFilePath;
+    QString m_encoding;
     QStringList m_sourceFileNameList;
     CommandId m_commandId;
     pmi::msreader::MSConvertOption m_msConvertOption;
@@ -13,12 +13,62 @@
 #include "pmi_common_ms_debug.h"
 #include <QtSqlUtils.h>
 
+// fix warning: undefine _USE_MATH_DEFINES as nanoflann.hpp is defining it
+#undef _USE_MATH_DEFINES
+#include <nanoflann.hpp>
+
+#include <QThread>
+#include <QtConcurrent/QtConcurrentMap>
+
+#include <algorithm>
+#include <limits>
+#include <numeric>
+
 const QString DEFAULT_FILENAME = QStringLiteral("Comparitron.nslco");
 const int VECTOR_GRANULARITY = 1000;
 const int VECTOR_GRANULARITY_TIME = 10000;
 
+// grouping splits features into at least this many per m/z stripe
+const int MIN_MASS_STRIPE_SIZE = 1024;
+// stripes are cut only where the mass gap is safely wider than the tolerance
+const double MASS_STRIPE_GAP_FACTOR = 1.001;
+const int KD_TREE_MAX_LEAF_SIZE = 16;
+
 _PMI_BEGIN
 
+namespace
+{
+
+//! @brief Features of one m/z stripe as nanoflann reads them: scaled mass and warped time
+struct StripePointCloud {
+    std::vector<double> coordinates;
+
+    inline size_t kdtree_get_point_count() const { return coordinates.size() / 2; }
+
+    inline double kdtree_get_pt(const size_t idx, int dim) const
+    {
+        return coordinates[idx * 2 + dim];
+    }
+
+    template <class BBOX>
+    bool kdtree_get_bbox(BBOX &) const
+    {
+        return false;
+    }
+};
+
+typedef nanoflann::KDTreeSingleIndexAdaptor<nanoflann::L2_Simple_Adaptor<double, StripePointCloud>,
+                                            StripePointCloud, 2, int>
+    StripeKDTree;
+
+//! @brief [begin, end) range of the features sorted by mass
+struct MassStripe {
+    int begin = 0;
+    int end = 0;
+};
+
+} // namespace
+
 CrossSampleFeatureCollatorTurbo::CrossSampleFeatureCollatorTurbo(
     const QVector<SampleFeaturesTurbo> &sampleFeatures,
     const SettableFeatureFinderParameters &ffUserParams)
@@ -246,41 +296,175 @@ inline double calculateIntersectionOverUnion(double start1, double end1, double
 }
 
 
-Err CrossSampleFeatureCollatorTurbo::crossSampleFeatureGrouping()
+/*!
+ * @brief Splits the features into m/z stripes of about @a targetStripeSize features
+ *
+ * A stripe is only cut where the mass gap is wider than the tolerance of the heavier side, so no
+ * feature can be grouped with a feature of another stripe and the stripes can be grouped
+ * independently. Dense data without such gaps ends up in fewer, bigger stripes.
+ */
+static std::vector<MassStripe> splitIntoMassStripes(const std::vector<double> &masses, int ppm,
+                                                    int targetStripeSize, std::vector<int> *byMass)
 {
-    Err e = kNoErr;
+    const int featureCount = static_cast<int>(masses.size());
 
-    std::sort(m_consolidatedCrossSampleFeatures.begin(), m_consolidatedCrossSampleFeatures.end(),
-        [](const CrossSampleFeatureTurbo &a, const CrossSampleFeatureTurbo &b) {return a.rtWarped < b.rtWarped; });
+    byMass->resize(featureCount);
+    std::iota(byMass->begin(), byMass->end(), 0);
+    std::sort(byMass->begin(), byMass->end(), [&masses](int a, int b) {
+        return masses[a] < masses[b] || (masses[a] == masses[b] && a < b);
+    });
 
-    int masterFeature = 0;
-    for (int i = 0; i < static_cast<int>(m_consolidatedCrossSampleFeatures.size()); ++i) {
+    std::vector<MassStripe> stripes;
+    MassStripe stripe;
+    for (int k = 1; k < featureCount; ++k) {
+        if (k - stripe.begin < targetStripeSize) {
+            continue;
+        }
 
-        CrossSampleFeatureTurbo &row = m_consolidatedCrossSampleFeatures[i];
-        if (row.masterFeature != NOT_SET) {
+        const double lower = masses[(*byMass)[k - 1]];
+        const double upper = masses[(*byMass)[k]];
+        if (upper - lower > calculatePPMTolerance(upper, ppm) * MASS_STRIPE_GAP_FACTOR) {
+            stripe.end = k;
+            stripes.push_back(stripe);
+            stripe.begin = k;
+        }
+    }
+
+    if (stripe.begin < featureCount) {
+        stripe.end = featureCount;
+        stripes.push_back(stripe);
+    }
+
+    return stripes;
+}
+
+/*!
+ * @brief Groups features of one stripe, @a seeds[i] is set to the feature which started the group
+ * of feature i
+ *
+ * Features are visited in time order (that is the index order), an ungrouped feature starts a new
+ * group and takes all later ungrouped features within the mass and time tolerance.
+ */
+static void groupMassStripe(const MassStripe &stripe, const std::vector<int> &byMass,
+                            const std::vector<double> &masses, const std::vector<double> &times,
+                            const std::vector<char> &grouped, int ppm, double timeTolerance,
+                            std::vector<int> *seeds)
+{
+    std::vector<int> indices(byMass.begin() + stripe.begin, byMass.begin() + stripe.end);
+    std::sort(indices.begin(), indices.end());
+
+    const int featureCount = static_cast<int>(indices.size());
+
+    // both tolerances have similar size in the tree so the tolerance box is close to the circle
+    const double maxMassTolerance = calculatePPMTolerance(masses[byMass[stripe.end - 1]], ppm);
+    const double massScale
+        = (maxMassTolerance > 0 && timeTolerance > 0) ? timeTolerance / maxMassTolerance : 1.0;
+
+    StripePointCloud cloud;
+    cloud.coordinates.reserve(featureCount * 2);
+    std::vector<char> isGrouped(featureCount);
+    for (int k = 0; k < featureCount; ++k) {
+        cloud.coordinates.push_back(masses[indices[k]] * massScale);
+        cloud.coordinates.push_back(times[indices[k]]);
+        isGrouped[k] = grouped[indices[k]];
+    }
+
+    StripeKDTree tree(2, cloud, nanoflann::KDTreeSingleIndexAdaptorParams(KD_TREE_MAX_LEAF_SIZE));
+    tree.buildIndex();
+
+    // squared radius of a circle around the tolerance box, the candidates are then checked with
+    // the exact tolerances
+    const double scaledMassTolerance = std::abs(maxMassTolerance) * massScale;
+    const double searchRadius
+        = (scaledMassTolerance * scaledMassTolerance + timeTolerance * timeTolerance) * 1.0001
+        + std::numeric_limits<double>::min();
+
+    nanoflann::SearchParams params;
+    params.sorted = false;
+    std::vector<std::pair<int, double>> matches;
+
+    for (int k = 0; k < featureCount; ++k) {
+        if (isGrouped[k]) {
             continue;
         }
 
-        row.masterFeature = masterFeature;
-        double massTolerance = calculatePPMTolerance(row.mwMonoisotopic, m_ffUserParams.ppm);
+        const int seed = indices[k];
+        (*seeds)[seed] = seed;
+        isGrouped[k] = true;
+
+        const double massTolerance = calculatePPMTolerance(masses[seed], ppm);
+        tree.radiusSearch(&cloud.coordinates[k * 2], searchRadius, matches, params);
 
-        for (int j = i + 1; j < m_consolidatedCrossSampleFeatures.size(); ++j) {
-            
-            CrossSampleFeatureTurbo &toCompareCurrentRow 
-                = m_consolidatedCrossSampleFeatures[j];
-            if (toCompareCurrentRow.masterFeature != NOT_SET) {
+        for (const std::pair<int, double> &match : matches) {
+            const int m = match.first;
+            if (m <= k || isGrouped[m]) {
                 continue;
             }
 
-            if (std::abs(toCompareCurrentRow.mwMonoisotopic - row.mwMonoisotopic) <= massTolerance
-                && std::abs(toCompareCurrentRow.rtWarped - row.rtWarped) <= m_ffParams.maxTimeToleranceWarped) {
-                toCompareCurrentRow.masterFeature = masterFeature;
+            const int feature = indices[m];
+            if (std::abs(masses[feature] - masses[seed]) <= massTolerance
+                && std::abs(times[feature] - times[seed]) <= timeTolerance) {
+                (*seeds)[feature] = seed;
+                isGrouped[m] = true;
             }
         }
+    }
+}
 
-        masterFeature++;
+Err CrossSampleFeatureCollatorTurbo::crossSampleFeatureGrouping()
+{
+    Err e = kNoErr;
+
+    std::sort(m_consolidatedCrossSampleFeatures.begin(), m_consolidatedCrossSampleFeatures.end(),
+        [](const CrossSampleFeatureTurbo &a, const CrossSampleFeatureTurbo &b) {return a.rtWarped < b.rtWarped; });
+
+    const int featureCount = m_consolidatedCrossSampleFeatures.size();
+    if (featureCount == 0) {
+        return e;
     }
 
+    std::vector<double> masses(featureCount);
+    std::vector<double> times(featureCount);
+    std::vector<char> grouped(featureCount);
+    for (int i = 0; i < featureCount; ++i) {
+        const CrossSampleFeatureTurbo &row = m_consolidatedCrossSampleFeatures.at(i);
+        masses[i] = row.mwMonoisotopic;
+        times[i] = row.rtWarped;
+        grouped[i] = (row.masterFeature != NOT_SET);
+    }
+
+    const int targetStripeSize
+        = std::max(MIN_MASS_STRIPE_SIZE, featureCount / (QThread::idealThreadCount() * 4));
+    std::vector<int> byMass;
+    std::vector<MassStripe> stripes
+        = splitIntoMassStripes(masses, m_ffUserParams.ppm, targetStripeSize, &byMass);
+
+    // every stripe writes seeds of its own features only
+    std::vector<int> seeds(featureCount, NOT_SET);
+    const int ppm = m_ffUserParams.ppm;
+    const double timeTolerance = m_ffParams.maxTimeToleranceWarped;
+    QtConcurrent::blockingMap(stripes, [&](const MassStripe &stripe) {
+        groupMassStripe(stripe, byMass, masses, times, grouped, ppm, timeTolerance, &seeds);
+    });
+
+    // master features are numbered in the time order of the features which started them
+    std::vector<int> seedMasterFeature(featureCount, NOT_SET);
+    int masterFeature = 0;
+    for (int i = 0; i < featureCount; ++i) {
+        if (seeds[i] == i) {
+            seedMasterFeature[i] = masterFeature++;
+        }
+    }
+
+    for (int i = 0; i < featureCount; ++i) {
+        if (seeds[i] != NOT_SET) {
+            m_consolidatedCrossSampleFeatures[i].masterFeature = seedMasterFeature[seeds[i]];
+        }
+    }
+
+    debugMs() << "Grouped" << featureCount << "features into" << masterFeature
+              << "master features in" << stripes.size() << "m/z stripes";
+
     std::sort(m_consolidatedCrossSampleFeatures.begin(), m_consolidatedCrossSampleFeatures.end(),
               [](const CrossSampleFeatureTurbo &left, const CrossSampleFeatureTurbo &right) {
                   return (left.masterFeature < right.masterFeature);
@@ -487,27 +671,26 @@ Err CrossSampleFeatureCollatorTurbo::consolidateDuplicateSampleIdsFoundInMasterF
     QVector<CrossSampleFeatureTurbo> consolidatedCrossSampleFeatures;
     QHash<int, QVector<CrossSampleFeatureTurbo>> sampleIdsInMasterFeature;
 
-    // +1 is added here so that when the last present masterFeature found is procesed it will
-    // proceed to the else if conditional. Otherwise last master feature goes unprocessed.
-    for (int i = 0; i <= m_consolidatedCrossSampleFeatures.back().masterFeature + 1; ++i) {
-
-        for (int j = 0; j < static_cast<int>(m_consolidatedCrossSampleFeatures.size()); ++j) {
-
-            const CrossSampleFeatureTurbo &currentFeature = m_consolidatedCrossSampleFeatures[j];
-
-            if (i == currentFeature.masterFeature) {
+    // every run of the same master feature is consolidated, features without master feature are
+    // dropped
+    const int featureCount = m_consolidatedCrossSampleFeatures.size();
+    int end = 0;
+    for (int begin = 0; begin < featureCount; begin = end) {
+        const int masterFeature = m_consolidatedCrossSampleFeatures[begin].masterFeature;
+        for (end = begin;
+             end < featureCount && m_consolidatedCrossSampleFeatures[end].masterFeature == masterFeature;
+             ++end) {
+            if (masterFeature >= 0) {
+                const CrossSampleFeatureTurbo &currentFeature = m_consolidatedCrossSampleFeatures[end];
                 sampleIdsInMasterFeature[currentFeature.sampleId].push_back(currentFeature);
-            } else if (i < m_consolidatedCrossSampleFeatures[j].masterFeature
-                       || j == (m_consolidatedCrossSampleFeatures.size() - 1)) {
-                for (auto it = sampleIdsInMasterFeature.begin();
-                     it != sampleIdsInMasterFeature.end(); ++it) {
-                    consolidatedCrossSampleFeatures.push_back(
-                        consolidateMultiSampleIdToSingleFeature(it.value()));
-                }
-                sampleIdsInMasterFeature.clear();
-                break;
             }
         }
+
+        for (auto it = sampleIdsInMasterFeature.begin(); it != sampleIdsInMasterFeature.end(); ++it) {
+            consolidatedCrossSampleFeatures.push_back(
+                consolidateMultiSampleIdToSingleFeature(it.value()));
+        }
+        sampleIdsInMasterFeature.clear();
     }
 
     m_consolidatedCrossSampleFeatures = consolidatedCrossSampleFeatures;
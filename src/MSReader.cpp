@@ -14,12 +14,10 @@
 #include <qt_string_utils.h>
 #include "VendorPathChecker.h"
 
-#ifdef PMI_MS_ENABLE_CENTROID_CACHE
-    #include <MSCentroidCacheManager.h>
-#endif
 
 #include "CacheFileCreatorThread.h"
 #include "MS1PrefixSum.h"
+#include "MSCentroidCache.h"
 #include "MSDataNonUniformAdapter.h"
 #include "pmi_common_ms_debug.h"
 #include "ProgressBarInterface.h"
@@ -164,9 +162,6 @@ MSReader::MSReader()
     : m_cacheFileManager(new CacheFileManager())
     , m_caliManager(*m_cacheFileManager.data())
     , m_xicMode(XICModeVendor)
-#ifdef PMI_MS_ENABLE_CENTROID_CACHE
-    , m_centroidCacheManager(new MSCentroidCacheManager)
-#endif
 {
     if (!s_instance) {
         s_instance = this;
@@ -233,10 +228,6 @@ MSReader::~MSReader()
     // anything to commonMsDebug(), stderr, stdout. Need to fix this later. ML-284
     closeAllFileConnections();
 
-#ifdef PMI_MS_ENABLE_CENTROID_CACHE
-    delete m_centroidCacheManager;
-#endif
-
     if (s_instance == this) {
         s_instance = nullptr;
     }
@@ -490,8 +481,34 @@ Err MSReader::getScanData(long scanNumber, point2dList *points, bool do_centroid
 {
     Q_ASSERT(points);
 
+    Err e = kNoErr;
+    ScanDataProcessing processing;
+
+    e = readScanData(scanNumber, points, do_centroiding, pointListAsByteArrays, &processing); ree;
+
+    if (processing.customCentroiding) {
+        e = _customCentroid(processing.smoothingWidth, points); ree;
+
+        // not being able to write the cache file is not fatal
+        _centroidCache()->insert(scanNumber, *points);
+        processing.customCentroiding = false;
+    }
+
+    return processScanData(processing, points, pointListAsByteArrays);
+}
+
+Err MSReader::readScanData(long scanNumber, point2dList *points, bool do_centroiding,
+                           msreader::PointListAsByteArrays *pointListAsByteArrays,
+                           ScanDataProcessing *processing)
+{
+    Q_ASSERT(points);
+    Q_ASSERT(processing);
+
     Err e = kNoErr;
 
+    *processing = ScanDataProcessing();
+    processing->scanNumber = scanNumber;
+
     if (m_openReader) {
         ScanInfo scanInfo;
         e = getScanInfo(scanNumber, &scanInfo); eee;
@@ -504,14 +521,14 @@ Err MSReader::getScanData(long scanNumber, point2dList *points, bool do_centroid
             : isCustomCentroidingPreferred(m_openReader.data(), m_centroidOption, scanNumber,
                                            scanInfo.peakMode);
         if (peformCustomCentroiding) {
-            PlotBase plot;
+            // custom centroiding is slow, the result is kept in the cache file across sessions
+            if (!_centroidCache()->find(scanNumber, points)) {
+                e = m_openReader->getScanData(scanNumber, points, false,
+                                              pointListAsByteArrays); eee;
 
-            e = m_openReader->getScanData(scanNumber, &plot.getPointList(), false,
-                                          pointListAsByteArrays); eee;
-
-            e = gaussianSmooth(plot, m_centroidOption.getSmoothingWidth()); eee;
-
-            plot.makeCentroidedPoints(points);
+                processing->customCentroiding = true;
+                processing->smoothingWidth = m_centroidOption.getSmoothingWidth();
+            }
 
             // TODO: If there's compressed information, we currently do not calibrate them
             // correctly.  So, we are currently placing with InitUsingPointList_NoCompression below.
@@ -523,56 +540,86 @@ Err MSReader::getScanData(long scanNumber, point2dList *points, bool do_centroid
             e = m_openReader->getScanData(scanNumber, points, do_centroiding,
                                           pointListAsByteArrays); eee;
         }
-#ifdef PMI_MS_CHECK_MS_READER_SCAN_DATA
-        // Keep the test quick.  Don't try and recover from a bad scan.
-        QString errMsg;
 
-        for (unsigned int i = 0; i < points->size(); i++) {
-            // Note: using .at() is slower due to assert call.
-            if (std::isnan((*points)[i].x()) || std::isnan((*points)[i].y())) {
-                errMsg = QString("infinite point at i = %1").arg(i);
+        bool found = false;
+        auto iter = m_caliManager.get(m_openReader->getFilename(), &found);
 
-                break;
-            }
+        if (found) {
+            processing->calibration = iter->scanCalibration(scanInfo.retTimeMinutes);
+        }
+    } else {
+        e = kError; eee;
+    }
+error:
+    return e;
+}
 
-            if (i > 0 && ((*points)[i].x() < (*points)[i - 1].x())) {
-                errMsg = QString("order flipped at i = %1").arg(i);
+Err MSReader::_customCentroid(double smoothingWidth, point2dList *points)
+{
+    Q_ASSERT(points);
 
-                break;
-            }
-        }
-        if (errMsg.size() > 0) {
-            warningMs() << (QString("Scan number: %1 has issue: %2.\nTotal number of points: %3.")
-                                .arg(scanNumber)
-                                .arg(errMsg)
-                                .arg(points->size()));
+    Err e = kNoErr;
+    PlotBase plot(std::move(*points));
+
+    e = gaussianSmooth(plot, smoothingWidth); ree;
+
+    plot.makeCentroidedPoints(points);
+
+    return e;
+}
+
+Err MSReader::processScanData(const ScanDataProcessing &processing, point2dList *points,
+                              msreader::PointListAsByteArrays *pointListAsByteArrays)
+{
+    Q_ASSERT(points);
+
+    Err e = kNoErr;
+
+    if (processing.customCentroiding) {
+        e = _customCentroid(processing.smoothingWidth, points); ree;
+    }
+#ifdef PMI_MS_CHECK_MS_READER_SCAN_DATA
+    // Keep the test quick.  Don't try and recover from a bad scan.
+    QString errMsg;
 
-            points->clear(); // ignore the whole scan
+    for (unsigned int i = 0; i < points->size(); i++) {
+        // Note: using .at() is slower due to assert call.
+        if (std::isnan((*points)[i].x()) || std::isnan((*points)[i].y())) {
+            errMsg = QString("infinite point at i = %1").arg(i);
+
+            break;
         }
-#endif // PMI_MS_CHECK_MS_READER_SCAN_DATA
 
-        bool found = false;
-        auto iter = m_caliManager.get(m_openReader->getFilename(), &found);
+        if (i > 0 && ((*points)[i].x() < (*points)[i - 1].x())) {
+            errMsg = QString("order flipped at i = %1").arg(i);
 
-        if (found) {
-            iter->calibrate(scanInfo.retTimeMinutes, *points);
+            break;
         }
+    }
+    if (errMsg.size() > 0) {
+        warningMs() << (QString("Scan number: %1 has issue: %2.\nTotal number of points: %3.")
+                            .arg(processing.scanNumber)
+                            .arg(errMsg)
+                            .arg(points->size()));
+
+        points->clear(); // ignore the whole scan
+    }
+#endif // PMI_MS_CHECK_MS_READER_SCAN_DATA
 
-        if (pointListAsByteArrays) {
-            if (pointListAsByteArrays->dataX.size() <= 0 && pointListAsByteArrays->dataY.size() <= 0
-                && pointListAsByteArrays->compressionInfoId.isNull()) {
-                DEBUG_WARNING_LIMIT(
-                    debugMs() << "Using uncompressed blob format on scanNumber,do_centroiding"
-                              << scanNumber << "," << do_centroiding,
-                    50);
+    processing.calibration.apply(*points);
 
-                e = InitUsingPointList_NoCompression(points, *pointListAsByteArrays); eee;
-            }
+    if (pointListAsByteArrays) {
+        if (pointListAsByteArrays->dataX.size() <= 0 && pointListAsByteArrays->dataY.size() <= 0
+            && pointListAsByteArrays->compressionInfoId.isNull()) {
+            DEBUG_WARNING_LIMIT(
+                debugMs() << "Using uncompressed blob format on scanNumber"
+                          << processing.scanNumber,
+                50);
+
+            e = InitUsingPointList_NoCompression(points, *pointListAsByteArrays); ree;
         }
-    } else {
-        e = kError; eee;
     }
-error:
+
     return e;
 }
 
@@ -582,7 +629,13 @@ Err MSReader::getXICData(const XICWindow &win, point2dList *points, int msLevel)
     Err e = kNoErr;
 
     if (!m_openReader.isNull()) {
-        if (m_xicMode == XICModeVendor) {
+        bool calibrated = false;
+        m_caliManager.get(m_openReader->getFilename(), &calibrated);
+
+        // byspec XIC index stores uncalibrated m/z, use manual XIC when calibration is applied
+        if (m_xicMode == XICModeVendor
+            && !(calibrated
+                 && m_openReader->classTypeName() == MSReaderBase::MSReaderClassTypeByspec)) {
             // let us inside block for NonUniform and ManualXIC
             e = m_openReader->getXICData(win, points, msLevel);
         } else {
@@ -626,6 +679,57 @@ error:
     return e;
 }
 
+Err MSReader::getXICDataBatch(const QVector<XICWindow> &windows, QVector<point2dList> *points,
+                              int msLevel) const
+{
+    Q_ASSERT(points);
+    Err e = kNoErr;
+
+    points->clear();
+
+    if (!m_openReader) {
+        rrr(kError);
+    }
+
+    if (windows.isEmpty()) {
+        return e;
+    }
+
+    if (m_xicMode == XICModeVendor) {
+        bool calibrated = false;
+        m_caliManager.get(m_openReader->getFilename(), &calibrated);
+
+        // same rule as getXICData: byspec XIC index stores uncalibrated m/z
+        if (!(calibrated && m_openReader->classTypeName() == MSReaderBase::MSReaderClassTypeByspec)) {
+            e = m_openReader->getXICDataBatch(windows, points, msLevel);
+            if (e != kFunctionNotImplemented) {
+                return e;
+            }
+        }
+    } else if (m_xicMode == XICModeTiledCache) {
+        // const_cast hack to allow getXICDataBatchCached lazy-initialize the database on first
+        // call. Like getXICData, the tiled cache has no manual fall-back, e.g. for ms level 2
+        MSReader *msConstless = const_cast<MSReader *>(this);
+        return msConstless->getXICDataBatchCached(windows, points, msLevel);
+    }
+
+    // fall-back to manual: one sweep over the scans, each scan routed to all windows overlapping it
+    QVector<ChromatogramRequest> requests;
+    requests.reserve(windows.size());
+    for (const XICWindow &win : windows) {
+        requests.push_back(ChromatogramRequest(win));
+    }
+
+    e = getChromatogramsSinglePass(&requests, msLevel); ree;
+
+    points->resize(windows.size());
+    for (int i = 0; i < requests.size(); ++i) {
+        (*points)[i].swap(requests[i].points);
+    }
+
+    return e;
+}
+
 Err MSReader::setScanInfoCache(long scanNumber, const msreader::ScanInfo &obj)
 {
     if (!m_openReader) {
@@ -915,9 +1019,7 @@ void MSReader::closeAllFileConnections()
     }
 
     m_fileName_ms1PrefixSumPtr.clear();
-#ifdef PMI_MS_ENABLE_CENTROID_CACHE
-    m_centroidCacheManager->clear();
-#endif
+    m_fileName_centroidCache.clear();
 }
 
 Err MSReader::getTimeDomain(double *startTime, double *endTime) const
@@ -1121,6 +1223,21 @@ Err MSReader::_getScanDataMS1SumManualScanNumber(int msLevel, long scanStart, lo
     ScanInfo scanInfo;
     PlotBase plot;
 
+    // Scans are read on this thread and summed in batches on all threads. The chunk count is fixed
+    // so the sum doesn't depend on the number of cores. Small batches are summed one scan at a time
+    // as the pool and the partial grids would cost more than they save.
+    const int maxBatchPointCount = 1 << 22;
+    const int minParallelPointCount = 1 << 18;
+    const int batchChunkCount = 8;
+    QVector<point2dList> batch;
+    int batchPointCount = 0;
+    auto accumulateBatch = [&]() {
+        const int chunkCount = (batchPointCount < minParallelPointCount) ? 1 : batchChunkCount;
+        gridOut->accumulate_sorted(batch, type, chunkCount);
+        batch.clear();
+        batchPointCount = 0;
+    };
+
     const long scanExcludingStart = scanStart + 1;
 
     for (long scan = scanExcludingStart; scan <= scanEnd; scan++) {
@@ -1130,9 +1247,16 @@ Err MSReader::_getScanDataMS1SumManualScanNumber(int msLevel, long scanStart, lo
             e = getScanData(scan, &plot.getPointList()); ree;
 
             plot.sortPointListByX();
-            gridOut->accumulate(plot, type);
+            batchPointCount += static_cast<int>(plot.getPointList().size());
+            batch.push_back(std::move(plot.getPointList()));
+            plot.getPointList().clear();
+
+            if (batchPointCount >= maxBatchPointCount) {
+                accumulateBatch();
+            }
         }
     }
+    accumulateBatch();
 
     return e;
 }
@@ -1380,28 +1504,7 @@ Err MSReader::_getXICManual(const XICWindow &win, point2dList *points, int msLev
             continue;
         }
 
-        bool found = false;
-
-#ifdef PMI_MS_ENABLE_CENTROID_CACHE
-        auto cacheManager = const_cast<MSCentroidCacheManager *>(m_centroidCacheManager);
-        auto it = cacheManager->getCacheIt(m_openReader->getFilename(), scan, &found);
-
-        if (found) {
-            plot.setPointList(it.value());
-        }
-#endif
-
-        if (!found) {
-            // Use this->getScanData instead of calling via m_openReader to get proper calibration
-            // done.
-            auto ms = const_cast<MSReader *>(this);
-
-            e = ms->getScanData(scan, &plot.getPointList(), true, nullptr); eee;
-
-#ifdef PMI_MS_ENABLE_CENTROID_CACHE
-            cacheManager->setScanCache(m_openReader->getFilename(), scan, plot.getPointList());
-#endif
-        }
+        e = _getCentroidedScanData(scan, &plot); eee;
 
         time_point.rx() = info.retTimeMinutes;
         time_point.ry() = extractMS1Sum(plot, win.mz_start, win.mz_end);
@@ -1509,6 +1612,171 @@ error:
     return e;
 }
 
+Err MSReader::_getCentroidedScanData(long scanNumber, PlotBase *plot) const
+{
+    Q_ASSERT(plot);
+
+    // Use this->getScanData instead of calling via m_openReader to get proper calibration
+    // done.
+    auto ms = const_cast<MSReader *>(this);
+
+    return ms->getScanData(scanNumber, &plot->getPointList(), true, nullptr);
+}
+
+MSCentroidCache *MSReader::_centroidCache()
+{
+    Q_ASSERT(m_openReader);
+
+    const double smoothingWidth = m_centroidOption.getSmoothingWidth();
+    QSharedPointer<MSCentroidCache> &cache = m_fileName_centroidCache[m_openReader->getFilename()];
+
+    if (cache && cache->smoothingWidth() == smoothingWidth) {
+        return cache.data();
+    }
+
+    // lazy creation; a different smoothing width has its own cache file
+    if (!cache) {
+        cache = QSharedPointer<MSCentroidCache>::create();
+    }
+
+    QString cachePath;
+    m_cacheFileManager->findOrCreateCachePath(MSCentroidCache::cacheSuffix(smoothingWidth),
+                                              &cachePath);
+
+    if (cache->open(cachePath, smoothingWidth) != kNoErr) {
+        warningMs() << "Centroided scans of" << m_openReader->getFilename()
+                    << "are cached in memory only";
+    }
+
+    return cache.data();
+}
+
+Err MSReader::getChromatogramsSinglePass(QVector<ChromatogramRequest> *requests,
+                                         int msLevel) const
+{
+    Q_ASSERT(requests);
+
+    Err e = kNoErr;
+
+    if (!m_openReader) {
+        rrr(kError);
+    }
+
+    if (requests->isEmpty()) {
+        return e;
+    }
+
+    if (msLevel < 0) {
+        msLevel = bestMSLevelOne();
+    }
+
+    long totalNumber = 0;
+    long firstScan = -1;
+    long lastScan = -1;
+
+    e = m_openReader->getNumberOfSpectra(&totalNumber, &firstScan, &lastScan); ree;
+
+    // scan range of every request; TIC and base peak cover the whole file
+    struct ScanRange {
+        long start;
+        long end;
+    };
+    QVector<ScanRange> ranges(requests->size(), ScanRange{ firstScan, lastScan });
+    QVector<int> xicIndexes;
+    bool wholeRangeRequested = false;
+
+    for (int i = 0; i < requests->size(); ++i) {
+        ChromatogramRequest &request = (*requests)[i];
+        request.points.clear();
+
+        if (request.type != ChromatogramRequest::TypeXIC) {
+            wholeRangeRequested = true;
+            continue;
+        }
+
+        const XICWindow &win = request.window;
+        ScanRange &range = ranges[i];
+
+        e = m_openReader->getBestScanNumberFromScanTime(msLevel, win.time_start, &range.start); ree;
+        e = m_openReader->getBestScanNumberFromScanTime(msLevel, win.time_end, &range.end); ree;
+
+        if (range.start > range.end) {
+            debugMs() << "Error, scan numbers are in reverse order.  "
+                         "time_start,time_end,startScan,endScan="
+                      << win.time_start << "," << win.time_end << "," << range.start << ","
+                      << range.end;
+            rrr(kError);
+        }
+
+        xicIndexes.push_back(i);
+    }
+
+    // XIC windows ordered by their first scan, so they can be activated while sweeping
+    std::sort(xicIndexes.begin(), xicIndexes.end(), [&ranges](int a, int b) {
+        return ranges[a].start < ranges[b].start;
+    });
+
+    long sweepStart = lastScan;
+    long sweepEnd = firstScan;
+    for (const ScanRange &range : ranges) {
+        sweepStart = std::min(sweepStart, range.start);
+        sweepEnd = std::max(sweepEnd, range.end);
+    }
+
+    PlotBase plot;
+    QVector<int> activeXics;
+    int nextXic = 0;
+
+    for (long scan = sweepStart; scan <= sweepEnd; ++scan) {
+        while (nextXic < xicIndexes.size() && ranges[xicIndexes[nextXic]].start <= scan) {
+            activeXics.push_back(xicIndexes[nextXic]);
+            ++nextXic;
+        }
+
+        activeXics.erase(std::remove_if(activeXics.begin(), activeXics.end(),
+                                        [&ranges, scan](int index) {
+                                            return ranges[index].end < scan;
+                                        }),
+                         activeXics.end());
+
+        if (!wholeRangeRequested && activeXics.isEmpty()) {
+            continue;
+        }
+
+        ScanInfo info;
+        e = getScanInfo(scan, &info); ree;
+
+        if (info.scanLevel != msLevel) {
+            continue;
+        }
+
+        e = _getCentroidedScanData(scan, &plot); ree;
+
+        const point2dList &scanPoints = plot.getPointList();
+
+        if (wholeRangeRequested) {
+            const double ticValue = getYSumAll(scanPoints);
+            const double basePeakValue = plot.getMaxPoint().y();
+
+            for (ChromatogramRequest &request : *requests) {
+                if (request.type == ChromatogramRequest::TypeTIC) {
+                    request.points.push_back(point2d(info.retTimeMinutes, ticValue));
+                } else if (request.type == ChromatogramRequest::TypeBasePeak) {
+                    request.points.push_back(point2d(info.retTimeMinutes, basePeakValue));
+                }
+            }
+        }
+
+        for (int index : activeXics) {
+            const XICWindow &win = (*requests)[index].window;
+            (*requests)[index].points.push_back(
+                point2d(info.retTimeMinutes, extractMS1Sum(plot, win.mz_start, win.mz_end)));
+        }
+    }
+
+    return e;
+}
+
 Err MSReader::_getBestScanNumber(int msLevel, double scanTime, long *scanNumber) const
 {
     Q_ASSERT(scanNumber);
@@ -1667,9 +1935,9 @@ void MSReader::_handlePassingCentroidToMSReaderByspec()
     }
 }
 
-Err MSReader::getXICDataCached(const XICWindow &win, point2dList *points, int ms_level)
+Err MSReader::loadNonUniformTilesCache(QSharedPointer<MSDataNonUniformAdapter> *cache)
 {
-    Q_ASSERT(points);
+    Q_ASSERT(cache);
 
     Err e = kNoErr;
 
@@ -1723,6 +1991,20 @@ Err MSReader::getXICDataCached(const XICWindow &win, point2dList *points, int ms
         e = nonUniformTilesCache->load(scanInfo); ree;
     }
 
+    *cache = nonUniformTilesCache;
+
+    return e;
+}
+
+Err MSReader::getXICDataCached(const XICWindow &win, point2dList *points, int ms_level)
+{
+    Q_ASSERT(points);
+
+    Err e = kNoErr;
+    QSharedPointer<MSDataNonUniformAdapter> nonUniformTilesCache;
+
+    e = loadNonUniformTilesCache(&nonUniformTilesCache); ree;
+
     XICWindow fixedWindow;
 
     e = alignTimesInWindow(win, nonUniformTilesCache.data(), ms_level, &fixedWindow); ree;
@@ -1733,6 +2015,26 @@ Err MSReader::getXICDataCached(const XICWindow &win, point2dList *points, int ms
     return e;
 }
 
+Err MSReader::getXICDataBatchCached(const QVector<XICWindow> &windows,
+                                    QVector<point2dList> *points, int ms_level)
+{
+    Q_ASSERT(points);
+
+    Err e = kNoErr;
+    QSharedPointer<MSDataNonUniformAdapter> nonUniformTilesCache;
+
+    e = loadNonUniformTilesCache(&nonUniformTilesCache); ree;
+
+    QVector<XICWindow> fixedWindows(windows.size());
+    for (int i = 0; i < windows.size(); ++i) {
+        e = alignTimesInWindow(windows[i], nonUniformTilesCache.data(), ms_level, &fixedWindows[i]); ree;
+    }
+
+    e = nonUniformTilesCache->getXICDataBatch(fixedWindows, points, ms_level); ree;
+
+    return e;
+}
+
 Err MSReader::alignTimesInWindow(const XICWindow &win, const MSDataNonUniformAdapter *adapter,
                                  int msLevel, XICWindow *window) const
 {
@@ -29,9 +29,8 @@ _PMI_BEGIN
 class CacheFileManager;
 class CacheFileManagerInterface;
 class MS1PrefixSum;
-#ifdef PMI_MS_ENABLE_CENTROID_CACHE
-class MSCentroidCacheManager;
-#endif
+class PlotBase;
+class MSCentroidCache;
 
 PMI_COMMON_MS_EXPORT Err bugPatchSchema_CompressionInfo(QSqlDatabase &db);
 
@@ -47,6 +46,8 @@ class PMI_COMMON_MS_EXPORT MSReader : public QObject, public MSReaderInterface,
 #ifdef PMI_QT_COMMON_BUILD_TESTING
     friend class NonUniformTileBuilderTest;
     friend class MSDataNonUniformAdapterTest;
+    friend class MSReaderBenchmark;
+    friend class MSWriterByspec2Test;
 #endif
 
 public:
@@ -119,8 +120,43 @@ public:
     Err getTICData(point2dList *points) const override;
     Err getScanData(long scanNumber, point2dList *points, bool do_centroiding = false,
                     msreader::PointListAsByteArrays *pointListAsByteArrays = nullptr) override;
+
+    /*!
+     * \brief Work left on a scan read by readScanData(), it doesn't refer to the reader
+     */
+    struct ScanDataProcessing {
+        long scanNumber = -1;
+        bool customCentroiding = false; //!< the points are smoothed and centroided
+        double smoothingWidth = 0;
+        MzScanCalibration calibration;
+    };
+
+    /*!
+     * \brief getScanData() split in two steps.
+     *
+     * readScanData() reads the scan with the vendor reader and has to be called from the thread
+     * using this reader. processScanData() does the custom centroiding, the m/z calibration and
+     * builds the uncompressed blobs; it can run on any thread. Scans found in the centroid cache
+     * are not centroided again, scans centroided by processScanData() are not added to the cache.
+     */
+    Err readScanData(long scanNumber, point2dList *points, bool do_centroiding,
+                     msreader::PointListAsByteArrays *pointListAsByteArrays,
+                     ScanDataProcessing *processing);
+    static Err processScanData(const ScanDataProcessing &processing, point2dList *points,
+                               msreader::PointListAsByteArrays *pointListAsByteArrays);
     Err getXICData(const msreader::XICWindow &win, point2dList *points,
                    int msLevel = 1) const override;
+    /*!
+     * \brief Extracts XICs for many windows at once, points[i] is equal to
+     * getXICData(windows[i], ...) in the current XIC mode.
+     *
+     * Vendor (or tiled cache) batch extraction is used when available. Otherwise the windows are
+     * sorted by time and the scans are swept once (see getChromatogramsSinglePass), so the cost is
+     * close to a single read of the file regardless of the number of windows. Like getXICData, the
+     * tiled cache mode returns the cache's error, e.g. kFunctionNotImplemented for ms level 2.
+     */
+    Err getXICDataBatch(const QVector<msreader::XICWindow> &windows, QVector<point2dList> *points,
+                        int msLevel = 1) const override;
     Err getScanInfo(long scanNumber, msreader::ScanInfo *obj) const override;
     Err getScanPrecursorInfo(long scanNumber, msreader::PrecursorInfo *pinfo) const override;
     Err getNumberOfSpectra(long *totalNumber, long *startScan, long *endScan) const override;
@@ -172,6 +208,21 @@ public:
 
     Err getTimeDomain(double *startTime, double *endTime) const;
 
+    /*!
+     * \brief Fills TIC, base peak and XIC traces in a single sweep over the scans. Each scan of
+     * the requested level is decoded at most once, regardless of the number of requests.
+     *
+     * Scans are decoded the same way as in manual XIC extraction (centroided and m/z calibrated);
+     * TIC and base peak values are computed from the same decoded data. Vendor provided TIC/XIC
+     * are not used here.
+     *
+     * \param requests in/out; points of every request are replaced
+     * \param msLevel scan level to extract; -1 means bestMSLevelOne()
+     * \return kNoErr on success; otherwise specific error
+     */
+    Err getChromatogramsSinglePass(QVector<msreader::ChromatogramRequest> *requests,
+                                   int msLevel = -1) const;
+
     void setCentroidOptions(const CentroidOptions &centroidOptions);
 
     bool isOpen() const;
@@ -236,6 +287,15 @@ private:
     Err _getXICManual(const msreader::XICWindow &win, point2dList *points, int msLevel) const;
     Err _getBasePeakManual(point2dList *points) const;
     Err _getTICManual(point2dList *points) const;
+    Err _getCentroidedScanData(long scanNumber, PlotBase *plot) const;
+
+    /*!
+     * \brief persistent cache of custom centroided scans of the open file for the current
+     * smoothing width. The cache is opened lazily; if the cache file can't be used, the scans are
+     * cached in memory only.
+     */
+    MSCentroidCache *_centroidCache();
+    static Err _customCentroid(double smoothingWidth, point2dList *points);
     Err _getBestScanNumber(int msLevel, double scanTimeMinutes, long *scanNumber) const;
 
     Err _loadCentroidOptionsFromDatabase(const QString &filename);
@@ -249,7 +309,10 @@ private:
 
     void _handlePassingCentroidToMSReaderByspec();
 
+    Err loadNonUniformTilesCache(QSharedPointer<MSDataNonUniformAdapter> *cache);
     Err getXICDataCached(const msreader::XICWindow &win, point2dList *points, int ms_level);
+    Err getXICDataBatchCached(const QVector<msreader::XICWindow> &windows,
+                              QVector<point2dList> *points, int ms_level);
 
     /*!
      * \brief helper function to dump content of the xicData to csv files if the actual and expected
@@ -299,9 +362,7 @@ private:
     QMap<QString, std::shared_ptr<MS1PrefixSum>> m_fileName_ms1PrefixSumPtr;
     QMap<QString, QSharedPointer<MSDataNonUniformAdapter>> m_fileName_nonUniformTiles;
 
-#ifdef PMI_MS_ENABLE_CENTROID_CACHE
-    MSCentroidCacheManager *m_centroidCacheManager;
-#endif
+    QMap<QString, QSharedPointer<MSCentroidCache>> m_fileName_centroidCache;
 
     /// Temporary solution to disable ScanInfo caching for Byomap/Intact MS1 extraction.
     bool m_useScanInfoCache = true;
@@ -371,6 +371,27 @@ Err MSReaderBase::getScanInfoListAtLevel(int level, QList<ScanInfoWrapper> *lock
     return m_scanInfoList.getAllScansInfoAtLevel(this, level, lockmassList);
 }
 
+Err MSReaderBase::getXICDataBatch(const QVector<XICWindow> &windows,
+                                  QVector<point2dList> *points, int msLevel) const
+{
+    Q_ASSERT(points);
+
+    Err e = kNoErr;
+
+    points->clear();
+    points->resize(windows.size());
+
+    for (int i = 0; i < windows.size(); ++i) {
+        e = getXICData(windows[i], &(*points)[i], msLevel);
+        if (e != kNoErr) {
+            points->clear();
+            return e;
+        }
+    }
+
+    return e;
+}
+
 bool MSReaderBase::scanInfoCache(long scanNumber, ScanInfo *obj) const
 {
     return m_scanInfoList.scanInfoCache(scanNumber, obj);
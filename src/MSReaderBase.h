@@ -163,6 +163,14 @@ public:
     Err getScanInfoListAtLevel(int level,
                                QList<msreader::ScanInfoWrapper> *lockmassList) const override;
 
+    /*!
+     * \brief getXICDataBatch calls getXICData for every window. Vendors without native XIC
+     * return kFunctionNotImplemented on the first window, so the caller can sweep the scans
+     * instead.
+     */
+    Err getXICDataBatch(const QVector<msreader::XICWindow> &windows,
+                        QVector<point2dList> *points, int msLevel = 1) const override;
+
     Err cacheScanNumbers(const QList<int> & scanNumberList, QSharedPointer<ProgressBarInterface> progress);
 
     bool scanInfoCache(long scanNumber, msreader::ScanInfo *obj) const;
@@ -43,6 +43,15 @@ public:
                             msreader::PointListAsByteArrays *pointListAsByteArrays = nullptr) = 0;
     virtual Err getXICData(const msreader::XICWindow &win, point2dList *points,
                            int msLevel = 1) const = 0;
+    /*!
+     * \brief Extracts XICs for many windows at once. points is resized to windows.size() and
+     * points[i] holds the XIC of windows[i], the same as getXICData(windows[i], ...) would.
+     *
+     * Returns kFunctionNotImplemented if the reader cannot provide the XICs itself; the caller
+     * then falls back to extracting them from the scan data.
+     */
+    virtual Err getXICDataBatch(const QVector<msreader::XICWindow> &windows,
+                                QVector<point2dList> *points, int msLevel = 1) const = 0;
     virtual Err getScanInfo(long scanNumber, msreader::ScanInfo *obj) const = 0;
     virtual Err getScanPrecursorInfo(long scanNumber, msreader::PrecursorInfo *pinfo) const = 0;
     virtual Err getNumberOfSpectra(long *totalNumber, long *startScan, long *endScan) const = 0;
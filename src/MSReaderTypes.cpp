@@ -125,6 +125,22 @@ bool XICWindow::isTimeRangeDefined() const
     return time_start != 0.0 || time_end != 0.0;
 }
 
+ChromatogramRequest::ChromatogramRequest()
+    : type(TypeTIC)
+{
+}
+
+ChromatogramRequest::ChromatogramRequest(Type type)
+    : type(type)
+{
+}
+
+ChromatogramRequest::ChromatogramRequest(const XICWindow &win)
+    : type(TypeXIC)
+    , window(win)
+{
+}
+
 QDataStream& operator<<(QDataStream& out, const XICWindow& win)
 {
     out << win.mz_start << win.mz_end;
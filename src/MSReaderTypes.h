@@ -111,6 +111,25 @@ struct PMI_COMMON_MS_EXPORT XICWindow
 PMI_COMMON_MS_EXPORT QDataStream& operator<<(QDataStream& out, const XICWindow& win);
 PMI_COMMON_MS_EXPORT QDataStream& operator>>(QDataStream& in, XICWindow& win);
 
+/*!
+ * \brief ChromatogramRequest describes one trace filled in by MSReader::getChromatogramsSinglePass.
+ * TIC and base peak requests cover all scans of the level, XIC requests only the scans inside
+ * the time range of their window.
+ */
+struct PMI_COMMON_MS_EXPORT ChromatogramRequest
+{
+    enum Type { TypeTIC = 0, TypeBasePeak, TypeXIC };
+
+    Type type;
+    XICWindow window; ///used only for TypeXIC
+
+    point2dList points; ///output, one point per scan in the requested range
+
+    ChromatogramRequest();
+    explicit ChromatogramRequest(Type type);
+    explicit ChromatogramRequest(const XICWindow &win);
+};
+
 struct PMI_COMMON_MS_EXPORT PrecursorInfo
 {
     long nScanNumber;
@@ -13,7 +13,20 @@
 
 #include "sqlite_utils.h"
 
+#include <QtSqlUtils.h>
+
 #include <QDir>
+#include <QFuture>
+#include <QMutex>
+#include <QQueue>
+#include <QSemaphore>
+#include <QSharedPointer>
+#include <QThread>
+#include <QThreadPool>
+#include <QWaitCondition>
+#include <QtConcurrent/QtConcurrentRun>
+
+#include <atomic>
 
 _PMI_BEGIN
 
@@ -30,19 +43,21 @@ void calculatePeakIntensitySum(byspec2::PeakDaoEntry &peak) {
     peak.intensitySum = std::accumulate(peak.peaksIntensity.begin(), peak.peaksIntensity.end(), 0.0);
 }
 
-byspec2::PeakDaoEntry makeCentroided(const byspec2::PeakDaoEntry &peak, const pico::CentroidOptions &centroidOptions) {
+byspec2::PeakDaoEntry makeCentroided(const byspec2::PeakDaoEntry &peak, const pico::CentroidOptions &centroidOptions,
+                                     pico::Centroid *centroid) {
     byspec2::PeakDaoEntry centroidedPeak;
-    pico::Centroid centroid;
-    std::vector<std::pair<double, double>> dataIn;
+    std::vector<double> intensity;
     std::vector<std::pair<double, double>> dataOut;
 
-    // Prepare data for centroiding
-    dataIn.reserve(static_cast<unsigned int>(peak.peaksCount));
-    for (int i = 0; i < peak.peaksCount; ++i) {
-        dataIn.push_back(
-            std::make_pair(peak.peaksMz[i], static_cast<double>(peak.peaksIntensity[i])));
+    // Prepare data for centroiding, m/z is used as it is
+    const int peaksCount
+        = std::min(peak.peaksCount, std::min(peak.peaksMz.size(), peak.peaksIntensity.size()));
+    intensity.reserve(static_cast<unsigned int>(peaksCount));
+    for (int i = 0; i < peaksCount; ++i) {
+        intensity.push_back(static_cast<double>(peak.peaksIntensity[i]));
     }
-    centroid.smooth_and_centroid(dataIn, centroidOptions, dataOut);
+    centroid->smooth_and_centroid(peak.peaksMz.constData(), intensity.data(),
+                                  static_cast<size_t>(peaksCount), centroidOptions, dataOut);
     // Convert data from the centroided format
     const size_t dataCount = dataOut.size();
     centroidedPeak.peaksMz.reserve(static_cast<int>(dataCount));
@@ -301,204 +316,268 @@ Err MSWriterByspec2::insertDataIntoFileInfoTable(const QMap<QString, QString> &d
     return e;
 }
 
-Err writeBrokenSpectra(QSqlQuery& query, int fileId, int scan, const QString& errorMessage)
-{
-    query.bindValue(":FilesId", fileId);
-    query.bindValue(":ScanNumber", scan);
-    query.bindValue(":Comment", QVariant(errorMessage));
-    return QEXEC_NOARG(query);
-}
+namespace {
 
-Err MSWriterByspec2::insertDataIntoPeaksAndSpectraTable(bool onlyCentroided, int fileId)
-{
-    if (!m_database.isValid()) {
-        return kError;
-    }
+// scans read in a batch processed by one task
+const int SCAN_BATCH_SIZE = 8;
 
-    static const QString conversionErrorMessage = QStringLiteral("ConversionErrorMessage");
+// rows inserted by one statement; 19 Spectra columns x 32 rows stay below the default SQLite
+// limit of 999 host parameters
+const int ROWS_PER_INSERT = 32;
+
+const QString PEAKS_COLUMNS = QStringLiteral("Id, PeaksMz, PeaksIntensity, PeaksCount, "
+                                             "IntensitySum, MetaText, Comment, CompressionInfoId");
+const int PEAKS_COLUMN_COUNT = 8;
 
+const QString SPECTRA_COLUMNS = QStringLiteral(
+    "FilesId, MSLevel, ObservedMz, IsolationWindowLowerOffset, IsolationWindowUpperOffset, "
+    "RetentionTime, ScanNumber, NativeId, ChargeList, PeaksId, PrecursorIntensity, "
+    "FragmentationType, ParentScanNumber, ParentNativeId, Comment, MetaText, DebugText, "
+    "MobilityValue, Valid");
+const int SPECTRA_COLUMN_COUNT = 19;
+
+//! peaks of one scan for the Peaks or Peaks_MS1Centroided table
+struct PeaksRow {
     Err e = kNoErr;
+    point2dList points;
+    PointListAsByteArrays pointsInBytes;
+    MSReader::ScanDataProcessing processing;
+    double intensitySum = 0;
+    int compressionInfo = 0;
+};
 
-    QSqlQuery queryProfilePeaks = makeQuery(m_database, true);
-    QSqlQuery queryCentroidPeaks = makeQuery(m_database, true);
-    QSqlQuery querySpectra = makeQuery(m_database, true);
-    QSqlQuery queryInvalidSpectra = makeQuery(m_database, true);
+//! scan read on the calling thread, processed by a worker and written by the writer
+struct ScanRecord {
+    long index = 0;
+    Err infoError = kNoErr;
+    ScanInfo info;
+    Err precursorError = kNoErr;
+    PrecursorInfo precursorInfo;
+    QString fragmentationType;
+    bool hasProfilePeaks = false;
+    PeaksRow profilePeaks;
+    PeaksRow centroidPeaks;
+};
 
-    TransactionInstance instance(&m_database);
-    instance.setRollbackOnDestruction(true);
+typedef QVector<QSharedPointer<ScanRecord>> ScanRecordBatch;
 
-    MSReader *reader = MSReader::Instance();
+//! \brief batches in the order they have to be written
+struct ScanRecordBatchQueue {
+    QMutex mutex;
+    QWaitCondition batchAvailable;
+    QQueue<QFuture<ScanRecordBatch>> batches;
+    bool finished = false;
+};
 
-    long start = 0;
-    long end = 0;
-    long total = 0;
-    e = reader->getNumberOfSpectra(&total, &start, &end);
-    if (e != kNoErr) {
-        QMap<QString, QString> messages;
-        messages[conversionErrorMessage] = QStringLiteral("getNumberOfSpectra returns error: ")
-            + QString::fromStdString(convertErrToString(e));
-        insertDataIntoFileInfoTable(messages, fileId);
-        ree;
-    }
+QSharedPointer<ScanRecord> readScanRecord(MSReader *reader, long index, bool onlyCentroided)
+{
+    QSharedPointer<ScanRecord> record(new ScanRecord);
+    record->index = index;
 
-    const QString commandPeaksTemplate
-        = QStringLiteral("INSERT INTO %1 (Id, PeaksMz, PeaksIntensity, PeaksCount, \
-                        IntensitySum, MetaText, Comment, CompressionInfoId) \
-                        values(:Id, :PeaksMz, :PeaksIntensity, :PeaksCount, :IntensitySum, :MetaText, \
-                        :Comment, :CompressionInfoId)");
-    const QString commandProfilePeaks
-        = onlyCentroided ? QString() : commandPeaksTemplate.arg(TABLE_PEAKS);
-    const QString commandCentroidPeaks
-        = commandPeaksTemplate.arg(onlyCentroided ? TABLE_PEAKS : TABLE_PEAKS_MS1CENTROIDED);
-
-    const QString commandSpectra = QStringLiteral(
-        "INSERT INTO Spectra(FilesId, MSLevel, ObservedMz, IsolationWindowLowerOffset, \
-        IsolationWindowUpperOffset, RetentionTime, ScanNumber, NativeId, ChargeList, PeaksId, \
-        PrecursorIntensity, FragmentationType, ParentScanNumber, ParentNativeId, Comment, \
-        MetaText, DebugText, MobilityValue) \
-        values(:FilesId, :MSLevel, :ObservedMz, :IsolationWindowLowerOffset, \
-        :IsolationWindowUpperOffset, :RetentionTime, :ScanNumber, :NativeId, :ChargeList, :PeaksId, \
-        :PrecursorIntensity, :FragmentationType, :ParentScanNumber, :ParentNativeId, :Comment, \
-        :MetaText, :DebugText, :MobilityValue)");
-    const QString commandInvalidSpectra(
-        "INSERT INTO Spectra(FilesId, ScanNumber, PeaksId, Comment, Valid) \
-        values(:FilesId, :ScanNumber, NULL, :Comment, 0)");
-
-    if (!onlyCentroided) {
-        e = QPREPARE(queryProfilePeaks, commandProfilePeaks); ree;
-    }
-    e = QPREPARE(queryCentroidPeaks, commandCentroidPeaks); ree;
-    e = QPREPARE(querySpectra, commandSpectra); ree;
-    e = QPREPARE(queryInvalidSpectra, commandInvalidSpectra); ree;
-
-    e = instance.beginTransaction(); ree;
+    record->infoError = reader->getScanInfo(index, &record->info);
+    if (record->infoError != kNoErr) {
+        return record;
+    }
 
-    int brokenScans = 0;
-    auto queryValuesBinder = [](MSReader* reader, QSqlQuery& queryPeaks, int index, int peakId, bool centroided)->Err {
-        point2dList points;
-        PointListAsByteArrays pointsInBytes;
-        const Err e = reader->getScanData(index, &points, centroided, &pointsInBytes); ree;
-
-        double product = 0;
-        for (const QPointF &point : points) {
-            product += point.y();
+    record->hasProfilePeaks = !onlyCentroided;
+    if (record->hasProfilePeaks) {
+        PeaksRow &row = record->profilePeaks;
+        row.e = reader->readScanData(index, &row.points, false, &row.pointsInBytes, &row.processing);
+    }
+    PeaksRow &row = record->centroidPeaks;
+    row.e = reader->readScanData(index, &row.points, true, &row.pointsInBytes, &row.processing);
+
+    const bool scanDataRead = (!record->hasProfilePeaks || record->profilePeaks.e == kNoErr)
+        && record->centroidPeaks.e == kNoErr;
+    if (scanDataRead && record->info.scanLevel > 1) {
+        record->precursorError = reader->getScanPrecursorInfo(index, &record->precursorInfo);
+        if (record->precursorError == kNoErr) {
+            reader->getFragmentType(index, record->info.scanLevel, &record->fragmentationType);
         }
+    }
 
-        int compressionInfo = 0;
-        if (pointsInBytes.compressionInfoId.isValid()) {
-            compressionInfo = pointsInBytes.compressionInfoId.toInt();
-        }
+    return record;
+}
 
-        queryPeaks.bindValue(":Id", peakId);
-        queryPeaks.bindValue(":PeaksMz", pointsInBytes.dataX);
-        queryPeaks.bindValue(":PeaksIntensity", pointsInBytes.dataY);
-        queryPeaks.bindValue(":PeaksCount", points.size());
-        queryPeaks.bindValue(":IntensitySum", product);
-        queryPeaks.bindValue(":MetaText", QVariant());
-        queryPeaks.bindValue(":Comment", QVariant());
-        queryPeaks.bindValue(":CompressionInfoId", compressionInfo);
+void processPeaksRow(PeaksRow *row)
+{
+    if (row->e != kNoErr) {
+        return;
+    }
+    row->e = MSReader::processScanData(row->processing, &row->points, &row->pointsInBytes);
+    if (row->e != kNoErr) {
+        return;
+    }
 
-        return kNoErr;
-    };
+    double product = 0;
+    for (const QPointF &point : row->points) {
+        product += point.y();
+    }
+    row->intensitySum = product;
 
-    int peakId = 1;
-    for (long index = start; index <= end; ++index) {
-        QStringList errorMessages;
+    if (row->pointsInBytes.compressionInfoId.isValid()) {
+        row->compressionInfo = row->pointsInBytes.compressionInfoId.toInt();
+    }
+}
+
+void processScanRecord(ScanRecord *record)
+{
+    if (record->infoError != kNoErr) {
+        return;
+    }
+    if (record->hasProfilePeaks) {
+        processPeaksRow(&record->profilePeaks);
+    }
+    processPeaksRow(&record->centroidPeaks);
+}
+
+/*!
+ * \brief Writes processed scans in scan order to the Peaks and Spectra tables
+ *
+ * Rows are collected and inserted ROWS_PER_INSERT at a time with multi-row INSERT statements.
+ * The caller owns the transaction.
+ */
+class PeaksAndSpectraWriter
+{
+public:
+    PeaksAndSpectraWriter(const QSqlDatabase &database, bool onlyCentroided, int fileId)
+        : m_database(database)
+        , m_onlyCentroided(onlyCentroided)
+        , m_fileId(fileId)
+        , m_profilePeaksTable(TABLE_PEAKS)
+        , m_centroidPeaksTable(onlyCentroided ? TABLE_PEAKS : TABLE_PEAKS_MS1CENTROIDED)
+        , m_profilePeaksQuery(makeQuery(m_database, true))
+        , m_centroidPeaksQuery(makeQuery(m_database, true))
+        , m_spectraQuery(makeQuery(m_database, true))
+    {
+    }
+
+    Err write(const ScanRecord &record)
+    {
+        static const QString errorMessageTemplate
+            = QStringLiteral("getScanData with scanNo=%1, centroided=%2 returns error: %3");
 
-        /// Here data will go into Spectra table
-        ScanInfo info;
-        e = reader->getScanInfo(index, &info);
-        if (e != kNoErr) {
+        Err e = kNoErr;
+        const long index = record.index;
+
+        QStringList errorMessages;
+        if (record.infoError != kNoErr) {
             errorMessages << QStringLiteral("getScanInfo with scanNo=%1 returns error: %2")
                                  .arg(index)
-                                 .arg(QString::fromStdString(convertErrToString(e)));
+                                 .arg(QString::fromStdString(convertErrToString(record.infoError)));
         } else {
-            static const QString errorMessageTemplate
-                = QStringLiteral("getScanData with scanNo=%1, centroided=%2 returns error: %3");
-
-            if (!onlyCentroided) {
-                const bool centroided = false;
-                e = queryValuesBinder(reader, queryProfilePeaks, index, peakId, centroided);
-                if (e != kNoErr) {
-                    errorMessages << errorMessageTemplate.arg(index)
-                                         .arg(centroided)
-                                         .arg(QString::fromStdString(convertErrToString(e)));
-                }
+            if (record.hasProfilePeaks && record.profilePeaks.e != kNoErr) {
+                errorMessages << errorMessageTemplate.arg(index)
+                                     .arg(false)
+                                     .arg(QString::fromStdString(
+                                         convertErrToString(record.profilePeaks.e)));
             }
-
-            const bool centroided = true;
-            e = queryValuesBinder(reader, queryCentroidPeaks, index, peakId, centroided);
-            if (e != kNoErr) {
+            if (record.centroidPeaks.e != kNoErr) {
                 errorMessages << errorMessageTemplate.arg(index)
-                                     .arg(centroided)
-                                     .arg(QString::fromStdString(convertErrToString(e)));
+                                     .arg(true)
+                                     .arg(QString::fromStdString(
+                                         convertErrToString(record.centroidPeaks.e)));
             }
         }
 
         if (!errorMessages.isEmpty()) {
-            brokenScans++;
-            const Err e = writeBrokenSpectra(queryInvalidSpectra, fileId, index,
-                                             errorMessages.join(QStringLiteral(", "))); ree;
-            continue;
-        }
-
-        if (info.scanLevel > 1) {
-            PrecursorInfo precursorInfo;
+            appendBrokenSpectrum(index, errorMessages.join(QStringLiteral(", ")));
+        } else if (record.info.scanLevel > 1 && record.precursorError != kNoErr) {
             /// For some vendor data format this gives error which is not sufficient to
             /// return from this point, so didn't return on any such failures
-            e = reader->getScanPrecursorInfo(index, &precursorInfo);
-            if (e != kNoErr) {
-                const QString errorMessage
-                    = QStringLiteral("getScanPrecursorInfo with scanNo=%1 returns error: %2")
-                          .arg(index)
-                          .arg(QString::fromStdString(convertErrToString(e)));
-                e = writeBrokenSpectra(queryInvalidSpectra, fileId, index, errorMessage); ree;
-                brokenScans++;
-                continue;
+            appendBrokenSpectrum(
+                index, QStringLiteral("getScanPrecursorInfo with scanNo=%1 returns error: %2")
+                           .arg(index)
+                           .arg(QString::fromStdString(convertErrToString(record.precursorError))));
+        } else {
+            if (record.hasProfilePeaks) {
+                appendPeaks(record.profilePeaks, &m_profilePeaks);
             }
+            appendPeaks(record.centroidPeaks, &m_centroidPeaks);
+            appendSpectrum(record);
+            ++m_peakId;
+        }
 
-            querySpectra.bindValue(":ObservedMz", precursorInfo.dMonoIsoMass);
-            querySpectra.bindValue(":IsolationWindowLowerOffset", precursorInfo.lowerWindowOffset);
-            querySpectra.bindValue(":IsolationWindowUpperOffset", precursorInfo.upperWindowOffset);
-            querySpectra.bindValue(":ChargeList", QString::number(precursorInfo.nChargeState));
-            QString fragmentationType;
-            reader->getFragmentType(index, info.scanLevel, &fragmentationType);
-            querySpectra.bindValue(":FragmentationType", QVariant(fragmentationType));
-            querySpectra.bindValue(":ParentScanNumber", int(precursorInfo.nScanNumber));
-            querySpectra.bindValue(":ParentNativeId", precursorInfo.nativeId);
-        } else {
-            querySpectra.bindValue(":ObservedMz", QVariant());
-            querySpectra.bindValue(":IsolationWindowLowerOffset", QVariant());
-            querySpectra.bindValue(":IsolationWindowUpperOffset", QVariant());
-            querySpectra.bindValue(":ChargeList", QVariant());
-            querySpectra.bindValue(":FragmentationType", QVariant());
-            querySpectra.bindValue(":ParentScanNumber", QVariant());
-            querySpectra.bindValue(":ParentNativeId", QVariant());
+        // Spectra gets a row for every scan, so the Peaks tables never have more rows
+        if (m_spectra.size() >= ROWS_PER_INSERT * SPECTRA_COLUMN_COUNT) {
+            e = flush(); ree;
         }
-        //Byonic Viewer doesn't have a way to view the Spectra.MobilityData without
-        //some effort. Until Byonic Viewer can properly setup SQL statement, we'll
-        //keep it in the comment section.
-        if (info.mobility.isValid()) {
-            const QString mobilityComment = QStringLiteral("mobility=%1").arg(info.mobility.mobilityValue());
-            querySpectra.bindValue(":Comment", mobilityComment);
-        } else {
-            querySpectra.bindValue(":Comment", QVariant());
+
+        return e;
+    }
+
+    //! \brief inserts the collected rows
+    Err flush()
+    {
+        Err e = kNoErr;
+
+        if (!m_onlyCentroided) {
+            e = insertRows(m_profilePeaksTable, PEAKS_COLUMNS, PEAKS_COLUMN_COUNT, &m_profilePeaks,
+                           &m_profilePeaksQuery); ree;
         }
+        e = insertRows(m_centroidPeaksTable, PEAKS_COLUMNS, PEAKS_COLUMN_COUNT, &m_centroidPeaks,
+                       &m_centroidPeaksQuery); ree;
+        e = insertRows(QStringLiteral("Spectra"), SPECTRA_COLUMNS, SPECTRA_COLUMN_COUNT,
+                       &m_spectra, &m_spectraQuery); ree;
 
-        querySpectra.bindValue(":FilesId", fileId);
-        querySpectra.bindValue(":MSLevel", info.scanLevel);
+        return e;
+    }
 
-        querySpectra.bindValue(":RetentionTime", info.retTimeMinutes * 60);
-        querySpectra.bindValue(":ScanNumber", int(index));
-        querySpectra.bindValue(":NativeId", info.nativeId);
+    int brokenScans() const { return m_brokenScans; }
 
-        querySpectra.bindValue(":PeaksId", peakId);
-        querySpectra.bindValue(":PrecursorIntensity", QVariant());
+private:
+    void appendBrokenSpectrum(long index, const QString &errorMessage)
+    {
+        ++m_brokenScans;
+
+        QVector<QVariant> values(SPECTRA_COLUMN_COUNT);
+        values[0] = m_fileId;
+        values[6] = int(index);
+        values[14] = errorMessage;
+        values[18] = 0;
+        m_spectra += values;
+    }
+
+    void appendPeaks(const PeaksRow &row, QVector<QVariant> *values)
+    {
+        values->push_back(m_peakId);
+        values->push_back(row.pointsInBytes.dataX);
+        values->push_back(row.pointsInBytes.dataY);
+        values->push_back(static_cast<int>(row.points.size()));
+        values->push_back(row.intensitySum);
+        values->push_back(QVariant());
+        values->push_back(QVariant());
+        values->push_back(row.compressionInfo);
+    }
+
+    void appendSpectrum(const ScanRecord &record)
+    {
+        const ScanInfo &info = record.info;
 
+        QVector<QVariant> values(SPECTRA_COLUMN_COUNT);
+        values[0] = m_fileId;
+        values[1] = info.scanLevel;
+        if (info.scanLevel > 1) {
+            const PrecursorInfo &precursorInfo = record.precursorInfo;
+            values[2] = precursorInfo.dMonoIsoMass;
+            values[3] = precursorInfo.lowerWindowOffset;
+            values[4] = precursorInfo.upperWindowOffset;
+            values[8] = QString::number(precursorInfo.nChargeState);
+            values[11] = record.fragmentationType;
+            values[12] = int(precursorInfo.nScanNumber);
+            values[13] = precursorInfo.nativeId;
+        }
+        values[5] = info.retTimeMinutes * 60;
+        values[6] = int(record.index);
+        values[7] = info.nativeId;
+        values[9] = m_peakId;
+
+        //Byonic Viewer doesn't have a way to view the Spectra.MobilityData without
+        //some effort. Until Byonic Viewer can properly setup SQL statement, we'll
+        //keep it in the comment section.
         if (info.mobility.isValid()) {
-            querySpectra.bindValue(":MobilityValue", info.mobility.mobilityValue());
-        } else {
-            querySpectra.bindValue(":MobilityValue", QVariant());
+            values[14] = QStringLiteral("mobility=%1").arg(info.mobility.mobilityValue());
+            values[17] = info.mobility.mobilityValue();
         }
 
         QString metaText(
@@ -518,17 +597,228 @@ Err MSWriterByspec2::insertDataIntoPeaksAndSpectraTable(bool onlyCentroided, int
             break;
         }
 
-        querySpectra.bindValue(":MetaText", metaText);
-        querySpectra.bindValue(":DebugText", QVariant());
+        values[15] = metaText;
+        values[18] = 1;
+        m_spectra += values;
+    }
+
+    //! \brief statement inserting @a rowCount rows, the one for ROWS_PER_INSERT rows is prepared once
+    Err insertRows(const QString &table, const QString &columns, int columnCount,
+                   QVector<QVariant> *values, QSqlQuery *fullQuery)
+    {
+        Err e = kNoErr;
+
+        const int rowCount = values->size() / columnCount;
+        if (rowCount <= 0) {
+            return e;
+        }
+
+        QSqlQuery partialQuery = makeQuery(m_database, true);
+        QSqlQuery *query = fullQuery;
+        if (rowCount != ROWS_PER_INSERT || fullQuery->lastQuery().isEmpty()) {
+            const QString row = QStringLiteral("(?") + QStringLiteral(",?").repeated(columnCount - 1)
+                + QStringLiteral(")");
+            QStringList rows;
+            for (int i = 0; i < rowCount; ++i) {
+                rows.push_back(row);
+            }
+            const QString command = QStringLiteral("INSERT INTO %1 (%2) VALUES %3")
+                                        .arg(table, columns, rows.join(QStringLiteral(",")));
+            if (rowCount != ROWS_PER_INSERT) {
+                query = &partialQuery;
+            }
+            e = QPREPARE((*query), command); ree;
+        }
+
+        for (int i = 0; i < values->size(); ++i) {
+            query->bindValue(i, values->at(i));
+        }
+        e = QEXEC_NOARG((*query)); ree;
+
+        values->clear();
+        return e;
+    }
+
+private:
+    QSqlDatabase m_database;
+    const bool m_onlyCentroided;
+    const int m_fileId;
+    const QString m_profilePeaksTable;
+    const QString m_centroidPeaksTable;
+
+    int m_peakId = 1;
+    int m_brokenScans = 0;
+
+    QVector<QVariant> m_profilePeaks;
+    QVector<QVariant> m_centroidPeaks;
+    QVector<QVariant> m_spectra;
+
+    QSqlQuery m_profilePeaksQuery;
+    QSqlQuery m_centroidPeaksQuery;
+    QSqlQuery m_spectraQuery;
+};
+
+}
+
+Err MSWriterByspec2::insertDataIntoPeaksAndSpectraTable(bool onlyCentroided, int fileId)
+{
+    if (!m_database.isValid()) {
+        return kError;
+    }
+
+    static const QString conversionErrorMessage = QStringLiteral("ConversionErrorMessage");
+
+    Err e = kNoErr;
+
+    MSReader *reader = MSReader::Instance();
+
+    long start = 0;
+    long end = 0;
+    long total = 0;
+    e = reader->getNumberOfSpectra(&total, &start, &end);
+    if (e != kNoErr) {
+        QMap<QString, QString> messages;
+        messages[conversionErrorMessage] = QStringLiteral("getNumberOfSpectra returns error: ")
+            + QString::fromStdString(convertErrToString(e));
+        insertDataIntoFileInfoTable(messages, fileId);
+        ree;
+    }
+
+    int brokenScans = 0;
+    const int threadCount = (m_threadCount > 0) ? m_threadCount : QThread::idealThreadCount();
+    if (threadCount <= 1) {
+        TransactionInstance instance(&m_database);
+        instance.setRollbackOnDestruction(true);
+
+        e = instance.beginTransaction(); ree;
+
+        PeaksAndSpectraWriter scanWriter(m_database, onlyCentroided, fileId);
+        for (long index = start; index <= end; ++index) {
+            const QSharedPointer<ScanRecord> record = readScanRecord(reader, index, onlyCentroided);
+            processScanRecord(record.data());
+            e = scanWriter.write(*record); ree;
+        }
+        e = scanWriter.flush(); ree;
+        brokenScans = scanWriter.brokenScans();
+
+        e = instance.endTransaction(); ree;
+    } else {
+        // batches which were read but not written yet; bounds the memory held by the pipeline
+        QSemaphore freeBatches(2 * threadCount);
+        ScanRecordBatchQueue queue;
+        // set by the writer, stops reading
+        std::atomic<bool> failed{ false };
+
+        // sqlite connection can be used only by the thread which opened it
+        QThreadPool writerPool;
+        writerPool.setMaxThreadCount(1);
+
+        const QString connectionName = QStringLiteral("MakeByspec2-writer-%1").arg(++connCounter);
+        const QString dbFilePath = m_database.databaseName();
+
+        QFuture<Err> writer = QtConcurrent::run(&writerPool, [&]() {
+            Err writerErr = kNoErr;
+            {
+                QSqlDatabase writerDb;
+                writerErr = addDatabaseAndOpen(connectionName, dbFilePath, writerDb);
+                if (writerErr == kNoErr && !writerDb.transaction()) {
+                    writerErr = kError;
+                }
+                if (writerErr != kNoErr) {
+                    failed = true;
+                }
+
+                {
+                    PeaksAndSpectraWriter scanWriter(writerDb, onlyCentroided, fileId);
+                    while (true) {
+                        QFuture<ScanRecordBatch> batchFuture;
+                        {
+                            QMutexLocker locker(&queue.mutex);
+                            while (queue.batches.isEmpty() && !queue.finished) {
+                                queue.batchAvailable.wait(&queue.mutex);
+                            }
+                            if (queue.batches.isEmpty()) {
+                                break;
+                            }
+                            batchFuture = queue.batches.dequeue();
+                        }
+
+                        // batches are always drained, so the reader is not blocked after a failure
+                        const ScanRecordBatch batch = batchFuture.result();
+                        freeBatches.release();
+                        if (writerErr != kNoErr) {
+                            continue;
+                        }
+
+                        for (int i = 0; i < batch.size() && writerErr == kNoErr; ++i) {
+                            writerErr = scanWriter.write(*batch[i]);
+                        }
+                        if (writerErr != kNoErr) {
+                            failed = true;
+                        }
+                    }
+                    if (writerErr == kNoErr) {
+                        writerErr = scanWriter.flush();
+                    }
+                    brokenScans = scanWriter.brokenScans();
+                }
+
+                if (writerErr != kNoErr) {
+                    writerDb.rollback();
+                } else if (!writerDb.commit()) {
+                    writerErr = kError;
+                }
+                writerDb.close();
+            }
+            QSqlDatabase::removeDatabase(connectionName);
+            return writerErr;
+        });
+
+        QThreadPool workerPool;
+        workerPool.setMaxThreadCount(threadCount);
 
-        if (!onlyCentroided) {
-            e = QEXEC_NOARG(queryProfilePeaks); ree;
+        ScanRecordBatch batch;
+        auto submitBatch = [&]() {
+            if (batch.isEmpty()) {
+                return;
+            }
+
+            const ScanRecordBatch scans = batch;
+            QFuture<ScanRecordBatch> batchFuture = QtConcurrent::run(&workerPool, [scans]() {
+                for (const QSharedPointer<ScanRecord> &record : scans) {
+                    processScanRecord(record.data());
+                }
+                return scans;
+            });
+
+            {
+                QMutexLocker locker(&queue.mutex);
+                queue.batches.enqueue(batchFuture);
+            }
+            queue.batchAvailable.wakeOne();
+
+            batch.clear();
+        };
+
+        for (long index = start; index <= end && !failed; ++index) {
+            if (batch.isEmpty()) {
+                freeBatches.acquire();
+            }
+            batch.push_back(readScanRecord(reader, index, onlyCentroided));
+            if (batch.size() >= SCAN_BATCH_SIZE) {
+                submitBatch();
+            }
+        }
+        submitBatch();
+
+        {
+            QMutexLocker locker(&queue.mutex);
+            queue.finished = true;
         }
-        e = QEXEC_NOARG(queryCentroidPeaks); ree;
-        e = QEXEC_NOARG(querySpectra); ree;
-        ++peakId;
+        queue.batchAvailable.wakeOne();
+
+        e = writer.result(); ree;
     }
-    e = instance.endTransaction(); ree;
 
     if (brokenScans > 0) {
         QMap<QString, QString> messages;
@@ -602,7 +892,7 @@ Err MSWriterByspec2::writePeak(const byspec2::PeakDaoEntry &peak, PeakOptions op
     const bool centroidedAsNormal = options.testFlag(PeakOption::CentroidedAsNormal);
     if (centroided || centroidedAsNormal) {
         // Calculate centroided peak
-        const byspec2::PeakDaoEntry centroidedPeak = makeCentroided(peak, centroidOptions);
+        const byspec2::PeakDaoEntry centroidedPeak = makeCentroided(peak, centroidOptions, &m_centroid);
         if(centroided) {
             e = writePeakToDb(centroidedPeak, true); ree;
         }
@@ -65,6 +65,13 @@ public:
                     const msreader::IonMobilityOptions &ionMobilityOptions,
                     const QStringList &argumentList);
 
+    /*!
+     * \brief Number of threads processing scans in \a makeByspec2. 0 (default) means
+     * QThread::idealThreadCount(), 1 reads, processes and writes the scans on the calling thread.
+     */
+    void setThreadCount(int threadCount) { m_threadCount = threadCount; }
+    int threadCount() const { return m_threadCount; }
+
     /*!
      * \brief Creates all tables required by the bysec2 format.
      */
@@ -140,6 +147,10 @@ private:
     /*!
      * The \a fileId specifies the File Id value for the created entry.
      * \brief Populates the Peaks and Spectra tables. The MSReader instance must be initialized.
+     *
+     * Scans are read on the calling thread, processed (centroiding, calibration, blobs and
+     * intensity sums) on a thread pool and written in scan order by a writer thread with its own
+     * connection.
      */
     Err insertDataIntoPeaksAndSpectraTable(bool centroided, int fileId);
 
@@ -149,6 +160,8 @@ private:
 
     QSqlDatabase m_database;
     QString m_outputFile;
+    pico::Centroid m_centroid;
+    int m_threadCount = 0;
 
     static QAtomicInt connCounter;
 };
@@ -29,6 +29,18 @@
 #include <Eigen/Dense>
 #include <Eigen/Sparse>
 
+#include <QAtomicInt>
+#include <QFuture>
+#include <QMutex>
+#include <QQueue>
+#include <QSemaphore>
+#include <QThread>
+#include <QThreadPool>
+#include <QWaitCondition>
+#include <QtConcurrent/QtConcurrentRun>
+
+#include <atomic>
+
 #define SPECTRA_DISAMBIGUTRON
 //#define  TROUBLESHOOTING_ENABLED
 
@@ -36,9 +48,70 @@
 ///// checking
 _PMI_BEGIN
 
+namespace {
+
+//! \brief scans read from the file which are analyzed together by one worker task
+struct ScanBatch {
+    QVector<ScanDetails> details;
+    QVector<point2dList> points;
+};
+
+//! \brief charge clusters found in each scan of a ScanBatch
+struct AnalyzedScanBatch {
+    Err e = kNoErr;
+    QVector<ScanDetails> details;
+    QVector<std::vector<ChargeCluster>> chargeClusters;
+};
+
+//! \brief analyzed batches in the order they have to be written
+struct AnalyzedScanBatchQueue {
+    QMutex mutex;
+    QWaitCondition batchAvailable;
+    QQueue<QFuture<AnalyzedScanBatch>> batches;
+    bool finished = false;
+};
+
+//! \brief files are processed on several threads at once, see MultiSampleScanFeatureFinder; the
+//! file names alone may repeat
+QString uniqueConnectionName(const QString &prefix)
+{
+    static QAtomicInt count;
+    return QStringLiteral("%1_%2").arg(prefix).arg(count.fetchAndAddOrdered(1));
+}
+
+}
+
+//! \brief classes analyzing a scan; they keep state of the current scan, so each thread needs
+//! its own copy
+struct ScanIterator::ScanAnalyzer {
+    ScanAnalyzer(const ChargeDeterminatorNN &charge, const MonoisotopeDeterminatorNN &mono,
+                 const SettableFeatureFinderParameters &ffUserParams)
+        : chargeDeterminator(charge)
+        , monoDeterminator(mono)
+        , mzFinder(charge, ffUserParams)
+        , chargeClusterDecimator(ffUserParams.minIsotopeCount)
+    {
+    }
+
+    Err init()
+    {
+        Err e = kNoErr;
+        e = chargeClusterDecimator.init(); ree;
+        e = spectraDisambigutron.init(); ree;
+        return e;
+    }
+
+    ChargeDeterminatorNN chargeDeterminator;
+    MonoisotopeDeterminatorNN monoDeterminator;
+    FindMzToProcess mzFinder;
+    SpectraSubtractomatic chargeClusterDecimator;
+    SpectraDisambigutron spectraDisambigutron;
+};
+
 ScanIterator::ScanIterator(const QString &neuralNetworkDbFilePath, const SettableFeatureFinderParameters &ffUserParams)
     : m_neuralNetworkDbFilePath(neuralNetworkDbFilePath)
     , m_isWorkingDirectorySet(false)
+    , m_threadCount(0)
     , m_ffUserParams(ffUserParams)
 {
 }
@@ -73,13 +146,28 @@ QDir ScanIterator::workingDirectory() const
     return m_workingDirectory;
 }
 
-Err ScanIterator::createFeatureFinderDB(QSqlDatabase &db, const QString &msFilePath, QString *outputFilePath)
+void ScanIterator::setThreadCount(int threadCount)
+{
+    m_threadCount = threadCount;
+}
+
+int ScanIterator::threadCount() const
+{
+    return m_threadCount;
+}
+
+QString ScanIterator::featureFinderDBFilePath(const QString &msFilePath) const
 {
     QFileInfo fi(msFilePath);
     QString fileName = QString("%1.ftrs").arg(fi.completeBaseName());
 
-    const QString dbFilePath = m_isWorkingDirectorySet ? m_workingDirectory.filePath(fileName)
-        : fi.absoluteDir().filePath(fileName);
+    return m_isWorkingDirectorySet ? m_workingDirectory.filePath(fileName)
+                                   : fi.absoluteDir().filePath(fileName);
+}
+
+Err ScanIterator::createFeatureFinderDB(QSqlDatabase &db, const QString &msFilePath, QString *outputFilePath)
+{
+    const QString dbFilePath = featureFinderDBFilePath(msFilePath);
 
     if (QFileInfo(dbFilePath).exists()) {
         // remove the file
@@ -93,8 +181,8 @@ Err ScanIterator::createFeatureFinderDB(QSqlDatabase &db, const QString &msFileP
 
     debugMs() << "Saving features to" << dbFilePath;
 
-    QString connectionName = QStringLiteral("ScanIterator_ftrs_cache_%1")
-                                 .arg(QFileInfo(dbFilePath).completeBaseName());
+    const QString connectionName
+        = uniqueConnectionName(QStringLiteral("ScanIterator_ftrs_cache"));
 
     Err e = addDatabaseAndOpen(connectionName, dbFilePath, db);
     if (e != kNoErr) {
@@ -155,28 +243,74 @@ Err ScanIterator::iterateMSFileLinearDBSCANSelect(const QString &msFilePath, QSt
         rrr(kBadParameterError);
     }
 
-    QSqlDatabase db;
     MSReader *ms = MSReader::Instance();
 
 #ifdef TROUBLESHOOTING_ENABLED
-    QString testFile = "P:/PMI_Share_Data/Data2018/NIST/MAM RR/9119/SPK_MS.RAW";
-    e = createFeatureFinderDB(db, testFile, outputPath); ree;
-    e = ms->openFile(testFile); ree;
+    const QString filePath = "P:/PMI_Share_Data/Data2018/NIST/MAM RR/9119/SPK_MS.RAW";
 #else
-    e = createFeatureFinderDB(db, msFilePath, outputPath); ree;
-    e = ms->openFile(msFilePath); ree;
+    const QString filePath = msFilePath;
 #endif
-    ////Instantiate required classes and variables for scan iteration
-    const bool doCentroid = true;
+    e = ms->openFile(filePath); ree;
+
+    e = iterateMSFileLinearDBSCANSelect(ms, filePath, outputPath, progress);
+
+    ms->closeFile();
+    ms->closeAllFileConnections();
+
+    return e;
+}
+
+Err ScanIterator::iterateMSFileLinearDBSCANSelect(MSReaderInterface *ms, const QString &msFilePath,
+                                                  QString *outputPath,
+                                                  QSharedPointer<ProgressBarInterface> progress)
+{
+    Err e = kNoErr;
+    if (!ms || !outputPath) {
+        rrr(kBadParameterError);
+    }
+
+    QSqlDatabase db;
+    e = createFeatureFinderDB(db, msFilePath, outputPath); ree;
 
     QList<msreader::ScanInfoWrapper> scanInfoList;
     e = ms->getScanInfoListAtLevel(1, &scanInfoList); ree;
 
-    FindMzToProcess mzFinderNew(m_chargeDeterminator, m_ffUserParams);
-    SpectraSubtractomatic chargeClusterDecimator(m_ffUserParams.minIsotopeCount);
-    e = chargeClusterDecimator.init(); ree;
-    SpectraDisambigutron spectraDisambigutron;
-    e = spectraDisambigutron.init(); ree;
+    if (progress) {
+        progress->setText(QObject::tr("Feature finding at %1").arg(msFilePath));
+    }
+
+    const int threadCount = (m_threadCount > 0) ? m_threadCount : QThread::idealThreadCount();
+    if (threadCount <= 1) {
+        e = findChargeClustersSerial(ms, db, scanInfoList, progress); ree;
+    } else {
+        e = findChargeClustersParallel(ms, *outputPath, scanInfoList, threadCount, progress); ree;
+    }
+
+    {
+        ////Collate Charge Clusters found to Features w/ DBSCAN.
+        CollateChargeClustersToFeatures featureMaker(db, m_ffUserParams);
+        e = featureMaker.init(); ree;
+    }
+
+    // connection names are unique, so the connection is not reused by the next file
+    const QString connectionName = db.connectionName();
+    db.close();
+    db = QSqlDatabase();
+    QSqlDatabase::removeDatabase(connectionName);
+    return e;
+}
+
+Err ScanIterator::findChargeClustersSerial(MSReaderInterface *ms, QSqlDatabase &db,
+                                           const QList<msreader::ScanInfoWrapper> &scanInfoList,
+                                           QSharedPointer<ProgressBarInterface> progress)
+{
+    Err e = kNoErr;
+
+    ////Instantiate required classes and variables for scan iteration
+    const bool doCentroid = true;
+
+    ScanAnalyzer analyzer(m_chargeDeterminator, m_monoDeterminator, m_ffUserParams);
+    e = analyzer.init(); ree;
 
     ////Being Scanning DB Transaction
     bool ok = db.transaction();
@@ -184,10 +318,6 @@ Err ScanIterator::iterateMSFileLinearDBSCANSelect(const QString &msFilePath, QSt
         return kError;
     }
 
-    if (progress) {
-        progress->setText(QObject::tr("Feature finding at %1").arg(msFilePath));
-    }
-
     {
         ProgressContext progressContext(scanInfoList.size(), progress);
         //// Begin Processing Scan
@@ -210,8 +340,6 @@ Err ScanIterator::iterateMSFileLinearDBSCANSelect(const QString &msFilePath, QSt
         }
 #endif
 
-            ///////////////////////////////////////////////////////////////////////////////////////////
-
             //////Retrieve Scan from file
             point2dList points;
             e = ms->getScanData(scanDetails.vendorScanNumber, &points, doCentroid); ree;
@@ -220,130 +348,324 @@ Err ScanIterator::iterateMSFileLinearDBSCANSelect(const QString &msFilePath, QSt
                 std::cout << "Scan " << scanInfo.scanNumber;
                 std::cout << " Point Count " << points.size() << std::endl;
                 continue;
-            } else if (static_cast<int>(points.size()) > m_ffParams.maxIonCount + 1) {
-                auto point2d_greater_y = [](const point2d &a, const point2d &b) {
-                    return b.y() < a.y();
-                };
-                std::sort(points.begin(), points.end(), point2d_greater_y);
-                points.resize(m_ffParams.maxIonCount);
-                std::sort(points.begin(), points.end(), point2d_less_x);
             }
 
+            std::vector<ChargeCluster> vectorChargeCluster;
+            e = analyzeScan(&analyzer, std::move(points), &vectorChargeCluster); ree;
 
-            // Convert scanData into Eigen::RowVectorXd  TODO Abstract this to Common Functions
-            // later////////
-            Eigen::SparseVector<double, Eigen::RowMajor> fullScan(
-                static_cast<int>(m_ffParams.mzMax * m_ffParams.vectorGranularity));
-            fullScan.reserve(m_ffParams.maxIonCount);
-            for (size_t j = 0; j < points.size(); ++j) {
-                double insertionPoint
-                    = FeatureFinderUtils::hashMz(points[j].x(), m_ffParams.vectorGranularity);
-                if (insertionPoint
-                    < static_cast<int>(m_ffParams.mzMax * m_ffParams.vectorGranularity)) {
-                    fullScan.insert(insertionPoint) = points[j].y();
-                }
+            e = saveChargeClusterIntoDb(db, scanDetails, vectorChargeCluster); ree;
+
+            if ((i % 1000) == 0) {
+                debugMs() << i << "scans processed";
             }
 
-            // Build Mz Iterators here w/ linearDBSCAN clustering.
-            point2dList pointsOfInterest = mzFinderNew.searchFullScanForMzIterators(points, fullScan);
-    
+        } ////End Processing Scan
+    }
 
-            // Iterate Points of Interest & determine charge, monoiso, subtract scans, and enter charge
-            // cluster into DB
-            std::vector<ChargeCluster> vectorChargeCluster;
-            for (size_t k = 0; k < pointsOfInterest.size(); ++k) {
+    //// End Scanning DB Transaction
+    ok = db.commit();
+    if (!ok) {
+        return kError;
+    }
 
-                double t_mz = pointsOfInterest[k].x();
+    return e;
+}
 
-                // Slice the array for use in the following functions and check if viable
-                int t_index = FeatureFinderUtils::hashMz(t_mz, m_ffParams.vectorGranularity);
-                Eigen::SparseVector<double> scanSegment
-                    = fullScan.middleCols(t_index - m_ffParams.mzMatchIndex, (2 * m_ffParams.mzMatchIndex) + 1);
+Err ScanIterator::findChargeClustersParallel(MSReaderInterface *ms, const QString &dbFilePath,
+                                             const QList<msreader::ScanInfoWrapper> &scanInfoList,
+                                             int threadCount,
+                                             QSharedPointer<ProgressBarInterface> progress)
+{
+    // scans analyzed by one worker task
+    static const int SCAN_BATCH_SIZE = 8;
 
-                Eigen::RowVectorXd scanSegmentMzTooth
-                    = fullScan.middleCols(t_index - m_ffParams.errorRangeHashed, (2 * m_ffParams.errorRangeHashed) + 1);
-                int t_maxIntensity = static_cast<int>(scanSegmentMzTooth.maxCoeff());
-                if (scanSegment.cols() == 0 || t_maxIntensity < mzFinderNew.noiseFloor()) {
-                    continue;
-                }
+    Err e = kNoErr;
+    const bool doCentroid = true;
 
-                // Determine Charge
-                int charge = m_chargeDeterminator.determineCharge(scanSegment);
+    // the analyzers keep state of the scan being analyzed, so every worker needs its own copy;
+    // there are as many copies as worker threads, a free one is always available to a task
+    ScanAnalyzer prototype(m_chargeDeterminator, m_monoDeterminator, m_ffUserParams);
+    e = prototype.init(); ree;
+    std::vector<ScanAnalyzer> analyzers(threadCount, prototype);
+    QMutex analyzersMutex;
+    QVector<ScanAnalyzer *> freeAnalyzers;
+    for (ScanAnalyzer &analyzer : analyzers) {
+        freeAnalyzers.push_back(&analyzer);
+    }
 
-                // Determine Mono Offset
-                if (charge == 0) {
+    // batches which were read but not written yet; bounds the memory held by the pipeline
+    QSemaphore freeBatches(2 * threadCount);
+    AnalyzedScanBatchQueue queue;
+    // set by the reader or the writer, stops reading and rolls back the writer transaction
+    std::atomic<bool> failed{ false };
+
+    // sqlite connection can be used only by the thread which opened it
+    QThreadPool writerPool;
+    writerPool.setMaxThreadCount(1);
+
+    QFuture<Err> writer = QtConcurrent::run(&writerPool, [&]() {
+        const QString connectionName
+            = uniqueConnectionName(QStringLiteral("ScanIterator_ftrs_writer"));
+        Err writerErr = kNoErr;
+        {
+            QSqlDatabase writerDb;
+            writerErr = addDatabaseAndOpen(connectionName, dbFilePath, writerDb);
+            if (writerErr == kNoErr && !writerDb.transaction()) {
+                writerErr = kError;
+            }
+            if (writerErr != kNoErr) {
+                failed = true;
+            }
+
+            while (true) {
+                QFuture<AnalyzedScanBatch> batchFuture;
+                {
+                    QMutexLocker locker(&queue.mutex);
+                    while (queue.batches.isEmpty() && !queue.finished) {
+                        queue.batchAvailable.wait(&queue.mutex);
+                    }
+                    if (queue.batches.isEmpty()) {
+                        break;
+                    }
+                    batchFuture = queue.batches.dequeue();
+                }
+
+                // batches are always drained, so the reader is not blocked after a failure
+                const AnalyzedScanBatch batch = batchFuture.result();
+                freeBatches.release();
+                if (writerErr != kNoErr) {
                     continue;
                 }
 
+                writerErr = batch.e;
+                for (int j = 0; j < batch.details.size() && writerErr == kNoErr; ++j) {
+                    writerErr = saveChargeClusterIntoDb(writerDb, batch.details[j],
+                                                        batch.chargeClusters[j]);
+                    if ((batch.details[j].scanIndex % 1000) == 0) {
+                        debugMs() << batch.details[j].scanIndex << "scans processed";
+                    }
+                }
+                if (writerErr != kNoErr) {
+                    failed = true;
+                }
+            }
 
-#ifdef SPECTRA_DISAMBIGUTRON
-                Eigen::SparseVector<double> cleanedScan;
-                e = spectraDisambigutron.removeOverlappingIonsFromScan(scanSegment, charge, &cleanedScan); ree;
-                int monoOffset = m_monoDeterminator.determineMonoisotopeOffset(cleanedScan, t_mz, charge);
-                Decimator decimator = chargeClusterDecimator.buildChargeClusterDecimator(
-                    cleanedScan, t_mz, charge, monoOffset, true);
-#else
-                int monoOffset = m_monoDeterminator.determineMonoisotopeOffset(scanSegment, t_mz, charge);
-                Decimator decimator = chargeClusterDecimator.buildChargeClusterDecimator(
-                    scanSegment, t_mz, charge, monoOffset, false);
-#endif
+            if (failed) {
+                writerDb.rollback();
+            } else if (!writerDb.commit()) {
+                writerErr = kError;
+            }
+            writerDb.close();
+        }
+        QSqlDatabase::removeDatabase(connectionName);
+        return writerErr;
+    });
 
-                fullScan -= decimator.clusterDecimator; 
+    QThreadPool workerPool;
+    workerPool.setMaxThreadCount(threadCount);
 
-                // Sets all negative values in fullScan to 0 after decimator subtraction
-                for (Eigen::SparseVector<double, Eigen::RowMajor>::InnerIterator it(fullScan); it;
-                     ++it) {
-                    if (it.value() < 0) {
-                        fullScan.coeffRef(it.index()) = 0;
-                    }
-                }
-                fullScan.prune(0.0);
+    ScanBatch batch;
+    auto submitBatch = [&]() {
+        if (batch.details.isEmpty()) {
+            return;
+        }
 
-    // For Troubleshooting and Testing uncomment the define above
-    #ifdef TROUBLESHOOTING_ENABLED
+        freeBatches.acquire();
+        const ScanBatch scans = batch;
+        QFuture<AnalyzedScanBatch> batchFuture = QtConcurrent::run(&workerPool, [&, scans]() {
+            ScanAnalyzer *analyzer = nullptr;
+            {
+                QMutexLocker locker(&analyzersMutex);
+                analyzer = freeAnalyzers.takeLast();
+            }
 
-                if (decimator.correlation > m_ffUserParams.averagineCorrelationCutOff) {
-                        std::cout << "mz: " << t_mz << " charge: " << charge << " mono: " << monoOffset
-                                  << " corr: " << decimator.correlation
-                                  << " mw: " << (charge * t_mz) - charge - monoOffset << std::endl;
-                    }
-    #endif
+            AnalyzedScanBatch result;
+            result.details = scans.details;
+            result.chargeClusters.resize(scans.points.size());
+            for (int j = 0; j < scans.points.size() && result.e == kNoErr; ++j) {
+                result.e = analyzeScan(analyzer, scans.points[j], &result.chargeClusters[j]);
+            }
 
-                // Build Charge Cluster struct for entry to DB
-                ChargeCluster chargeCluster;
-                chargeCluster.charge = charge;
-                chargeCluster.corr = decimator.correlation;
-                chargeCluster.maxIntensity = t_maxIntensity;
-                chargeCluster.monoOffset = monoOffset;
-                chargeCluster.mzFound = t_mz;
-                chargeCluster.istopeCount = decimator.isotopeCount;
-                chargeCluster.scanNoiseFloor = mzFinderNew.noiseFloor();
-                vectorChargeCluster.push_back(chargeCluster);
+            {
+                QMutexLocker locker(&analyzersMutex);
+                freeAnalyzers.push_back(analyzer);
             }
+            return result;
+        });
 
-            e = saveChargeClusterIntoDb(db, scanDetails, vectorChargeCluster); ree;
+        {
+            QMutexLocker locker(&queue.mutex);
+            queue.batches.enqueue(batchFuture);
+        }
+        queue.batchAvailable.wakeOne();
 
-            if ((i % 1000) == 0) {
-                debugMs() << i << "scans processed";
+        batch = ScanBatch();
+    };
+
+    {
+        ProgressContext progressContext(scanInfoList.size(), progress);
+        for (int i = 0; i < scanInfoList.size() && !failed; ++i, ++progressContext) {
+            const msreader::ScanInfoWrapper &scanInfo = scanInfoList[i];
+
+            ScanDetails scanDetails;
+            scanDetails.scanIndex = i;
+            scanDetails.vendorScanNumber = scanInfo.scanNumber;
+            scanDetails.rt = scanInfo.scanInfo.retTimeMinutes;
+
+// For Troubleshooting and Testing uncomment the define above
+#ifdef TROUBLESHOOTING_ENABLED
+        int vendorScanNumber = 17746; // "P:\PMI_Share_Data\Data2018\NIST\MAM RR\9119\SPK_MS.RAW"
+        if (scanInfo.scanNumber < vendorScanNumber) {
+            continue;
+        }
+        else if (scanInfo.scanNumber > vendorScanNumber + 0) {
+            break;
+        }
+#endif
+
+            // MSReader has to be used from the calling thread, so the reading is not parallel
+            point2dList points;
+            e = ms->getScanData(scanDetails.vendorScanNumber, &points, doCentroid);
+            if (e != kNoErr) {
+                failed = true;
+                break;
             }
 
-        } ////End Processing Scan
+            if (points.empty()) {
+                debugMs() << "Scan" << scanInfo.scanNumber << "Point Count" << points.size();
+                continue;
+            }
+
+            batch.details.push_back(scanDetails);
+            batch.points.push_back(std::move(points));
+            if (batch.details.size() == SCAN_BATCH_SIZE) {
+                submitBatch();
+            }
+        }
     }
 
-    //// End Scanning DB Transaction
-    ok = db.commit();
-    if (!ok) {
-        return kError;
+    if (!failed) {
+        submitBatch();
     }
 
-    ////Collate Charge Clusters found to Features w/ DBSCAN.
-    CollateChargeClustersToFeatures featureMaker(db, m_ffUserParams);
-    e = featureMaker.init(); ree;
-    
-    ms->closeFile();
-    ms->closeAllFileConnections();
+    {
+        QMutexLocker locker(&queue.mutex);
+        queue.finished = true;
+    }
+    queue.batchAvailable.wakeAll();
+
+    const Err writerErr = writer.result();
+    ree;
+
+    e = writerErr; ree;
+    return e;
+}
+
+Err ScanIterator::analyzeScan(ScanAnalyzer *analyzer, point2dList points,
+                              std::vector<ChargeCluster> *vectorChargeCluster) const
+{
+    Err e = kNoErr;
+
+    if (static_cast<int>(points.size()) > m_ffParams.maxIonCount + 1) {
+        auto point2d_greater_y = [](const point2d &a, const point2d &b) {
+            return b.y() < a.y();
+        };
+        std::sort(points.begin(), points.end(), point2d_greater_y);
+        points.resize(m_ffParams.maxIonCount);
+        std::sort(points.begin(), points.end(), point2d_less_x);
+    }
+
+    // Convert scanData into Eigen::RowVectorXd  TODO Abstract this to Common Functions
+    // later////////
+    Eigen::SparseVector<double, Eigen::RowMajor> fullScan(
+        static_cast<int>(m_ffParams.mzMax * m_ffParams.vectorGranularity));
+    fullScan.reserve(m_ffParams.maxIonCount);
+    for (size_t j = 0; j < points.size(); ++j) {
+        double insertionPoint
+            = FeatureFinderUtils::hashMz(points[j].x(), m_ffParams.vectorGranularity);
+        if (insertionPoint
+            < static_cast<int>(m_ffParams.mzMax * m_ffParams.vectorGranularity)) {
+            fullScan.insert(insertionPoint) = points[j].y();
+        }
+    }
+
+    FindMzToProcess &mzFinderNew = analyzer->mzFinder;
+
+    // Build Mz Iterators here w/ linearDBSCAN clustering.
+    point2dList pointsOfInterest = mzFinderNew.searchFullScanForMzIterators(points, fullScan);
+
+    // Iterate Points of Interest & determine charge, monoiso, subtract scans, and enter charge
+    // cluster into DB
+    for (size_t k = 0; k < pointsOfInterest.size(); ++k) {
+
+        double t_mz = pointsOfInterest[k].x();
+
+        // Slice the array for use in the following functions and check if viable
+        int t_index = FeatureFinderUtils::hashMz(t_mz, m_ffParams.vectorGranularity);
+        Eigen::SparseVector<double> scanSegment
+            = fullScan.middleCols(t_index - m_ffParams.mzMatchIndex, (2 * m_ffParams.mzMatchIndex) + 1);
+
+        Eigen::RowVectorXd scanSegmentMzTooth
+            = fullScan.middleCols(t_index - m_ffParams.errorRangeHashed, (2 * m_ffParams.errorRangeHashed) + 1);
+        int t_maxIntensity = static_cast<int>(scanSegmentMzTooth.maxCoeff());
+        if (scanSegment.cols() == 0 || t_maxIntensity < mzFinderNew.noiseFloor()) {
+            continue;
+        }
+
+        // Determine Charge
+        int charge = analyzer->chargeDeterminator.determineCharge(scanSegment);
+
+        // Determine Mono Offset
+        if (charge == 0) {
+            continue;
+        }
+
+
+#ifdef SPECTRA_DISAMBIGUTRON
+        Eigen::SparseVector<double> cleanedScan;
+        e = analyzer->spectraDisambigutron.removeOverlappingIonsFromScan(scanSegment, charge, &cleanedScan); ree;
+        int monoOffset = analyzer->monoDeterminator.determineMonoisotopeOffset(cleanedScan, t_mz, charge);
+        Decimator decimator = analyzer->chargeClusterDecimator.buildChargeClusterDecimator(
+            cleanedScan, t_mz, charge, monoOffset, true);
+#else
+        int monoOffset = analyzer->monoDeterminator.determineMonoisotopeOffset(scanSegment, t_mz, charge);
+        Decimator decimator = analyzer->chargeClusterDecimator.buildChargeClusterDecimator(
+            scanSegment, t_mz, charge, monoOffset, false);
+#endif
+
+        fullScan -= decimator.clusterDecimator; 
+
+        // Sets all negative values in fullScan to 0 after decimator subtraction
+        for (Eigen::SparseVector<double, Eigen::RowMajor>::InnerIterator it(fullScan); it;
+             ++it) {
+            if (it.value() < 0) {
+                fullScan.coeffRef(it.index()) = 0;
+            }
+        }
+        fullScan.prune(0.0);
+
+// For Troubleshooting and Testing uncomment the define above
+#ifdef TROUBLESHOOTING_ENABLED
+
+        if (decimator.correlation > m_ffUserParams.averagineCorrelationCutOff) {
+                std::cout << "mz: " << t_mz << " charge: " << charge << " mono: " << monoOffset
+                          << " corr: " << decimator.correlation
+                          << " mw: " << (charge * t_mz) - charge - monoOffset << std::endl;
+            }
+#endif
+
+        // Build Charge Cluster struct for entry to DB
+        ChargeCluster chargeCluster;
+        chargeCluster.charge = charge;
+        chargeCluster.corr = decimator.correlation;
+        chargeCluster.maxIntensity = t_maxIntensity;
+        chargeCluster.monoOffset = monoOffset;
+        chargeCluster.mzFound = t_mz;
+        chargeCluster.istopeCount = decimator.isotopeCount;
+        chargeCluster.scanNoiseFloor = mzFinderNew.noiseFloor();
+        vectorChargeCluster->push_back(chargeCluster);
+    }
 
-    db.close();
     return e;
 }
 
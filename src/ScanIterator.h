@@ -17,6 +17,7 @@
 
 #include "FeatureFinderParameters.h"
 #include "MonoisotopeDeterminatorNN.h"
+#include "MSReaderTypes.h"
 
 #include <common_errors.h>
 #include <common_math_types.h>
@@ -35,6 +36,8 @@ class QSqlDatabase;
 
 _PMI_BEGIN
 
+class MSReaderInterface;
+
 struct ScanDetails {
     int scanIndex = 0;
     int vendorScanNumber = 0;
@@ -66,6 +69,17 @@ public:
     Err iterateMSFileLinearDBSCANSelect(const QString &msFilePath, QString *outputPath,
                                         QSharedPointer<ProgressBarInterface> progress = NoProgress);
 
+    /*!
+     * @brief Same as above, but reads the scans from @a reader which has @a msFilePath already
+     * open. The reader is not closed.
+     *
+     * Unlike the MSReader singleton, a reader which does not need the calling thread lets samples
+     * be processed in parallel with one ScanIterator per thread.
+     */
+    Err iterateMSFileLinearDBSCANSelect(MSReaderInterface *reader, const QString &msFilePath,
+                                        QString *outputPath,
+                                        QSharedPointer<ProgressBarInterface> progress = NoProgress);
+
     Err iterateMSFileLinearDBSCANSelectTestPurposes(
         const QVector<FauxScanCreator::Scan> &scansVec,
         QVector<CrossSampleFeatureTurbo> *crossSampleFeautreTurbosReturn);
@@ -75,7 +89,34 @@ public:
     void setWorkingDirectory(const QDir &workingDirectory);
     QDir workingDirectory() const;
 
+    //! @brief path of the ftrs file the features of @a msFilePath are saved to; an existing file
+    //! is replaced
+    QString featureFinderDBFilePath(const QString &msFilePath) const;
+
+    /*!
+     * @brief Number of threads analyzing the scans of one file, 0 (default) means
+     * QThread::idealThreadCount().
+     *
+     * With more than one thread the scans are read on the calling thread, analyzed by a pool of
+     * workers and written in scan order by a writer thread, so the ftrs file is the same as with
+     * one thread.
+     */
+    void setThreadCount(int threadCount);
+    int threadCount() const;
+
 private:
+    struct ScanAnalyzer;
+
+    Err findChargeClustersSerial(MSReaderInterface *ms, QSqlDatabase &db,
+                                 const QList<msreader::ScanInfoWrapper> &scanInfoList,
+                                 QSharedPointer<ProgressBarInterface> progress);
+    Err findChargeClustersParallel(MSReaderInterface *ms, const QString &dbFilePath,
+                                   const QList<msreader::ScanInfoWrapper> &scanInfoList,
+                                   int threadCount, QSharedPointer<ProgressBarInterface> progress);
+    //! @brief finds the charge clusters in @a points of one scan, safe to call from any thread
+    //! with its own @a analyzer
+    Err analyzeScan(ScanAnalyzer *analyzer, point2dList points,
+                    std::vector<ChargeCluster> *vectorChargeCluster) const;
     Err saveChargeClusterIntoDb(QSqlDatabase &db, const ScanDetails &scanDetails,
                                  const std::vector<ChargeCluster> vectorChargeCluster);
     Err createFeatureFinderSqliteDbSchema(QSqlDatabase &db);
@@ -90,6 +131,7 @@ private:
     QString m_neuralNetworkDbFilePath;
     QDir m_workingDirectory;
     bool m_isWorkingDirectorySet;
+    int m_threadCount;
     ImmutableFeatureFinderParameters m_ffParams;
     SettableFeatureFinderParameters m_ffUserParams;
     ChargeDeterminatorNN m_chargeDeterminator;
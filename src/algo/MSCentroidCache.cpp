@@ -1,41 +1,294 @@
-#include <QDebug>
+/*
+ * Copyright (C) 2019 Protein Metrics Inc. - All Rights Reserved.
+ * Unauthorized copying or distribution of this file, via any medium is strictly prohibited.
+ * Confidential.
+ */
+
 #include "MSCentroidCache.h"
 
+#include "pmi_common_ms_debug.h"
+
+#include <cstring>
+
 _PMI_BEGIN
 
-MSCentroidCache::MSCentroidCache () {
+namespace {
+
+const char FILE_MAGIC[8] = { 'P', 'M', 'I', 'C', 'N', 'T', 'R', 'D' };
+const quint32 FILE_VERSION = 1;
+// the file is written in the native byte order, the mark detects files from other platforms
+const quint32 BYTE_ORDER_MARK = 0x01020304;
+const int DEFAULT_MEMORY_LIMIT = 256 * 1024 * 1024;
+
+struct FileHeader {
+    char magic[8];
+    quint32 version;
+    quint32 headerSize;
+    quint32 byteOrderMark;
+    quint32 reserved0;
+    double smoothingWidth;
+    quint64 reserved[4];
+};
+
+static_assert(sizeof(FileHeader) == 64, "FileHeader is part of the file format");
+
+//! \brief followed by the m/z and the intensity column of pointCount values
+struct RecordHeader {
+    qint64 scanNumber;
+    quint64 pointCount;
+};
+
+static_assert(sizeof(RecordHeader) == 16, "RecordHeader is part of the file format");
+
+qint64 recordSize(quint64 pointCount)
+{
+    return static_cast<qint64>(sizeof(RecordHeader) + pointCount * 2 * sizeof(double));
+}
+
+int memoryCost(const point2dList &points)
+{
+    return static_cast<int>(points.size() * sizeof(point2d));
+}
+
+}
+
+MSCentroidCache::MSCentroidCache()
+{
+    m_memory.setMaxCost(DEFAULT_MEMORY_LIMIT);
+}
+
+MSCentroidCache::~MSCentroidCache()
+{
+    close();
+}
+
+QString MSCentroidCache::cacheSuffix(double smoothingWidth)
+{
+    return QString(".centroid_%1.cache").arg(smoothingWidth);
+}
+
+Err MSCentroidCache::open(const QString &filePath, double smoothingWidth)
+{
+    Err e = kNoErr;
+
+    close();
+    m_smoothingWidth = smoothingWidth;
+
+    m_file.setFileName(filePath);
+    if (!m_file.open(QIODevice::ReadWrite)) {
+        warningMs() << "Cannot open centroid cache" << filePath << m_file.errorString();
+        rrr(kFileOpenError);
+    }
+
+    m_fileSize = m_file.size();
+    e = readIndex();
+    if (e != kNoErr) {
+        debugMs() << "Creating centroid cache" << filePath;
+        e = createFile();
+    }
+
+    if (e != kNoErr) {
+        close();
+    }
+
+    return e;
+}
+
+void MSCentroidCache::close()
+{
+    unmap();
+    if (m_file.isOpen()) {
+        m_file.close();
+    }
+    m_fileSize = 0;
+    m_index.clear();
+    m_memory.clear();
+}
+
+bool MSCentroidCache::isOpen() const
+{
+    return m_file.isOpen();
+}
+
+QString MSCentroidCache::filePath() const
+{
+    return m_file.isOpen() ? m_file.fileName() : QString();
+}
+
+double MSCentroidCache::smoothingWidth() const
+{
+    return m_smoothingWidth;
+}
+
+int MSCentroidCache::count() const
+{
+    return m_index.size();
 }
 
-void MSCentroidCache::clear() {
-    m_scanNumber_points.clear();
+Err MSCentroidCache::createFile()
+{
+    unmap();
+    m_index.clear();
+
+    FileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, FILE_MAGIC, sizeof(FILE_MAGIC));
+    header.version = FILE_VERSION;
+    header.headerSize = sizeof(FileHeader);
+    header.byteOrderMark = BYTE_ORDER_MARK;
+    header.smoothingWidth = m_smoothingWidth;
+
+    if (!m_file.resize(0) || !m_file.seek(0)
+        || m_file.write(reinterpret_cast<const char *>(&header), sizeof(header)) != sizeof(header)
+        || !m_file.flush()) {
+        warningMs() << "Cannot write centroid cache" << m_file.fileName() << m_file.errorString();
+        return kFileIoError;
+    }
+
+    m_fileSize = sizeof(FileHeader);
+    return map() ? kNoErr : kFileIoError;
 }
 
-void MSCentroidCache::setScanCache(long scanNumber, const point2dList & points)
+Err MSCentroidCache::readIndex()
 {
-    m_scanNumber_points.insert(scanNumber, points);
+    m_index.clear();
+
+    if (m_fileSize < static_cast<qint64>(sizeof(FileHeader)) || !map()) {
+        return kFileIntegrityError;
+    }
+
+    const FileHeader *header = reinterpret_cast<const FileHeader *>(m_data);
+    if (std::memcmp(header->magic, FILE_MAGIC, sizeof(FILE_MAGIC)) != 0
+        || header->version != FILE_VERSION
+        || header->headerSize != sizeof(FileHeader)
+        || header->byteOrderMark != BYTE_ORDER_MARK
+        || header->smoothingWidth != m_smoothingWidth) {
+        return kFileIntegrityError;
+    }
+
+    qint64 offset = sizeof(FileHeader);
+    while (m_fileSize - offset >= static_cast<qint64>(sizeof(RecordHeader))) {
+        const RecordHeader *record = reinterpret_cast<const RecordHeader *>(m_data + offset);
+        const quint64 maxPointCount = (m_fileSize - offset - sizeof(RecordHeader)) / (2 * sizeof(double));
+        if (record->pointCount > maxPointCount) {
+            break;
+        }
+        m_index.insert(static_cast<long>(record->scanNumber), offset);
+        offset += recordSize(record->pointCount);
+    }
+
+    // drop the record the last session did not finish
+    if (offset != m_fileSize) {
+        warningMs() << "Truncating incomplete centroid cache" << m_file.fileName() << "at" << offset;
+        unmap();
+        if (!m_file.resize(offset)) {
+            return kFileIoError;
+        }
+        m_fileSize = offset;
+        if (!map()) {
+            return kFileIoError;
+        }
+    }
+
+    return kNoErr;
+}
+
+bool MSCentroidCache::map()
+{
+    unmap();
+    m_data = m_file.map(0, m_fileSize);
+    if (!m_data) {
+        warningMs() << "Cannot map centroid cache" << m_file.fileName() << m_file.errorString();
+        return false;
+    }
+    m_mappedSize = m_fileSize;
+    return true;
 }
 
-bool MSCentroidCache::isCached(long scanNumber) const {
-    return m_scanNumber_points.contains(scanNumber);
+void MSCentroidCache::unmap()
+{
+    if (m_data) {
+        m_file.unmap(m_data);
+        m_data = nullptr;
+    }
+    m_mappedSize = 0;
 }
 
-QHash<long, point2dList>::const_iterator MSCentroidCache::getCacheIt(long scanNumber, bool * found) const {
-    *found = false;
+bool MSCentroidCache::find(long scanNumber, point2dList *points)
+{
+    Q_ASSERT(points);
+
+    const point2dList *cached = m_memory.object(scanNumber);
+    if (cached) {
+        *points = *cached;
+        return true;
+    }
+
+    const auto it = m_index.constFind(scanNumber);
+    if (it == m_index.constEnd()) {
+        return false;
+    }
+
+    // records appended since the file was mapped
+    const qint64 offset = it.value();
+    if (offset >= m_mappedSize && (!m_file.flush() || !map())) {
+        return false;
+    }
 
-    QHash<long, point2dList>::const_iterator returnIt = m_scanNumber_points.find(scanNumber);
-    if (returnIt != m_scanNumber_points.end()) {
-        *found = true;
+    const RecordHeader *record = reinterpret_cast<const RecordHeader *>(m_data + offset);
+    const double *mz = reinterpret_cast<const double *>(record + 1);
+    const double *intensity = mz + record->pointCount;
+
+    points->clear();
+    points->reserve(record->pointCount);
+    for (quint64 i = 0; i < record->pointCount; ++i) {
+        points->push_back(point2d(mz[i], intensity[i]));
     }
-    return returnIt;
+
+    m_memory.insert(scanNumber, new point2dList(*points), memoryCost(*points));
+    return true;
 }
 
-bool MSCentroidCache::isValidIt(QHash<long, point2dList>::const_iterator it) const {
-    bool returnVal = false;
+Err MSCentroidCache::insert(long scanNumber, const point2dList &points)
+{
+    m_memory.insert(scanNumber, new point2dList(points), memoryCost(points));
 
-    if (it != m_scanNumber_points.end()) {
-        returnVal = true;
+    if (!m_file.isOpen() || m_index.contains(scanNumber)) {
+        return kNoErr;
     }
-    return returnVal;
+
+    QByteArray block(static_cast<int>(recordSize(points.size())), Qt::Uninitialized);
+    RecordHeader *record = reinterpret_cast<RecordHeader *>(block.data());
+    record->scanNumber = scanNumber;
+    record->pointCount = points.size();
+    double *mz = reinterpret_cast<double *>(record + 1);
+    double *intensity = mz + points.size();
+    for (const point2d &point : points) {
+        *mz++ = point.x();
+        *intensity++ = point.y();
+    }
+
+    if (!m_file.seek(m_fileSize) || m_file.write(block) != block.size()) {
+        warningMs() << "Cannot write centroid cache" << m_file.fileName() << m_file.errorString();
+        // keep the file readable, the scan is centroided again next session
+        unmap();
+        m_file.resize(m_fileSize);
+        return kFileIoError;
+    }
+
+    m_index.insert(scanNumber, m_fileSize);
+    m_fileSize += block.size();
+    return kNoErr;
+}
+
+void MSCentroidCache::setMemoryLimit(int bytes)
+{
+    m_memory.setMaxCost(bytes);
+}
+
+int MSCentroidCache::memoryLimit() const
+{
+    return m_memory.maxCost();
 }
 
 _PMI_END
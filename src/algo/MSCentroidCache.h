@@ -1,34 +1,88 @@
+/*
+ * Copyright (C) 2019 Protein Metrics Inc. - All Rights Reserved.
+ * Unauthorized copying or distribution of this file, via any medium is strictly prohibited.
+ * Confidential.
+ */
+
 #ifndef MSCENTROIDCACHE_H
 #define MSCENTROIDCACHE_H
 
 #include "common_errors.h"
 #include "common_math_types.h"
 #include "pmi_common_ms_export.h"
-#include "config-pmi_qt_common.h"
 
+#include <QCache>
+#include <QFile>
 #include <QHash>
 
 _PMI_BEGIN
 
-//! @internal
-class MSCentroidCache
+/*!
+ * \brief Persistent cache of custom centroided scans of one MS file
+ *
+ * The cache file is created next to the other cache files of the MS file (see cacheSuffix()). It
+ * holds a header with the smoothing width the scans were centroided with, followed by records
+ * appended in the order the scans were centroided. Every record is the scan number, the point
+ * count, the m/z column and the intensity column. The file is memory mapped, so opening it only
+ * walks the record headers; a record cut short by a crash is dropped.
+ *
+ * Recently used scans are kept in memory up to memoryLimit() bytes.
+ *
+ * If no file is open, the cache keeps the scans in memory only. Not thread safe.
+ */
+class PMI_COMMON_MS_EXPORT MSCentroidCache
 {
 public:
     MSCentroidCache();
+    ~MSCentroidCache();
+
+    //! \brief cache file name suffix for CacheFileManager::findOrCreateCachePath
+    static QString cacheSuffix(double smoothingWidth);
+
+    /*!
+     * \brief opens or creates the cache file at @a filePath
+     *
+     * A file centroided with other smoothing width, written by other platform or otherwise invalid
+     * is replaced by an empty one.
+     */
+    Err open(const QString &filePath, double smoothingWidth);
+    void close();
+    bool isOpen() const;
+    QString filePath() const;
+
+    double smoothingWidth() const;
+
+    //! \brief number of scans in the cache file
+    int count() const;
 
-    void clear();
+    //! \brief sets @a points to the cached scan, @return false if @a scanNumber is not cached
+    bool find(long scanNumber, point2dList *points);
 
-    void setScanCache(long scanNumber, const point2dList & points);
-    bool isCached(long scanNumber) const;
-    QHash<long, point2dList>::const_iterator getCacheIt(long scanNumber, bool * found) const;
-    bool isValidIt(QHash<long, point2dList>::const_iterator) const;
-    //point2dList getCache(long scanNumber, bool * found) const;
+    //! \brief adds the scan to the memory and appends it to the file
+    Err insert(long scanNumber, const point2dList &points);
+
+    //! \brief size of the in-memory front in bytes, 256 MB by default
+    void setMemoryLimit(int bytes);
+    int memoryLimit() const;
 
-    int getScanCacheSize() const {
-        return m_scanNumber_points.size();
-    }
 private:
-    QHash<long, point2dList> m_scanNumber_points;
+    Q_DISABLE_COPY(MSCentroidCache)
+
+    Err createFile();
+    Err readIndex();
+    bool map();
+    void unmap();
+
+private:
+    QFile m_file;
+    uchar *m_data = nullptr;
+    qint64 m_mappedSize = 0;
+    qint64 m_fileSize = 0;
+    double m_smoothingWidth = 0.0;
+
+    //! scan number -> offset of the record in the file
+    QHash<long, qint64> m_index;
+    QCache<long, point2dList> m_memory;
 };
 
 _PMI_END
@@ -7,17 +7,22 @@
 */
 
 #include "MSMultiSampleTimeWarp.h"
+#include "MSMultiSampleTimeWarpUtils.h"
 
 #include <algorithm>
+#include <numeric>
 
 #include <MSReader.h>
 #include <ProgressContext.h>
 
+#include <QThread>
+
 _PMI_BEGIN
 
 MSMultiSampleTimeWarp::MSMultiSampleTimeWarp()
     : m_centralPlot(-1)
     , m_samplesPerMinute(2.0)
+    , m_threadCount(0)
 {
     
 }
@@ -70,7 +75,9 @@ Err MSMultiSampleTimeWarp::constructTimeWarp(const QVector<QString> &msFilenames
     ProgressContext progressContext(taskCount, progress);
     progressContext.setText("Constructing time warp");
 
-    // read all plots
+    const int threadCount = (m_threadCount > 0) ? m_threadCount : QThread::idealThreadCount();
+
+    // read all plots, MSReader is only used from the calling thread
     for (int i = 0; i < static_cast<int>(msFilenames.size()); i++) {
         e = loadAlignableDataFromSample(msFilenames[i], msFileIDs[i]); ree;
         ++progressContext;
@@ -81,18 +88,20 @@ Err MSMultiSampleTimeWarp::constructTimeWarp(const QVector<QString> &msFilenames
     ++progressContext;
 
     // decide which plot should be used for time warping
-    e = decideCentralPlot(&m_centralPlot); ree;
+    e = decideCentralPlot(threadCount, &m_centralPlot); ree;
     ++progressContext;
 
     // Create time warps for all samples except m_centralPlot.
     m_timeWarps.resize(m_basePeakPlots.size());
+    QVector<int> targetPlots;
     for (int i = 0; i < static_cast<int>(m_basePeakPlots.size()); i++) {
-        if (i == m_centralPlot) {
-            continue;
+        if (i != m_centralPlot) {
+            targetPlots.push_back(i);
         }
-        e = produceTimeWarp(i, &m_timeWarps[i]); ree;
-        ++progressContext;
     }
+    e = runIndexedTasks(targetPlots, threadCount,
+                        [this](int i) { return produceTimeWarp(i, &m_timeWarps[i]); },
+                        &progressContext); ree;
 
     return e;
 }
@@ -202,6 +211,16 @@ Err MSMultiSampleTimeWarp::warp(const QString &msFilename, double t, double *tWa
     return e;
 }
 
+int MSMultiSampleTimeWarp::threadCount() const
+{
+    return m_threadCount;
+}
+
+void MSMultiSampleTimeWarp::setThreadCount(int threadCount)
+{
+    m_threadCount = threadCount;
+}
+
 Err MSMultiSampleTimeWarp::loadAlignableDataFromSample(const QString &filename, const MSID &machineFileID)
 {
     Err e = kNoErr;
@@ -286,22 +305,13 @@ Err MSMultiSampleTimeWarp::resample()
     return e;
 }
 
-Err MSMultiSampleTimeWarp::decideCentralPlot(int *centralPlot) const
+Err MSMultiSampleTimeWarp::decideCentralPlot(int threadCount, int *centralPlot) const
 {
     Err e = kNoErr;
 
     // calculate total dot similarity of each plot with all the other plots
-    std::vector<double> dot(m_uniformPlots.size(), 0.0);
-    for (int i = 0; i < static_cast<int>(m_uniformPlots.size()); i++) {
-        const QVector<double> &a = m_uniformPlots[i];
-        for (int j = 0; j < static_cast<int>(m_uniformPlots.size()); j++) {
-            if (i == j) {
-                continue;
-            }
-            const QVector<double> &b = m_uniformPlots[j];
-            dot[i] += std::inner_product(a.begin(), a.end(), b.begin(), 0.0);
-        }
-    }
+    const std::vector<double> dot
+        = totalSimilarity(dotSimilarityMatrix(m_uniformPlots, threadCount));
 
     *centralPlot
         = static_cast<int>(std::distance(dot.begin(), std::max_element(dot.begin(), dot.end())));
@@ -113,10 +113,22 @@ public:
     */
     Err warp(const QString &msFilename, double t, double *tWarped) const;
 
+    /*! \brief Gets the number of threads used by constructTimeWarp. */
+    int threadCount() const;
+
+    /*!
+        \brief Sets the number of threads used by constructTimeWarp. 0 (default) means
+            QThread::idealThreadCount().
+            The samples are always read through MSReader on the calling thread. With more than
+            one thread the similarity of the plots and the time warps are computed on a thread
+            pool; the result does not depend on the thread count.
+    */
+    void setThreadCount(int threadCount);
+
 private:
     Err loadAlignableDataFromSample(const QString &filename, const MSID &machineFileID);
     Err resample();
-    Err decideCentralPlot(int *centralTIC) const;
+    Err decideCentralPlot(int threadCount, int *centralTIC) const;
     Err produceTimeWarp(int targetPlotIndex, TimeWarp *outputWarp) const;
     double samplePeriod() const;
 
@@ -132,6 +144,7 @@ private:
     int m_centralPlot;
     const double m_samplesPerMinute; // for resampled plots
     QVector<QVector<double> > m_uniformPlots;
+    int m_threadCount;
 };
 
 _PMI_END
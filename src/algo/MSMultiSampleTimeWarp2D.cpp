@@ -7,12 +7,16 @@
  */
 
 #include "MSMultiSampleTimeWarp2D.h"
+#include "MSMultiSampleTimeWarpUtils.h"
 
 #include <algorithm>
+#include <numeric>
 
 #include <MSReader.h>
 #include <ProgressContext.h>
 
+#include <QThread>
+
 _PMI_BEGIN
 
 // Default settings
@@ -26,6 +30,7 @@ MSMultiSampleTimeWarp2D::MSMultiSampleTimeWarp2D()
     , m_mzMatchPpm(MZ_MATCH_PPM_DEFAULT)
     , m_mzWindowToExtractMaxima(MZ_WINDOW_TO_EXTRACT_MAXIMA_DEFAULT)
     , m_mzIntensityPairCount(MZ_INTENSITY_PAIR_COUNT_DEFAULT)
+    , m_threadCount(0)
 {
 }
 
@@ -85,7 +90,9 @@ Err MSMultiSampleTimeWarp2D::constructTimeWarp(const QVector<QString> &msFilenam
     progressContext.setText("Constructing time warp");
 
 
-    // read all plots
+    const int threadCount = (m_threadCount > 0) ? m_threadCount : QThread::idealThreadCount();
+
+    // read all plots, MSReader is only used from the calling thread
     for (int i = 0; i < static_cast<int>(msFilenames.size()); i++) {
         e = loadAlignableDataFromSample(msFilenames[i], msFileIDs[i]); ree;
         ++progressContext;
@@ -96,19 +103,26 @@ Err MSMultiSampleTimeWarp2D::constructTimeWarp(const QVector<QString> &msFilenam
     ++progressContext;
 
     // decide which plot should be used for time warping
-    e = decideCentralPlot(&m_centralPlot); ree;
+    e = decideCentralPlot(threadCount, &m_centralPlot); ree;
     ++progressContext;
 
     // Create time warps for all samples except m_centralPlot.
     m_timeWarps.resize(m_timedWarpElementLists.size());
+    QVector<int> targetPlots;
     for (int i = 0; i < static_cast<int>(m_timedWarpElementLists.size()); i++) {
-        if (i == m_centralPlot) {
-            continue;
+        if (i != m_centralPlot) {
+            targetPlots.push_back(i);
         }
-        e = produceTimeWarp(i, &m_timeWarps[i]); ree;
-        ++progressContext;
     }
 
+    // threads left over when there are fewer warps than threads are used by the warps themselves
+    const int warpThreadCount = std::max(1, threadCount / std::max(1, targetPlots.size()));
+    e = runIndexedTasks(targetPlots, threadCount,
+                        [this, warpThreadCount](int i) {
+                            return produceTimeWarp(i, warpThreadCount, &m_timeWarps[i]);
+                        },
+                        &progressContext); ree;
+
     return e;
 }
 
@@ -223,6 +237,16 @@ QString MSMultiSampleTimeWarp2D::pivotFilename() const
     return m_msFilenames[m_centralPlot];
 }
 
+int MSMultiSampleTimeWarp2D::threadCount() const
+{
+    return m_threadCount;
+}
+
+void MSMultiSampleTimeWarp2D::setThreadCount(int threadCount)
+{
+    m_threadCount = threadCount;
+}
+
 Err MSMultiSampleTimeWarp2D::loadAlignableDataFromSample(const QString &filename, const MSID &machineFileID)
 {
     Err e = kNoErr;
@@ -324,25 +348,29 @@ Err MSMultiSampleTimeWarp2D::resample()
     return e;
 }
 
-Err MSMultiSampleTimeWarp2D::decideCentralPlot(int *centralPlot) const
+Err MSMultiSampleTimeWarp2D::decideCentralPlot(int threadCount, int *centralPlot) const
 {
     Err e = kNoErr;
 
     // calculate total dot similarity of each plot with all the other plots
     // TODO: Try to minimize WarpElement penalty instead
+    QVector<QVector<double>> intensities(static_cast<int>(m_uniformPlots.size()));
+    for (int i = 0; i < static_cast<int>(m_uniformPlots.size()); i++) {
+        for (const WarpElement &element : m_uniformPlots[i]) {
+            intensities[i].push_back(element.intensity());
+        }
+    }
+    const std::vector<std::vector<double>> similarity
+        = dotSimilarityMatrix(intensities, threadCount);
+
+    // the score of a plot is its similarity with the last other plot
     std::vector<double> dot(m_uniformPlots.size(), 0.0);
-    
     for (int i = 0; i < static_cast<int>(m_uniformPlots.size()); i++) {
-        const WarpElementList &a = m_uniformPlots[i];
         for (int j = 0; j < static_cast<int>(m_uniformPlots.size()); j++) {
             if (i == j) {
                 continue;
             }
-            const WarpElementList &b = m_uniformPlots[j];
-            dot[i] = 0.0;
-            for (int j = 0; j < static_cast<int>(a.size()) && j < static_cast<int>(b.size()); j++) {
-                dot[i] += a[j].intensity() * b[j].intensity();
-            }
+            dot[i] = similarity[i][j];
         }
     }
 
@@ -352,7 +380,8 @@ Err MSMultiSampleTimeWarp2D::decideCentralPlot(int *centralPlot) const
     return e;
 }
 
-Err MSMultiSampleTimeWarp2D::produceTimeWarp(int targetPlotIndex, TimeWarp2D *outputWarp) const
+Err MSMultiSampleTimeWarp2D::produceTimeWarp(int targetPlotIndex, int warpThreadCount,
+                                             TimeWarp2D *outputWarp) const
 {
     Err e = kNoErr;
 
@@ -405,6 +434,7 @@ Err MSMultiSampleTimeWarp2D::produceTimeWarp(int targetPlotIndex, TimeWarp2D *ou
     // warp
     TimeWarp2D::TimeWarpOptions options;
     options.mzMatchPpm = m_mzMatchPpm;
+    options.threadCount = warpThreadCount;
     outputWarp->clear();
     e = outputWarp->constructWarp(plotA, plotB, options); ree;
 
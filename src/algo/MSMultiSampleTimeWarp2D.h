@@ -115,11 +115,23 @@ public:
     /*! \brief Get the filename of the central sample (used as pivot). */
     QString pivotFilename() const;
 
+    /*! \brief Gets the number of threads used by constructTimeWarp. */
+    int threadCount() const;
+
+    /*!
+        \brief Sets the number of threads used by constructTimeWarp. 0 (default) means
+            QThread::idealThreadCount().
+            The samples are always read through MSReader on the calling thread. With more than
+            one thread the similarity of the plots and the time warps are computed on a thread
+            pool; the result does not depend on the thread count.
+    */
+    void setThreadCount(int threadCount);
+
 private:
     Err loadAlignableDataFromSample(const QString &filename, const MSID &machineFileID);
     Err resample();
-    Err decideCentralPlot(int *cantralPlot) const;
-    Err produceTimeWarp(int targetPlotIndex, TimeWarp2D *outputWarp) const;
+    Err decideCentralPlot(int threadCount, int *cantralPlot) const;
+    Err produceTimeWarp(int targetPlotIndex, int warpThreadCount, TimeWarp2D *outputWarp) const;
     double samplePeriod() const;
     Err fileIndex(const MSID &msid, int *outputFileIndex) const;
 
@@ -135,6 +147,7 @@ private:
     double m_mzMatchPpm;
     double m_mzWindowToExtractMaxima;
     int m_mzIntensityPairCount; // 0 for legacy (intensity only)
+    int m_threadCount;
 };
 
 _PMI_END
@@ -0,0 +1,110 @@
+/*
+ * Copyright (C) 2019 Protein Metrics Inc. - All Rights Reserved.
+ * Unauthorized copying or distribution of this file, via any medium is strictly prohibited.
+ * Confidential.
+ */
+
+#include "MSMultiSampleTimeWarpUtils.h"
+
+#include <ProgressContext.h>
+
+#include <QFuture>
+#include <QThreadPool>
+#include <QtConcurrent>
+
+#include <algorithm>
+#include <numeric>
+
+_PMI_BEGIN
+
+std::vector<std::vector<double>> dotSimilarityMatrix(const QVector<QVector<double>> &plots,
+                                                     int threadCount)
+{
+    const int plotCount = static_cast<int>(plots.size());
+    std::vector<std::vector<double>> similarity(plotCount, std::vector<double>(plotCount, 0.0));
+
+    auto computeRow = [&plots, &similarity, plotCount](int i) {
+        const QVector<double> &a = plots[i];
+        for (int j = i + 1; j < plotCount; j++) {
+            const QVector<double> &b = plots[j];
+            const int size = std::min(a.size(), b.size());
+            similarity[i][j] = std::inner_product(a.begin(), a.begin() + size, b.begin(), 0.0);
+        }
+    };
+
+    if (threadCount <= 1) {
+        for (int i = 0; i < plotCount; i++) {
+            computeRow(i);
+        }
+    } else {
+        QThreadPool pool;
+        pool.setMaxThreadCount(threadCount);
+        QVector<QFuture<void>> rows;
+        for (int i = 0; i < plotCount; i++) {
+            rows.push_back(QtConcurrent::run(&pool, [&computeRow, i]() { computeRow(i); }));
+        }
+        for (QFuture<void> &row : rows) {
+            row.waitForFinished();
+        }
+    }
+
+    // a * b == b * a, so the lower triangle is a copy of the upper one
+    for (int i = 0; i < plotCount; i++) {
+        for (int j = 0; j < i; j++) {
+            similarity[i][j] = similarity[j][i];
+        }
+    }
+
+    return similarity;
+}
+
+std::vector<double> totalSimilarity(const std::vector<std::vector<double>> &similarity)
+{
+    const int plotCount = static_cast<int>(similarity.size());
+    std::vector<double> total(plotCount, 0.0);
+    for (int i = 0; i < plotCount; i++) {
+        for (int j = 0; j < plotCount; j++) {
+            if (i == j) {
+                continue;
+            }
+            total[i] += similarity[i][j];
+        }
+    }
+
+    return total;
+}
+
+Err runIndexedTasks(const QVector<int> &indices, int threadCount,
+                    const std::function<Err(int)> &task, ProgressContext *progressContext)
+{
+    Err e = kNoErr;
+
+    if (threadCount <= 1) {
+        for (int index : indices) {
+            e = task(index); ree;
+            ++(*progressContext);
+        }
+        return e;
+    }
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(threadCount);
+
+    QVector<QFuture<Err>> futures;
+    for (int index : indices) {
+        futures.push_back(QtConcurrent::run(&pool, [&task, index]() { return task(index); }));
+    }
+
+    for (QFuture<Err> &future : futures) {
+        if (e == kNoErr) {
+            e = future.result();
+        } else {
+            future.waitForFinished();
+        }
+        ++(*progressContext);
+    }
+
+    return e;
+}
+
+_PMI_END
@@ -0,0 +1,48 @@
+/*
+ * Copyright (C) 2019 Protein Metrics Inc. - All Rights Reserved.
+ * Unauthorized copying or distribution of this file, via any medium is strictly prohibited.
+ * Confidential.
+ */
+
+#ifndef __MS_MULTI_SAMPLE_TIME_WARP_UTILS_H__
+#define __MS_MULTI_SAMPLE_TIME_WARP_UTILS_H__
+
+#include <QVector>
+
+#include <pmi_common_ms_export.h>
+#include <common_errors.h>
+#include <pmi_core_defs.h>
+
+#include <functional>
+#include <vector>
+
+_PMI_BEGIN
+
+class ProgressContext;
+
+/*!
+    \brief Returns the symmetric matrix of dot products of every pair of plots, the diagonal is 0.
+        Rows of the upper triangle are computed on \a threadCount threads. Every product is
+        accumulated in the same order on any thread count, so the result does not depend on it.
+*/
+PMI_COMMON_MS_EXPORT std::vector<std::vector<double>>
+dotSimilarityMatrix(const QVector<QVector<double>> &plots, int threadCount);
+
+/*! \brief Sums the similarity of each plot with all the other plots, in the order of the plots. */
+PMI_COMMON_MS_EXPORT std::vector<double>
+totalSimilarity(const std::vector<std::vector<double>> &similarity);
+
+/*!
+    \brief Runs \a task for every index of \a indices on \a threadCount threads, or on the calling
+        thread when \a threadCount is 1 or less. \a progressContext is advanced once per task in
+        the order of \a indices.
+        Returns the first error in the order of \a indices. On the calling thread the tasks stop
+        at the first error; on the pool every task runs and all of them finish before returning.
+*/
+PMI_COMMON_MS_EXPORT Err runIndexedTasks(const QVector<int> &indices, int threadCount,
+                                         const std::function<Err(int)> &task,
+                                         ProgressContext *progressContext);
+
+_PMI_END
+
+#endif // __MS_MULTI_SAMPLE_TIME_WARP_UTILS_H__
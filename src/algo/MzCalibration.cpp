@@ -4,15 +4,21 @@
 #include "QtSqlUtils.h"
 #include "pmi_common_ms_debug.h"
 
+#include "PlotBaseUtils.h"
+
 #ifdef PMI_MS_MZCALIBRATION_USE_MSREADER_TO_READ
 #include "vendor/MSReaderByspec.h"
 #include "MSReader.h"
-#include "PlotBaseUtils.h"
 #endif
 
 #include <CacheFileManager.h>
 #include <PmiQtCommonConstants.h>
 
+#include <QQueue>
+#include <QThread>
+#include <QThreadPool>
+#include <QtConcurrent/QtConcurrentRun>
+
 using namespace std;
 
 _PMI_BEGIN
@@ -137,6 +143,139 @@ point2d largest(const point2dList & plist) {
     return p;
 }
 
+namespace {
+
+//! lock mass peak of one scan
+struct LockMassPeak {
+    Err e = kNoErr;
+    bool found = false;
+    point2d time_diff;
+};
+
+//! @param centroid profile scans are centroided first
+LockMassPeak findLockMassPeak(double scanTime, PlotBase &plot_scan, bool centroid,
+                              double lockMassMz, double minMz, double maxMz)
+{
+    LockMassPeak peak;
+
+    if (centroid) {
+        PlotBase centroidPlot;
+        peak.e = gaussianSmooth(plot_scan, 0.03);
+        if (peak.e != kNoErr) {
+            return peak;
+        }
+        plot_scan.makeCentroidedPoints(&centroidPlot.getPointList());
+        plot_scan = centroidPlot;
+    }
+
+    const point2dList plist = plot_scan.getPointsBetween(minMz, maxMz, true);
+    if (plist.size() > 0) {
+        //Note: these are already centroided peaks.  This will still work if it's in profile, but probably we want properly centroied points here.
+        const point2d lockMassPoint = largest(plist);
+        peak.found = true;
+        peak.time_diff.rx() = scanTime;
+        peak.time_diff.ry() = lockMassPoint.x() - lockMassMz;
+    }
+    return peak;
+}
+
+/*!
+ * \brief Finds lock mass peaks of scans on a thread pool while the scans are being read
+ *
+ * The reading thread adds scans in scan order. At most CHUNKS_PER_THREAD scans per thread are in
+ * flight; the peaks are taken in the order the scans were added, so the recalibration plot does
+ * not depend on the thread count or on the order the workers finish in.
+ */
+class LockMassPeakFinder
+{
+public:
+    LockMassPeakFinder(double lockMassMz, double ppmTolerance, int threadCount)
+        : m_lockMassMz(lockMassMz)
+        , m_threadCount(threadCount > 0 ? threadCount : QThread::idealThreadCount())
+    {
+        const double mzTolerance = lockMassMz / 1000000 * ppmTolerance;
+        m_minMz = lockMassMz - mzTolerance;
+        m_maxMz = lockMassMz + mzTolerance;
+        m_pool.setMaxThreadCount(m_threadCount);
+    }
+
+    ~LockMassPeakFinder()
+    {
+        // scans in flight after an error
+        m_pool.waitForDone();
+    }
+
+    //! \brief takes the points of @a plot_scan
+    Err add(double scanTime, PlotBase *plot_scan, bool centroid)
+    {
+        Err e = kNoErr;
+
+        if (m_threadCount <= 1) {
+            return takePeak(findLockMassPeak(scanTime, *plot_scan, centroid, m_lockMassMz, m_minMz,
+                                             m_maxMz));
+        }
+
+        if (m_pending.size() >= m_threadCount * CHUNKS_PER_THREAD) {
+            e = takePeak(m_pending.dequeue().result()); ree;
+        }
+
+        QSharedPointer<PlotBase> scan(new PlotBase);
+        scan->getPointList().swap(plot_scan->getPointList());
+        const double lockMassMz = m_lockMassMz;
+        const double minMz = m_minMz;
+        const double maxMz = m_maxMz;
+        m_pending.enqueue(QtConcurrent::run(&m_pool, [=]() {
+            return findLockMassPeak(scanTime, *scan, centroid, lockMassMz, minMz, maxMz);
+        }));
+
+        return e;
+    }
+
+    //! \brief waits for the scans in flight
+    Err finish()
+    {
+        Err e = kNoErr;
+        while (!m_pending.isEmpty()) {
+            e = takePeak(m_pending.dequeue().result()); ree;
+        }
+        return e;
+    }
+
+    const PlotBase &plot_recal() const { return m_plot_recal; }
+    int found_peak_count() const { return m_found_peak_count; }
+    int total_peak_count() const { return m_total_peak_count; }
+
+private:
+    Err takePeak(const LockMassPeak &peak)
+    {
+        Err e = peak.e; ree;
+
+        m_total_peak_count++;
+        if (peak.found) {
+            m_found_peak_count++;
+            m_plot_recal.addPoint(peak.time_diff);
+        }
+        return e;
+    }
+
+private:
+    static const int CHUNKS_PER_THREAD = 4;
+
+    const double m_lockMassMz;
+    double m_minMz;
+    double m_maxMz;
+    const int m_threadCount;
+
+    QThreadPool m_pool;
+    QQueue<QFuture<LockMassPeak>> m_pending;
+
+    PlotBase m_plot_recal;
+    int m_found_peak_count = 0;
+    int m_total_peak_count = 0;
+};
+
+}
+
 Err printDebugCal_same_length(QString filename, QList<PlotBase> & list, QStringList titles) {
     Err e = kNoErr;
     if (list.size() <= 0)
@@ -283,18 +422,147 @@ error:
 }
 
 
+//////////////////////////////////////////////////////
+// MzScanCalibration
+//////////////////////////////////////////////////////
+
+namespace {
+
+// The operations are done in the order of MzCalibration::calibrate(mz, time) to get the same
+// values. The loops over points have no dependencies and no calls, so they are vectorized.
+
+template <int N>
+inline double polynomialDelta(const double *coefficients, double mz)
+{
+    double mz_delta_total = 0;
+    double x = 1;
+    for (int i = 0; i < N; i++) {
+        mz_delta_total += coefficients[i] * x;
+        x = x * mz;
+    }
+    return mz_delta_total;
+}
+
+inline double polynomialDelta(const double *coefficients, int count, double mz)
+{
+    double mz_delta_total = 0;
+    double x = 1;
+    for (int i = 0; i < count; i++) {
+        mz_delta_total += coefficients[i] * x;
+        x = x * mz;
+    }
+    return mz_delta_total;
+}
+
+template <int N>
+void applyPolynomial(const double *coefficients, double *mz, int count)
+{
+    for (int i = 0; i < count; i++) {
+        const double value = mz[i];
+        mz[i] = value > 0 ? value - polynomialDelta<N>(coefficients, value) : value;
+    }
+}
+
+template <int N>
+void applyPolynomial(const double *coefficients, point2dList &plist)
+{
+    for (point2d &p : plist) {
+        const double value = p.x();
+        p.rx() = value > 0 ? value - polynomialDelta<N>(coefficients, value) : value;
+    }
+}
+
+}
+
+bool MzScanCalibration::isIdentity() const
+{
+    return !m_usePpm && m_coefficients.isEmpty();
+}
+
+void MzScanCalibration::apply(double *mz, int count) const
+{
+    if (m_usePpm) {
+        const double ppmError = m_ppmError;
+        for (int i = 0; i < count; i++) {
+            const double value = mz[i];
+            mz[i] = value > 0 ? value - value * ppmError : value;
+        }
+        return;
+    }
+
+    const double *coefficients = m_coefficients.constData();
+    switch (m_coefficients.size()) {
+    case 0:
+        break;
+    case 1:
+        applyPolynomial<1>(coefficients, mz, count);
+        break;
+    case 2:
+        applyPolynomial<2>(coefficients, mz, count);
+        break;
+    case 3:
+        applyPolynomial<3>(coefficients, mz, count);
+        break;
+    default:
+        for (int i = 0; i < count; i++) {
+            const double value = mz[i];
+            if (value > 0) {
+                mz[i] = value - polynomialDelta(coefficients, m_coefficients.size(), value);
+            }
+        }
+        break;
+    }
+}
+
+void MzScanCalibration::apply(point2dList &plist) const
+{
+    if (m_usePpm) {
+        const double ppmError = m_ppmError;
+        for (point2d &p : plist) {
+            const double value = p.x();
+            p.rx() = value > 0 ? value - value * ppmError : value;
+        }
+        return;
+    }
+
+    const double *coefficients = m_coefficients.constData();
+    switch (m_coefficients.size()) {
+    case 0:
+        break;
+    case 1:
+        applyPolynomial<1>(coefficients, plist);
+        break;
+    case 2:
+        applyPolynomial<2>(coefficients, plist);
+        break;
+    case 3:
+        applyPolynomial<3>(coefficients, plist);
+        break;
+    default:
+        for (point2d &p : plist) {
+            const double value = p.x();
+            if (value > 0) {
+                p.rx() = value - polynomialDelta(coefficients, m_coefficients.size(), value);
+            }
+        }
+        break;
+    }
+}
+
 //////////////////////////////////////////////////////
 // MzCalibration
 //////////////////////////////////////////////////////
 
 MzCalibration::MzCalibration()
     : m_cacheFileManager(nullptr)
+    , m_threadCount(0)
 {
     clear();
 }
 
 MzCalibration::MzCalibration(const CacheFileManagerInterface &cacheFileManager)
     : m_cacheFileManager(&cacheFileManager)
+    , m_threadCount(0)
 {
     clear();
 }
@@ -346,10 +614,32 @@ void MzCalibration::calibrate(double time, PlotBase & plot) const
 
 void MzCalibration::calibrate(double time, point2dList & plist) const
 {
-    for (int i = 0; i < (int)plist.size(); i++) {
-        point2d & p = plist[i];
-        p.rx() = calibrate(p.x(), time);
+    scanCalibration(time).apply(plist);
+}
+
+MzScanCalibration MzCalibration::scanCalibration(double time) const
+{
+    static int use_boundary_value = 1;
+    static int interpolate = 1;
+
+    MzScanCalibration result;
+    if (m_coeffList.size() <= 0) {
+        return result;
     }
+
+    // same choice as calibrate(mz, time)
+    if (m_options.lock_mass_use_ppm_for_one_point && m_coeffList.size() == 1 && m_lockmass_single_point > 0) {
+        double coeff0_aka_constant_offset = m_coeffList[0].evaluate(time, interpolate, use_boundary_value);
+        result.m_usePpm = true;
+        result.m_ppmError = coeff0_aka_constant_offset / m_lockmass_single_point;
+        return result;
+    }
+
+    result.m_coefficients.reserve(m_coeffList.size());
+    for (int i = 0; i < m_coeffList.size(); i++) {
+        result.m_coefficients.push_back(m_coeffList[i].evaluate(time, interpolate, use_boundary_value));
+    }
+    return result;
 }
 
 Err MzCalibration::readFromDB(QString filename, int filesId)
@@ -746,9 +1036,6 @@ Err MzCalibration::computeCoefficientsFromScanList(MSReader * ms, const QList<ms
     PlotBase plot_scan;
     const double lockMassMz = massList.first();
     const double ppmTolerance = m_options.ppmTolerance().toDouble();
-    double mzTolerance = lockMassMz / 1000000 * ppmTolerance;
-    double minMz = lockMassMz - mzTolerance;
-    double maxMz = lockMassMz + mzTolerance;
     const QList<msreader::ScanInfoWrapper> list = _list;
     int list_increment = 1;
 
@@ -762,29 +1049,24 @@ Err MzCalibration::computeCoefficientsFromScanList(MSReader * ms, const QList<ms
         if (list_increment <= 0) list_increment = 1;
     }
     int found_peak_count = 0, total_peak_count = 0;
+
+    // MSReader is used from this thread only, peaks are found by the finder's workers
+    LockMassPeakFinder finder(lockMassMz, ppmTolerance, m_threadCount);
     for (int i = 0; i < list.size(); i += list_increment) {
         const msreader::ScanInfoWrapper & obj = list[i];
 
         plot_scan.clear();
         double scanTime = obj.scanInfo.retTimeMinutes;
-        point2d lockMassPoint;
-        point2dList plist;
 
         bool do_centroding = true;
         e = ms->getScanData(obj.scanNumber, &plot_scan.getPointList(), do_centroding, NULL); eee;
-        plist = plot_scan.getPointsBetween(minMz, maxMz, true);
-
-        total_peak_count++;
-        if (plist.size() > 0 ) {
-            found_peak_count++;
-            //Note: these are already centroided peaks.  This will still work if it's in profile, but probably we want properly centroied points here.
-            point2d time_diff;
-            lockMassPoint = largest(plist);
-            time_diff.rx() = scanTime;
-            time_diff.ry() = lockMassPoint.x() - lockMassMz;
-            plot_recal.addPoint(time_diff);
-        }
+        e = finder.add(scanTime, &plot_scan, false); eee;
     }
+    e = finder.finish(); eee;
+
+    plot_recal = finder.plot_recal();
+    found_peak_count = finder.found_peak_count();
+    total_peak_count = finder.total_peak_count();
     if (total_peak_count > 0) {
         found_peak_ratio = found_peak_count / (double) total_peak_count;
     } else {
@@ -882,15 +1164,12 @@ Err MzCalibration::computeCoefficientsFromByspecDB(QSqlDatabase &db)
         PlotBase plot_scan;
         const double lockMassMz = massList.first();
         const double ppmTolerance = m_options.ppmTolerance().toDouble();
-        double mzTolerance = lockMassMz / 1000000 * ppmTolerance;
-        double minMz = lockMassMz - mzTolerance;
-        double maxMz = lockMassMz + mzTolerance;
+        LockMassPeakFinder finder(lockMassMz, ppmTolerance, m_threadCount);
 
         e = QEXEC_CMD(q, cmd); eee;
         while (q.next()) {
             plot_scan.clear();
             double scanTime = q.value(2).toDouble();
-            point2d lockMassPoint;
             QString metaText = q.value(3).toString();
             QVariant filesId = q.value(4);
             bool ok = false;
@@ -911,8 +1190,6 @@ Err MzCalibration::computeCoefficientsFromByspecDB(QSqlDatabase &db)
                     cerr << "warning, filesId not found for this given byspec file" << endl;
                 }
             }
-            total_peak_count++;
-            point2dList plist;
             if (metaText.contains("<RetentionTimeUnit>second</RetentionTimeUnit>") ||
                 metaText.contains("<RetentionTimeUnit>seconds</RetentionTimeUnit>"))
             {
@@ -924,28 +1201,18 @@ Err MzCalibration::computeCoefficientsFromByspecDB(QSqlDatabase &db)
             int scanNumber = q.value(5).toInt();
             e = ms_byspec.getScanData(scanNumber, &plot_scan.getPointList(), do_centroding, NULL); eee;
             e = ms_byspec.getScanInfo(scanNumber, &scanInfo); eee;
-            if (scanInfo.peakMode == msreader::PeakPickingProfile){
-                PlotBase centroidPlot;
-                e = gaussianSmooth(plot_scan, 0.03); eee;
-                plot_scan.makeCentroidedPoints(&centroidPlot.getPointList());
-                plot_scan = centroidPlot;
-            }
+            const bool centroid = scanInfo.peakMode == msreader::PeakPickingProfile;
 #else
             e = byteArrayToPlotBase(q.value(0).toByteArray(), q.value(1).toByteArray(), &plot_scan, true); eee;
+            const bool centroid = false;
 #endif
-
-            plist = plot_scan.getPointsBetween(minMz, maxMz, true);
-
-            if (plist.size() > 0 ) {
-                found_peak_count++;
-                //Note: these are already centroided peaks.  This will still work if it's in profile, but probably we want properly centroied points here.
-                point2d time_diff;
-                lockMassPoint = largest(plist);
-                time_diff.rx() = scanTime;
-                time_diff.ry() = lockMassPoint.x() - lockMassMz;
-                plot_recal.addPoint(time_diff);
-            }
+            e = finder.add(scanTime, &plot_scan, centroid); eee;
         }
+        e = finder.finish(); eee;
+
+        plot_recal = finder.plot_recal();
+        found_peak_count = finder.found_peak_count();
+        total_peak_count = finder.total_peak_count();
         if (total_peak_count > 0) {
             found_peak_ratio = found_peak_count / (double) total_peak_count;
         } else {
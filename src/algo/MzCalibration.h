@@ -11,6 +11,7 @@
 #include <MzCalibrationOptions.h>
 
 #include <QSqlDatabase>
+#include <QVector>
 
 struct sqlite3;
 
@@ -19,6 +20,30 @@ _PMI_BEGIN
 class CacheFileManagerInterface;
 class MSReader;
 
+/*!
+ * \brief Calibration of scans at one retention time
+ *
+ * Holds the coefficient plots of MzCalibration evaluated at the scan time, so applying it costs a
+ * few multiplications per point. The m/z values are the same as of MzCalibration::calibrate(mz,
+ * time). The default object leaves m/z unchanged.
+ */
+class PMI_COMMON_MS_EXPORT MzScanCalibration final
+{
+public:
+    bool isIdentity() const;
+
+    void apply(double *mz, int count) const;
+    void apply(point2dList &plist) const;
+
+private:
+    friend class MzCalibration;
+
+    //! m/z delta is mz * m_ppmError if m_usePpm is set, polynomial in m/z otherwise
+    bool m_usePpm = false;
+    double m_ppmError = 0.0;
+    QVector<double> m_coefficients;
+};
+
 class PMI_COMMON_MS_EXPORT MzCalibration final
 {
 public:
@@ -35,6 +60,9 @@ public:
     void calibrate(double time, PlotBase & plot) const;
     void calibrate(double time, point2dList & plist) const;
 
+    //! \brief evaluates coefficients once for all points of scans at @a time
+    MzScanCalibration scanCalibration(double time) const;
+
     Err readFromDB(QSqlDatabase &db, int filesId);
     Err readFromDB(QString filename, int filesId);
     Err writeToDB(QSqlDatabase &db) const;
@@ -61,6 +89,14 @@ public:
 
     inline const MzCalibrationOptions& options() const { return m_options; }
 
+    //! \brief threads finding lock mass peaks while computing coefficients
+    //
+    // 0 (default) means QThread::idealThreadCount(), 1 finds the peaks on the calling thread
+    void setThreadCount(int threadCount) {
+        m_threadCount = threadCount;
+    }
+    int threadCount() const { return m_threadCount; }
+
     inline const QList<pmi::PlotBase>& coefficientPlots() const { return m_coeffList; }
 
 private:
@@ -75,6 +111,7 @@ private:
     QList<pmi::PlotBase> m_coeffList;
     MzCalibrationOptions m_options;
     double m_lockmass_single_point;  /// used when lock_mass_use_ppm_for_one_point is true
+    int m_threadCount;
 };
 
 //! @todo Private functions? Move to MzCalibration_p.h?
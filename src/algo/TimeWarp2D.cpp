@@ -298,6 +298,7 @@ Err TimeWarp2D::constructWarp(const TimedWarpElementList &inputPointsA,
     warpCore.setGlobalSkew(options.globalSkew);
     warpCore.setStretchPenalty(options.stretchPenalty);
     warpCore.setMzMatchPpm(options.mzMatchPpm);
+    warpCore.setThreadCount(options.threadCount);
     e = warpCore.constructWarp(A, B, knotsA, &knotsB); ree;
 
     if (knotsA.size() != knotsB.size()) {
@@ -49,6 +49,7 @@ public:
                                         //! later upgrade the warpping dynamic table to be more memory
                                         //! efficient.
         double mzMatchPpm;                //! ppm to consider two mz values as a "match"
+        int threadCount;                  //! warp core threads, 0 means QThread::idealThreadCount()
 
         TimeWarpOptions()
         {
@@ -60,6 +61,7 @@ public:
             numberOfSamplesPerSegment = 4; //! make each segment very small.
             maxTotalNumberOfPoints = 10000;
             mzMatchPpm = 100.0;
+            threadCount = 0;
         }
     };
 
@@ -7,6 +7,14 @@
  */
 
 #include "WarpCore2D.h"
+
+#include <common_constants.h>
+#include <MathUtils.h>
+
+#include <QFuture>
+#include <QThread>
+#include <QThreadPool>
+#include <QtConcurrent>
 #include <QtMath>
 
 _PMI_BEGIN
@@ -20,10 +28,14 @@ static const int defaultGlobalSkew = 100;
 static const double defaultStretchPenalty = 0.0;
 static const double defaultMzMatchPpm = 100.0;
 
+// Chunks of end positions per thread and row of the dynamic table, for load balancing
+static const int CHUNKS_PER_THREAD = 4;
+
 WarpCore2D::WarpCore2D()
     : m_stretchPenalty(defaultStretchPenalty)
     , m_globalSkew(defaultGlobalSkew)
     , m_mzMatchPpm(defaultMzMatchPpm)
+    , m_threadCount(0)
 {
 
 }
@@ -72,11 +84,203 @@ void WarpCore2D::setMzMatchPpm(double ppm)
     m_mzMatchPpm = ppm;
 }
 
+int WarpCore2D::threadCount() const
+{
+    return m_threadCount;
+}
 
-/*! \brief This function does the integral of product of A segment and B segment */
-static double segmentMatchScore(const std::vector<WarpElement> &a, int beginA, int endA,
-                                const std::vector<WarpElement> &b, int beginB, int endB,
-                                double mzMatchPpm)
+void WarpCore2D::setThreadCount(int threadCount)
+{
+    m_threadCount = threadCount;
+}
+
+
+namespace {
+    /*!
+        \brief Structure-of-arrays copy of a WarpElement list.
+
+        The intensities and the m/z values of the n-th pair of all elements are stored in
+        contiguous arrays, so that the score of a segment reads the samples with unit stride.
+        The last element is repeated once at the end, because interpolation at the last sample
+        reads its right neighbour.
+    */
+    struct WarpElementColumns
+    {
+        //! Number of elements, without the repeated last element
+        int size = 0;
+        //! True if all elements are legacy (intensity only)
+        bool legacy = true;
+        //! Number of mz/intensity pairs per element, 0 for legacy elements
+        std::vector<int> pairCount;
+        std::vector<double> intensity[WarpElement::maxMzIntensityPairCount];
+        std::vector<double> mz[WarpElement::maxMzIntensityPairCount];
+
+        explicit WarpElementColumns(const std::vector<WarpElement> &elements)
+            : size(static_cast<int>(elements.size()))
+        {
+            const int paddedSize = elements.empty() ? 0 : size + 1;
+            pairCount.resize(paddedSize);
+            for (int pair = 0; pair < WarpElement::maxMzIntensityPairCount; pair++) {
+                intensity[pair].resize(paddedSize);
+                mz[pair].resize(paddedSize);
+            }
+
+            for (int i = 0; i < paddedSize; i++) {
+                const WarpElement &element = elements[std::min(i, size - 1)];
+                pairCount[i] = element.mzIntensityPairCount();
+                legacy = legacy && element.isLegacy();
+                for (int pair = 0; pair < WarpElement::maxMzIntensityPairCount; pair++) {
+                    intensity[pair][i] = element.mzIntensityPairs[pair].intensity;
+                    mz[pair][i] = element.mzIntensityPairs[pair].mz;
+                }
+            }
+        }
+    };
+}
+
+static inline bool withinPpm(double mzA, double mzB, double ppm)
+{
+    double mzMargin = std::max(mzA, mzB) * ppm * ONE_MILLIONTH;
+    double diff = std::abs(mzB - mzA);
+    return diff <= mzMargin;
+}
+
+/*!
+    \brief Score of sample \a indexA of a against sample \a indexB of b.
+
+    This is WarpElement::scoreFunction(a[indexA], b[indexB]) evaluated on the columns, operation by
+    operation, so the result is bitwise the same. b[indexB] must not be legacy.
+*/
+static double sampleMatchScore(const WarpElementColumns &a, int indexA,
+                               const WarpElementColumns &b, int indexB, double mzMatchPpm)
+{
+    if (a.pairCount[indexA] == 0) {
+        // Original objective func - return diff squared
+        double ret = a.intensity[0][indexA] - b.intensity[0][indexB];
+        ret = -ret * ret;
+        return ret;
+    }
+
+    // Match all mz/int pairs from a against all from b
+    int matchMapAB[WarpElement::maxMzIntensityPairCount];
+    int matchMapBA[WarpElement::maxMzIntensityPairCount];
+
+    const int UNMATCHED = -1;
+    const int USED = -2;
+
+    for (int i = 0; i < WarpElement::maxMzIntensityPairCount; i++) {
+        matchMapAB[i] = UNMATCHED;
+        matchMapBA[i] = UNMATCHED;
+    }
+
+    const int pairCount = std::min(a.pairCount[indexA], b.pairCount[indexB]);
+
+    for (int pairA = 0; pairA < pairCount; pairA++) {
+        for (int pairB = 0; pairB < pairCount; pairB++) {
+            if (withinPpm(a.mz[pairA][indexA], b.mz[pairB][indexB], mzMatchPpm)) {
+                matchMapAB[pairA] = pairB;
+                matchMapBA[pairB] = pairA;
+            }
+        }
+    }
+
+    // sum square diffs
+    double ret = 0.0;
+
+    const double matchedWeight = 1.0;
+    const double unmatchedWeight = 0.5;
+
+    // Sum square diffs of mz/int pairs of a
+    for (int i = 0; i < pairCount; i++) {
+        double weight = unmatchedWeight;
+        double intensity1 = a.intensity[i][indexA];
+        double intensity2 = 0.0;
+
+        int index2 = matchMapAB[i];
+        if (index2 >= 0) {
+            weight = matchedWeight;
+            intensity2 = b.intensity[index2][indexB];
+            matchMapBA[index2] = USED;
+        }
+
+        double diff = intensity2 - intensity1;
+        ret -= weight * diff * diff;
+    }
+
+    // Sum square diffs of mz/int pairs of b
+    for (int i = 0; i < pairCount; i++) {
+        int index1 = matchMapBA[i];
+        if (index1 == USED) {
+            continue;
+        }
+
+        double weight = unmatchedWeight;
+        double intensity2 = b.intensity[i][indexB];
+        double intensity1 = 0.0;
+        if (index1 >= 0) {
+            intensity1 = a.intensity[index1][indexA];
+            weight = matchedWeight;
+        }
+        double diff = intensity2 - intensity1;
+        ret -= weight * diff * diff;
+    }
+
+    return ret;
+}
+
+namespace {
+    /*!
+        \brief Scores of the samples of one segment of a against a range of samples of b.
+
+        WarpElements with m/z are interpolated by nearest neighbour, so the score of a segment
+        mapping is a sum of scores of sample pairs. The same pairs are scored for many start and end
+        positions of a row of the dynamic table, so they are computed once per row.
+    */
+    struct SampleScoreTable
+    {
+        int beginA = 0;
+        int beginB = 0;
+        int width = 0;
+        std::vector<double> scores;
+
+        //! Scores samples [beginA, endA) of \a a against samples [beginB, endB] of \a b
+        void init(const WarpElementColumns &a, int beginA, int endA, const WarpElementColumns &b,
+                  int beginB, int endB, double mzMatchPpm)
+        {
+            this->beginA = beginA;
+            this->beginB = beginB;
+            width = std::max(0, endB - beginB + 1);
+            scores.resize(static_cast<size_t>(std::max(0, endA - beginA)) * width);
+            for (int indexA = beginA; indexA < endA; indexA++) {
+                double *row = scores.data() + static_cast<size_t>(indexA - beginA) * width;
+                for (int indexB = beginB; indexB <= endB; indexB++) {
+                    // legacy samples of b are interpolated and never looked up
+                    row[indexB - beginB] = (b.pairCount[indexB] == 0)
+                        ? 0.0
+                        : sampleMatchScore(a, indexA, b, indexB, mzMatchPpm);
+                }
+            }
+        }
+
+        double at(int indexA, int indexB) const
+        {
+            Q_ASSERT(indexB >= beginB && indexB - beginB < width);
+            return scores[static_cast<size_t>(indexA - beginA) * width + (indexB - beginB)];
+        }
+    };
+}
+
+/*!
+    \brief This function does the integral of product of A segment and B segment
+
+    The score of every sample is computed into \a terms first and summed in order afterwards, so
+    the result is the same as adding WarpElement::scoreFunction() of the interpolated samples one by
+    one. For legacy signals the first loop has no branches and is vectorized by the compiler.
+    Otherwise the scores of the nearest neighbours are looked up in \a sampleScores.
+*/
+static double segmentMatchScore(const WarpElementColumns &a, int beginA, int endA,
+                                const WarpElementColumns &b, int beginB, int endB,
+                                const SampleScoreTable &sampleScores, std::vector<double> *terms)
 {
     
     // Zero score on error
@@ -99,19 +303,49 @@ static double segmentMatchScore(const std::vector<WarpElement> &a, int beginA, i
         return 0.0;
     }
 
+    if (static_cast<int>(terms->size()) < durationA) {
+        terms->resize(durationA);
+    }
+    double *term = terms->data();
+
     //  Compute integral of product
-    double stepB = static_cast<double>(durationB) / static_cast<double>(durationA);
+    const double stepB = static_cast<double>(durationB) / static_cast<double>(durationA);
+    const int lastIndexB = b.size - 1;
+    const double *intensityA = a.intensity[0].data() + beginA;
+    const double *intensityB = b.intensity[0].data();
+    if (a.legacy && b.legacy) {
+        for (int i = 0; i < durationA; i++) {
+            const double indexBDouble = beginB + i * stepB;
+            const int indexB = std::min(qFloor(indexBDouble), lastIndexB);
+            const double lerpFactor = indexBDouble - indexB;
+
+            // Use quadratic penalty
+            double diff = intensityA[i]
+                - MathUtils::lerp(intensityB[indexB], intensityB[indexB + 1], lerpFactor);
+            term[i] = -diff * diff;
+        }
+    } else {
+        for (int i = 0; i < durationA; i++) {
+            const double indexBDouble = beginB + i * stepB;
+            const int indexB = std::min(qFloor(indexBDouble), lastIndexB);
+            const double lerpFactor = indexBDouble - indexB;
+
+            if (b.pairCount[indexB] == 0 || b.pairCount[indexB + 1] == 0) {
+                // WarpElement::interpolate() defaults to legacy (intensity only)
+                double diff = intensityA[i]
+                    - MathUtils::lerp(intensityB[indexB], intensityB[indexB + 1], lerpFactor);
+                term[i] = -diff * diff;
+            } else {
+                // otherwise, nearest neighbour
+                const int indexNearest = (lerpFactor < 0.5) ? indexB : indexB + 1;
+                term[i] = sampleScores.at(beginA + i, indexNearest);
+            }
+        }
+    }
+
     double integral = 0.0;
-    for (int indexA = beginA; indexA < endA; indexA++) {
-        const WarpElement &sampleA = a[indexA];
-        double indexBDouble = beginB + (indexA - beginA) * stepB;
-        int indexB = qFloor(indexBDouble);
-        indexB = std::min(indexB, static_cast<int>(b.size()) - 1);
-        double lerpFactor = indexBDouble - indexB;
-        WarpElement sampleB = WarpElement::interpolate(b[indexB], b[indexB + 1], mzMatchPpm, lerpFactor);
-
-        // Use quadratic penalty
-        integral += WarpElement::scoreFunction(sampleA, sampleB, mzMatchPpm);
+    for (int i = 0; i < durationA; i++) {
+        integral += term[i];
     }
 
     return integral;
@@ -203,22 +437,45 @@ Err WarpCore2D::constructWarp(std::vector<WarpElement> &a, std::vector<WarpEleme
         dynamicTable[i].resize(rowEnd[i] - rowStart[i]);
     }
 
+    // Samples of both signals as contiguous columns, for the score kernel
+    const WarpElementColumns columnsA(a);
+    const WarpElementColumns columnsB(b);
+    std::vector<double> terms;
+    SampleScoreTable sampleScores;
+    const bool legacy = columnsA.legacy && columnsB.legacy;
+
+    // Scores samples [beginA, endA) against the samples of b reached by mappings which start at
+    // firstIndexB or later and end at lastIndexB or earlier
+    auto initSampleScores = [&](int beginA, int endA, int firstIndexB, int lastIndexB) {
+        if (!legacy && nB > 0) {
+            sampleScores.init(columnsA, beginA, endA, columnsB, std::max(0, firstIndexB),
+                              std::min(nB, lastIndexB), m_mzMatchPpm);
+        }
+    };
+    auto initRowSampleScores = [&](int i) {
+        int durationA = std::abs(knotsA[i + 1] - knotsA[i]);
+        initSampleScores(knotsA[i], knotsA[i + 1], rowStart[i] - qCeil(MAXIMUM_STRETCH * durationA),
+                         rowEnd[i]);
+    };
+
     // Score for first segment  -- lighter penalty here?
+    initSampleScores(0, firstSegmentDuration, 0, rowEnd[0]);
     for (int j = rowStart[0]; j < rowEnd[0]; j++) {
         DynamicTableEntry &currentCell = dtCell(0, j);
-        currentCell.score = segmentMatchScore(a, 0, firstSegmentDuration, b, 0, j, m_mzMatchPpm);
+        currentCell.score = segmentMatchScore(columnsA, 0, firstSegmentDuration, columnsB, 0, j,
+                                              sampleScores, &terms);
         double stretch = static_cast<double>(std::abs(j - firstSegmentDuration));
         currentCell.score -= stretchPenaltyFactor * stretch * stretch;
     }
 
-    // Score for subsequent segments
-    for (int i = 1; i < segmentCount; i++) {
+    // Evaluates the ending positions [jBegin, jEnd) in B's space of segment i. This only reads row
+    // i - 1 of the dynamic table and writes cells (i, jBegin) to (i, jEnd - 1).
+    auto scoreEndPositions = [&](int i, int jBegin, int jEnd, std::vector<double> *rowTerms) {
         int startA = knotsA[i];
         int endA = knotsA[i + 1];
         double durationA = std::abs(endA - startA);
 
-        // Evaluate different ending positions for the current segment in B's space
-        for (int j = rowStart[i]; j < rowEnd[i]; j++) {
+        for (int j = jBegin; j < jEnd; j++) {
             // For each of the ending positions, evaluate a number of starting positions
             int maxk = std::max(0, j - qFloor(MINIMUM_STRETCH * durationA));
             int mink = std::max(0, j - qCeil(MAXIMUM_STRETCH * durationA));
@@ -230,8 +487,9 @@ Err WarpCore2D::constructWarp(std::vector<WarpElement> &a, std::vector<WarpEleme
                 }
 
                 // calculate score for this combination of start/end for B
-                double score = accumulatedScore + 
-                    segmentMatchScore(a, startA, endA, b, k, j, m_mzMatchPpm);
+                double score = accumulatedScore
+                    + segmentMatchScore(columnsA, startA, endA, columnsB, k, j, sampleScores,
+                                        rowTerms);
 
                 // calculate stretch penalty
                 // (Change the following to Segments-1 to get no penalty for stretching last
@@ -250,7 +508,46 @@ Err WarpCore2D::constructWarp(std::vector<WarpElement> &a, std::vector<WarpEleme
                 }
             } // end for k
         } // end for j
-    } // end for i
+    };
+
+    // Score for subsequent segments
+    const int threadCount = (m_threadCount > 0) ? m_threadCount : QThread::idealThreadCount();
+    if (threadCount <= 1) {
+        for (int i = 1; i < segmentCount; i++) {
+            initRowSampleScores(i);
+            scoreEndPositions(i, rowStart[i], rowEnd[i], &terms);
+        }
+    } else {
+        // The ending positions of a segment are independent of each other, so every row is split
+        // in chunks which are scored in parallel. Rows are still evaluated one after another.
+        QThreadPool pool;
+        pool.setMaxThreadCount(threadCount);
+
+        const int chunkCount = threadCount * CHUNKS_PER_THREAD;
+        std::vector<std::vector<double>> chunkTerms(chunkCount);
+        QVector<QFuture<void>> chunks;
+        for (int i = 1; i < segmentCount; i++) {
+            initRowSampleScores(i);
+
+            const int rowSize = rowEnd[i] - rowStart[i];
+            const int chunkSize = std::max(1, (rowSize + chunkCount - 1) / chunkCount);
+
+            chunks.clear();
+            for (int chunk = 0; chunk * chunkSize < rowSize; chunk++) {
+                const int jBegin = rowStart[i] + chunk * chunkSize;
+                const int jEnd = std::min(rowEnd[i], jBegin + chunkSize);
+                std::vector<double> *rowTerms = &chunkTerms[chunk];
+                chunks.push_back(QtConcurrent::run(&pool, [&scoreEndPositions, i, jBegin, jEnd,
+                                                           rowTerms]() {
+                    scoreEndPositions(i, jBegin, jEnd, rowTerms);
+                }));
+            }
+
+            for (QFuture<void> &future : chunks) {
+                future.waitForFinished();
+            }
+        }
+    }
 
     // Find winning warp.
     knotsB->resize(segmentCount + 1);
@@ -67,6 +67,18 @@ public:
     */
     void setMzMatchPpm(double ppm);
 
+    /*! \brief Gets the number of threads used by constructWarp. */
+    int threadCount() const;
+
+    /*!
+        \brief Sets the number of threads used by constructWarp. 0 (default) means
+            QThread::idealThreadCount().
+            The cells of one row of the dynamic table only depend on the previous row, so the
+            candidate end positions of a segment are scored in parallel. The warp does not depend
+            on the thread count.
+    */
+    void setThreadCount(int threadCount);
+
     /*!
         \brief Constructs a time warp.
         \param a Reference signal
@@ -82,6 +94,7 @@ private:
     double m_stretchPenalty;
     int m_globalSkew;
     double m_mzMatchPpm;
+    int m_threadCount;
 };
 
 _PMI_END
@@ -109,65 +109,83 @@ static void output_to_file(const std::vector<std::pair<double, double> > &data,
 bool Centroid::smooth_and_centroid(std::vector<std::pair<double, double> > &data, double start_sigma, double end_sigma,
     const UncertaintyScaling uncertainty_type, int top_k, double merge_radius, bool adjust_intensity,
     bool sort_mz, std::vector<std::pair<double, double> > &centroided_out)
+{
+    const bool bypass = data.size() < MIN_CENTROID_POINTS;
+
+    m_mz.resize(data.size());
+    m_intensity.resize(data.size());
+    for (size_t ii = 0; ii < data.size(); ii++) {
+        m_mz[ii] = data[ii].first;
+        m_intensity[ii] = data[ii].second;
+    }
+
+    if (!smooth_and_centroid_arrays(m_mz.data(), m_intensity.data(), data.size(), start_sigma, end_sigma,
+                                    uncertainty_type, top_k, merge_radius, adjust_intensity, sort_mz,
+                                    centroided_out)) {
+        return false;
+    }
+
+    if (!bypass) {
+        data.clear(); //<---------- d_kletter fix bad cleanup
+        std::vector<std::pair<double, double> >(data).swap(data);
+    }
+
+    return true;
+}
+
+bool Centroid::smooth_and_centroid(std::vector<std::pair<double, double> > &data,
+                                   const CentroidOptions &options,
+                                   std::vector<std::pair<double, double> > &centroided_out)
+{
+    return smooth_and_centroid(data, options.startSigma, options.endSigma, options.uncertaintyType,
+                               options.topK, options.mergeRadius, options.adjustIntencity,
+                               options.sortMz, centroided_out);
+}
+
+bool Centroid::smooth_and_centroid(const double *mz, const double *intensity, size_t point_count,
+                                   const CentroidOptions &options,
+                                   std::vector<std::pair<double, double> > &centroided_out)
+{
+    return smooth_and_centroid_arrays(mz, intensity, point_count, options.startSigma, options.endSigma,
+                                      options.uncertaintyType, options.topK, options.mergeRadius,
+                                      options.adjustIntencity, options.sortMz, centroided_out);
+}
+
+bool Centroid::smooth_and_centroid_arrays(const double *mz, const double *intensity, size_t point_count,
+    double start_sigma, double end_sigma, const UncertaintyScaling uncertainty_type, int top_k,
+    double merge_radius, bool adjust_intensity, bool sort_mz,
+    std::vector<std::pair<double, double> > &centroided_out)
 {
     centroided_out.clear();
-    if (data.size() < MIN_CENTROID_POINTS) { // bypass if too few points, no filtering
-        for (unsigned int ii = 0; ii<data.size(); ii++) {
-            double intens = data[ii].second;
+    if (point_count < MIN_CENTROID_POINTS) { // bypass if too few points, no filtering
+        for (size_t ii = 0; ii < point_count; ii++) {
+            double intens = intensity[ii];
             if (intens>0.0)
-                centroided_out.push_back(std::pair<double, double>(data[ii].first, intens));
+                centroided_out.push_back(std::pair<double, double>(mz[ii], intens));
         }
         return true;
     }
 
-    // create table 
-    std::vector<double> gaussian_table = makeUnitGaussianTable(GAUSS_TEMPLATE_RANGE, GAUSS_TEMPLATE_COUNT);
+    // table is made once
+    const std::vector<double> &gaussian_table = unitGaussianTable();
     if (gaussian_table.size() == 0)
         return false;
 
     // gaussian smooth the data
-    std::vector<std::pair<int, double> > smoothed_data;
-    if (!gaussian_smooth2(data, start_sigma, end_sigma, uncertainty_type, gaussian_table, smoothed_data)) {
+    if (!gaussianSmoothArrays(mz, intensity, static_cast<ptrdiff_t>(point_count), start_sigma,
+                              end_sigma, uncertainty_type, gaussian_table)) {
         return false;
     }
 
-#ifdef PMI_MS_OUTPUT_DEBUG_CENTROID_SMOOTHING_TO_FILE
-    static int count = 0;
-    count++;
-    if (count % 500 == 0) {
-        std::string before_file = toString(count) + "_before_smooth_" + toString(uncertainty_value, 5);
-        std::string after_file = toString(count) + "_after_smooth_" + toString(uncertainty_value, 5);
-
-        output_to_file(data, before_file);
-        output_to_file(smoothed_data, after_file);
-    }
-#endif
-
     // make max indicies
-    std::vector<std::pair<int, double> > max_list = computeMaxIndexList2(data, smoothed_data);
-    consolidateMergeRadius(data, merge_radius, max_list);
-
-#ifdef PMI_MS_OUTPUT_DEBUG_CENTROID_SMOOTHING_TO_FILE
-    if (count % 500 == 0) {
-        std::string after_centroided_file = toString(count) + "_after_centroided_" + toString(uncertainty_value, 5);
-        output_to_file(centroided_out, after_centroided_file);
-    }
-#endif
-
-    smoothed_data.clear();
-    std::vector<std::pair<int, double> >(smoothed_data).swap(smoothed_data);
+    computeMaxIndexList();
+    consolidateMergeRadius(mz, intensity, merge_radius);
 
     // retain top k points
-    retainIntensePoints2(data, max_list, top_k, false, centroided_out);
-
-    max_list.clear(); // free capacity
-    std::vector<std::pair<int, double> >(max_list).swap(max_list);
+    retainIntensePoints(mz, intensity, point_count, top_k, centroided_out);
 
     if (adjust_intensity)
-        restoreIntensity(centroided_out, data, start_sigma, end_sigma, uncertainty_type);
-
-    data.clear(); //<---------- d_kletter fix bad cleanup
-    std::vector<std::pair<double, double> >(data).swap(data);
+        restoreIntensity(centroided_out, mz, intensity, point_count, start_sigma, end_sigma, uncertainty_type);
 
     if (sort_mz)
         std::sort(centroided_out.begin(), centroided_out.end(), sort_by_x());
@@ -175,15 +193,6 @@ bool Centroid::smooth_and_centroid(std::vector<std::pair<double, double> > &data
     return true;
 }
 
-bool Centroid::smooth_and_centroid(std::vector<std::pair<double, double> > &data,
-                                   const CentroidOptions &options,
-                                   std::vector<std::pair<double, double> > &centroided_out)
-{
-    return smooth_and_centroid(data, options.startSigma, options.endSigma, options.uncertaintyType,
-                               options.topK, options.mergeRadius, options.adjustIntencity,
-                               options.sortMz, centroided_out);
-}
-
 // Gaussian smoothing
 bool Centroid::gaussian_smooth2(const std::vector<std::pair<double, double> > &in, double start_sigma, double end_sigma, const UncertaintyScaling uncertainty_type, const std::vector<double> &gaussian_table, std::vector<std::pair<int, double> > &smoothed_data)
 {
@@ -266,6 +275,82 @@ bool Centroid::gaussian_smooth2(const std::vector<std::pair<double, double> > &i
 }
 
 
+// Gaussian smoothing of arrays, the same sums in the same order as gaussian_smooth2
+bool Centroid::gaussianSmoothArrays(const double *mz, const double *intensity, ptrdiff_t in_size, double start_sigma, double end_sigma, const UncertaintyScaling uncertainty_type, const std::vector<double> &gaussian_table)
+{
+    m_smoothed_data.clear();
+    if (in_size <= 0)
+        return false;
+    if (uncertainty_type == SquareRootUncertainty) {
+        cout << "not yet supported: Square Root Uncertainty mode" << endl; return false;
+    }
+
+    m_smoothed_data.resize(in_size);
+    double *smoothed = m_smoothed_data.data();
+    const double *table = gaussian_table.data();
+    const ptrdiff_t table_size = gaussian_table.size();
+
+    double start_stddev = start_sigma, stddev_slope = 0, x_start = mz[0];
+    if (uncertainty_type == LinearUncertainty) {
+        double mz_range = mz[in_size - 1] - x_start;
+        stddev_slope = (end_sigma - start_sigma) / mz_range;
+    }
+
+    const ptrdiff_t count = table_size / 2;
+    double std_dev = start_sigma;
+    double half_kernel_width = 3 * std_dev;
+
+    for (ptrdiff_t in_idx = 0; in_idx < in_size; in_idx++) {
+        if (intensity[in_idx] < NEAR_ZERO && in_idx < in_size - 1 && intensity[in_idx + 1] < NEAR_ZERO) {
+            smoothed[in_idx] = 0;
+            in_idx++; smoothed[in_idx] = 0;
+            continue;
+        }
+        double point_x_position = mz[in_idx];
+
+        if (uncertainty_type == LinearUncertainty) {
+            std_dev = start_stddev + (point_x_position - x_start)*stddev_slope;
+            half_kernel_width = 3 * std_dev;
+        }
+        double start_convolution = point_x_position - half_kernel_width;
+        double end_convolution = point_x_position + half_kernel_width;
+        double count_per_stdev = (count - 1) / std_dev / 6.0;
+
+        // search up for points to convolute and add contribution to point
+        double point_y_position = intensity[in_idx]*table[count];
+        for (ptrdiff_t point_idx = in_idx + 1; point_idx < in_size; point_idx++) {
+            const double signal_intensity = intensity[point_idx];
+            if (signal_intensity > NEAR_ZERO) {
+                double cur_x_position = mz[point_idx];
+                if (cur_x_position > end_convolution)
+                    break;
+                double kernel_x_position = (cur_x_position - point_x_position)*count_per_stdev; // in kernel space
+                const ptrdiff_t kernel_index = count + my_round(kernel_x_position);
+                if (kernel_index >= 0 && kernel_index < table_size) {
+                    point_y_position += signal_intensity*table[kernel_index];
+                }
+            }
+        }
+
+        // search down for points to convolute and add contribution to point
+        for (ptrdiff_t point_idx = in_idx - 1; point_idx >= 0; point_idx--) {
+            const double signal_intensity = intensity[point_idx];
+            if (signal_intensity > NEAR_ZERO) {
+                double cur_x_position = mz[point_idx];
+                if (cur_x_position < start_convolution)
+                    break;
+                double kernel_x_position = (cur_x_position - point_x_position)*count_per_stdev; // in kernel space
+                const ptrdiff_t kernel_index = count + my_round(kernel_x_position);
+                if (kernel_index >= 0 && kernel_index < table_size) {
+                    point_y_position += signal_intensity*table[kernel_index];
+                }
+            }
+        }
+        smoothed[in_idx] = point_y_position;
+    }
+    return true;
+}
+
 // get gaussian value -- only call this once
 inline double Centroid::getGaussianValue(double mean, double std_dev, double x_position)
 {
@@ -286,7 +371,7 @@ inline double Centroid::getGaussianValue(double mean, double std_dev, double x_p
 }
 
 // make gaussian table
-inline std::vector<double> Centroid::makeUnitGaussianTable(double range, int count)
+std::vector<double> Centroid::makeUnitGaussianTable(double range, int count)
 {
     std::vector<double> gaussian_table;
     if (range <= MIN_GAUSS_RANGE) {
@@ -302,49 +387,41 @@ inline std::vector<double> Centroid::makeUnitGaussianTable(double range, int cou
     return gaussian_table;
 }
 
+// gaussian table shared by all objects, made on first use
+const std::vector<double> &Centroid::unitGaussianTable()
+{
+    static const std::vector<double> gaussian_table = makeUnitGaussianTable(GAUSS_TEMPLATE_RANGE, GAUSS_TEMPLATE_COUNT);
+    return gaussian_table;
+}
+
 // compute max index list
-inline std::vector<std::pair<int, double> > Centroid::computeMaxIndexList2(const std::vector<std::pair<double, double> > &data, const std::vector<std::pair<int, double> > &smooth_data)
+void Centroid::computeMaxIndexList()
 {
-    (void)data;
-    std::vector<std::pair<int, double> > index_list;
+    const std::vector<double> &smooth_data = m_smoothed_data;
+    std::vector<std::pair<int, double> > &index_list = m_max_list;
+    index_list.clear();
     if (smooth_data.size() < 2)
-        return index_list;
+        return;
 
-    int prev_index = -1; double prev_sm_intense = 0.0; //, prev_x = 0.0;
-    if (smooth_data[0].second > smooth_data[1].second) {
-        prev_index = 0; prev_sm_intense = smooth_data[0].second; //prev_x = data[0].first;
-        index_list.push_back(std::pair<int, double>(smooth_data[0].first, prev_sm_intense));
+    if (smooth_data[0] > smooth_data[1]) {
+        index_list.push_back(std::pair<int, double>(0, smooth_data[0]));
     }
 
     for (int i = 1; i < (int)smooth_data.size() - 1; i++) {
-        double b = smooth_data[i].second;
-        if (b > smooth_data[i + 1].second) {
-            double a = smooth_data[i - 1].second;
+        double b = smooth_data[i];
+        if (b > smooth_data[i + 1]) {
+            double a = smooth_data[i - 1];
             if (a<b) {
-                if (prev_index < 0) {
-                    prev_index = i; prev_sm_intense = b; //prev_x = data[i].first;
-                    index_list.push_back(std::pair<int, double>(smooth_data[i].first, b));
-                } else {
-                    /*  double dx = data[i].first - prev_x;
-                    if (dx > merge_radius){*/
-                    prev_index = i; prev_sm_intense = b; //prev_x = data[i].first;
-                    index_list.push_back(std::pair<int, double>(smooth_data[i].first, b));
-                    /*                    } else {
-                    if (b > prev_sm_intense){
-                    prev_index = i; prev_sm_intense = b; prev_x = data[i].first;
-                    index_list[index_list.size() - 1].first = i;
-                    }
-                    }*/
-                }
+                index_list.push_back(std::pair<int, double>(i, b));
             } else if (a == b) {
                 /*This is a maxima or just a slant? E.g.
                 //   ___       \___
                 //  /   \  or      \
-        //Find the previous non-equavalent value to determine extrema */
+                //Find the previous non-equavalent value to determine extrema */
                 for (int j = i - 2; j >= 0; j--) {
-                    a = smooth_data[j].second;
+                    a = smooth_data[j];
                     if (a < b) {
-                        index_list.push_back(std::pair<int, double>(smooth_data[i].first, b)); //prev_index = i; prev_sm_intense = smooth_data[i]; prev_x = data[i].first;
+                        index_list.push_back(std::pair<int, double>(i, b));
                         break;
                     } else if (a > b) {
                         break;
@@ -354,35 +431,36 @@ inline std::vector<std::pair<int, double> > Centroid::computeMaxIndexList2(const
         }
     }
 
-    double a = smooth_data[smooth_data.size() - 2].second;
-    double b = smooth_data[smooth_data.size() - 1].second;
+    double a = smooth_data[smooth_data.size() - 2];
+    double b = smooth_data[smooth_data.size() - 1];
     if (b > a) {
         index_list.push_back(std::pair<int, double>(static_cast<int>(smooth_data.size()) - 1, b));
     } else if (b == a) {
         //find the previous non-equavalent value to determine extrema
         for (ptrdiff_t j = static_cast<ptrdiff_t>(smooth_data.size()) - 3; j >= 0; j--) {
-            a = smooth_data[j].second;
+            a = smooth_data[j];
             if (a < b) {
-                index_list.push_back(std::pair<int, double>(smooth_data[smooth_data.size() - 1].first, b));
+                index_list.push_back(std::pair<int, double>(static_cast<int>(smooth_data.size()) - 1, b));
                 break;
             } else if (a > b) {
                 break;
             }
         }
     }
-    return index_list;
 }
 
 // restore intensity
-inline void Centroid::restoreIntensity(std::vector<std::pair<double, double> > &centroided_out, const std::vector<std::pair<double, double> > &data, double start_sigma, double end_sigma, const UncertaintyScaling uncertainty_type)
+void Centroid::restoreIntensity(std::vector<std::pair<double, double> > &centroided_out, const double *mz, const double *intensity, size_t point_count, double start_sigma, double end_sigma, const UncertaintyScaling uncertainty_type)
 {
     if (uncertainty_type == SquareRootUncertainty) {
         cout << "caution: Square Root Uncertainty mode not yet supported -- using fixed uncertainty mode" << endl;
     }
+    if (centroided_out.empty())
+        return;
 
-    double start_stddev = start_sigma, stddev_slope = 0, x_start = data[0].first;
+    double start_stddev = start_sigma, stddev_slope = 0, x_start = mz[0];
     if (uncertainty_type == LinearUncertainty) {
-        double mz_range = data[data.size() - 1].first - x_start;
+        double mz_range = mz[point_count - 1] - x_start;
         stddev_slope = (end_sigma - start_sigma) / mz_range;
     }
 
@@ -407,15 +485,15 @@ inline void Centroid::restoreIntensity(std::vector<std::pair<double, double> > &
             start_mz = (start_mz + prv_x) / 2;
         if (nxt_x<end_mz)
             end_mz = (end_mz + nxt_x) / 2;
-        while (data[idx].first<x_pos)
+        while (mz[idx]<x_pos)
             idx++;
-        double max1 = data[idx].second, max = max1, last = max; bool prv = false, cur = false;
+        double max1 = intensity[idx], max = max1, last = max; bool prv = false, cur = false;
         double thr = max * intensity_thr;
-        for (unsigned int jj = idx + 1; jj<data.size(); jj++) {
-            double yy = data[jj].second;
+        for (unsigned int jj = idx + 1; jj<point_count; jj++) {
+            double yy = intensity[jj];
             if (yy <= thr)
                 break;
-            if (data[jj].first>end_mz)
+            if (mz[jj]>end_mz)
                 break;
             prv = cur; cur = last>yy; last = yy;
             if (prv && cur)
@@ -424,10 +502,10 @@ inline void Centroid::restoreIntensity(std::vector<std::pair<double, double> > &
         }
         last = max1; prv = false; cur = false;
         for (int jj = idx - 1; jj >= 0; jj--) {
-            double yy = data[jj].second;
+            double yy = intensity[jj];
             if (yy <= thr)
                 break;
-            if (data[jj].first<start_mz)
+            if (mz[jj]<start_mz)
                 break;
             prv = cur; cur = last>yy; last = yy;
             if (prv && cur)
@@ -517,91 +595,92 @@ inline void Centroid::removeDuplicatePoints(std::vector<std::pair<double, double
 }
 
 // retain only the top intesity points
-inline void Centroid::retainIntensePoints2(std::vector<std::pair<double, double> > &data, std::vector<std::pair<int, double> > &index_list, int top_k, bool sort_mz, std::vector<std::pair<double, double> > &centroided_out)
+void Centroid::retainIntensePoints(const double *mz, const double *intensity, size_t point_count, int top_k, std::vector<std::pair<double, double> > &centroided_out)
 {
-    //(void)sort_mz;
+    std::vector<std::pair<int, double> > &index_list = m_max_list;
     if (top_k > 0 && top_k < (int)index_list.size()) {
-        //std::sort(index_list.rbegin(), index_list.rend(), sort_by_intens());
-        std::partial_sort(index_list.begin(), index_list.begin() + top_k, index_list.end(), sort_by_intens());
+        // equal intensities are ordered by index so that the selection is the same everywhere
+        std::nth_element(index_list.begin(), index_list.begin() + (top_k - 1), index_list.end(),
+                         [](const std::pair<int, double> &left, const std::pair<int, double> &right) {
+                             return left.second > right.second
+                                 || (left.second == right.second && left.first < right.first);
+                         });
         index_list.resize(top_k);
         std::sort(index_list.begin(), index_list.end(), sort_by_mz());
     }
     centroided_out.reserve(index_list.size());
     for (unsigned int ii = 0; ii < index_list.size(); ii++) {
         int index = index_list[ii].first;
-        if (index > 0 && index < int(data.size()) - 1) {
-            std::pair<double, double> left = data[index - 1];
-            std::pair<double, double> mid = data[index];
-            std::pair<double, double> right = data[index + 1];
-            if (left.second < 0) left.second = 0;
-            if (mid.second < 0) mid.second = 0;
-            if (right.second < 0) right.second = 0;
-
-            double pmin = min(min(left.second, mid.second), right.second);
-            double denominator = left.second + mid.second + right.second - 3 * pmin;
+        if (index > 0 && index < int(point_count) - 1) {
+            double left = intensity[index - 1];
+            double mid = intensity[index];
+            double right = intensity[index + 1];
+            if (left < 0) left = 0;
+            if (mid < 0) mid = 0;
+            if (right < 0) right = 0;
+
+            double pmin = min(min(left, mid), right);
+            double denominator = left + mid + right - 3 * pmin;
             if (denominator > 1e-05){
-                //double new_mz = (left.first * left.second + mid.first * mid.second + right.first * right.second) / denominator;
-                //mid.first = new_mz;
-                //points.push_back(mid);
-                double new_mz = (left.first * (left.second - pmin) + mid.first * (mid.second - pmin) + right.first * (right.second - pmin)) / denominator;
-                mid.first = new_mz;
-                mid.second = index_list[ii].second;
-                centroided_out.push_back(mid);
+                double new_mz = (mz[index - 1] * (left - pmin) + mz[index] * (mid - pmin) + mz[index + 1] * (right - pmin)) / denominator;
+                centroided_out.push_back(std::pair<double, double>(new_mz, index_list[ii].second));
             } else {
-                centroided_out.push_back(std::pair<double, double>(data[index].first, index_list[ii].second));
+                centroided_out.push_back(std::pair<double, double>(mz[index], index_list[ii].second));
             }
         } else {
-            centroided_out.push_back(std::pair<double, double>(data[index].first, index_list[ii].second));
+            centroided_out.push_back(std::pair<double, double>(mz[index], index_list[ii].second));
         }
     }
 }
 
 // consolidate by merge radius
-void Centroid::consolidateMergeRadius(const std::vector<std::pair<double, double> > &data, double merge_radius, std::vector<std::pair<int, double> > &max_list)
+void Centroid::consolidateMergeRadius(const double *mz, const double *intensity, double merge_radius)
 {
-    std::vector<std::pair<int, double> > sorted_list; sorted_list.reserve(max_list.size());
+    std::vector<std::pair<int, double> > &max_list = m_max_list;
+    std::vector<std::pair<int, double> > &sorted_list = m_sorted_list;
+    sorted_list.clear();
     for (unsigned int ii = 0; ii < max_list.size(); ii++) {
         sorted_list.push_back(std::pair<int, double>(ii, max_list[ii].second));
     }
     std::sort(sorted_list.begin(), sorted_list.end(), sort_by_intens());
 
-    std::vector<int> remove; remove.resize(max_list.size());
+    std::vector<int> &remove = m_remove;
+    remove.assign(max_list.size(), 0);
     for (unsigned int ii = 0; ii < sorted_list.size(); ii++) {
         int idxi = sorted_list[ii].first; double vali = sorted_list[ii].second;
-        int idi = max_list[idxi].first; double mzi = data[idi].first;
+        int idi = max_list[idxi].first; double mzi = mz[idi];
         if (remove[idxi] == 0) {
             for (unsigned int jj = idxi + 1; jj < max_list.size(); jj++) {
-                int idj = max_list[jj].first; double mzj = data[idj].first;
+                int idj = max_list[jj].first; double mzj = mz[idj];
                 double dx = mzj - mzi;
                 if (dx > merge_radius)
                     break;
                 if (remove[jj] == 0) {
-                    double valj = data[idj].second;
+                    double valj = intensity[idj];
                     if (valj < vali - INTENSITY_THR)
                         remove[jj] = 1;
                 }
             }
             for (int jj = idxi - 1; jj >= 0; jj--) {
-                int idj = max_list[jj].first; double mzj = data[idj].first;
+                int idj = max_list[jj].first; double mzj = mz[idj];
                 double dx = mzi - mzj;
                 if (dx > merge_radius)
                     break;
                 if (remove[jj] == 0) {
-                    double valj = data[idj].second;
+                    double valj = intensity[idj];
                     if (valj < vali - INTENSITY_THR)
                         remove[jj] = 1;
                 }
             }
         }
     }
-    std::vector<std::pair<int, double> > updated_list;
+    size_t kept = 0;
     for (unsigned int ii = 0; ii < max_list.size(); ii++) {
         if (remove[ii] == 0) {
-            updated_list.push_back(max_list[ii]);
+            max_list[kept++] = max_list[ii];
         }
     }
-    max_list.clear();
-    max_list.swap(updated_list);
+    max_list.resize(kept);
 }
 
 // always rounding midpoint up (1.3->1, 1.5->2, 1.6->2) for positive val
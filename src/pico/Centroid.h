@@ -207,11 +207,23 @@ public:
                              const CentroidOptions &options,
                              std::vector<std::pair<double, double> > &centroided_out);
 
+    // smooth and centroid point_count points given as separate mz and intensity arrays, the input
+    // is not modified. The Gaussian table and the scratch buffers are kept between calls, so one
+    // object should be reused for many scans. The output is the same as of the overloads above.
+    bool smooth_and_centroid(const double *mz, const double *intensity, size_t point_count,
+                             const CentroidOptions &options,
+                             std::vector<std::pair<double, double> > &centroided_out);
+
     // gaussian smooth only - for debug or if needed for other purpose
     bool gaussian_smooth2(const std::vector<std::pair<double, double> > &in, double start_sigma, double end_sigma, const UncertaintyScaling uncertainty_type, const std::vector<double> &gaussian_table, std::vector<std::pair<int, double> > &smoothed_data);
 
 private:
-    // private vars -- none
+    // smooth and centroid arrays
+    bool smooth_and_centroid_arrays(const double *mz, const double *intensity, size_t point_count,
+                                    double start_sigma, double end_sigma,
+                                    const UncertaintyScaling uncertainty_type, int top_k,
+                                    double merge_radius, bool adjust_intensity, bool sort_mz,
+                                    std::vector<std::pair<double, double> > &centroided_out);
 
     // compute standard deviation
     inline bool compute_stdev(double mz, double uncertainty_value, UncertaintyScaling uncertainty_type, double &uncertainty);
@@ -220,10 +232,16 @@ private:
     inline double getGaussianValue(double mean, double std_dev, double x_position);
 
     // make gaussian table
-    inline std::vector<double> makeUnitGaussianTable(double range, int count);
+    static std::vector<double> makeUnitGaussianTable(double range, int count);
 
-    // compute max index list
-    inline std::vector<std::pair<int, double> > computeMaxIndexList2(const std::vector<std::pair<double, double> > &data, const std::vector<std::pair<int, double> > &smooth_data);
+    // gaussian table shared by all objects
+    static const std::vector<double> &unitGaussianTable();
+
+    // gaussian smooth arrays to m_smoothed_data, index of smoothed value is the index of the point
+    bool gaussianSmoothArrays(const double *mz, const double *intensity, ptrdiff_t in_size, double start_sigma, double end_sigma, const UncertaintyScaling uncertainty_type, const std::vector<double> &gaussian_table);
+
+    // compute max index list of m_smoothed_data to m_max_list
+    void computeMaxIndexList();
 
     // make points from index
     inline void makePointsFromIndex(const std::vector<std::pair<double, double> > &m_pointList, const std::vector<int> &index_list, std::vector<std::pair<double, double> > & points);
@@ -232,19 +250,27 @@ private:
     //inline void makePointsFromIndexWeightedAverageOfNeighbors(const std::vector<std::pair<double, double> > &m_pointList, const std::vector<int> &index_list, std::vector<std::pair<double, double> > & points);
 
     // restore intensity
-    inline void restoreIntensity(std::vector<std::pair<double, double> > &centroided_out, const std::vector<std::pair<double, double> > &data, double start_sigma, double end_sigma, const UncertaintyScaling uncertainty_type);
+    void restoreIntensity(std::vector<std::pair<double, double> > &centroided_out, const double *mz, const double *intensity, size_t point_count, double start_sigma, double end_sigma, const UncertaintyScaling uncertainty_type);
 
-    // retain only the top intesity points
-    inline void retainIntensePoints2(std::vector<std::pair<double, double> > &data, std::vector<std::pair<int, double> > &index_list, int top_k, bool sort_mz, std::vector<std::pair<double, double> > &centroided_out);
+    // retain only the top intesity points of m_max_list
+    void retainIntensePoints(const double *mz, const double *intensity, size_t point_count, int top_k, std::vector<std::pair<double, double> > &centroided_out);
 
     // remove duplicate points
     inline void removeDuplicatePoints(std::vector<std::pair<double, double> > & plist, bool do_sort_by_x, double fudge = 1e-15);
 
-    // consolidate by merge radius
-    void consolidateMergeRadius(const std::vector<std::pair<double, double> > &data, double merge_radius, std::vector<std::pair<int, double> > &max_list);
+    // consolidate m_max_list by merge radius
+    void consolidateMergeRadius(const double *mz, const double *intensity, double merge_radius);
 
     inline int my_round(double val);
 
+private:
+    // scratch buffers reused between calls
+    std::vector<double> m_mz;
+    std::vector<double> m_intensity;
+    std::vector<double> m_smoothed_data;
+    std::vector<std::pair<int, double> > m_max_list;
+    std::vector<std::pair<int, double> > m_sorted_list;
+    std::vector<int> m_remove;
 };
 
 #ifdef _MSC_VER
@@ -0,0 +1,348 @@
+/*
+ * Copyright (C) 2019 Protein Metrics Inc. - All Rights Reserved.
+ * Unauthorized copying or distribution of this file, via any medium is strictly prohibited.
+ * Confidential.
+ */
+
+#include "PicoDecodeKernels.h"
+
+#include <algorithm>
+#include <cstring>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define PICO_DECODE_KERNELS_X64
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+// SSE2 is part of x64, AVX kernels are compiled for AVX and only called when the cpu has it
+#if defined(__GNUC__)
+#define PICO_TARGET_AVX __attribute__((target("avx")))
+#define PICO_FORCE_INLINE inline __attribute__((always_inline))
+#else
+#define PICO_TARGET_AVX
+#define PICO_FORCE_INLINE __forceinline
+#endif
+
+_PICO_BEGIN
+
+namespace {
+
+// m/z code ranges of decodeAndCalibrateMzType1(): codes from RANGE_START are split in ranges of
+// RANGE_WIDTH, a code in range k decodes to code / 2^(21 - k) - offset, where the offset maps the
+// range start to 2^(5 + k), one less for range 8. Codes out of all ranges are clipped.
+const double RANGE_START = 872415232.0; // 0x34000000
+const double RANGE_WIDTH = 134217728.0; // 0x08000000
+const double RANGE_LAST = 9.0;
+const double RANGE_END = 2214592512.0; // 0x84000000
+const double RANGE_START_MZ_SCALE = 67108864.0; // 2^26, range start / 2^(21 - k) - 2^(5 + k)
+const int RANGE_EXPONENT_BIAS = 1023 - 21;
+const double MZ_LOWER_LIMIT = 32.0;
+const double MZ_UPPER_LIMIT = 32768.0;
+
+// calibration of decodeAndCalibrateMzType1(), coef is NULL without calibration
+struct Calibration
+{
+    const double* coef = NULL;
+    bool sqd = false;
+    bool mod = false;
+    const double* mod_coef = NULL;
+    size_t mod_count = 0;
+    bool mod_t0 = false;
+};
+
+DecodeKernelIsa detectDecodeKernelIsa()
+{
+#if !defined(PICO_DECODE_KERNELS_X64)
+    return DecodeKernelScalar;
+#elif defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    const bool osxsave = (info[2] & (1 << 27)) != 0;
+    const bool avx = (info[2] & (1 << 28)) != 0;
+    // the os has to save the ymm registers too
+    if (osxsave && avx && (_xgetbv(0) & 0x6) == 0x6) {
+        return DecodeKernelAvx;
+    }
+    return DecodeKernelSse2;
+#else
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx") ? DecodeKernelAvx : DecodeKernelSse2;
+#endif
+}
+
+DecodeKernelIsa usableIsa(DecodeKernelIsa isa)
+{
+    return std::min(isa, supportedDecodeKernelIsa());
+}
+
+void evaluateCentroidedMzScalar(const double* x_values, size_t count, double aa, double bb, double cc, double dd, double* out)
+{
+    for (size_t ii = 0; ii < count; ii++) {
+        const double x = x_values[ii];
+        const double k2 = x*x;
+        out[ii] = aa*x*k2+bb*k2+cc*x+dd;
+    }
+}
+
+#if defined(PICO_DECODE_KERNELS_X64)
+
+// ---- SSE2 ----
+
+PICO_FORCE_INLINE __m128d selectSse2(__m128d mask, __m128d a, __m128d b)
+{
+    return _mm_or_pd(_mm_and_pd(mask, a), _mm_andnot_pd(mask, b));
+}
+
+PICO_FORCE_INLINE __m128d centroidedMzSse2(__m128d x, __m128d aa, __m128d bb, __m128d cc, __m128d dd)
+{
+    const __m128d k2 = _mm_mul_pd(x, x);
+    __m128d v = _mm_mul_pd(_mm_mul_pd(aa, x), k2);
+    v = _mm_add_pd(v, _mm_mul_pd(bb, k2));
+    v = _mm_add_pd(v, _mm_mul_pd(cc, x));
+    return _mm_add_pd(v, dd);
+}
+
+void evaluateCentroidedMzSse2(const double* x_values, size_t count, double aa, double bb, double cc, double dd, double* out)
+{
+    const __m128d vaa = _mm_set1_pd(aa), vbb = _mm_set1_pd(bb), vcc = _mm_set1_pd(cc), vdd = _mm_set1_pd(dd);
+    size_t ii = 0;
+    for (; ii + 2 <= count; ii += 2) {
+        _mm_storeu_pd(out + ii, centroidedMzSse2(_mm_loadu_pd(x_values + ii), vaa, vbb, vcc, vdd));
+    }
+    if (ii < count) {
+        double tail[2] = { x_values[ii], 0.0 };
+        _mm_storeu_pd(tail, centroidedMzSse2(_mm_loadu_pd(tail), vaa, vbb, vcc, vdd));
+        out[ii] = tail[0];
+    }
+}
+
+PICO_FORCE_INLINE __m128d decodeMzSse2(__m128d code, const Calibration &calibration)
+{
+    __m128d range = _mm_mul_pd(_mm_sub_pd(code, _mm_set1_pd(RANGE_START)), _mm_set1_pd(1.0 / RANGE_WIDTH));
+    range = _mm_min_pd(_mm_max_pd(range, _mm_setzero_pd()), _mm_set1_pd(RANGE_LAST));
+    const __m128i index = _mm_cvttpd_epi32(range);
+    const __m128d k = _mm_cvtepi32_pd(index);
+    // 2^(k - 21) from its exponent bits, dividing by a power of 2 is the same as multiplying
+    const __m128i exponent = _mm_add_epi32(index, _mm_set1_epi32(RANGE_EXPONENT_BIAS));
+    const __m128d scale = _mm_castsi128_pd(_mm_slli_epi64(_mm_unpacklo_epi32(exponent, _mm_setzero_si128()), 52));
+    const __m128d start = _mm_add_pd(_mm_set1_pd(RANGE_START), _mm_mul_pd(k, _mm_set1_pd(RANGE_WIDTH)));
+    __m128d offset = _mm_sub_pd(_mm_mul_pd(start, scale), _mm_mul_pd(_mm_set1_pd(RANGE_START_MZ_SCALE), scale));
+    offset = _mm_sub_pd(offset, _mm_and_pd(_mm_cmpeq_pd(k, _mm_set1_pd(8.0)), _mm_set1_pd(1.0)));
+
+    __m128d val = _mm_sub_pd(_mm_mul_pd(code, scale), offset);
+    val = selectSse2(_mm_cmplt_pd(code, _mm_set1_pd(RANGE_START)), _mm_set1_pd(MZ_LOWER_LIMIT), val);
+    val = selectSse2(_mm_cmpge_pd(code, _mm_set1_pd(RANGE_END)), _mm_set1_pd(MZ_UPPER_LIMIT), val);
+
+    __m128d oval = val;
+    if (calibration.coef != NULL) {
+        const double* c = calibration.coef;
+        const __m128d val2 = _mm_mul_pd(val, val);
+        if (calibration.sqd) {
+            oval = _mm_sub_pd(_mm_set1_pd(c[0]), _mm_mul_pd(_mm_set1_pd(c[1]), val));
+            oval = _mm_add_pd(oval, _mm_mul_pd(_mm_set1_pd(c[2]), val2));
+            oval = _mm_add_pd(oval, _mm_mul_pd(_mm_mul_pd(_mm_set1_pd(c[3]), val2), val));
+            oval = _mm_add_pd(oval, _mm_mul_pd(_mm_mul_pd(_mm_set1_pd(c[4]), val2), val2));
+        } else {
+            const __m128d vsq = _mm_sqrt_pd(val);
+            oval = _mm_add_pd(_mm_set1_pd(c[0]), _mm_mul_pd(_mm_set1_pd(c[1]), vsq));
+            oval = _mm_add_pd(oval, _mm_mul_pd(_mm_set1_pd(c[2]), val));
+            oval = _mm_add_pd(oval, _mm_mul_pd(_mm_mul_pd(_mm_set1_pd(c[3]), vsq), val));
+            oval = _mm_add_pd(oval, _mm_mul_pd(_mm_set1_pd(c[4]), val2));
+            oval = _mm_add_pd(oval, _mm_mul_pd(_mm_mul_pd(_mm_set1_pd(c[5]), val2), vsq));
+            oval = _mm_mul_pd(oval, oval);
+        }
+        if (calibration.mod) {
+            const __m128d base = calibration.mod_t0 ? oval : _mm_sqrt_pd(oval);
+            __m128d power = _mm_set1_pd(1.0);
+            oval = _mm_setzero_pd();
+            for (size_t ii = 0; ii < calibration.mod_count; ii++) {
+                oval = _mm_add_pd(oval, _mm_mul_pd(_mm_set1_pd(calibration.mod_coef[ii]), power));
+                power = _mm_mul_pd(power, base);
+            }
+            if (!calibration.mod_t0) {
+                oval = _mm_mul_pd(oval, oval);
+            }
+        }
+    }
+    return selectSse2(_mm_cmpeq_pd(code, _mm_setzero_pd()), _mm_setzero_pd(), oval);
+}
+
+void decodeMzSse2(const double* codes, size_t count, const Calibration &calibration, double* out)
+{
+    size_t ii = 0;
+    for (; ii + 2 <= count; ii += 2) {
+        _mm_storeu_pd(out + ii, decodeMzSse2(_mm_loadu_pd(codes + ii), calibration));
+    }
+    if (ii < count) {
+        double tail[2] = { codes[ii], 0.0 };
+        _mm_storeu_pd(tail, decodeMzSse2(_mm_loadu_pd(tail), calibration));
+        out[ii] = tail[0];
+    }
+}
+
+// ---- AVX ----
+
+PICO_TARGET_AVX PICO_FORCE_INLINE __m256d centroidedMzAvx(__m256d x, __m256d aa, __m256d bb, __m256d cc, __m256d dd)
+{
+    const __m256d k2 = _mm256_mul_pd(x, x);
+    __m256d v = _mm256_mul_pd(_mm256_mul_pd(aa, x), k2);
+    v = _mm256_add_pd(v, _mm256_mul_pd(bb, k2));
+    v = _mm256_add_pd(v, _mm256_mul_pd(cc, x));
+    return _mm256_add_pd(v, dd);
+}
+
+PICO_TARGET_AVX void evaluateCentroidedMzAvx(const double* x_values, size_t count, double aa, double bb, double cc, double dd, double* out)
+{
+    const __m256d vaa = _mm256_set1_pd(aa), vbb = _mm256_set1_pd(bb), vcc = _mm256_set1_pd(cc), vdd = _mm256_set1_pd(dd);
+    size_t ii = 0;
+    for (; ii + 4 <= count; ii += 4) {
+        _mm256_storeu_pd(out + ii, centroidedMzAvx(_mm256_loadu_pd(x_values + ii), vaa, vbb, vcc, vdd));
+    }
+    if (ii < count) {
+        double tail[4] = { 0.0, 0.0, 0.0, 0.0 };
+        const size_t rest = count - ii;
+        memcpy(tail, x_values + ii, rest * sizeof(double));
+        _mm256_storeu_pd(tail, centroidedMzAvx(_mm256_loadu_pd(tail), vaa, vbb, vcc, vdd));
+        memcpy(out + ii, tail, rest * sizeof(double));
+    }
+    _mm256_zeroupper();
+}
+
+PICO_TARGET_AVX PICO_FORCE_INLINE __m256d decodeMzAvx(__m256d code, const Calibration &calibration)
+{
+    __m256d range = _mm256_mul_pd(_mm256_sub_pd(code, _mm256_set1_pd(RANGE_START)), _mm256_set1_pd(1.0 / RANGE_WIDTH));
+    range = _mm256_min_pd(_mm256_max_pd(range, _mm256_setzero_pd()), _mm256_set1_pd(RANGE_LAST));
+    const __m128i index = _mm256_cvttpd_epi32(range);
+    const __m256d k = _mm256_cvtepi32_pd(index);
+    // AVX has no 256 bit integer operations, the exponents are built in two halves
+    const __m128i exponent = _mm_add_epi32(index, _mm_set1_epi32(RANGE_EXPONENT_BIAS));
+    const __m128d scale_low = _mm_castsi128_pd(_mm_slli_epi64(_mm_unpacklo_epi32(exponent, _mm_setzero_si128()), 52));
+    const __m128d scale_high = _mm_castsi128_pd(_mm_slli_epi64(_mm_unpackhi_epi32(exponent, _mm_setzero_si128()), 52));
+    const __m256d scale = _mm256_insertf128_pd(_mm256_castpd128_pd256(scale_low), scale_high, 1);
+    const __m256d start = _mm256_add_pd(_mm256_set1_pd(RANGE_START), _mm256_mul_pd(k, _mm256_set1_pd(RANGE_WIDTH)));
+    __m256d offset = _mm256_sub_pd(_mm256_mul_pd(start, scale), _mm256_mul_pd(_mm256_set1_pd(RANGE_START_MZ_SCALE), scale));
+    offset = _mm256_sub_pd(offset, _mm256_and_pd(_mm256_cmp_pd(k, _mm256_set1_pd(8.0), _CMP_EQ_OQ), _mm256_set1_pd(1.0)));
+
+    __m256d val = _mm256_sub_pd(_mm256_mul_pd(code, scale), offset);
+    val = _mm256_blendv_pd(val, _mm256_set1_pd(MZ_LOWER_LIMIT), _mm256_cmp_pd(code, _mm256_set1_pd(RANGE_START), _CMP_LT_OQ));
+    val = _mm256_blendv_pd(val, _mm256_set1_pd(MZ_UPPER_LIMIT), _mm256_cmp_pd(code, _mm256_set1_pd(RANGE_END), _CMP_GE_OQ));
+
+    __m256d oval = val;
+    if (calibration.coef != NULL) {
+        const double* c = calibration.coef;
+        const __m256d val2 = _mm256_mul_pd(val, val);
+        if (calibration.sqd) {
+            oval = _mm256_sub_pd(_mm256_set1_pd(c[0]), _mm256_mul_pd(_mm256_set1_pd(c[1]), val));
+            oval = _mm256_add_pd(oval, _mm256_mul_pd(_mm256_set1_pd(c[2]), val2));
+            oval = _mm256_add_pd(oval, _mm256_mul_pd(_mm256_mul_pd(_mm256_set1_pd(c[3]), val2), val));
+            oval = _mm256_add_pd(oval, _mm256_mul_pd(_mm256_mul_pd(_mm256_set1_pd(c[4]), val2), val2));
+        } else {
+            const __m256d vsq = _mm256_sqrt_pd(val);
+            oval = _mm256_add_pd(_mm256_set1_pd(c[0]), _mm256_mul_pd(_mm256_set1_pd(c[1]), vsq));
+            oval = _mm256_add_pd(oval, _mm256_mul_pd(_mm256_set1_pd(c[2]), val));
+            oval = _mm256_add_pd(oval, _mm256_mul_pd(_mm256_mul_pd(_mm256_set1_pd(c[3]), vsq), val));
+            oval = _mm256_add_pd(oval, _mm256_mul_pd(_mm256_set1_pd(c[4]), val2));
+            oval = _mm256_add_pd(oval, _mm256_mul_pd(_mm256_mul_pd(_mm256_set1_pd(c[5]), val2), vsq));
+            oval = _mm256_mul_pd(oval, oval);
+        }
+        if (calibration.mod) {
+            const __m256d base = calibration.mod_t0 ? oval : _mm256_sqrt_pd(oval);
+            __m256d power = _mm256_set1_pd(1.0);
+            oval = _mm256_setzero_pd();
+            for (size_t ii = 0; ii < calibration.mod_count; ii++) {
+                oval = _mm256_add_pd(oval, _mm256_mul_pd(_mm256_set1_pd(calibration.mod_coef[ii]), power));
+                power = _mm256_mul_pd(power, base);
+            }
+            if (!calibration.mod_t0) {
+                oval = _mm256_mul_pd(oval, oval);
+            }
+        }
+    }
+    return _mm256_blendv_pd(oval, _mm256_setzero_pd(), _mm256_cmp_pd(code, _mm256_setzero_pd(), _CMP_EQ_OQ));
+}
+
+PICO_TARGET_AVX void decodeMzAvx(const double* codes, size_t count, const Calibration &calibration, double* out)
+{
+    size_t ii = 0;
+    for (; ii + 4 <= count; ii += 4) {
+        _mm256_storeu_pd(out + ii, decodeMzAvx(_mm256_loadu_pd(codes + ii), calibration));
+    }
+    if (ii < count) {
+        double tail[4] = { 0.0, 0.0, 0.0, 0.0 };
+        const size_t rest = count - ii;
+        memcpy(tail, codes + ii, rest * sizeof(double));
+        _mm256_storeu_pd(tail, decodeMzAvx(_mm256_loadu_pd(tail), calibration));
+        memcpy(out + ii, tail, rest * sizeof(double));
+    }
+    _mm256_zeroupper();
+}
+
+#endif // PICO_DECODE_KERNELS_X64
+
+} // namespace
+
+DecodeKernelIsa supportedDecodeKernelIsa()
+{
+    static const DecodeKernelIsa isa = detectDecodeKernelIsa();
+    return isa;
+}
+
+void centroidedMzType1Kernel(const double* x_values, size_t count, double aa, double bb, double cc, double dd,
+                             double* out, DecodeKernelIsa isa)
+{
+    switch (usableIsa(isa)) {
+#if defined(PICO_DECODE_KERNELS_X64)
+    case DecodeKernelAvx:
+        evaluateCentroidedMzAvx(x_values, count, aa, bb, cc, dd, out);
+        return;
+    case DecodeKernelSse2:
+        evaluateCentroidedMzSse2(x_values, count, aa, bb, cc, dd, out);
+        return;
+#endif
+    default:
+        evaluateCentroidedMzScalar(x_values, count, aa, bb, cc, dd, out);
+        return;
+    }
+}
+
+bool decodeAndCalibrateMzType1Kernel(const double* codes, size_t count, const std::vector<double> &calib_coefi,
+                                     const WatersCalibration::Coefficents *cal_mod_coef, double* out,
+                                     DecodeKernelIsa isa)
+{
+    isa = usableIsa(isa);
+    if (isa == DecodeKernelScalar) {
+        return false;
+    }
+
+    Calibration calibration;
+    if (!calib_coefi.empty()) {
+        calibration.coef = calib_coefi.data();
+        calibration.sqd = calib_coefi.size() > 1 && calib_coefi[1] < 0;
+        if (calib_coefi.size() < (calibration.sqd ? 5u : 6u)) {
+            return false;
+        }
+        if (cal_mod_coef != NULL && cal_mod_coef->type != WatersCalibration::CoefficentsType_None) {
+            calibration.mod = true;
+            calibration.mod_coef = cal_mod_coef->coeffients.data();
+            calibration.mod_count = cal_mod_coef->coeffients.size();
+            calibration.mod_t0 = cal_mod_coef->type == WatersCalibration::CoefficentsType_T0;
+        }
+    }
+
+#if defined(PICO_DECODE_KERNELS_X64)
+    if (isa == DecodeKernelAvx) {
+        decodeMzAvx(codes, count, calibration, out);
+    } else {
+        decodeMzSse2(codes, count, calibration, out);
+    }
+    return true;
+#else
+    (void)codes; (void)count; (void)out;
+    return false;
+#endif
+}
+
+_PICO_END
@@ -0,0 +1,47 @@
+/*
+ * Copyright (C) 2019 Protein Metrics Inc. - All Rights Reserved.
+ * Unauthorized copying or distribution of this file, via any medium is strictly prohibited.
+ * Confidential.
+ */
+
+#ifndef PICO_DECODE_KERNELS_H
+#define PICO_DECODE_KERNELS_H
+
+#include "PicoCommon.h"
+#include "WatersCalibration.h"
+
+#include <cstddef>
+#include <vector>
+
+_PICO_BEGIN
+
+// Vectorized stages of the Type1 decoders. The variable length codes are unpacked serially by the
+// decoders; the kernels evaluate the m/z polynomials for a whole scan at once. Every kernel does the
+// same double operations in the same order as the scalar code it replaces, so the results are bit
+// exact for any instruction set.
+
+enum DecodeKernelIsa
+{
+    DecodeKernelScalar = 0,
+    DecodeKernelSse2,
+    DecodeKernelAvx
+};
+
+// best instruction set of this cpu, detected once
+DecodeKernelIsa supportedDecodeKernelIsa();
+
+// out[i] = aa*x*x^2 + bb*x^2 + cc*x + dd for x = x_values[i], the m/z of centroided Type1 scans.
+// out may be x_values. An isa not supported by the cpu falls back to the best supported one.
+void centroidedMzType1Kernel(const double* x_values, size_t count, double aa, double bb, double cc, double dd,
+                             double* out, DecodeKernelIsa isa = supportedDecodeKernelIsa());
+
+// PicoLocalDecompress::decodeAndCalibrateMzType1() of count Waters m/z codes given as doubles, out
+// may be codes. Returns false without writing out if isa is scalar or the calibration has fewer
+// coefficients than the scalar decoder reads; the caller decodes with the scalar decoder then.
+bool decodeAndCalibrateMzType1Kernel(const double* codes, size_t count, const std::vector<double> &calib_coefi,
+                                     const WatersCalibration::Coefficents *cal_mod_coef, double* out,
+                                     DecodeKernelIsa isa = supportedDecodeKernelIsa());
+
+_PICO_END
+
+#endif
@@ -51,6 +51,7 @@
 #include "Centroid.h"
 #include "WatersCalibration.h"
 #include "PicoUtil.h"
+#include "PicoDecodeKernels.h"
 
 using namespace std;
 using namespace pico;
@@ -74,6 +75,47 @@ string commas2(unsigned long long n)
   return s;
 }
 
+double* DecompressBuffer::mzStorage(size_t size)
+{
+    // never empty, so the decoders get a valid pointer for empty scans as they do from malloc
+    size = max<size_t>(size, 1);
+    if (m_mzCapacity < size) {
+        m_mz.reset(new double[size]);
+        m_mzCapacity = size;
+    }
+    return m_mz.get();
+}
+
+float* DecompressBuffer::intensityStorage(size_t size, bool zeroed)
+{
+    size = max<size_t>(size, 1);
+    if (m_intensityCapacity < size) {
+        m_intensity.reset(new float[size]);
+        m_intensityCapacity = size;
+    }
+    if (zeroed)
+        std::fill(m_intensity.get(), m_intensity.get() + size, 0.0f);
+    return m_intensity.get();
+}
+
+// restored m/z array of the spectra decoders, malloc'ed for the caller to free when there is no buffer
+static double* allocateRestoredMz(DecompressBuffer* buffer, size_t size, bool zeroed)
+{
+    if (buffer == NULL)
+        return zeroed ? (double*)calloc(size, sizeof(double)) : (double*)malloc(size*sizeof(double));
+    double* mz = buffer->mzStorage(size);
+    if (zeroed)
+        std::fill(mz, mz + size, 0.0);
+    return mz;
+}
+
+static float* allocateRestoredIntensity(DecompressBuffer* buffer, size_t size, bool zeroed)
+{
+    if (buffer == NULL)
+        return zeroed ? (float*)calloc(size, sizeof(float)) : (float*)malloc(size*sizeof(float));
+    return buffer->intensityStorage(size, zeroed);
+}
+
 PicoLocalDecompress::PicoLocalDecompress()
 {
     //LSB_FACTOR = 4;
@@ -845,7 +887,22 @@ bool PicoLocalDecompress::decompressType4(const wstring &input_compressed_db_fil
 // decompress type 0 spectra
 bool PicoLocalDecompress::decompressSpectraType0(unsigned char** compressed, double** restored_mz, float** restored_intensity, int* length) const
 {
-    unsigned char* ptr = *compressed; 
+    return decompressSpectraType0(*compressed, restored_mz, restored_intensity, length, NULL);
+}
+
+bool PicoLocalDecompress::decompressSpectraType0(const unsigned char* compressed, DecompressBuffer* buffer) const
+{
+    double* restored_mz = NULL; float* restored_intensity = NULL; int length = 0;
+    buffer->clear();
+    if (!decompressSpectraType0(const_cast<unsigned char*>(compressed), &restored_mz, &restored_intensity, &length, buffer))
+        return false;
+    buffer->setLength(length);
+    return true;
+}
+
+bool PicoLocalDecompress::decompressSpectraType0(unsigned char* compressed, double** restored_mz, float** restored_intensity, int* length, DecompressBuffer* buffer) const
+{
+    unsigned char* ptr = compressed; 
     unsigned int restored_mz_size = *(unsigned int*)ptr; ptr+=4; *length = restored_mz_size; 
     double restored_b0 = *(double*)ptr; ptr+=8; 
     double restored_b1 = *(double*)ptr; ptr+=8; 
@@ -880,7 +937,7 @@ bool PicoLocalDecompress::decompressSpectraType0(unsigned char** compressed, dou
 
         
     // --------- decompress scan -----
-    *restored_mz = (double *)malloc(restored_mz_size*sizeof(double)); 
+    *restored_mz = allocateRestoredMz(buffer, restored_mz_size, false);
     if (*restored_mz==NULL){
         std::cout << "null mz buf alloc" << endl; return false; 
     }
@@ -891,7 +948,7 @@ bool PicoLocalDecompress::decompressSpectraType0(unsigned char** compressed, dou
         
     unsigned int current = 0;
     unsigned int indices_size = *(unsigned int*)ptr; ptr+=4; 
-    *restored_intensity = (float *)calloc(restored_mz_size, sizeof(float));
+    *restored_intensity = allocateRestoredIntensity(buffer, restored_mz_size, true);
     if (*restored_intensity==NULL){
         std::cout << "null intensity buf alloc" << endl; return false; 
     }
@@ -926,10 +983,25 @@ bool PicoLocalDecompress::decompressSpectraType0(unsigned char** compressed, dou
     return true;
 }
 
-// decompress type 0 spectra
+// decompress type 02 spectra
 bool PicoLocalDecompress::decompressSpectraType02(unsigned char** compressed, double** restored_mz, float** restored_intensity, int* length)
 {
-    unsigned char* ptd = *compressed; 
+    return decompressSpectraType02(*compressed, restored_mz, restored_intensity, length, NULL);
+}
+
+bool PicoLocalDecompress::decompressSpectraType02(const unsigned char* compressed, DecompressBuffer* buffer) const
+{
+    double* restored_mz = NULL; float* restored_intensity = NULL; int length = 0;
+    buffer->clear();
+    if (!decompressSpectraType02(const_cast<unsigned char*>(compressed), &restored_mz, &restored_intensity, &length, buffer))
+        return false;
+    buffer->setLength(length);
+    return true;
+}
+
+bool PicoLocalDecompress::decompressSpectraType02(unsigned char* compressed, double** restored_mz, float** restored_intensity, int* length, DecompressBuffer* buffer) const
+{
+    unsigned char* ptd = compressed; 
     unsigned int restored_mz_size = *(unsigned int*)ptd; ptd+=4; *length = restored_mz_size; 
     double restored_b0 = *(double*)ptd; ptd+=8; 
     double restored_b1 = *(double*)ptd; ptd+=8; 
@@ -953,7 +1025,7 @@ bool PicoLocalDecompress::decompressSpectraType02(unsigned char** compressed, do
     }
 
     // --------- decompress scan -----
-    *restored_mz = (double *)malloc(restored_mz_size*sizeof(double)); 
+    *restored_mz = allocateRestoredMz(buffer, restored_mz_size, false);
     if (*restored_mz==NULL){
         std::cout << "null mz buf alloc" << endl; return false; 
     }
@@ -962,7 +1034,7 @@ bool PicoLocalDecompress::decompressSpectraType02(unsigned char** compressed, do
         (*restored_mz)[ii] = val;
     }
         
-    *restored_intensity = (float *)calloc(restored_mz_size, sizeof(float));
+    *restored_intensity = allocateRestoredIntensity(buffer, restored_mz_size, true);
     if (*restored_intensity==NULL){
         std::cout << "null intensity buf alloc" << endl; return false; 
     }
@@ -1104,6 +1176,27 @@ bool PicoLocalDecompress::decompressSpectraType1(unsigned char** compressed_mz,
     }
 }
 
+bool PicoLocalDecompress::decompressSpectraType1(const unsigned char* compressed_mz, const unsigned char* compressed_intensity, const WatersCalibration::Coefficents *cal_mod_coef, int compress_info_id, unsigned int compressed_length, DecompressBuffer* buffer, bool restore_zero_peaks) const
+{
+    if (compress_info_id==WATERS_READER_INFO_ID){ // reader profile compression
+        return decompressRawType1_N(compressed_mz, cal_mod_coef, buffer, restore_zero_peaks);
+
+    } else if (compress_info_id==WATERS_READER_CENTROIDED_INFO_ID){ // reader centroid compression
+        return decompressSpectraCentroidedType1(compressed_mz, compressed_intensity, buffer);
+
+    } else if (compress_info_id==WATERS_CENTROID_NO_COMPRESSION_ID){ // reader centroid, no_compression
+        // the blobs are the restored arrays, copied as the buffer owns its data
+        const int length = compressed_length/8;
+        std::copy((const double *)compressed_mz, (const double *)compressed_mz + length, buffer->mzStorage(length));
+        std::copy((const float *)compressed_intensity, (const float *)compressed_intensity + length, buffer->intensityStorage(length, false));
+        buffer->setLength(length);
+        return true;
+
+    } else {
+        cout << "unrecognized compress_info_id tag=" << compress_info_id << endl; return false;
+    }
+}
+
 bool PicoLocalDecompress::decompressMzType1(unsigned char** compressed, double** restored_mz, int* length) const
 {
     unsigned char* ptd = *compressed;
@@ -1122,10 +1215,10 @@ bool PicoLocalDecompress::decompressMzType1(unsigned char** compressed, double**
     }
 
     // ----- dict ---------
-    map<unsigned short, unsigned short> hmpd; 
+    std::vector<unsigned short> hmpd; // dictionary, the keys are the indices
     for (unsigned short ii=0; ii<dictd_len/2; ii++){
         unsigned short vali = *(unsigned short*)ptd; ptd+=2;
-        hmpd.insert(std::pair<unsigned short, unsigned short>(static_cast<unsigned short>(hmpd.size()), vali));
+        hmpd.push_back(vali);
     }
 
     // -------- base --------
@@ -1217,7 +1310,7 @@ bool PicoLocalDecompress::decompressMzType1(unsigned char** compressed, double**
     double * ptv = *restored_mz; *ptv++ = d_pos;
     for (unsigned int ii=1; ii<mzd_len; ii++){
         unsigned short idx = base1[ii-1];
-        unsigned short vid = hmpd[idx];
+        unsigned short vid = idx < hmpd.size() ? hmpd[idx] : 0;
         double vali = (double)vid/32768.0;
         double step = d_pos + vali;
         *ptv++ = step; 
@@ -1232,7 +1325,7 @@ bool PicoLocalDecompress::decompressIntensityType1(unsigned char** compressed, f
     unsigned int restored_mz_size = *(unsigned int*)ptr; ptr+=4;
     *length = (int)restored_mz_size;
     
-    map<unsigned int, unsigned int> hmap_intens; 
+    std::vector<unsigned int> hmap_intens; // dictionary, the keys are the indices
     bool hflag = false; unsigned char hold = 0;
     unsigned int idz = *(unsigned int*)ptr; ptr+=4;
     unsigned int idz1 = *(unsigned int*)ptr; ptr+=4;
@@ -1244,11 +1337,11 @@ bool PicoLocalDecompress::decompressIntensityType1(unsigned char** compressed, f
             unsigned int val1 = *(unsigned char*)ptr; ptr++;
             unsigned int val = *(unsigned char*)ptr; ptr++;
             hold = (unsigned char)(val&0x0F); 
-            val = (val1<<4) | (val>>4); hmap_intens.insert(std::pair<unsigned int, unsigned int>(ii, val)); hflag = true; 
+            val = (val1<<4) | (val>>4); hmap_intens.push_back(val); hflag = true; 
         } else {
             unsigned int val1 = *(unsigned char*)ptr; ptr++;
             unsigned int val = val1 | (((unsigned int)hold)<<8);
-            hmap_intens.insert(std::pair<unsigned int, unsigned int>(ii, val)); hflag = false; 
+            hmap_intens.push_back(val); hflag = false; 
         }
     }
 
@@ -1256,20 +1349,19 @@ bool PicoLocalDecompress::decompressIntensityType1(unsigned char** compressed, f
     for (unsigned int ii = 0; ii < min(idz1, total_cnt); ii++) {
         unsigned int val = *(unsigned int *)ptr;
         ptr += 4;
-        hmap_intens.insert(std::pair<unsigned int, unsigned int>(
-            static_cast<unsigned int>(hmap_intens.size()), val));
+        hmap_intens.push_back(val);
     }
 
     for (unsigned int ii=0; ii<min(idz2,total_cnt); ii++){
         if (!hflag){
             unsigned int val = *(unsigned int*)ptr; ptr+=4; val <<= 4;
             hold = *(unsigned char*)ptr; ptr++;
-            val |= (hold>>4); hmap_intens.insert(std::pair<unsigned int, unsigned int>(static_cast<unsigned int>(hmap_intens.size()), val)); 
+            val |= (hold>>4); hmap_intens.push_back(val); 
             hflag = true; 
         } else {
             unsigned int val = *(unsigned int*)ptr; ptr+=4; 
             unsigned int val1 = (hold & 0x0F); 
-            val |= (val1<<16); hmap_intens.insert(std::pair<unsigned int, unsigned int>(static_cast<unsigned int>(hmap_intens.size()), val));
+            val |= (val1<<16); hmap_intens.push_back(val);
             hflag = false; 
         }
     }
@@ -1278,7 +1370,7 @@ bool PicoLocalDecompress::decompressIntensityType1(unsigned char** compressed, f
     for (unsigned int ii=idz+idz1+idz2; ii<total_cnt; ii++){
         unsigned int val1 = *(unsigned short*)ptr; ptr+=2; 
         unsigned int val = *(unsigned int*)ptr; ptr+=4; 
-        val |= (val1<<16); hmap_intens.insert(std::pair<unsigned int, unsigned int>(static_cast<unsigned int>(hmap_intens.size()), val));
+        val |= (val1<<16); hmap_intens.push_back(val);
     }
 
     // --------- decompress scan -----
@@ -1330,7 +1422,7 @@ bool PicoLocalDecompress::decompressIntensityType1(unsigned char** compressed, f
             }
         }
         
-        unsigned int cword = hmap_intens[val]; 
+        unsigned int cword = val < hmap_intens.size() ? hmap_intens[val] : 0; 
         unsigned int del = cword & 0x03; unsigned int intens = cword >> 2; 
         if (ii>0)
             del++; 
@@ -1400,15 +1492,34 @@ bool PicoLocalDecompress::decompressSpectraCentroidedType1(unsigned char** compr
     return true;
 }
 
+bool PicoLocalDecompress::decompressSpectraCentroidedType1(const unsigned char* compressed_mz, const unsigned char* compressed_intensity, DecompressBuffer* buffer) const
+{
+    double* restored_mz = NULL; float* restored_intensity = NULL; int length = 0, intens_length = 0;
+    buffer->clear();
+    if (!decompressMzCentroidedType1(const_cast<unsigned char*>(compressed_mz), &restored_mz, &length, buffer)){
+        return false;
+    }
+    if (!decompressIntensityCentroidedType1(const_cast<unsigned char*>(compressed_intensity), &restored_intensity, &intens_length, buffer)){
+        return false;
+    }
+    buffer->setLength(length);
+    return true;
+}
+
 // decompress mz centroided Type1 
 bool PicoLocalDecompress::decompressMzCentroidedType1(unsigned char** compressed, double** restored_mz, int* length) const
 {
-    unsigned char* ptd = *compressed;
+    return decompressMzCentroidedType1(*compressed, restored_mz, length, NULL);
+}
+
+bool PicoLocalDecompress::decompressMzCentroidedType1(unsigned char* compressed, double** restored_mz, int* length, DecompressBuffer* buffer) const
+{
+    unsigned char* ptd = compressed;
     unsigned int mz_len1 = *(unsigned int *)ptd; ptd+=4; 
 
     if ((mz_len1&0x80000000)>0){ // no compression
         mz_len1 &= 0x7FFFFFFF; *length = (int)mz_len1;
-        *restored_mz = (double*)malloc((mz_len1+1)*sizeof(double)); 
+        *restored_mz = allocateRestoredMz(buffer, mz_len1+1, false);
         if (*restored_mz==NULL){
             if (verbose) std::cout << "compressed mz buf allocation failed" << endl; return false;
         }
@@ -1425,7 +1536,7 @@ bool PicoLocalDecompress::decompressMzCentroidedType1(unsigned char** compressed
     double dd0 = *(double *)ptd; ptd+=8;
     unsigned int k_min = *(unsigned int *)ptd; ptd+=4;
 
-    *restored_mz = (double*)malloc((mz_len1+1)*sizeof(double)); 
+    *restored_mz = allocateRestoredMz(buffer, mz_len1+1, false);
     if (*restored_mz==NULL){
         if (verbose) std::cout << "compressed mz buf allocation failed" << endl; return false;
     }
@@ -1553,13 +1664,13 @@ bool PicoLocalDecompress::decompressMzCentroidedType1(unsigned char** compressed
         inc += k_min;
         cnt++;
         cur += inc;
-        double k2 = (double)cur*cur;
-        double vali = aa0*cur*k2+bb0*k2+cc0*cur+dd0;
         if (cnt > (int)mz_len1){
             if (verbose) std::cout << "cur index exceeded m/z range" << endl;
         } else
-            (*restored_mz)[cnt] = vali;
+            (*restored_mz)[cnt] = (double)cur;
     }
+    // the codes are unpacked serially, the polynomial is evaluated for the whole scan at once
+    centroidedMzType1Kernel(*restored_mz + 1, (size_t)cnt, aa0, bb0, cc0, dd0, *restored_mz + 1);
     //int compressed_mz_length = ptd - *compressed;
     return true;
 }
@@ -1567,12 +1678,17 @@ bool PicoLocalDecompress::decompressMzCentroidedType1(unsigned char** compressed
 // decompress intensity centroided Type1 
 bool PicoLocalDecompress::decompressIntensityCentroidedType1(unsigned char** compressed, float** restored_intensity, int* length) const
 {
-    unsigned char* ptd = *compressed;
+    return decompressIntensityCentroidedType1(*compressed, restored_intensity, length, NULL);
+}
+
+bool PicoLocalDecompress::decompressIntensityCentroidedType1(unsigned char* compressed, float** restored_intensity, int* length, DecompressBuffer* buffer) const
+{
+    unsigned char* ptd = compressed;
     unsigned int mz_len1 = *(unsigned int *)ptd; ptd+=4;  
 
     if ((mz_len1&0x80000000)>0){ // no compression
         mz_len1 &= 0x7FFFFFFF; *length = (int)mz_len1;
-        *restored_intensity = (float*)malloc((mz_len1+1)*sizeof(float)); 
+        *restored_intensity = allocateRestoredIntensity(buffer, mz_len1+1, false);
         if (*restored_intensity==NULL){
             if (verbose) std::cout << "restores mz buf allocation failed" << endl; return false;
         }
@@ -1588,13 +1704,13 @@ bool PicoLocalDecompress::decompressIntensityCentroidedType1(unsigned char** com
     unsigned short hop_size = *(unsigned short *)ptd; ptd+=2;
     int scale_fact = *ptd++;
 
-    *restored_intensity = (float*)malloc((mz_len1+1)*sizeof(float)); 
+    *restored_intensity = allocateRestoredIntensity(buffer, mz_len1+1, false);
     if (*restored_intensity==NULL){
         if (verbose) std::cout << "compressed intensity buf allocation failed" << endl; return false;
     }
 
     // ---- dict ---------
-    map<unsigned int, unsigned int> hm9; 
+    std::vector<unsigned int> hm9; // dictionary, the keys are the indices
     bool hflag = false; unsigned char hold = 0;
     //unsigned int cur = 0;
     unsigned int inc = 0; int cnt = 0;
@@ -1734,7 +1850,7 @@ bool PicoLocalDecompress::decompressIntensityCentroidedType1(unsigned char** com
             }
         }
         unsigned int zi = inc*scale_fact + min_intens; cnt++; 
-        hm9.insert(std::pair<unsigned int, unsigned int>(static_cast<unsigned int>(hm9.size()), zi));
+        hm9.push_back(zi);
     }
 
     // ---- indices ---------
@@ -1877,7 +1993,7 @@ bool PicoLocalDecompress::decompressIntensityCentroidedType1(unsigned char** com
                 }
             }
         }
-        unsigned int zi = hm9[inc];  
+        unsigned int zi = inc < hm9.size() ? hm9[inc] : 0;  
         if (cnt>=(int)mz_len1){
             if (verbose) std::cout << "intensity index exceeded range" << endl; 
         } else {
@@ -1894,6 +2010,21 @@ bool PicoLocalDecompress::decompressIntensityCentroidedType1(unsigned char** com
 
 // decompress raw file type 4 (ABSciex)
 bool PicoLocalDecompress::decompressRawType4(unsigned char* compressed, int /*compressed_length*/, double** restored_mz, float** restored_intensity, int* restored_mz_length, bool /*restore_zero_peaks*/) const
+{
+    return decompressRawType4(compressed, restored_mz, restored_intensity, restored_mz_length, NULL);
+}
+
+bool PicoLocalDecompress::decompressRawType4(const unsigned char* compressed, int /*compressed_length*/, DecompressBuffer* buffer, bool /*restore_zero_peaks*/) const
+{
+    double* restored_mz = NULL; float* restored_intensity = NULL; int length = 0;
+    buffer->clear();
+    if (!decompressRawType4(const_cast<unsigned char*>(compressed), &restored_mz, &restored_intensity, &length, buffer))
+        return false;
+    buffer->setLength(length);
+    return true;
+}
+
+bool PicoLocalDecompress::decompressRawType4(unsigned char* compressed, double** restored_mz, float** restored_intensity, int* restored_mz_length, DecompressBuffer* buffer) const
 {
         // ------- decompress ---------
     double mz0d = *(double*)(compressed);
@@ -1906,12 +2037,12 @@ bool PicoLocalDecompress::decompressRawType4(unsigned char* compressed, int /*co
     unsigned short levelsd = *(unsigned short*)(compressed+52);
     unsigned int mzd_len = *(unsigned int*)(compressed+54);
 
-    *restored_mz = (double*)calloc(((int)(mzd_len*1.2)), sizeof(double)); 
+    *restored_mz = allocateRestoredMz(buffer, (int)(mzd_len*1.2), true);
     if (*restored_mz==NULL){
         if (verbose) std::cout << "decompress mz buf allocation failed" << endl; return false;
     }
 
-    *restored_intensity = (float*)calloc(((int)(mzd_len*1.2)), sizeof(float)); 
+    *restored_intensity = allocateRestoredIntensity(buffer, (int)(mzd_len*1.2), true);
     if (*restored_intensity==NULL){
         if (verbose) std::cout << "decompress intensity buf allocation failed" << endl; return false;
     }
@@ -2144,6 +2275,21 @@ bool PicoLocalDecompress::decompressRawType4(unsigned char* compressed, int /*co
 
 // decompress raw type 1 memory to memory (Waters)
 bool PicoLocalDecompress::decompressRawType1_N(unsigned char* compressed, const WatersCalibration::Coefficents *cal_mod_coef, double** restored_mz, float** restored_intensity, int* restored_mz_length, bool restore_zero_peaks, const bool file_decompress) const
+{
+    return decompressRawType1_N(compressed, cal_mod_coef, restored_mz, restored_intensity, restored_mz_length, restore_zero_peaks, file_decompress, NULL);
+}
+
+bool PicoLocalDecompress::decompressRawType1_N(const unsigned char* compressed, const WatersCalibration::Coefficents *cal_mod_coef, DecompressBuffer* buffer, bool restore_zero_peaks) const
+{
+    double* restored_mz = NULL; float* restored_intensity = NULL; int length = 0;
+    buffer->clear();
+    if (!decompressRawType1_N(const_cast<unsigned char*>(compressed), cal_mod_coef, &restored_mz, &restored_intensity, &length, restore_zero_peaks, false, buffer))
+        return false;
+    buffer->setLength(length);
+    return true;
+}
+
+bool PicoLocalDecompress::decompressRawType1_N(unsigned char* compressed, const WatersCalibration::Coefficents *cal_mod_coef, double** restored_mz, float** restored_intensity, int* restored_mz_length, bool restore_zero_peaks, const bool file_decompress, DecompressBuffer* buffer) const
 {
     const int steps_size = 12;
     const unsigned int steps[] = { 3520, 2496, 1768, 1248, 880, 624, 440, 312, 256, 0, 0, 0 };
@@ -2170,11 +2316,11 @@ bool PicoLocalDecompress::decompressRawType1_N(unsigned char* compressed, const
 
         if (!restore_zero_peaks){ // -- no need to restore zeros
 
-            *restored_mz = (double*)malloc((size_t)(base_len_intens*sizeof(double)));
+            *restored_mz = allocateRestoredMz(buffer, base_len_intens, false);
             if (*restored_mz == NULL){
                 if (verbose) std::cout << "compressed mz buf allocation failed" << endl; return false;
             }
-            *restored_intensity = (float*)malloc((size_t)(base_len_intens*sizeof(float)));
+            *restored_intensity = allocateRestoredIntensity(buffer, base_len_intens, false);
             if (*restored_intensity == NULL){
                 if (verbose) std::cout << "compressed mz buf allocation failed" << endl; return false;
             }
@@ -2183,12 +2329,12 @@ bool PicoLocalDecompress::decompressRawType1_N(unsigned char* compressed, const
             for (int ii = 0; ii < (int)base_len_intens; ii++){
                 unsigned int mziu = prev_mz + *(unsigned int *)ptd; ptd += 4;
                 prev_mz = mziu;
-                double mzi = decodeAndCalibrateMzType1(mziu, calib_coefi, cal_mod_coef);
-                (*restored_mz)[ii] = mzi;
+                (*restored_mz)[ii] = (double)mziu;
 
                 unsigned int intensi = *(unsigned int *)ptd; ptd += 4;
                 (*restored_intensity)[ii] = (float)intensi;
             }
+            decodeAndCalibrateMzType1(*restored_mz, base_len_intens, calib_coefi, cal_mod_coef);
             return true;
         }
 
@@ -2227,17 +2373,19 @@ bool PicoLocalDecompress::decompressRawType1_N(unsigned char* compressed, const
         // restore zeros
         // -------- convert to double mz -----------
         std::vector<double> dbl_mz, delta_mz; std::vector<unsigned int> intense;
-        unsigned int prev_mzh = *(unsigned int *)ptd; ptd += 4;
-        double prev_mz = decodeAndCalibrateMzType1(prev_mzh, calib_coefi, cal_mod_coef); dbl_mz.push_back(prev_mz);
+        dbl_mz.reserve(base_len_intens); intense.reserve(base_len_intens);
+        unsigned int prev_mzh = *(unsigned int *)ptd; ptd += 4; dbl_mz.push_back((double)prev_mzh);
         unsigned int prev_intensi = *(unsigned int *)ptd; ptd += 4; intense.push_back(prev_intensi);
         for (int ii = 1; ii < (int)base_len_intens; ii++){
             unsigned int mziu = prev_mzh + *(unsigned int *)ptd; ptd += 4;
-            prev_mzh = mziu;
-            double mzi = decodeAndCalibrateMzType1(mziu, calib_coefi, cal_mod_coef); dbl_mz.push_back(mzi);
-            delta_mz.push_back(mzi - prev_mz);
-            prev_mz = mzi;
+            prev_mzh = mziu; dbl_mz.push_back((double)mziu);
             unsigned int intensi = *(unsigned int *)ptd; ptd += 4; intense.push_back(intensi);
         }
+        decodeAndCalibrateMzType1(dbl_mz.data(), dbl_mz.size(), calib_coefi, cal_mod_coef);
+        delta_mz.reserve(dbl_mz.size());
+        for (size_t ii = 1; ii < dbl_mz.size(); ii++){
+            delta_mz.push_back(dbl_mz[ii] - dbl_mz[ii - 1]);
+        }
 
         // restore zeros
         std::vector<double> restore_dbl_mzs; std::vector<unsigned int> restore_intens;
@@ -2264,12 +2412,12 @@ bool PicoLocalDecompress::decompressRawType1_N(unsigned char* compressed, const
             free_safe(data);
             dbl_mz.clear(); intense.clear();
 
-            *restored_intensity = (float*)malloc(restore_intens.size()*sizeof(float));
+            *restored_intensity = allocateRestoredIntensity(buffer, restore_intens.size(), false);
             if (*restored_intensity == NULL){
                 if (verbose) std::cout << "decomp intensity buf allocation failed" << endl; return false;
             }
 
-            *restored_mz = (double*)malloc(restore_dbl_mzs.size()*sizeof(double));
+            *restored_mz = allocateRestoredMz(buffer, restore_dbl_mzs.size(), false);
             if (*restored_mz == NULL){
                 cout << "decomp mz buf alloc failed" << endl; return false;
             }
@@ -2404,11 +2552,11 @@ bool PicoLocalDecompress::decompressRawType1_N(unsigned char* compressed, const
                 prev_dbl_mz = mzi; prev_intens = intensi;
             }
 
-            *restored_mz = (double*)malloc((size_t)(dbl_mz_final.size()*sizeof(double)));
+            *restored_mz = allocateRestoredMz(buffer, dbl_mz_final.size(), false);
             if (*restored_mz == NULL){
                 if (verbose) std::cout << "compressed mz buf allocation failed" << endl; return false;
             }
-            *restored_intensity = (float*)malloc((size_t)(dbl_mz_final.size()*sizeof(float)));
+            *restored_intensity = allocateRestoredIntensity(buffer, dbl_mz_final.size(), false);
             if (*restored_intensity == NULL){
                 if (verbose) std::cout << "compressed mz buf allocation failed" << endl; return false;
             }
@@ -3127,11 +3275,17 @@ bool PicoLocalDecompress::decompressRawType1_N(unsigned char* compressed, const
     // -------- no need to restore zeros: convert to double mz output -----------
     cur = mz0d; 
     if (!restore_zero_peaks){ // -- no need to restore zeros
-        double mzv = decodeAndCalibrateMzType1(mz0d, calib_coefi, cal_mod_coef); (*restored_mz)[0] = mzv;
+        *restored_mz = allocateRestoredMz(buffer, base00.size(), false);
+        *restored_intensity = allocateRestoredIntensity(buffer, base00.size(), false);
+        if (*restored_mz == NULL || *restored_intensity == NULL){
+            if (verbose) std::cout << "decompress buf allocation failed" << endl; return false;
+        }
+        (*restored_mz)[0] = (double)mz0d;
         for (unsigned int ii=1; ii<base00.size(); ii++){
             unsigned int val = base00[ii]; cur += val;
-            mzv = decodeAndCalibrateMzType1(cur, calib_coefi, cal_mod_coef); (*restored_mz)[ii] = mzv;
+            (*restored_mz)[ii] = (double)cur;
         }
+        decodeAndCalibrateMzType1(*restored_mz, base00.size(), calib_coefi, cal_mod_coef);
         for (unsigned int ii=0; ii<base00.size(); ii++){
             unsigned int restored_intensi = base_intens[ii]; // decodeIntensityType1(base_intens[ii]);
             (*restored_intensity)[ii] = (float)restored_intensi;
@@ -3143,18 +3297,16 @@ bool PicoLocalDecompress::decompressRawType1_N(unsigned char* compressed, const
     // restore zeros
     // -------- convert to double mz -----------
     std::vector<double> dbl_mz, delta_mz; cur=mz0d; //std::vector<unsigned int> intense; //base_intens[]
-    double prev_mz = decodeAndCalibrateMzType1(mz0d, calib_coefi, cal_mod_coef); dbl_mz.push_back(prev_mz);
     unsigned int lenx = static_cast<unsigned int>(base00.size()); if (base00[lenx-1]==0) lenx--;
+    dbl_mz.reserve(std::max(lenx, 1u)); dbl_mz.push_back((double)mz0d);
     for (unsigned int ii=1; ii<lenx; ii++){ //base00.size()
         unsigned int val = base00[ii]; cur += val;
-        //if (ii>108974)
-        //    ii+=0;
-        double mzv = decodeAndCalibrateMzType1(cur, calib_coefi, cal_mod_coef); dbl_mz.push_back(mzv);
-        double del = mzv-prev_mz;
-        if (del<0)
-            ii+=0;
-        delta_mz.push_back(del);
-        prev_mz = mzv;
+        dbl_mz.push_back((double)cur);
+    }
+    decodeAndCalibrateMzType1(dbl_mz.data(), dbl_mz.size(), calib_coefi, cal_mod_coef);
+    delta_mz.reserve(dbl_mz.size());
+    for (size_t ii=1; ii<dbl_mz.size(); ii++){
+        delta_mz.push_back(dbl_mz[ii]-dbl_mz[ii-1]);
     }
 
     // restore zeros
@@ -3306,12 +3458,12 @@ bool PicoLocalDecompress::decompressRawType1_N(unsigned char* compressed, const
 
     }
 
-    *restored_intensity = (float*)malloc(restore_intens.size()*sizeof(float));
+    *restored_intensity = allocateRestoredIntensity(buffer, restore_intens.size(), false);
     if (*restored_intensity == NULL){
         if (verbose) std::cout << "decomp intensity buf allocation failed" << endl; return false;
     }
 
-    *restored_mz = (double*)malloc(restore_dbl_mzs.size()*sizeof(double));
+    *restored_mz = allocateRestoredMz(buffer, restore_dbl_mzs.size(), false);
     if (*restored_mz == NULL){
         cout << "decomp mz buf alloc failed" << endl; return false;
     }
@@ -3474,6 +3626,16 @@ double PicoLocalDecompress::decodeAndCalibrateMzType1(const unsigned int mz, con
     return oval;
 }
 
+// decode and calibrate count mz codes in place
+void PicoLocalDecompress::decodeAndCalibrateMzType1(double* codes, size_t count, const std::vector<double> &calib_coefi, const WatersCalibration::Coefficents *cal_mod_coef) const
+{
+    if (decodeAndCalibrateMzType1Kernel(codes, count, calib_coefi, cal_mod_coef, codes))
+        return;
+    for (size_t ii = 0; ii < count; ii++){
+        codes[ii] = decodeAndCalibrateMzType1((unsigned int)codes[ii], calib_coefi, cal_mod_coef);
+    }
+}
+
 // parse calibration string
 bool PicoLocalDecompress::parseCalibrationString(const string &coeff_str, std::vector<double> &coeffs)
 {
@@ -39,14 +39,24 @@
 
 #include <ios>
 #include <iostream>
+#include <algorithm>
 #include <map>
+#include <memory>
 #include <vector>
 #include <assert.h> 
 #include "PicoCommon.h"
 #include "WatersCalibration.h"
+#include "PicoDecodeKernels.h"
+#include "config-pmi_qt_common.h"
 
 class Sqlite;
 
+#ifdef PMI_QT_COMMON_BUILD_TESTING
+namespace pmi {
+class PicoLocalDecompressTest;
+}
+#endif
+
 #define ZERO_MZ_SNAP 300
 #define DEFAULT_ZERO_GAP 0.01
 #define MAX_ZERO_GAP 0.11 //0.025
@@ -60,6 +70,38 @@ class PicoLocalDecompressMemoryOnly {
         unsigned char ** uncompressed_mz, unsigned char ** uncompressed_inten, int * uncompressed_length);
 };
 
+// Caller owned output of the spectra decoders. The storage only grows, so a buffer reused for
+// every scan stops allocating once it holds the largest scan. The decoders don't keep any state,
+// so one PicoLocalDecompress can be shared by threads as long as every thread has its own buffer.
+class DecompressBuffer
+{
+public:
+    // decoded m/z and intensity values, length() of each
+    const double* mz() const { return m_mz.get(); }
+    const float* intensity() const { return m_intensity.get(); }
+
+    // number of decoded points, 0 before the first decode
+    int length() const { return m_length; }
+    void setLength(int length) { m_length = length; }
+
+    // number of points the buffer holds without allocating
+    size_t capacity() const { return std::min(m_mzCapacity, m_intensityCapacity); }
+
+    void clear() { m_length = 0; }
+
+    // storage for at least size values used by the decoders, previous values are not kept,
+    // new storage is left uninitialized as from malloc unless zeroed
+    double* mzStorage(size_t size);
+    float* intensityStorage(size_t size, bool zeroed);
+
+private:
+    std::unique_ptr<double[]> m_mz;
+    std::unique_ptr<float[]> m_intensity;
+    size_t m_mzCapacity = 0;
+    size_t m_intensityCapacity = 0;
+    int m_length = 0;
+};
+
 enum CompressionType
 {
     Unknown = 0,
@@ -70,6 +112,10 @@ enum CompressionType
 
 class PicoLocalDecompress
 {
+#ifdef PMI_QT_COMMON_BUILD_TESTING
+    friend class pmi::PicoLocalDecompressTest;
+#endif
+
 public:
     // Constructor:
     PicoLocalDecompress();
@@ -101,11 +147,22 @@ public:
     // decompress raw type 1 memory to memory (Waters)
     bool decompressRawType1_N(unsigned char* compressed_mz, const WatersCalibration::Coefficents *cal_mod_coef, double** restored_mz, float** restored_intensity, int* restored_mz_length, bool restore_zero_peaks, const bool file_decompress) const;
 
+    // the same decoders writing into a caller owned buffer instead of malloc'ed arrays, the number
+    // of decoded points is buffer->length()
+    bool decompressSpectraType0(const unsigned char* compressed, DecompressBuffer* buffer) const;
+    bool decompressSpectraType02(const unsigned char* compressed, DecompressBuffer* buffer) const;
+    bool decompressSpectraType1(const unsigned char* compressed_mz, const unsigned char* compressed_intensity, const WatersCalibration::Coefficents *cal_mod_coef, int compress_info_id, unsigned int compressed_length, DecompressBuffer* buffer, bool restore_zero_peaks) const;
+    bool decompressSpectraCentroidedType1(const unsigned char* compressed_mz, const unsigned char* compressed_intensity, DecompressBuffer* buffer) const;
+    bool decompressRawType4(const unsigned char* compressed_mz, int compressed_mz_length, DecompressBuffer* buffer, bool restore_zero_peaks) const;
+    bool decompressRawType1_N(const unsigned char* compressed_mz, const WatersCalibration::Coefficents *cal_mod_coef, DecompressBuffer* buffer, bool restore_zero_peaks) const;
+
     // get compression info type
     bool getCompressionInfoType(const std::wstring &input_compressed_db_filename, std::string &compression_type);
 
     // decode and calibrate mz
     double decodeAndCalibrateMzType1(unsigned int mz, const std::vector<double> &calib_coefi, const WatersCalibration::Coefficents *cal_mod_coef) const;
+    // decode and calibrate count mz codes given as doubles in place, vectorized when the cpu supports it
+    void decodeAndCalibrateMzType1(double* codes, size_t count, const std::vector<double> &calib_coefi, const WatersCalibration::Coefficents *cal_mod_coef) const;
     double decodeAndCalibrateMzType1_old(unsigned int mz, const std::vector<double> &calib_coefi) const;
 
     bool test_decompress_pico_byspec(const std::wstring &input_compressed_db_filename, const std::string &output_filename);
@@ -136,6 +193,15 @@ private:
     // decompress type 0 spectra
     //bool decompressSpectraType0(unsigned char** compressed, double** restored_mz, float** restored_intensity, int* length);
 
+    // spectra decoders, the restored arrays are malloc'ed when buffer is NULL and point into
+    // buffer otherwise
+    bool decompressSpectraType0(unsigned char* compressed, double** restored_mz, float** restored_intensity, int* length, DecompressBuffer* buffer) const;
+    bool decompressSpectraType02(unsigned char* compressed, double** restored_mz, float** restored_intensity, int* length, DecompressBuffer* buffer) const;
+    bool decompressRawType4(unsigned char* compressed_mz, double** restored_mz, float** restored_intensity, int* restored_mz_length, DecompressBuffer* buffer) const;
+    bool decompressRawType1_N(unsigned char* compressed_mz, const WatersCalibration::Coefficents *cal_mod_coef, double** restored_mz, float** restored_intensity, int* restored_mz_length, bool restore_zero_peaks, const bool file_decompress, DecompressBuffer* buffer) const;
+    bool decompressMzCentroidedType1(unsigned char* compressed, double** restored_mz, int* length, DecompressBuffer* buffer) const;
+    bool decompressIntensityCentroidedType1(unsigned char* compressed, float** restored_intensity, int* length, DecompressBuffer* buffer) const;
+
     // decompress mz Type1 
     bool decompressMzType1(unsigned char** compressed, double** restored_mz, int* length) const;
 
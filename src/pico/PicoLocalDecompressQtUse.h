@@ -121,6 +121,34 @@ public:
         }
         return false;
     }
+
+    // the same as above, decoding into the caller owned buffer
+    bool decompress(const WatersCalibration::Coefficents & coef, const CompressionInfo* compressionInfo, const QByteArray &compressedMzByteArray, const QByteArray &compressedIntensityByteArray,
+                    DecompressBuffer* buffer) const
+    {
+        return decompress(coef, getCompressionType(compressionInfo->GetProperty(), compressionInfo->GetVersion()), compressedMzByteArray,
+                          compressedIntensityByteArray, buffer);
+    }
+
+    bool decompress(const WatersCalibration::Coefficents & coef, const CompressionType compressionType, const QByteArray &compressedMzByteArray, const QByteArray &compressedIntensityByteArray,
+                    DecompressBuffer* buffer) const
+    {
+        const unsigned char* compressedMz = reinterpret_cast<const unsigned char*>(compressedMzByteArray.constData());
+        const unsigned char* compressedIntensity = reinterpret_cast<const unsigned char*>(compressedIntensityByteArray.constData());
+
+        bool restore_zero_peaks = true;
+        switch(compressionType) {
+            case Unknown:
+                return false;
+            case Bruker_Type0:
+                return decompressSpectraType0(compressedMz, buffer);
+            case Centroid_Type1:
+                return decompressSpectraCentroidedType1(compressedMz, compressedIntensity, buffer);
+            case Waters_Type1:
+                return decompressRawType1_N(compressedMz, &coef, buffer, restore_zero_peaks);
+        }
+        return false;
+    }
 };
 
 _PICO_END
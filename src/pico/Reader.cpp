@@ -613,6 +613,7 @@ bool Reader::readRawFileType1ToByspec(const wstring &raw_dir_, const wstring &ou
 
     sqlite3_exec(db_out, "BEGIN;", NULL, NULL, NULL); 
     bool sts_override = false, check_override = true;
+    Centroid cnt; // reused for all scans
     for (unsigned int function = 1; function<functions.size() + 1; function++){
         wstring name_prefix(L"_FUNC");
         wstring name = appendZeroPaddedNumberForWatersFile(name_prefix, function);
@@ -1009,11 +1010,9 @@ bool Reader::readRawFileType1ToByspec(const wstring &raw_dir_, const wstring &ou
 */
                         std::vector<std::pair<double, double>> centroided_out;
                         if (i_first){
-                            Centroid *cnt = new Centroid();
-                            if (!cnt->smooth_and_centroid(input_data, uncert_val, end_uncert_val, uncert_type, top_k, merge_radius, adjust_intensity, sort_mz, centroided_out)){
+                            if (!cnt.smooth_and_centroid(input_data, uncert_val, end_uncert_val, uncert_type, top_k, merge_radius, adjust_intensity, sort_mz, centroided_out)){
                                 centroided_out.clear(); // return false;
                             }
-                            delete cnt;
                         }
 
                         in_data.clear();
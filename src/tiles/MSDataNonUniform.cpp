@@ -20,8 +20,10 @@
 #include "PlotBase.h"
 
 #include <QDir>
+#include <QMap>
 #include <QRect>
 
+#include <algorithm>
 #include <iterator>
 #include "MzScanIndexRect.h"
 #include "MzScanIndexNonUniformTileRectIterator.h"
@@ -63,10 +65,8 @@ Err MSDataNonUniform::getScanDataPart(int scanIndex, double mzStart, double mzEn
 {
     int tileXStart = m_range.tileX(mzStart);
     int tileXEnd = m_range.tileX(mzEnd);
-    int tileCountX = (tileXEnd - tileXStart) + 1;
 
     RandomNonUniformTileIterator iterator(m_manager, m_range, doCentroiding);
-    m_manager->setCacheSize(std::max(tileCountX, m_manager->cacheSize()));
 
     points->clear();
 
@@ -121,7 +121,7 @@ bool MSDataNonUniform::exportTile(const QPoint &tilePos, NonUniformTileStore::Co
 
     for (int scanIndex = scanIndexStart; scanIndex < scanIndexEnd; ++scanIndex) {
         iterator.moveTo(tileX, tileY, scanIndex);
-        point2dList tileScanPart = iterator.value();
+        const point2dList &tileScanPart = iterator.value();
 
         QStringList row = QStringList{ QString::number(scanIndex), QString(), QString() };
         for (const point2d &pt : tileScanPart) {
@@ -241,6 +241,95 @@ Err MSDataNonUniform::getXICDataNG(const XICWindow &win, point2dList *points)
     return kNoErr;
 }
 
+Err MSDataNonUniform::getXICDataBatch(const QVector<XICWindow> &windows,
+                                      QVector<point2dList> *points)
+{
+    Q_ASSERT(points);
+
+    const NonUniformTileStore::ContentType contentType = NonUniformTileStore::ContentMS1Centroided;
+    QVector<int> scanIndexStarts(windows.size());
+    QVector<int> scanIndexEnds(windows.size());
+    // windows overlapping each tile, keyed by (tileY, tileX) so the tiles are visited row by row
+    QMap<QPair<int, int>, QVector<int>> tileToWindows;
+
+    points->clear();
+    points->resize(windows.size());
+
+    for (int w = 0; w < windows.size(); ++w) {
+        const XICWindow &win = windows[w];
+        const int scanIndexStart = m_converter.timeToScanIndex(win.time_start);
+        const int scanIndexEnd = m_converter.timeToScanIndex(win.time_end);
+        const int rowCount = scanIndexEnd - scanIndexStart + 1; // 0-based indexing, thus +1
+
+        scanIndexStarts[w] = scanIndexStart;
+        scanIndexEnds[w] = scanIndexEnd;
+
+        // init the points
+        point2dList &xic = (*points)[w];
+        xic.resize(std::max(0, rowCount));
+        for (int i = 0; i < rowCount; i++) {
+            double time = m_converter.toScanTime(m_converter.toScanNumber(scanIndexStart + i));
+            xic[i] = QPointF(time, 0.0);
+        }
+
+        if (rowCount <= 0) {
+            continue;
+        }
+
+        const QRect xicTileRect = tileRect(win);
+        for (int tileY = m_range.tileY(scanIndexStart); tileY <= m_range.tileY(scanIndexEnd); ++tileY) {
+            for (int tileX = xicTileRect.x(); tileX < xicTileRect.x() + xicTileRect.width(); ++tileX) {
+                tileToWindows[qMakePair(tileY, tileX)].push_back(w);
+            }
+        }
+    }
+
+    for (auto it = tileToWindows.cbegin(); it != tileToWindows.cend(); ++it) {
+        const int tileY = it.key().first;
+        const int tileX = it.key().second;
+
+        const NonUniformTile tile = m_manager->loadTile(QPoint(tileX, tileY), contentType);
+        if (tile.isNull() || tile.isEmpty()) {
+            if (tile.isNull()) {
+                warningMs() << "Null tile!" << QPoint(tileX, tileY) << "contentType" << contentType;
+            }
+            continue;
+        }
+
+        const double tileMzStart = m_range.mzAt(tileX);
+        const double tileMzEnd = m_range.mzAt(tileX + 1);
+        const int tileScanIndexStart = m_range.scanIndexAt(tileY);
+        const int tileScanIndexEnd = m_range.lastScanIndexAt(tileY);
+
+        for (int w : it.value()) {
+            const XICWindow &win = windows[w];
+            const double mzStart = qMax(win.mz_start, tileMzStart);
+            const double mzEnd = std::min(win.mz_end, tileMzEnd);
+            const int rowStart = std::max(scanIndexStarts[w], tileScanIndexStart);
+            const int rowEnd = std::min(scanIndexEnds[w], tileScanIndexEnd);
+
+            point2dList &xic = (*points)[w];
+            for (int scanIndex = rowStart; scanIndex <= rowEnd; ++scanIndex) {
+                // take the part between mzStart and mzEnd excluding
+                point2dList scanPart = Point2dListUtils::extractPointsIncluding(
+                    tile.value(scanIndex - tileScanIndexStart), mzStart, mzEnd);
+
+                double sumPart = 0.0;
+                for (const QPointF &pt : scanPart) {
+                    sumPart += pt.y();
+                }
+
+                int pointsIndex = scanIndex - scanIndexStarts[w];
+
+                double newSum = xic.at(pointsIndex).y() + sumPart;
+                xic[pointsIndex].setY(newSum);
+            }
+        }
+    }
+
+    return kNoErr;
+}
+
 Err MSDataNonUniform::getXICDataSequentialIterator(const QRect &tileArea, point2dList *points)
 {
     // contains tile indexes 
@@ -258,10 +347,11 @@ Err MSDataNonUniform::getXICDataSequentialIterator(const QRect &tileArea, point2
     bool doCentroiding = true;
     SequentialNonUniformTileIterator iterator(m_manager, m_range, doCentroiding, tileArea);
     while (iterator.hasNext()) {
-        point2dList scanPart = iterator.next();
+        const point2dList &tileScanPart = iterator.next();
 
         // take the part between mzStart and mzEnd excluding
-        scanPart = Point2dListUtils::extractPointsIncluding(scanPart, iterator.mzStart(), iterator.mzEnd());
+        const point2dList scanPart = Point2dListUtils::extractPointsIncluding(
+            tileScanPart, iterator.mzStart(), iterator.mzEnd());
 
         double sumPart = 0.0;
         for (const QPointF& pt : scanPart) {
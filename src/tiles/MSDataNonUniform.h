@@ -58,6 +58,12 @@ public:
     //! over respective tile by tile
     Err getXICDataNG(const msreader::XICWindow &win, point2dList *points);
 
+    //! \brief batched version of getXICDataNG, every tile touched by the windows is loaded only once
+    //!
+    //! Tiles are visited row by row and each one is routed to all windows overlapping it, so
+    //! points[i] is equal to getXICDataNG(windows[i], ...)
+    Err getXICDataBatch(const QVector<msreader::XICWindow> &windows, QVector<point2dList> *points);
+
     //! \brief Provide XIC for area defined only by tile rect
     Err getXICDataSequentialIterator(const QRect &tileRect, point2dList *points);
 
@@ -9,6 +9,7 @@
 
 #include "MSDataNonUniformAdapter.h"
 #include "MSReader.h"
+#include "NonUniformTileStoreMmap.h"
 #include "NonUniformTileStoreSqlite.h"
 #include "NonUniformTileRange.h"
 #include "QtSqlUtils.h"
@@ -21,11 +22,15 @@
 #include "db\NonUniformTilesDao.h"
 #include "pmi_common_ms_debug.h"
 
+#include <QFileInfo>
+#include <QScopedPointer>
+
 _PMI_BEGIN
 
 using namespace msreader;
 
 static const QLatin1String CACHE_SUFFIX(".NonUniform.cache");
+static const QLatin1String MMAP_SUFFIX(".mmap");
 
 MSDataNonUniformAdapter::MSDataNonUniformAdapter(const QString &filePath)
     : m_dbFilePath(filePath)
@@ -87,6 +92,9 @@ Err MSDataNonUniformAdapter::createNonUniformTiles(MSReader * reader, const NonU
 {
     Err e = openDatabase(); ree;
 
+    // memory mapped copy of the previous content is not valid anymore
+    removeMmapFile();
+
     // serialize to db
     NonUniformTilesInfoDao rangeDao(&m_db);
     e = rangeDao.createTable(); ree;
@@ -96,10 +104,11 @@ Err MSDataNonUniformAdapter::createNonUniformTiles(MSReader * reader, const NonU
     if (!store.init()) {
         return kSQLiteExecError;
     }
+    store.setEncoding(m_encoding);
 
     m_converter = ScanIndexNumberConverter::fromMSReader(scanInfo);
     NonUniformTileBuilder builder(range);
-    builder.buildNonUniformTilesNG(reader, m_converter, &store, m_contentType, progress);
+    builder.buildNonUniformTilesParallel(reader, m_converter, &store, m_contentType, progress);
     return e;
 }
 
@@ -118,6 +127,43 @@ Err MSDataNonUniformAdapter::getXICData(const XICWindow &win, point2dList *point
     return m_data->getXICDataNG(win, points);
 }
 
+Err MSDataNonUniformAdapter::getXICDataBatch(const QVector<XICWindow> &windows,
+                                             QVector<point2dList> *points, int ms_level)
+{
+    points->clear();
+    if (!m_data) {
+        return kError;
+    }
+
+    if (ms_level != 1) {
+        return kFunctionNotImplemented;
+    }
+
+    return m_data->getXICDataBatch(windows, points);
+}
+
+Err MSDataNonUniformAdapter::convertEncoding(const NonUniformTilesEncoding &encoding)
+{
+    if (m_store || m_data) {
+        warningMs() << "Bad API usage: the cache is loaded, it can't be converted";
+        return kError;
+    }
+
+    if (!hasValidCacheDbFile()) {
+        return kBadParameterError;
+    }
+
+    NonUniformTileStoreSqlite store(&m_db);
+    if (!store.convertEncoding(encoding)) {
+        return kSQLiteExecError;
+    }
+
+    // lossy encodings change the values
+    removeMmapFile();
+
+    return kNoErr;
+}
+
 bool MSDataNonUniformAdapter::hasValidCacheDbFile()
 {
     Err e = openDatabase(); 
@@ -153,8 +199,17 @@ Err MSDataNonUniformAdapter::load(const QList<ScanInfoWrapper> &scanInfo)
     
     m_store = new NonUniformTileStoreSqlite(&m_db);
     qDebug() << "File" << m_db.databaseName();
+
+    NonUniformTileStore *dataStore = m_store;
+    if (m_mmapStoreEnabled) {
+        m_mmapStore = openMmapStore();
+        if (m_mmapStore) {
+            dataStore = m_mmapStore;
+        }
+    }
+
     m_converter = ScanIndexNumberConverter::fromMSReader(scanInfo);
-    m_data = new MSDataNonUniform(m_store, m_range, m_converter);
+    m_data = new MSDataNonUniform(dataStore, m_range, m_converter);
 
     return e;
 }
@@ -164,10 +219,55 @@ void MSDataNonUniformAdapter::cleanUp()
     //TODO think about ownership
     delete m_data;
     m_data = nullptr;
+    delete m_mmapStore;
+    m_mmapStore = nullptr;
     delete m_store;
     m_store = nullptr;
 }
 
+QString MSDataNonUniformAdapter::mmapFilePath() const
+{
+    return m_dbFilePath + MMAP_SUFFIX;
+}
+
+NonUniformTileStoreMmap *MSDataNonUniformAdapter::openMmapStore()
+{
+    const QString filePath = mmapFilePath();
+    QScopedPointer<NonUniformTileStoreMmap> store(new NonUniformTileStoreMmap);
+
+    auto isUpToDate = [this, &store]() {
+        for (NonUniformTileStore::ContentType type : { NonUniformTileStore::ContentMS1Raw, NonUniformTileStore::ContentMS1Centroided }) {
+            if (store->count(type) != m_store->count(type)
+                || store->pointCount(type) != m_store->pointCount(type)) {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    if (store->open(filePath) && isUpToDate()) {
+        return store.take();
+    }
+
+    // the file has to be unmapped before it is replaced
+    store->close();
+    debugMs() << "Creating memory mapped tiles at" << filePath;
+    if (!NonUniformTileStoreMmap::exportFromSqlite(m_store, filePath) || !store->open(filePath)) {
+        warningMs() << "Failed to create memory mapped tiles at" << filePath << "using sqlite store";
+        return nullptr;
+    }
+
+    return store.take();
+}
+
+void MSDataNonUniformAdapter::removeMmapFile()
+{
+    const QString filePath = mmapFilePath();
+    if (QFileInfo(filePath).exists() && !QFile::remove(filePath)) {
+        warningMs() << "Failed to remove outdated memory mapped tiles" << filePath;
+    }
+}
+
 double MSDataNonUniformAdapter::scanNumberToScanTime(long scanNumber) const
 {
     if (!isLoaded()) {
@@ -21,6 +21,7 @@
 
 #include "NonUniformTileStore.h"
 #include "NonUniformTileRange.h"
+#include "NonUniformTilesSerialization.h"
 
 class ProgressBarInterface;
 
@@ -28,6 +29,7 @@ _PMI_BEGIN
 
 class MSDataNonUniform;
 class MSReader;
+class NonUniformTileStoreMmap;
 class NonUniformTileStoreSqlite;
 
 class PMI_COMMON_MS_EXPORT MSDataNonUniformAdapter final
@@ -51,6 +53,10 @@ public:
     //! \brief follows MSReader API to provide XICData, @see MSReader::getXICData
     Err getXICData(const msreader::XICWindow &win, point2dList *points, int ms_level);
 
+    //! \brief batched getXICData, @see MSDataNonUniform::getXICDataBatch
+    Err getXICDataBatch(const QVector<msreader::XICWindow> &windows, QVector<point2dList> *points,
+                        int ms_level);
+
     //! \brief Checks if the provided MSData has existing valid cache file
     //! Note: opens the database to check the schema
     bool hasValidCacheDbFile(); //TODO const?
@@ -89,8 +95,24 @@ public:
 
     bool hasData(NonUniformTileStore::ContentType type);
 
+    //! \brief Sets the blob encoding used during building tiles
+    //  @see createNonUniformTiles function
+    void setEncoding(const NonUniformTilesEncoding &encoding) { m_encoding = encoding; }
+
+    //! \brief Rewrites the tiles of existing cache file with @a encoding
+    Err convertEncoding(const NonUniformTilesEncoding &encoding);
+
     NonUniformTileStoreSqlite *store() const { return m_store; } 
 
+    //! \brief If enabled, load() serves the tiles from a memory mapped copy of the cache
+    //  @see NonUniformTileStoreMmap. The copy is created next to the cache file when missing or
+    //  outdated, the sqlite store is used if it can't be created. Disabled by default.
+    void setMmapStoreEnabled(bool enabled) { m_mmapStoreEnabled = enabled; }
+    bool isMmapStoreEnabled() const { return m_mmapStoreEnabled; }
+
+    //! @return file path of the memory mapped copy of the cache
+    QString mmapFilePath() const;
+
     //! \brief Returns the suffix (extension) for NonUniform cache files
     static QString formatSuffix();
 
@@ -100,6 +122,10 @@ private:
 
     bool verifyDatabaseContent();
 
+    //! @return nullptr if the memory mapped tile file can't be opened nor created
+    NonUniformTileStoreMmap *openMmapStore();
+    void removeMmapFile();
+
 private:
     QSqlDatabase m_db;
     QString m_dbFilePath;
@@ -108,6 +134,9 @@ private:
     MSDataNonUniform * m_data;
     ScanIndexNumberConverter m_converter;
     NonUniformTileStore::ContentType m_contentType;
+    NonUniformTilesEncoding m_encoding;
+    NonUniformTileStoreMmap *m_mmapStore = nullptr;
+    bool m_mmapStoreEnabled = false;
 
 
 #ifdef PMI_QT_COMMON_BUILD_TESTING
@@ -30,6 +30,7 @@ public:
     }
 
     bool doCentroiding = false;
+    NonUniformTilesEncoding encoding;
     QString vendorFilePath;
 
     QString outputFilePath;
@@ -76,6 +77,7 @@ Err MSDataNonUniformGenerator::generate(QSharedPointer<ProgressBarInterface> pro
         : NonUniformTileStore::ContentMS1Raw; // Profile
 
     adapter.setContentType(content);
+    adapter.setEncoding(d->encoding);
 
     bool ok;
     NonUniformTileRange range = adapter.createRange(reader, d->doCentroiding, scanInfo.size(), &ok);
@@ -106,4 +108,22 @@ void MSDataNonUniformGenerator::setDoCentroiding(bool on)
     d->doCentroiding = on;
 }
 
+void MSDataNonUniformGenerator::setEncoding(const NonUniformTilesEncoding &encoding)
+{
+    d->encoding = encoding;
+}
+
+Err MSDataNonUniformGenerator::convertEncoding(const QString &cacheFilePath,
+                                               const NonUniformTilesEncoding &encoding)
+{
+    if (!QFileInfo(cacheFilePath).exists()) {
+        warningMs() << "Cache file" << cacheFilePath << "does not exist";
+        return kFileOpenError;
+    }
+
+    MSDataNonUniformAdapter adapter(cacheFilePath);
+    Err e = adapter.convertEncoding(encoding); ree;
+    return e;
+}
+
 _PMI_END
@@ -15,6 +15,7 @@
 #include <pmi_core_defs.h>
 
 #include "ProgressBarInterface.h"
+#include "NonUniformTilesSerialization.h"
 
 #include <QScopedPointer>
 #include <QString>
@@ -42,6 +43,9 @@ public:
     // By default profile cache is created
     void setDoCentroiding(bool on);
 
+    //! \brief Set the encoding of the tile blobs, NonUniformTilesEncoding::legacy() by default
+    void setEncoding(const NonUniformTilesEncoding &encoding);
+
     //! \brief executes the generation of the NonUniform cache
     //
     // After you provide particular settings of the generator, you can execute
@@ -53,6 +57,9 @@ public:
     //! \brief provides default cache file path using @see CacheFileManager
     static Err defaultCacheLocation(const QString &vendorFilePath, QString *cacheFilePath);
 
+    //! \brief rewrites the tiles of existing cache with @a encoding, e.g. to convert legacy caches
+    static Err convertEncoding(const QString &cacheFilePath, const NonUniformTilesEncoding &encoding);
+
 private:
     Q_DISABLE_COPY(MSDataNonUniformGenerator)
     QScopedPointer<MSDataNonUniformGeneratorPrivate> d;
@@ -11,6 +11,7 @@
 #include "MSDataIterator.h"
 #include "MSReader.h"
 #include "NonUniformTileStoreMemory.h"
+#include "NonUniformTileStoreSqlite.h"
 
 #include "ScanDataTiledIterator.h"
 
@@ -22,8 +23,68 @@
 
 #include "pmi_common_ms_debug.h"
 
+#include <QFuture>
+#include <QMutex>
+#include <QQueue>
+#include <QScopedPointer>
+#include <QSemaphore>
+#include <QThread>
+#include <QThreadPool>
+#include <QWaitCondition>
+#include <QtConcurrent/QtConcurrentRun>
+
+#include <atomic>
+
 _PMI_BEGIN
 
+namespace {
+
+typedef QVector<NonUniformTilesEncodedEntry> EncodedTileRow;
+
+//! \brief splits the scans of one tile row into tiles and encodes them for the database
+EncodedTileRow encodeTileRow(const NonUniformTileStoreSqlite *store,
+                             const NonUniformTileRange &range, int tileY,
+                             const QVector<point2dList> &scans,
+                             NonUniformTileStore::ContentType type)
+{
+    const int tileCountX = range.tileCountX();
+
+    QVector<QVector<point2dList>> columns(tileCountX);
+    for (QVector<point2dList> &column : columns) {
+        column.reserve(scans.size());
+    }
+
+    for (const point2dList &scanData : scans) {
+        int tileXIndex = 0;
+        ScanDataTiledIterator it(&scanData, range, tileXIndex, tileCountX);
+        while (it.hasNext()) {
+            columns[tileXIndex].push_back(it.next());
+            tileXIndex++;
+        }
+    }
+
+    EncodedTileRow result;
+    result.reserve(tileCountX);
+    for (int tileX = 0; tileX < tileCountX; ++tileX) {
+        NonUniformTile tile;
+        tile.setPosition(QPoint(tileX, tileY));
+        tile.setData(std::move(columns[tileX]));
+        result.push_back(store->encodeTile(tile, type));
+    }
+
+    return result;
+}
+
+//! \brief encoded rows in the order they have to be written
+struct EncodedTileRowQueue {
+    QMutex mutex;
+    QWaitCondition rowAvailable;
+    QQueue<QFuture<EncodedTileRow>> rows;
+    bool finished = false;
+};
+
+}
+
 NonUniformTileBuilder::NonUniformTileBuilder(const NonUniformTileRange &range) :m_range(range)
 {
 }
@@ -147,6 +208,153 @@ void NonUniformTileBuilder::buildNonUniformTilesNG(MSReader *reader,
 
 }
 
+void NonUniformTileBuilder::buildNonUniformTilesParallel(MSReader *reader,
+                                                         const ScanIndexNumberConverter &converter,
+                                                         NonUniformTileStoreSqlite *store,
+                                                         NonUniformTileStore::ContentType type,
+                                                         QSharedPointer<ProgressBarInterface> progress)
+{
+    // commit the writer transaction after this amount of encoded data
+    static const qint64 TRANSACTION_SIZE_BYTES = 64 * 1024 * 1024;
+
+    const int threadCount = (m_threadCount > 0) ? m_threadCount : QThread::idealThreadCount();
+    if (threadCount <= 1) {
+        buildNonUniformTilesNG(reader, converter, store, type, progress);
+        return;
+    }
+
+    // rows which were read but not written yet; bounds the memory held by the pipeline
+    QSemaphore freeRows(2 * threadCount);
+    EncodedTileRowQueue queue;
+
+    // sqlite connection can be used only by the thread which opened it
+    QThreadPool writerPool;
+    writerPool.setMaxThreadCount(1);
+    QSemaphore writerReady;
+    std::atomic<bool> writerOk{ false };
+
+    QFuture<void> writer = QtConcurrent::run(&writerPool, [&]() {
+        QScopedPointer<NonUniformTileStore> cloned(store->clone());
+        NonUniformTileStoreSqlite *writerStore = dynamic_cast<NonUniformTileStoreSqlite *>(cloned.data());
+        writerOk = (writerStore != nullptr);
+        writerReady.release();
+        if (!writerOk) {
+            return;
+        }
+
+        qint64 transactionBytes = 0;
+        writerStore->start();
+        while (true) {
+            QFuture<EncodedTileRow> rowFuture;
+            {
+                QMutexLocker locker(&queue.mutex);
+                while (queue.rows.isEmpty() && !queue.finished) {
+                    queue.rowAvailable.wait(&queue.mutex);
+                }
+                if (queue.rows.isEmpty()) {
+                    break;
+                }
+                rowFuture = queue.rows.dequeue();
+            }
+
+            const EncodedTileRow row = rowFuture.result();
+            for (const NonUniformTilesEncodedEntry &entry : row) {
+                if (!writerStore->saveEncodedTile(entry)) {
+                    qWarning() << "Failed to save NonUniformTile at" << QPoint(entry.posX, entry.posY);
+                }
+                transactionBytes += entry.index.size() + entry.mz.size() + entry.intensity.size();
+            }
+            freeRows.release();
+
+            if (transactionBytes > TRANSACTION_SIZE_BYTES) {
+                writerStore->end();
+                writerStore->start();
+                transactionBytes = 0;
+            }
+        }
+        writerStore->end();
+    });
+
+    writerReady.acquire();
+    if (!writerOk) {
+        writer.waitForFinished();
+        warningMs() << "Failed to open writer connection, building the tiles serially";
+        buildNonUniformTilesNG(reader, converter, store, type, progress);
+        return;
+    }
+
+    if (progress) {
+        QString typeStr = (type == NonUniformTileStore::ContentMS1Centroided) ? "centroided" : "profile";
+        progress->setText(QString("Creating %1 cache...").arg(typeStr));
+    }
+
+    QThreadPool workerPool;
+    workerPool.setMaxThreadCount(threadCount);
+
+    const NonUniformTileRange range = m_range;
+    QVector<point2dList> rowScans;
+    rowScans.reserve(m_range.scanIndexTileLength());
+    int rowTileY = -1;
+
+    auto submitRow = [&]() {
+        if (rowScans.isEmpty()) {
+            return;
+        }
+
+        freeRows.acquire();
+        const QVector<point2dList> scans = rowScans;
+        const int tileY = rowTileY;
+        QFuture<EncodedTileRow> rowFuture = QtConcurrent::run(&workerPool, [=]() {
+            return encodeTileRow(store, range, tileY, scans, type);
+        });
+
+        {
+            QMutexLocker locker(&queue.mutex);
+            queue.rows.enqueue(rowFuture);
+        }
+        queue.rowAvailable.wakeOne();
+
+        rowScans.clear();
+        rowScans.reserve(m_range.scanIndexTileLength());
+    };
+
+    {
+        const int scanCount = m_range.scanIndexMax() - m_range.scanIndexMin() + 1;
+        ProgressContext progressContext(scanCount, progress);
+
+        for (int scanIndex = m_range.scanIndexMin(); scanIndex <= m_range.scanIndexMax(); ++scanIndex, ++progressContext) {
+            const int tileY = m_range.tileY(scanIndex);
+            if (tileY != rowTileY) {
+                // all scans of the previous tile row are read, its tiles are complete
+                submitRow();
+                rowTileY = tileY;
+            }
+
+            const int scanNumber = converter.toScanNumber(scanIndex);
+
+            point2dList scanData;
+            Err e = reader->getScanData(scanNumber, &scanData, type == NonUniformTileStore::ContentMS1Centroided);
+            if (e != kNoErr) {
+                QString msg = QString("Error reading scans for scan number %1").arg(scanNumber);
+                qWarning() << msg;
+                break;
+            }
+
+            rowScans.push_back(std::move(scanData));
+        }
+    }
+
+    submitRow();
+
+    {
+        QMutexLocker locker(&queue.mutex);
+        queue.finished = true;
+    }
+    queue.rowAvailable.wakeAll();
+
+    writer.waitForFinished();
+}
+
 bool NonUniformTileBuilder::buildNonUniformTileSelection(
     NonUniformTileStore *store, NonUniformTileStore::ContentType type,
     NonUniformTileSelectionStore *selectionStore, const QRect &tileArea)
@@ -170,7 +378,7 @@ bool NonUniformTileBuilder::buildNonUniformTileSelection(
     defaultTileData.resize(selectionTileHeight);
 
     while (tileIterator.hasNext()) {
-        point2dList scanPart = tileIterator.next();
+        const point2dList &scanPart = tileIterator.next();
         int tileX = tileIterator.x();
         int tileY = tileIterator.y();
 
@@ -226,7 +434,7 @@ bool NonUniformTileBuilder::buildNonUniformTileHillIndex(NonUniformTileStore *st
     defaultTileData.resize(selectionTileHeight);
 
     while (tileIterator.hasNext()) {
-        point2dList scanPart = tileIterator.next();
+        const point2dList &scanPart = tileIterator.next();
         int tileX = tileIterator.x();
         int tileY = tileIterator.y();
 
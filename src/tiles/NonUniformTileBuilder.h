@@ -21,6 +21,7 @@ _PMI_BEGIN
 
 class ScanIndexNumberConverter;
 class MSReader;
+class NonUniformTileStoreSqlite;
 
 class PMI_COMMON_MS_EXPORT NonUniformTileBuilder {
 
@@ -32,6 +33,25 @@ public:
                                 NonUniformTileStore *store, NonUniformTileStore::ContentType type,
                                 QSharedPointer<ProgressBarInterface> progress = NoProgress);
 
+    /*!
+     * \brief Builds the same tiles as buildNonUniformTilesNG with a pipeline of threads
+     *
+     * Scans are read on the calling thread (MSReader is not thread-safe) one tile row at a time.
+     * Complete rows are split into tiles and encoded by the worker threads and written in order
+     * by one writer thread using its own connection to the database of @a store, so the tile
+     * parts database is not needed. Falls back to buildNonUniformTilesNG when the thread count
+     * is 1 or the store can't be cloned (e.g. in-memory database).
+     */
+    void buildNonUniformTilesParallel(MSReader *reader, const ScanIndexNumberConverter &converter,
+                                      NonUniformTileStoreSqlite *store,
+                                      NonUniformTileStore::ContentType type,
+                                      QSharedPointer<ProgressBarInterface> progress = NoProgress);
+
+    //! \brief number of worker threads used by buildNonUniformTilesParallel,
+    // 0 (default) means QThread::idealThreadCount()
+    void setThreadCount(int threadCount) { m_threadCount = threadCount; }
+    int threadCount() const { return m_threadCount; }
+
     bool buildNonUniformTileSelection(NonUniformTileStore *store,
                                       NonUniformTileStore::ContentType type,
                                       NonUniformTileSelectionStore *selectionStore,
@@ -47,7 +67,8 @@ private:
 
 private:
     NonUniformTileRange m_range;
-    
+    int m_threadCount = 0;
+
 };
 
 _PMI_END
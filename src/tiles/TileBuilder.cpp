@@ -11,9 +11,79 @@
 #include "ImageTileIterator.h"
 #include "ImagePatternTileIterator.h"
 #include "TileDataProvider.h"
+#include "TileStoreMemory.h"
+
+#include <QFuture>
+#include <QSet>
+#include <QThread>
+#include <QThreadPool>
+#include <QtConcurrent/QtConcurrentRun>
+
+#include <memory>
 
 _PMI_BEGIN
 
+namespace {
+
+// tiles computed by one task of the thread pool
+const int TILES_PER_TASK = 16;
+
+// Missing tiles of a level computed together. The parent tiles they read are loaded from the store
+// before the tasks start, the tasks only read parentTiles.
+struct LevelBatch
+{
+    QVector<QPoint> positions;
+    QVector<Tile> tiles;
+    TileStoreMemory parentTiles;
+    QVector<QFuture<void>> tasks;
+};
+
+// collects up to batchTileCount missing tiles starting at *nextTile (row major index) and loads
+// their parent tiles
+void prepareLevelBatch(TileStore *store, const QPoint &parentLevel, const QPoint &level,
+                       int tileCountX, int tileCountY, int batchTileCount, int *nextTile,
+                       LevelBatch *batch)
+{
+    const int parentColumns = parentLevel.x() < level.x() ? 2 : 1;
+    const int parentRows = parentLevel.y() < level.y() ? 2 : 1;
+    QSet<TileInfo> loaded;
+
+    while (*nextTile < tileCountX * tileCountY && batch->positions.size() < batchTileCount) {
+        const int x = *nextTile % tileCountX;
+        const int y = *nextTile / tileCountX;
+        ++(*nextTile);
+        if (x == 0) {
+            qDebug() << "level=" << level << "row=" << y << "/" << tileCountY;
+        }
+
+        const QPoint tilePos(x * Tile::WIDTH, y * Tile::HEIGHT);
+        if (store->contains(level, tilePos)) {
+            continue;
+        }
+        batch->positions.push_back(tilePos);
+
+        for (int row = 0; row < parentRows; ++row) {
+            for (int column = 0; column < parentColumns; ++column) {
+                const QPoint parentPos(tilePos.x() * parentColumns + column * Tile::WIDTH,
+                                       tilePos.y() * parentRows + row * Tile::HEIGHT);
+                const TileInfo parentInfo(parentLevel, parentPos);
+                if (loaded.contains(parentInfo)) {
+                    continue;
+                }
+                loaded.insert(parentInfo);
+
+                // missing parent tiles read as Tile::DEFAULT_TILE_VALUE, as from the store
+                const Tile parent = store->loadTile(parentLevel, parentPos);
+                if (!parent.isNull()) {
+                    batch->parentTiles.saveTile(parent);
+                }
+            }
+        }
+    }
+}
+
+} // namespace
+
 TileBuilder::TileBuilder(const TileRange& range)
     :    m_range(range)
 {
@@ -167,9 +237,34 @@ void TileBuilder::buildLevel(const QPoint &parentLevel, const QPoint &level, Til
 
     qDebug() << "For level" << level << "size is" << QSize(width, height) << "Tile size" << QSize(tileCountX, tileCountY);
     qDebug() << "Building level " << level << "tile count:" << tileCountX * tileCountY << "WxH" << width << height;
-    
-    TileManager tm(store);
-    RandomTileIterator iterator(&tm);
+
+    // tiles of a level only read the parent level, so they are computed on the pool while this
+    // thread prepares the next batch and saves the previous one
+    const int threadCount = m_threadCount > 0 ? m_threadCount : qMax(1, QThread::idealThreadCount());
+    const int batchTileCount = TILES_PER_TASK * threadCount;
+    QThreadPool pool;
+    pool.setMaxThreadCount(threadCount);
+
+    auto startBatch = [&](LevelBatch *batch) {
+        batch->tiles.resize(batch->positions.size());
+        Tile *tiles = batch->tiles.data();
+        for (int begin = 0; begin < batch->positions.size(); begin += TILES_PER_TASK) {
+            const int end = qMin(begin + TILES_PER_TASK, batch->positions.size());
+            auto computeTiles = [this, batch, tiles, begin, end, parentLevel, level]() {
+                TileManager tm(&batch->parentTiles);
+                RandomTileIterator iterator(&tm);
+                for (int i = begin; i < end; ++i) {
+                    iterator.clearCache();
+                    tiles[i] = computeTileNG(batch->positions.at(i), iterator, parentLevel, level);
+                }
+            };
+            if (threadCount == 1) {
+                computeTiles();
+            } else {
+                batch->tasks.push_back(QtConcurrent::run(&pool, computeTiles));
+            }
+        }
+    };
 
     QElapsedTimer et;
     et.start();
@@ -177,30 +272,44 @@ void TileBuilder::buildLevel(const QPoint &parentLevel, const QPoint &level, Til
     int processedTiles = 0;
     const int TILE_COUNT_REPORT_PROGRESS = 400;
 
-    for (int y = 0; y < tileCountY; ++y) {
-        qDebug() << "level=" << level << "row=" << y << "/" << tileCountY;
-        int posY = y * Tile::HEIGHT;
-        for (int x = 0; x < tileCountX; ++x) {
-            QPoint tilePos(x * Tile::WIDTH, posY);
-
-            if (!store->contains(level, tilePos)) {
-                iterator.clearCache();
-                Tile t = computeTileNG(tilePos, iterator, parentLevel, level);
-
-                bool saved = store->saveTile(t);
-                if (!saved) {
-                    qWarning() << "Cannot save tile on level" << level << "at" << x << "," << y;
-                }
-
-                processedTiles++;
-                if (processedTiles % TILE_COUNT_REPORT_PROGRESS == 0) {
-                    qint64 milis = et.elapsed();
-                    emit progressChanged(level, totalTileCount, TILE_COUNT_REPORT_PROGRESS, milis);
-                    et.start();
-                }
+    auto saveBatch = [&](const LevelBatch &batch) {
+        if (!store->saveTiles(batch.tiles)) {
+            qWarning() << "Cannot save tiles on level" << level;
+        }
 
+        for (int i = 0; i < batch.tiles.size(); ++i) {
+            processedTiles++;
+            if (processedTiles % TILE_COUNT_REPORT_PROGRESS == 0) {
+                qint64 milis = et.elapsed();
+                emit progressChanged(level, totalTileCount, TILE_COUNT_REPORT_PROGRESS, milis);
+                et.start();
+            }
+        }
+    };
+
+    int nextTile = 0;
+    std::unique_ptr<LevelBatch> computing;
+    while (true) {
+        std::unique_ptr<LevelBatch> next(new LevelBatch);
+        prepareLevelBatch(store, parentLevel, level, tileCountX, tileCountY, batchTileCount,
+                          &nextTile, next.get());
+
+        std::unique_ptr<LevelBatch> computed = std::move(computing);
+        if (computed) {
+            for (QFuture<void> &task : computed->tasks) {
+                task.waitForFinished();
             }
         }
+        if (!next->positions.isEmpty()) {
+            startBatch(next.get());
+            computing = std::move(next);
+        }
+        if (computed) {
+            saveBatch(*computed);
+        }
+        if (!computing) {
+            break;
+        }
     }
     store->end();
 
@@ -219,58 +328,9 @@ void TileBuilder::buildTilePyramid(int lastLevel, TileStore * store)
    int parentLevel = 1;
    int level = 2;
 
-   TileManager tm(store);
-   RandomTileIterator iterator(&tm);
    while (level <= lastLevel) {
-       
-       QPoint level2d(level, level);
-       int width = m_range.levelWidth(level2d);
-       int height = m_range.levelHeigth(level2d);
-
-       // TODO: see TileRange, move to TileManager or Tile
-       int tileCountX = qCeil(qreal(width) / Tile::WIDTH);
-       int tileCountY = qCeil(qreal(height) / Tile::HEIGHT);
-       int totalTileCount = tileCountX * tileCountY;
-
-       qDebug() << "For level" << level << "size is" << QSize(width, height) << "Tile size" << QSize(tileCountX, tileCountY);
-       qDebug() << "Building level " << level << "tile count:" << tileCountX * tileCountY << "WxH" << width << height;
-       QElapsedTimer et;
-       et.start();
-       store->start();
-       int processedTiles = 0;
-       const int TILE_COUNT_REPORT_PROGRESS = 400;
-
-       for (int y = 0; y < tileCountY; ++y) {
-           qDebug() << "level=" << level << "row=" << y << "/" << tileCountY;
-           int posY = y * Tile::HEIGHT;
-           for (int x = 0; x < tileCountX; ++x) {
-               QPoint tilePos(x * Tile::WIDTH, posY);
-               
-               if (!store->contains(level2d, tilePos)) {
-                   iterator.clearCache();
-                   Tile t = computeTile(tilePos, iterator, QPoint(parentLevel, parentLevel), QPoint(level, level));
-                  
-                   bool saved = store->saveTile(t);
-                   if (!saved) {
-                       qWarning() << "Cannot save tile on level" << level << "at" << x << "," << y;
-                   }
-      
-                   processedTiles++;
-                   if (processedTiles % TILE_COUNT_REPORT_PROGRESS == 0) {
-                       qint64 milis = et.elapsed();
-                       emit progressChanged(level2d, totalTileCount, TILE_COUNT_REPORT_PROGRESS, milis);
-                       et.start();
-                   }
-
-               }
-           }
-       }
-       store->end();
-
-       qint64 milis = et.elapsed();
-       emit progressChanged(level2d, totalTileCount, processedTiles % TILE_COUNT_REPORT_PROGRESS, milis);
-       et.start();
-       
+       buildLevel(QPoint(parentLevel, parentLevel), QPoint(level, level), store);
+
        parentLevel = level;
        level++;
    }
@@ -319,45 +379,7 @@ void TileBuilder::buildRipTilePyramid(const QPoint &lastLevel, TileStore * store
 
 }
 
-Tile TileBuilder::computeTile(const QPoint &pos, RandomTileIterator &iterator, const QPoint &parentLevel, const QPoint &level)
-{
-    //TODO fix for rip map
-    Q_ASSERT(parentLevel.x() == parentLevel.y());
-    Q_ASSERT(level.x() == level.y());
-
-    // compute new tile
-    QVector<double> data;
-    data.reserve(Tile::WIDTH * Tile::HEIGHT);
-
-    for (int tileY = 0; tileY < Tile::HEIGHT; ++tileY) {
-        int globalPosY = pos.y() + tileY;
-        for (int tileX = 0; tileX < Tile::WIDTH; ++tileX) {
-            int globalPosX = pos.x() + tileX;
-
-            // box filtering , see https://graphics.ethz.ch/teaching/former/vc_master_06/Downloads/Mipmaps_1.pdf slide 10
-            iterator.moveTo(parentLevel, globalPosX * 2, globalPosY * 2);
-            double topLeft = iterator.value();
-            
-            iterator.moveTo(parentLevel, globalPosX * 2 + 1, globalPosY * 2);
-            double topRight = iterator.value();
-
-            iterator.moveTo(parentLevel, globalPosX * 2, globalPosY * 2 + 1);
-            double bottomLeft = iterator.value();
-
-            iterator.moveTo(parentLevel, globalPosX * 2 + 1, globalPosY * 2 + 1);
-            double bottomRight = iterator.value();
-
-            double value = (topLeft + topRight + bottomLeft + bottomRight) / 4.0;
-            data.push_back(value);
-        }
-    }
-
-    TileInfo ti(level, pos);
-    return Tile(ti, data);
-}
-
-
-Tile TileBuilder::computeTileNG(const QPoint &pos, RandomTileIterator &iterator, const QPoint &parentLevel, const QPoint &level)
+Tile TileBuilder::computeTileNG(const QPoint &pos, RandomTileIterator &iterator, const QPoint &parentLevel, const QPoint &level) const
 {
 
     bool scaleX = parentLevel.x() < level.x();
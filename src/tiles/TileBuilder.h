@@ -87,6 +87,12 @@ public:
 
     void buildTilePyramid(int lastLavel, TileStore * store);
 
+    // Number of threads computing the tiles of a level in buildTilePyramid and buildRipTilePyramid.
+    // 0 (default) means QThread::idealThreadCount(), 1 computes the tiles on the calling thread.
+    // The store is only used from the calling thread.
+    void setThreadCount(int threadCount) { m_threadCount = threadCount; }
+    int threadCount() const { return m_threadCount; }
+
     // building document 
     void buildRipTilePyramid(const QPoint &lastLevel, TileStore * store);
 
@@ -99,13 +105,11 @@ signals:
     void progressChanged(const QPoint &level, int totalTileCount, int processedTiles, qint64 milisecondsElapsed);
 
 private:
-    Tile computeTile(const QPoint &pos, RandomTileIterator &iterator, const QPoint &parentLevel, const QPoint &level);
-    Tile computeTileNG(const QPoint &pos, RandomTileIterator &iterator, const QPoint &parentLevel, const QPoint &level);
-
-
+    Tile computeTileNG(const QPoint &pos, RandomTileIterator &iterator, const QPoint &parentLevel, const QPoint &level) const;
 
 private:
     TileRange m_range;
+    int m_threadCount = 0;
 };
 
 _PMI_END
@@ -8,6 +8,7 @@
 
 #include "ClusterFinder.h"
 #include "FinderFeaturesDao.h"
+#include "FinderFeaturesKdTree.h"
 #include "FinderSamplesDao.h"
 #include "InsilicoPeptidesCsvFormatter.h"
 #include "ProgressBarInterface.h"
@@ -51,18 +52,13 @@ Err ClusterFinder::run(QSharedPointer<ProgressBarInterface> progress)
     FinderFeaturesDao featuresDao(d->db);
     e = featuresDao.makeIndexes(); ree;
 
-    const int INVALID_FEATURE_ID = -1;
-    int firstId = INVALID_FEATURE_ID;
-    int lastId = INVALID_FEATURE_ID;
-
-    e = featuresDao.firstItemId(&firstId); ree;
-    if (firstId == INVALID_FEATURE_ID) {
+    // all features are grouped in memory, neighbors come from a k-d tree built once for the pass
+    QVector<FinderFeaturesDaoEntry> features;
+    e = featuresDao.loadFeatures(&features); ree;
+    if (features.isEmpty()) {
         warningMs() << "No features to cluster! We are done.";
         return kNoErr;
     }
-    
-    e = featuresDao.lastItemId(&lastId); ree;
-    Q_ASSERT(lastId != INVALID_FEATURE_ID);
 
     FinderSamplesDao samplesDao(d->db);
 
@@ -73,69 +69,91 @@ Err ClusterFinder::run(QSharedPointer<ProgressBarInterface> progress)
         rrr(kError);
     }
 
-    const int CACHE_SIZE = 2 * 1024;
-    QMap<int, int> featureIdGroupNumberCache;
+    const FinderFeaturesKdTree tree(features);
+
+    // features are ordered by Id, candidates are mapped back to their index by Id
+    auto featureIndex = [&features](int id) {
+        auto it = std::lower_bound(
+            features.cbegin(), features.cend(), id,
+            [](const FinderFeaturesDaoEntry &feature, int value) { return feature.id < value; });
+        Q_ASSERT(it != features.cend() && it->id == id);
+        return static_cast<int>(it - features.cbegin());
+    };
+
+    QVector<int> groupNumbers(features.size());
+    for (int i = 0; i < features.size(); ++i) {
+        groupNumbers[i] = features.at(i).groupNumber;
+    }
+
+    QMap<int, int> featureIdGroupNumbers;
 
     {
-        const int size = lastId - firstId + 1;
-        ProgressContext progressContext(size, progress);
-        for (int i = firstId; i <= lastId; ++i, ++progressContext) {
+        ProgressContext progressContext(features.size(), progress);
+        QVector<int> neighborIndices;
+        QVector<FinderFeaturesDaoEntry> neighbors;
+        for (int i = 0; i < features.size(); ++i, ++progressContext) {
             if (progress && progress->userCanceled()) {
                 break;
             }
 
-            FinderFeaturesDaoEntry entry;
-            e = featuresDao.loadFeature(i, &entry); ree;
-            QVector<FinderFeaturesDaoEntry> cluster;
-
-            if (entry.groupNumber == -1 && !featureIdGroupNumberCache.contains(entry.id)) {
-                // determine group number
-                cluster.push_back(entry);
-
-                // fetch all neighbor features which are not grouped yet
-                // and are from different sample
-                QVector<FinderFeaturesDaoEntry> neighbors;
-                e = featuresDao.loadNeighborFeatures(entry, d->settings, &neighbors); ree;
-
-                // remove items that are grouped in cache!
-                QMutableVectorIterator<FinderFeaturesDaoEntry> it(neighbors);
-                while (it.hasNext()) {
-                    const FinderFeaturesDaoEntry &feature = it.next();
-                    if (featureIdGroupNumberCache.contains(feature.id)) {
-                        it.remove();
-                    }
-                }
+            if (groupNumbers.at(i) != -1) {
+                continue;
+            }
 
-                // for each sample select just one, "best" candidate
-                for (int sampleId : sampleIds) {
-                    // skip the same sample id features, we are not going to add them to cluster
-                    if (sampleId == entry.samplesId) {
-                        continue;
-                    }
+            const FinderFeaturesDaoEntry &entry = features.at(i);
 
-                    FinderFeaturesDaoEntry candidate = bestCandidate(sampleId, entry, neighbors);
-                    if (!candidate.isNull()) {
-                        cluster.push_back(candidate);
-                    }
+            // fetch all neighbor features which are not grouped yet
+            // and are from different sample
+            neighborIndices.clear();
+            tree.neighbors(entry, d->settings, &neighborIndices);
+
+            QMutableVectorIterator<int> it(neighborIndices);
+            while (it.hasNext()) {
+                const int index = it.next();
+                if (groupNumbers.at(index) != -1
+                    || features.at(index).samplesId == entry.samplesId) {
+                    it.remove();
                 }
+            }
+
+            // bestCandidate expects neighbors ordered by SamplesId
+            std::sort(neighborIndices.begin(), neighborIndices.end(),
+                      [&features](int left, int right) {
+                          const FinderFeaturesDaoEntry &l = features.at(left);
+                          const FinderFeaturesDaoEntry &r = features.at(right);
+                          return l.samplesId < r.samplesId
+                              || (l.samplesId == r.samplesId && l.id < r.id);
+                      });
+
+            neighbors.clear();
+            for (int index : qAsConst(neighborIndices)) {
+                neighbors.push_back(features.at(index));
+            }
+
+            // update group number
+            groupNumber++;
+            groupNumbers[i] = groupNumber;
+            featureIdGroupNumbers.insert(entry.id, groupNumber);
 
-                // update group number
-                groupNumber++;
-                for (const FinderFeaturesDaoEntry &entry : qAsConst(cluster)) {
-                    featureIdGroupNumberCache.insert(entry.id, groupNumber);
+            // for each sample select just one, "best" candidate
+            for (int sampleId : sampleIds) {
+                // skip the same sample id features, we are not going to add them to cluster
+                if (sampleId == entry.samplesId) {
+                    continue;
                 }
 
-                if (featureIdGroupNumberCache.size() > CACHE_SIZE) {
-                    e = featuresDao.updateGroupNumbers(featureIdGroupNumberCache); ree;
-                    featureIdGroupNumberCache.clear();
+                FinderFeaturesDaoEntry candidate = bestCandidate(sampleId, entry, neighbors);
+                if (!candidate.isNull()) {
+                    groupNumbers[featureIndex(candidate.id)] = groupNumber;
+                    featureIdGroupNumbers.insert(candidate.id, groupNumber);
                 }
             }
         }
     }
 
-    if (!featureIdGroupNumberCache.isEmpty()) {
-        e = featuresDao.updateGroupNumbers(featureIdGroupNumberCache); ree;
-        featureIdGroupNumberCache.clear();
+    // single transaction for the whole pass
+    if (!featureIdGroupNumbers.isEmpty()) {
+        e = featuresDao.updateGroupNumbers(featureIdGroupNumbers); ree;
     }
 
     return e;
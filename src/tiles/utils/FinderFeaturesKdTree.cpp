@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2019 Protein Metrics Inc. - All Rights Reserved.
+ * Unauthorized copying or distribution of this file, via any medium is strictly prohibited.
+ * Confidential.
+ */
+
+#include "FinderFeaturesKdTree.h"
+
+#include <algorithm>
+
+_PMI_BEGIN
+
+FinderFeaturesKdTree::FinderFeaturesKdTree(const QVector<FinderFeaturesDaoEntry> &features)
+{
+    m_points.resize(features.size());
+    for (int i = 0; i < features.size(); ++i) {
+        const FinderFeaturesDaoEntry &feature = features.at(i);
+        Point &point = m_points[i];
+        point.coordinates[AxisUnchargedMass] = feature.unchargedMass;
+        point.coordinates[AxisApexTime] = feature.apexTime;
+        point.coordinates[AxisIntensity] = feature.intensity;
+        point.index = i;
+    }
+
+    build(0, static_cast<int>(m_points.size()), AxisUnchargedMass);
+}
+
+void FinderFeaturesKdTree::neighbors(const FinderFeaturesDaoEntry &entry,
+                                     const NeighborSettings &settings,
+                                     QVector<int> *indices) const
+{
+    Q_ASSERT(indices);
+
+    // bounds are computed the same way as in the SQL of FinderFeaturesDao::loadNeighborFeatures
+    const double low[AxisCount] = { entry.unchargedMass - settings.unchargedMassEpsilon,
+                                    entry.apexTime - settings.apexTimeEpsilon,
+                                    entry.intensity - settings.intensityEpsilon };
+
+    const double high[AxisCount] = { entry.unchargedMass + settings.unchargedMassEpsilon,
+                                     entry.apexTime + settings.apexTimeEpsilon,
+                                     entry.intensity + settings.intensityEpsilon };
+
+    search(0, static_cast<int>(m_points.size()), AxisUnchargedMass, low, high, indices);
+}
+
+int FinderFeaturesKdTree::size() const
+{
+    return static_cast<int>(m_points.size());
+}
+
+void FinderFeaturesKdTree::build(int begin, int end, int axis)
+{
+    if (end - begin < 2) {
+        return;
+    }
+
+    const int middle = begin + (end - begin) / 2;
+    std::nth_element(m_points.begin() + begin, m_points.begin() + middle, m_points.begin() + end,
+                     [axis](const Point &left, const Point &right) {
+                         return left.coordinates[axis] < right.coordinates[axis];
+                     });
+
+    const int nextAxis = (axis + 1) % AxisCount;
+    build(begin, middle, nextAxis);
+    build(middle + 1, end, nextAxis);
+}
+
+void FinderFeaturesKdTree::search(int begin, int end, int axis, const double *low,
+                                  const double *high, QVector<int> *indices) const
+{
+    while (begin < end) {
+        const int middle = begin + (end - begin) / 2;
+        const Point &point = m_points[middle];
+
+        bool inside = true;
+        for (int i = 0; i < AxisCount && inside; ++i) {
+            inside = point.coordinates[i] < high[i] && point.coordinates[i] > low[i];
+        }
+        if (inside) {
+            indices->push_back(point.index);
+        }
+
+        // left part holds values <= split, right part values >= split
+        const double split = point.coordinates[axis];
+        const bool visitLeft = low[axis] < split;
+        const bool visitRight = high[axis] > split;
+        const int nextAxis = (axis + 1) % AxisCount;
+
+        if (visitLeft && visitRight) {
+            search(begin, middle, nextAxis, low, high, indices);
+            begin = middle + 1;
+        } else if (visitLeft) {
+            end = middle;
+        } else if (visitRight) {
+            begin = middle + 1;
+        } else {
+            return;
+        }
+        axis = nextAxis;
+    }
+}
+
+_PMI_END
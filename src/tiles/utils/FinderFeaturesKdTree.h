@@ -0,0 +1,64 @@
+/*
+ * Copyright (C) 2019 Protein Metrics Inc. - All Rights Reserved.
+ * Unauthorized copying or distribution of this file, via any medium is strictly prohibited.
+ * Confidential.
+ */
+
+#ifndef FINDER_FEATURES_KD_TREE_H
+#define FINDER_FEATURES_KD_TREE_H
+
+#include "pmi_common_ms_export.h"
+
+#include "FinderFeaturesDao.h"
+
+#include <pmi_core_defs.h>
+
+#include <QVector>
+
+#include <vector>
+
+_PMI_BEGIN
+
+/*
+ * @brief Static 3D k-d tree over uncharged mass, apex time and intensity of features
+ *
+ * The tree is built once for the whole grouping pass and replaces per feature range queries in
+ * the database. Neighbors are reported by index into the vector the tree was built from.
+ */
+class PMI_COMMON_MS_EXPORT FinderFeaturesKdTree
+{
+public:
+    explicit FinderFeaturesKdTree(const QVector<FinderFeaturesDaoEntry> &features);
+
+    /*
+     * @brief Appends indices of features strictly inside the box given by @a settings around
+     * @a entry, the box is the same as in FinderFeaturesDao::loadNeighborFeatures
+     *
+     * Indices are appended in no particular order, @a entry itself is included if it was part of
+     * the tree.
+     */
+    void neighbors(const FinderFeaturesDaoEntry &entry, const NeighborSettings &settings,
+                   QVector<int> *indices) const;
+
+    int size() const;
+
+private:
+    enum Axis { AxisUnchargedMass, AxisApexTime, AxisIntensity, AxisCount };
+
+    struct Point {
+        double coordinates[AxisCount];
+        int index;
+    };
+
+    void build(int begin, int end, int axis);
+    void search(int begin, int end, int axis, const double *low, const double *high,
+                QVector<int> *indices) const;
+
+private:
+    // implicit balanced tree, the node of range [begin, end) is its middle element
+    std::vector<Point> m_points;
+};
+
+_PMI_END
+
+#endif // FINDER_FEATURES_KD_TREE_H
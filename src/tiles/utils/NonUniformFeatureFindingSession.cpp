@@ -23,6 +23,8 @@
 
 #include <QRect>
 
+#include <limits>
+
 _PMI_BEGIN
 
 class Q_DECL_HIDDEN NonUniformFeatureFindingSession::Private
@@ -65,7 +67,8 @@ NonUniformFeatureFindingSession::NonUniformFeatureFindingSession(MSDataNonUnifor
 {
     const NonUniformTileRange &range = d->device.range();
 
-    d->device.tileManager()->setCacheSize(range.tileCountX() * range.tileCountY());
+    // keep every tile of the range cached for the whole session
+    d->device.tileManager()->setCacheSizeBytes(std::numeric_limits<qint64>::max());
     QRect tileRect = range.tileRect(range.areaRect());
     setSearchArea(tileRect);
 
@@ -75,7 +78,7 @@ NonUniformFeatureFindingSession::NonUniformFeatureFindingSession(MSDataNonUnifor
     // if tile is already deserialized to cache, so what can happen is that  you write directly to
     // store but when you read and tile is cached, the tile from cache does not have the values from
     // store
-    d->selectionTileManager.setCacheSize(0);
+    d->selectionTileManager.setCacheSizeBytes(0);
 }
 
 NonUniformFeatureFindingSession::~NonUniformFeatureFindingSession()
@@ -567,7 +567,7 @@ void NonUniformHillClusterFinder::markHills(const QVector<NonUniformTilePoint> &
         hillIndexManager, device->range(),
         device->doCentroiding());
 
-    hillIndexIterator.setCacheSize(0);
+    hillIndexIterator.setCacheSizeBytes(0);
 
     NonUniformTileHillIndexStoreMemory *memoryStore
         = dynamic_cast<NonUniformTileHillIndexStoreMemory *>(hillIndexManager->store());
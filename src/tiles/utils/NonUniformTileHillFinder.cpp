@@ -539,7 +539,7 @@ void NonUniformTileHillFinder::markPointsAsProcessed(
     RandomNonUniformTileSelectionIterator bitIterator(selectionTileManager, d->device->range(),
                                                       d->device->doCentroiding());
 
-    bitIterator.setCacheSize(0);
+    bitIterator.setCacheSizeBytes(0);
 
     NonUniformTileSelectionStoreMemory *selectionStore
         = dynamic_cast<NonUniformTileSelectionStoreMemory *>(selectionTileManager->store());
@@ -613,7 +613,7 @@ Err NonUniformTileHillFinder::getXICDataWithSelection(const MzScanIndexRect &win
 
     RandomNonUniformTileSelectionIterator bitIterator(
         d->session->selectionTileManager(), d->device->range(), d->device->doCentroiding());
-    bitIterator.setCacheSize(0);
+    bitIterator.setCacheSizeBytes(0);
 
     NonUniformTilePoint pt;
     while (iterator.hasNext()) {
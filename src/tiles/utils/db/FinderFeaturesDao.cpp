@@ -172,6 +172,49 @@ Err FinderFeaturesDao::loadFeature(int id, FinderFeaturesDaoEntry *entry) const
     return e;
 }
 
+Err FinderFeaturesDao::loadFeatures(QVector<FinderFeaturesDaoEntry> *entries) const
+{
+    Q_ASSERT(entries);
+
+    Err e = kNoErr;
+    QSqlQuery q = makeQuery(m_db, true);
+    q.setForwardOnly(true);
+    e = QPREPARE(q, QString(R"(SELECT   Id, SamplesId, 
+                                        UnchargedMass, StartTime, EndTime, 
+                                        ApexTime, Intensity, GroupNumber 
+                               FROM FinderFeatures 
+                               ORDER BY Id ASC)")); ree;
+
+    e = QEXEC_NOARG(q); ree;
+
+    entries->clear();
+    while (q.next()) {
+        FinderFeaturesDaoEntry result;
+
+        bool ok;
+        result.id = q.value(0).toInt(&ok);
+        Q_ASSERT(ok);
+        result.samplesId = q.value(1).toInt(&ok);
+        Q_ASSERT(ok);
+        result.unchargedMass = q.value(2).toDouble(&ok);
+        Q_ASSERT(ok);
+        result.startTime = q.value(3).toDouble(&ok);
+        Q_ASSERT(ok);
+        result.endTime = q.value(4).toDouble(&ok);
+        Q_ASSERT(ok);
+        result.apexTime = q.value(5).toDouble(&ok);
+        Q_ASSERT(ok);
+        result.intensity = q.value(6).toDouble(&ok);
+        Q_ASSERT(ok);
+        result.groupNumber = q.value(7).toInt(&ok);
+        Q_ASSERT(ok);
+
+        entries->push_back(result);
+    }
+
+    return e;
+}
+
 Err FinderFeaturesDao::loadNeighborFeatures(const FinderFeaturesDaoEntry &entry,
                                             const NeighborSettings &settings,
                                             QVector<FinderFeaturesDaoEntry> *entries) const
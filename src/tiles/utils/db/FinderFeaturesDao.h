@@ -68,6 +68,9 @@ public:
 
     Err loadFeature(int id, FinderFeaturesDaoEntry *entry) const;
 
+    // loads all features ordered by Id, text columns are not loaded
+    Err loadFeatures(QVector<FinderFeaturesDaoEntry> *entries) const;
+
     Err loadNeighborFeatures(const FinderFeaturesDaoEntry &entry, const NeighborSettings &settings,
                              QVector<FinderFeaturesDaoEntry> *entries) const;
 
@@ -10,6 +10,7 @@
 #include "pmi_common_ms_debug.h"
 
 #include "InsilicoGenerator.h"
+#include "MSReader.h"
 #include <PmiMemoryInfo.h>
 #include "PQMFeatureMatcher.h"
 #include "ScanIterator.h"
@@ -17,12 +18,354 @@
 #include <ProgressBarInterface.h>
 #include <ProgressContext.h>
 
+#include <QDir>
+#include <QElapsedTimer>
 #include <QFileInfo>
+#include <QFuture>
+#include <QHash>
+#include <QMutex>
+#include <QQueue>
+#include <QSharedPointer>
+#include <QThreadPool>
+#include <QWaitCondition>
+#include <QtConcurrent/QtConcurrentRun>
 
 #include <algorithm>
+#include <vector>
 
 _PMI_BEGIN
 
+namespace
+{
+
+// how often a sample held back by the memory limit re-checks the process memory
+const unsigned long MEMORY_CHECK_INTERVAL_MS = 500;
+
+/*!
+ * @brief Centroided MS1 scans of a sample, read through MSReader
+ *
+ * MSReader is a singleton which has to be used from the calling thread. The scans are read with
+ * its centroiding and m/z calibration, exactly as ScanIterator reads them in the serial path, and
+ * the worker thread finding the features reads them from here. Only the calls made by
+ * ScanIterator::iterateMSFileLinearDBSCANSelect are implemented.
+ */
+class SampleMS1Scans : public MSReaderInterface
+{
+public:
+    Err read(MSReader *ms, const QString &filePath)
+    {
+        Err e = kNoErr;
+
+        e = ms->openFile(filePath); ree;
+        e = readScans(ms);
+        ms->closeFile();
+        ms->closeAllFileConnections();
+
+        return e;
+    }
+
+    Err openFile(const QString &filename, msreader::MSConvertOption convert_options,
+                 QSharedPointer<ProgressBarInterface> progress) override
+    {
+        Q_UNUSED(filename);
+        Q_UNUSED(convert_options);
+        Q_UNUSED(progress);
+        return kFunctionNotImplemented;
+    }
+
+    Err closeFile() override
+    {
+        return kNoErr;
+    }
+
+    bool canOpen(const QString &filename) const override
+    {
+        Q_UNUSED(filename);
+        return false;
+    }
+
+    Err getLockmassScans(QList<msreader::ScanInfoWrapper> *lockmassList) const override
+    {
+        Q_UNUSED(lockmassList);
+        return kFunctionNotImplemented;
+    }
+
+    Err getScanInfoListAtLevel(int level,
+                               QList<msreader::ScanInfoWrapper> *scanInfoList) const override
+    {
+        if (level != 1) {
+            return kFunctionNotImplemented;
+        }
+        *scanInfoList = m_scanInfoList;
+        return kNoErr;
+    }
+
+    Err getBasePeak(point2dList *points) const override
+    {
+        Q_UNUSED(points);
+        return kFunctionNotImplemented;
+    }
+
+    Err getTICData(point2dList *points) const override
+    {
+        Q_UNUSED(points);
+        return kFunctionNotImplemented;
+    }
+
+    Err getScanData(long scanNumber, point2dList *points, bool do_centroiding,
+                    msreader::PointListAsByteArrays *pointListAsByteArrays) override
+    {
+        if (!do_centroiding || pointListAsByteArrays || !m_scans.contains(scanNumber)) {
+            return kFunctionNotImplemented;
+        }
+        *points = m_scans.value(scanNumber);
+        return kNoErr;
+    }
+
+    Err getXICData(const msreader::XICWindow &win, point2dList *points,
+                   int msLevel) const override
+    {
+        Q_UNUSED(win);
+        Q_UNUSED(points);
+        Q_UNUSED(msLevel);
+        return kFunctionNotImplemented;
+    }
+
+    Err getXICDataBatch(const QVector<msreader::XICWindow> &windows, QVector<point2dList> *points,
+                        int msLevel) const override
+    {
+        Q_UNUSED(windows);
+        Q_UNUSED(points);
+        Q_UNUSED(msLevel);
+        return kFunctionNotImplemented;
+    }
+
+    Err getScanInfo(long scanNumber, msreader::ScanInfo *obj) const override
+    {
+        Q_UNUSED(scanNumber);
+        Q_UNUSED(obj);
+        return kFunctionNotImplemented;
+    }
+
+    Err getScanPrecursorInfo(long scanNumber, msreader::PrecursorInfo *pinfo) const override
+    {
+        Q_UNUSED(scanNumber);
+        Q_UNUSED(pinfo);
+        return kFunctionNotImplemented;
+    }
+
+    Err getNumberOfSpectra(long *totalNumber, long *startScan, long *endScan) const override
+    {
+        Q_UNUSED(totalNumber);
+        Q_UNUSED(startScan);
+        Q_UNUSED(endScan);
+        return kFunctionNotImplemented;
+    }
+
+    Err getFragmentType(long scanNumber, long scanLevel, QString *fragType) const override
+    {
+        Q_UNUSED(scanNumber);
+        Q_UNUSED(scanLevel);
+        Q_UNUSED(fragType);
+        return kFunctionNotImplemented;
+    }
+
+    Err getChromatograms(QList<msreader::ChromatogramInfo> *chroList,
+                         const QString &internalChannelName) override
+    {
+        Q_UNUSED(chroList);
+        Q_UNUSED(internalChannelName);
+        return kFunctionNotImplemented;
+    }
+
+    Err getBestScanNumber(int msLevel, double scanTimeMinutes, long *scanNumber) const override
+    {
+        Q_UNUSED(msLevel);
+        Q_UNUSED(scanTimeMinutes);
+        Q_UNUSED(scanNumber);
+        return kFunctionNotImplemented;
+    }
+
+private:
+    Err readScans(MSReader *ms)
+    {
+        Err e = kNoErr;
+
+        // same calls as in ScanIterator::findChargeClustersSerial
+        const bool doCentroid = true;
+        e = ms->getScanInfoListAtLevel(1, &m_scanInfoList); ree;
+        m_scans.reserve(m_scanInfoList.size());
+        for (const msreader::ScanInfoWrapper &scanInfo : qAsConst(m_scanInfoList)) {
+            point2dList &points = m_scans[scanInfo.scanNumber];
+            e = ms->getScanData(scanInfo.scanNumber, &points, doCentroid); ree;
+        }
+
+        return e;
+    }
+
+private:
+    QList<msreader::ScanInfoWrapper> m_scanInfoList;
+    QHash<long, point2dList> m_scans;
+};
+
+struct SampleTask {
+    int index = -1;
+    QSharedPointer<SampleMS1Scans> scans;
+    QElapsedTimer queuedTimer;
+};
+
+struct SampleResult {
+    Err e = kNoErr;
+    QString errorMessage;
+    QString featuresFilePath;
+    SampleStageTimings timings;
+};
+
+/*!
+ * @brief Samples ready for feature finding, shared by the worker threads
+ *
+ * An idle worker takes the next sample, so the work is balanced without assigning samples to
+ * threads up front. A sample is not handed out while the process memory is above the limit and
+ * another sample is still running.
+ */
+class SampleTaskQueue
+{
+public:
+    explicit SampleTaskQueue(size_t memoryLimit)
+        : m_memoryLimit(memoryLimit)
+    {
+    }
+
+    void push(int index, const QSharedPointer<SampleMS1Scans> &scans)
+    {
+        SampleTask task;
+        task.index = index;
+        task.scans = scans;
+        task.queuedTimer.start();
+
+        QMutexLocker locker(&m_mutex);
+        m_tasks.enqueue(task);
+        m_condition.wakeAll();
+    }
+
+    //! @brief no more samples will be pushed
+    void close()
+    {
+        QMutexLocker locker(&m_mutex);
+        m_closed = true;
+        m_condition.wakeAll();
+    }
+
+    //! @brief drops the queued samples, running samples are finished
+    void abort()
+    {
+        QMutexLocker locker(&m_mutex);
+        m_aborted = true;
+        m_condition.wakeAll();
+    }
+
+    //! @brief blocks while @a count or more samples wait for a worker, bounds the scans in memory
+    void waitForQueuedBelow(int count)
+    {
+        QMutexLocker locker(&m_mutex);
+        while (!m_aborted && m_tasks.size() >= count) {
+            m_condition.wait(&m_mutex);
+        }
+    }
+
+    bool isAborted() const
+    {
+        QMutexLocker locker(&m_mutex);
+        return m_aborted;
+    }
+
+    int finishedCount() const
+    {
+        QMutexLocker locker(&m_mutex);
+        return m_finishedCount;
+    }
+
+    //! @brief blocks until a sample can be started, @return false when there is nothing left
+    bool take(SampleTask *task)
+    {
+        QMutexLocker locker(&m_mutex);
+        bool heldBack = false;
+        while (!m_aborted) {
+            if (!m_tasks.isEmpty()) {
+                // one sample always runs, otherwise nothing would ever release the memory
+                if (m_running == 0 || !isOverMemoryLimit()) {
+                    *task = m_tasks.dequeue();
+                    ++m_running;
+                    // wakes the reader waiting in waitForQueuedBelow()
+                    m_condition.wakeAll();
+                    return true;
+                }
+                if (!heldBack) {
+                    debugMs() << "Process memory" << MemoryInfo::processMemory()
+                              << "is over the limit" << m_memoryLimit << "with" << m_running
+                              << "samples running, waiting";
+                    heldBack = true;
+                }
+                m_condition.wait(&m_mutex, MEMORY_CHECK_INTERVAL_MS);
+            } else if (m_closed) {
+                return false;
+            } else {
+                m_condition.wait(&m_mutex);
+            }
+        }
+        return false;
+    }
+
+    //! @brief marks a taken sample as done, a failed sample aborts the queue
+    void finish(bool ok)
+    {
+        QMutexLocker locker(&m_mutex);
+        --m_running;
+        ++m_finishedCount;
+        if (!ok) {
+            m_aborted = true;
+        }
+        m_condition.wakeAll();
+    }
+
+    /*!
+     * @brief blocks until more than @a finishedCount samples are finished or until all work is
+     * done; @a finishedCount is updated. @return false when all work is done
+     */
+    bool waitForFinished(int *finishedCount)
+    {
+        QMutexLocker locker(&m_mutex);
+        while (!isDone() && m_finishedCount == *finishedCount) {
+            m_condition.wait(&m_mutex);
+        }
+        *finishedCount = m_finishedCount;
+        return !isDone();
+    }
+
+private:
+    bool isOverMemoryLimit() const
+    {
+        return m_memoryLimit > 0 && MemoryInfo::processMemory() > m_memoryLimit;
+    }
+
+    bool isDone() const
+    {
+        return m_closed && m_running == 0 && (m_aborted || m_tasks.isEmpty());
+    }
+
+private:
+    const size_t m_memoryLimit;
+    mutable QMutex m_mutex;
+    QWaitCondition m_condition;
+    QQueue<SampleTask> m_tasks;
+    int m_running = 0;
+    int m_finishedCount = 0;
+    bool m_closed = false;
+    bool m_aborted = false;
+};
+
+} // namespace
+
 MultiSampleScanFeatureFinder::MultiSampleScanFeatureFinder(const QVector<SampleSearch> &msFiles,
                                                            const QString &neuralNetworkDbFilePath, const SettableFeatureFinderParameters &ffUserParams)
     : m_inputFilePaths(msFiles)
@@ -84,53 +427,45 @@ Err MultiSampleScanFeatureFinder::findFeatures(QSharedPointer<ProgressBarInterfa
         progress->setText(QObject::tr("Finding features..."));
     }
 
-    ScanIterator iterator(m_neuralNetworkDbFilePath, m_ffUserParams);
-    if (m_isWorkingDirectorySet) {
-        iterator.setWorkingDirectory(m_workingDirectory);
-    } else {
+    if (!m_isWorkingDirectorySet) {
         debugMs() << "Working directory is not set, temporary files will be written next to vendor "
                      "file paths";
     }
-    
-    e = iterator.init();
-    if (e != kNoErr) {
-        // this is workflow, so we will properly format the message on error
-        setErrorMessage(QObject::tr("Failed to initialize the feature finder"));
-        rrr(e);
-    }
 
-    // this can be eventually done in threads, not sure about MSReader being used in multi-threaded
-    // environment
+    // samples are processed in parallel only on request, see setThreadCount()
+    const int threadCount = std::max(1, std::min(m_threadCount, m_inputFilePaths.size()));
+
     QVector<SampleFeaturesTurbo> msFeaturesDbPaths;
+    m_sampleStageTimings.clear();
 
-    {
-        ProgressContext progressContext(m_inputFilePaths.size(), progress);
-        for (const SampleSearch &item : qAsConst(m_inputFilePaths)) {
-            const QString sampleFilePath = item.sampleFilePath;
-            QString featuresCacheDbFilePath;
-            e = iterator.iterateMSFileLinearDBSCANSelect(sampleFilePath, &featuresCacheDbFilePath, progress);
-            if (e != kNoErr) {
-                setErrorMessage(QObject::tr("Finding features failed for %1").arg(sampleFilePath));
-                rrr(e);
-            }
+    QElapsedTimer stageTimer;
+    stageTimer.start();
 
-            SampleFeaturesTurbo featureItem;
-            featureItem.featuresFilePath = featuresCacheDbFilePath;
-            featureItem.sampleFilePath = sampleFilePath;
-            msFeaturesDbPaths.push_back(featureItem);
-            ++progressContext;
-        }
+    if (threadCount > 1) {
+        e = findFeaturesParallel(threadCount, &msFeaturesDbPaths, progress); ree;
+    } else {
+        e = findFeaturesSerial(&msFeaturesDbPaths, progress); ree;
     }
 
+    debugMs() << "Features found in" << m_inputFilePaths.size() << "samples using" << threadCount
+              << "threads in" << stageTimer.restart() << "ms";
+
     if (progress) {
         progress->setText(QObject::tr("Matching MS2 ..."));
     }
     ++overallProgressContext;
 
-    if (m_ffUserParams.enableMS2Matching) {
+    // the worker threads match MS2 right after finding the features of their sample
+    if (m_ffUserParams.enableMS2Matching && threadCount <= 1) {
         e = matchMS2WithByonic(msFeaturesDbPaths, progress); ree;
+        debugMs() << "MS2 matched in" << stageTimer.restart() << "ms";
+    }
+
+    for (const SampleStageTimings &timings : qAsConst(m_sampleStageTimings)) {
+        debugMs() << timings.sampleFilePath << "reading scans" << timings.readScansMs
+                  << "ms, queued" << timings.queuedMs << "ms, features" << timings.findFeaturesMs
+                  << "ms, MS2 matching" << timings.matchMS2Ms << "ms";
     }
-    
 
     // cross sample matching
     if (progress) {
@@ -153,6 +488,8 @@ Err MultiSampleScanFeatureFinder::findFeatures(QSharedPointer<ProgressBarInterfa
         rrr(e);
     }
     qDebug() << "Process peak memory after Collation" << pmi::MemoryInfo::peakProcessMemory();
+    debugMs() << "Cross sample collation done in" << stageTimer.restart() << "ms";
+
     InsilicoGenerator generator(crossSampleCollator.masterFeaturesDatabasePath());
     generator.setMS2MatchingEnabled(m_ffUserParams.enableMS2Matching);
 
@@ -163,6 +500,7 @@ Err MultiSampleScanFeatureFinder::findFeatures(QSharedPointer<ProgressBarInterfa
         setErrorMessage("Failed to generate Insilico CSV file");
         rrr(e);
     }
+    debugMs() << "Insilico file generated in" << stageTimer.elapsed() << "ms";
 
     m_insilicoPeptideCsv = csvFilePath;
 
@@ -171,13 +509,257 @@ Err MultiSampleScanFeatureFinder::findFeatures(QSharedPointer<ProgressBarInterfa
     return e;
 }
 
+Err MultiSampleScanFeatureFinder::initScanIterator(ScanIterator *iterator, int scanThreadCount)
+{
+    Err e = kNoErr;
+
+    iterator->setThreadCount(scanThreadCount);
+
+    if (m_isWorkingDirectorySet) {
+        iterator->setWorkingDirectory(m_workingDirectory);
+    }
+
+    e = iterator->init();
+    if (e != kNoErr) {
+        // this is workflow, so we will properly format the message on error
+        setErrorMessage(QObject::tr("Failed to initialize the feature finder"));
+        rrr(e);
+    }
+
+    return e;
+}
+
+Err MultiSampleScanFeatureFinder::checkFeaturesFilePaths(const ScanIterator &iterator)
+{
+    Err e = kNoErr;
+
+    QHash<QString, QString> samplesByFeaturesFilePath;
+    for (const SampleSearch &item : qAsConst(m_inputFilePaths)) {
+        const QString featuresFilePath
+            = QDir::cleanPath(iterator.featureFinderDBFilePath(item.sampleFilePath));
+        const auto it = samplesByFeaturesFilePath.constFind(featuresFilePath);
+        if (it != samplesByFeaturesFilePath.constEnd()) {
+            setErrorMessage(QObject::tr("Features of %1 and %2 would be saved to the same file %3")
+                                .arg(it.value(), item.sampleFilePath, featuresFilePath));
+            rrr(kBadParameterError);
+        }
+        samplesByFeaturesFilePath.insert(featuresFilePath, item.sampleFilePath);
+    }
+
+    return e;
+}
+
+Err MultiSampleScanFeatureFinder::findFeaturesSerial(QVector<SampleFeaturesTurbo> *msFeaturesDbPaths,
+                                                     QSharedPointer<ProgressBarInterface> progress)
+{
+    Err e = kNoErr;
+
+    ScanIterator iterator(m_neuralNetworkDbFilePath, m_ffUserParams);
+    e = initScanIterator(&iterator, m_threadCount); ree;
+    e = checkFeaturesFilePaths(iterator); ree;
+
+    ProgressContext progressContext(m_inputFilePaths.size(), progress);
+    for (const SampleSearch &item : qAsConst(m_inputFilePaths)) {
+        const QString sampleFilePath = item.sampleFilePath;
+
+        SampleStageTimings timings;
+        timings.sampleFilePath = sampleFilePath;
+        QElapsedTimer timer;
+        timer.start();
+
+        QString featuresCacheDbFilePath;
+        e = iterator.iterateMSFileLinearDBSCANSelect(sampleFilePath, &featuresCacheDbFilePath, progress);
+        if (e != kNoErr) {
+            setErrorMessage(QObject::tr("Finding features failed for %1").arg(sampleFilePath));
+            rrr(e);
+        }
+        timings.findFeaturesMs = timer.elapsed();
+        m_sampleStageTimings.push_back(timings);
+
+        SampleFeaturesTurbo featureItem;
+        featureItem.featuresFilePath = featuresCacheDbFilePath;
+        featureItem.sampleFilePath = sampleFilePath;
+        msFeaturesDbPaths->push_back(featureItem);
+        ++progressContext;
+    }
+
+    return e;
+}
+
+Err MultiSampleScanFeatureFinder::findFeaturesParallel(int threadCount,
+                                                       QVector<SampleFeaturesTurbo> *msFeaturesDbPaths,
+                                                       QSharedPointer<ProgressBarInterface> progress)
+{
+    Err e = kNoErr;
+
+    // the threads left over by the samples analyze the scans of each sample
+    const int scanThreadCount = std::max(1, m_threadCount / threadCount);
+
+    // neural network weights are read through numbered sqlite connections, so the iterators are
+    // initialized here and not on the worker threads
+    QVector<QSharedPointer<ScanIterator>> iterators;
+    for (int i = 0; i < threadCount; ++i) {
+        QSharedPointer<ScanIterator> iterator(
+            new ScanIterator(m_neuralNetworkDbFilePath, m_ffUserParams));
+        e = initScanIterator(iterator.data(), scanThreadCount); ree;
+        iterators.push_back(iterator);
+    }
+    e = checkFeaturesFilePaths(*iterators.first()); ree;
+
+    const int sampleCount = m_inputFilePaths.size();
+    std::vector<SampleResult> results(sampleCount);
+    SampleTaskQueue queue(m_memoryLimit);
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(threadCount);
+
+    QVector<QFuture<void>> workers;
+    for (const QSharedPointer<ScanIterator> &iterator : qAsConst(iterators)) {
+        workers.push_back(QtConcurrent::run(&pool, [this, iterator, &queue, &results]() {
+            SampleTask task;
+            while (queue.take(&task)) {
+                SampleResult &result = results[task.index];
+                result.timings.queuedMs = task.queuedTimer.elapsed();
+                result.e = findFeaturesInSample(iterator.data(), m_inputFilePaths.at(task.index),
+                                                task.scans.data(), &result.featuresFilePath,
+                                                &result.timings, &result.errorMessage);
+                // the scans are released here, not when the next sample is taken
+                task = SampleTask();
+                queue.finish(result.e == kNoErr);
+            }
+        }));
+    }
+
+    {
+        ProgressContext progressContext(sampleCount, progress);
+        int progressCount = 0;
+        auto updateProgress = [&](int finishedCount) {
+            for (; progressCount < finishedCount; ++progressCount) {
+                ++progressContext;
+            }
+        };
+
+        // MSReader is used on this thread only, the workers get the scans it read
+        for (int i = 0; i < sampleCount && !queue.isAborted(); ++i) {
+            const SampleSearch &item = m_inputFilePaths.at(i);
+            SampleResult &result = results[i];
+            result.timings.sampleFilePath = item.sampleFilePath;
+
+            // one sample is read ahead of the workers
+            queue.waitForQueuedBelow(1);
+            updateProgress(queue.finishedCount());
+            if (queue.isAborted()) {
+                break;
+            }
+
+            if (progress) {
+                progress->setText(QObject::tr("Reading %1...").arg(item.sampleFilePath));
+            }
+
+            QElapsedTimer timer;
+            timer.start();
+            QSharedPointer<SampleMS1Scans> scans(new SampleMS1Scans);
+            result.e = scans->read(MSReader::Instance(), item.sampleFilePath);
+            result.timings.readScansMs = timer.elapsed();
+            if (result.e != kNoErr) {
+                result.errorMessage = QObject::tr("Cannot read %1").arg(item.sampleFilePath);
+                queue.abort();
+                break;
+            }
+
+            queue.push(i, scans);
+            updateProgress(queue.finishedCount());
+        }
+        queue.close();
+
+        if (progress) {
+            progress->setText(QObject::tr("Finding features..."));
+        }
+
+        int finishedCount = progressCount;
+        while (queue.waitForFinished(&finishedCount)) {
+            updateProgress(finishedCount);
+        }
+        updateProgress(finishedCount);
+    }
+
+    for (QFuture<void> &worker : workers) {
+        worker.waitForFinished();
+    }
+
+    for (const SampleResult &result : results) {
+        m_sampleStageTimings.push_back(result.timings);
+    }
+
+    for (const SampleResult &result : results) {
+        if (result.e != kNoErr) {
+            setErrorMessage(result.errorMessage);
+            rrr(result.e);
+        }
+    }
+
+    for (int i = 0; i < sampleCount; ++i) {
+        SampleFeaturesTurbo featureItem;
+        featureItem.featuresFilePath = results[i].featuresFilePath;
+        featureItem.sampleFilePath = m_inputFilePaths.at(i).sampleFilePath;
+        msFeaturesDbPaths->push_back(featureItem);
+    }
+
+    return e;
+}
+
+Err MultiSampleScanFeatureFinder::findFeaturesInSample(ScanIterator *iterator,
+                                                       const SampleSearch &item,
+                                                       MSReaderInterface *reader,
+                                                       QString *featuresFilePath,
+                                                       SampleStageTimings *timings,
+                                                       QString *errorMessage) const
+{
+    Err e = kNoErr;
+
+    QElapsedTimer timer;
+    timer.start();
+
+    e = iterator->iterateMSFileLinearDBSCANSelect(reader, item.sampleFilePath, featuresFilePath);
+    if (e != kNoErr) {
+        *errorMessage = QObject::tr("Finding features failed for %1").arg(item.sampleFilePath);
+        rrr(e);
+    }
+    timings->findFeaturesMs = timer.restart();
+
+    if (!m_ffUserParams.enableMS2Matching) {
+        return e;
+    }
+
+    if (item.byonicFilePath.isEmpty()) {
+        warningMs() << item.sampleFilePath << "does not have associated byonic search file";
+        return e;
+    }
+
+    PQMFeatureMatcher matcher(*featuresFilePath, item.byonicFilePath, m_ffUserParams);
+    matcher.setSettings(m_matchingSettings);
+    e = matcher.init();
+    if (e != kNoErr) {
+        *errorMessage = QObject::tr("Failed to match ids at %2")
+                            .arg(item.sampleFilePath, item.byonicFilePath);
+        rrr(e);
+    }
+    timings->matchMS2Ms = timer.elapsed();
+
+    return e;
+}
+
 Err MultiSampleScanFeatureFinder::matchMS2WithByonic(
     const QVector<SampleFeaturesTurbo> &msFeaturesDbPaths, QSharedPointer<ProgressBarInterface> progress)
 {
     Err e = kNoErr;
 
     ProgressContext progressContext(m_inputFilePaths.size(), progress);
-    for (const SampleSearch &item : qAsConst(m_inputFilePaths)) {
+    for (int i = 0; i < m_inputFilePaths.size(); ++i) {
+        const SampleSearch &item = m_inputFilePaths.at(i);
+        QElapsedTimer timer;
+        timer.start();
+
         if (progress) {
             progress->setText(QObject::tr("Matching MS2 in %1...").arg(item.sampleFilePath));
         }
@@ -203,6 +785,10 @@ Err MultiSampleScanFeatureFinder::matchMS2WithByonic(
                                 .arg(item.sampleFilePath, item.byonicFilePath));
             rrr(e);
         }
+
+        if (i < m_sampleStageTimings.size()) {
+            m_sampleStageTimings[i].matchMS2Ms = timer.elapsed();
+        }
     }
 
     return e;
@@ -254,6 +840,31 @@ void MultiSampleScanFeatureFinder::setMatchingSettings(const FeatureMatcherSetti
     m_matchingSettings = settings;
 }
 
+void MultiSampleScanFeatureFinder::setThreadCount(int count)
+{
+    m_threadCount = count;
+}
+
+int MultiSampleScanFeatureFinder::threadCount() const
+{
+    return m_threadCount;
+}
+
+void MultiSampleScanFeatureFinder::setMemoryLimit(size_t bytes)
+{
+    m_memoryLimit = bytes;
+}
+
+size_t MultiSampleScanFeatureFinder::memoryLimit() const
+{
+    return m_memoryLimit;
+}
+
+QVector<SampleStageTimings> MultiSampleScanFeatureFinder::sampleStageTimings() const
+{
+    return m_sampleStageTimings;
+}
+
 void MultiSampleScanFeatureFinder::setErrorMessage(const QString &msg)
 {
     m_errorMessage = msg;
@@ -32,6 +32,21 @@ struct SampleSearch {
     QString byonicFilePath;
 };
 
+//! @brief Time spent in the per sample stages of the feature finding, in milliseconds
+struct SampleStageTimings {
+    QString sampleFilePath;
+    //! reading of the MS1 scans through MSReader, done before the sample is queued; with one
+    //! thread the scans are read while finding the features and this stays 0
+    qint64 readScansMs = 0;
+    //! waiting for a free worker thread or for the memory to drop below the limit
+    qint64 queuedMs = 0;
+    qint64 findFeaturesMs = 0;
+    qint64 matchMS2Ms = 0;
+};
+
+class MSReaderInterface;
+class ScanIterator;
+
 //! @brief Scan feature finder for multiple samples
 class PMI_COMMON_MS_EXPORT MultiSampleScanFeatureFinder
 {
@@ -74,9 +89,52 @@ public:
     */
     void setMatchingSettings(const FeatureMatcherSettings &settings);
 
+    /*!
+    * @brief Number of samples processed in parallel. 0 or 1 (default) processes the samples one
+    * after another.
+    *
+    * The scans are always read through MSReader on the calling thread (vendors like Thermo must be
+    * opened on the main thread, see MSReader::openFile), so they are centroided and m/z calibrated
+    * the same way for any thread count. With more than one thread the MS1 scans of a sample are
+    * read into memory and handed to a worker thread which finds the features in them, while the
+    * next sample is read. Idle workers take the next sample, so long and short injections balance
+    * out.
+    *
+    * The threads are shared with the scan analysis of each sample, see ScanIterator::setThreadCount.
+    */
+    void setThreadCount(int count);
+    int threadCount() const;
+
+    /*!
+    * @brief No new sample is started while the process memory is above @a bytes, unless no other
+    * sample is in progress. 0 (default) means no limit.
+    */
+    void setMemoryLimit(size_t bytes);
+    size_t memoryLimit() const;
+
+    //! @brief Timings of the samples of the last findFeatures() call, in the input order
+    QVector<SampleStageTimings> sampleStageTimings() const;
+
 private:
     void setErrorMessage(const QString &msg);
 
+    Err initScanIterator(ScanIterator *iterator, int scanThreadCount);
+
+    //! @brief fails if two samples would save their features to the same ftrs file, e.g. samples
+    //! with the same name from different folders and a working directory set
+    Err checkFeaturesFilePaths(const ScanIterator &iterator);
+
+    Err findFeaturesSerial(QVector<SampleFeaturesTurbo> *msFeaturesDbPaths,
+                           QSharedPointer<ProgressBarInterface> progress);
+
+    Err findFeaturesParallel(int threadCount, QVector<SampleFeaturesTurbo> *msFeaturesDbPaths,
+                             QSharedPointer<ProgressBarInterface> progress);
+
+    //! @brief runs on the worker threads, must not modify the finder
+    Err findFeaturesInSample(ScanIterator *iterator, const SampleSearch &item,
+                             MSReaderInterface *reader, QString *featuresFilePath,
+                             SampleStageTimings *timings, QString *errorMessage) const;
+
     QString findFeaturesDbFilePath(const QString &sampleFilePath, const QVector<SampleFeaturesTurbo> &msFeaturesDbPaths);
 
     Err matchMS2WithByonic(const QVector<SampleFeaturesTurbo> &msFeaturesDbPaths,
@@ -95,6 +153,10 @@ private:
     FeatureMatcherSettings m_matchingSettings;
     SettableFeatureFinderParameters m_ffUserParams;
 
+    int m_threadCount = 0;
+    size_t m_memoryLimit = 0;
+    QVector<SampleStageTimings> m_sampleStageTimings;
+
 };
 
 _PMI_END
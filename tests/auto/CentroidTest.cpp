@@ -0,0 +1,512 @@
+/*
+ * Copyright (C) 2019 Protein Metrics Inc. - All Rights Reserved.
+ * Unauthorized copying or distribution of this file, via any medium is strictly prohibited.
+ * Confidential.
+ */
+
+#include "Centroid.h"
+
+#include <pmi_core_defs.h>
+
+#include <QtTest>
+
+#include <algorithm>
+#include <cstring>
+#include <random>
+
+_PMI_BEGIN
+
+typedef std::vector<std::pair<double, double>> PairList;
+
+class CentroidTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void testFewPoints();
+
+    // output is bitwise the same as of the implementation allocating all lists for every scan
+    void testLegacyOutput_data();
+    void testLegacyOutput();
+
+    // scans per second: one iteration centroids SCAN_COUNT scans
+    void benchmarkSmoothAndCentroid_data();
+    void benchmarkSmoothAndCentroid();
+};
+
+static const int SCAN_COUNT = 100;
+
+namespace {
+
+// Copy of the centroiding before the scratch buffers and the array input were introduced
+namespace legacy {
+
+const int MIN_CENTROID_POINTS = 10;
+const double NEAR_ZERO = 1E-4;
+const double MERGE_INTENSITY_THR = 0.0;
+const double SIGMA_FACTOR = 4.0;
+const double RESTORE_INTENSITY_THR = 0.2;
+
+int myRound(double val)
+{
+    return (int)(val + .5);
+}
+
+bool byIntensity(const std::pair<int, double> &left, const std::pair<int, double> &right)
+{
+    return left.second > right.second;
+}
+
+std::vector<double> makeUnitGaussianTable(double range, int count)
+{
+    std::vector<double> table;
+    double norm = sqrt(8.0 * std::atan(1.0));
+    for (double xx = -range; xx <= range; xx += 2 * range / (count - 1)) {
+        table.push_back(exp(-xx * xx / 2.0) / norm);
+    }
+    return table;
+}
+
+std::vector<double> gaussianSmooth(const PairList &in, double startSigma, double endSigma,
+                                   pico::UncertaintyScaling uncertaintyType,
+                                   const std::vector<double> &table)
+{
+    const ptrdiff_t inSize = in.size();
+    std::vector<double> smoothed;
+    double stddevSlope = 0;
+    const double xStart = in[0].first;
+    if (uncertaintyType == pico::LinearUncertainty) {
+        stddevSlope = (endSigma - startSigma) / (in[inSize - 1].first - xStart);
+    }
+
+    const ptrdiff_t count = table.size() / 2;
+    double stdDev = startSigma;
+    double halfKernelWidth = 3 * stdDev;
+    for (ptrdiff_t inIdx = 0; inIdx < inSize; inIdx++) {
+        const std::pair<double, double> inPoint = in[inIdx];
+        if (inPoint.second < NEAR_ZERO && inIdx < inSize - 1 && in[inIdx + 1].second < NEAR_ZERO) {
+            smoothed.push_back(0);
+            smoothed.push_back(0);
+            inIdx++;
+            continue;
+        }
+        const double x = inPoint.first;
+        if (uncertaintyType == pico::LinearUncertainty) {
+            stdDev = startSigma + (x - xStart) * stddevSlope;
+            halfKernelWidth = 3 * stdDev;
+        }
+        const double startConvolution = x - halfKernelWidth;
+        const double endConvolution = x + halfKernelWidth;
+        const double countPerStdev = (count - 1) / stdDev / 6.0;
+
+        double y = inPoint.second * table[count];
+        for (ptrdiff_t idx = inIdx + 1; idx < inSize; idx++) {
+            if (in[idx].second > NEAR_ZERO) {
+                if (in[idx].first > endConvolution) {
+                    break;
+                }
+                const ptrdiff_t kernelIndex = count + myRound((in[idx].first - x) * countPerStdev);
+                if (kernelIndex >= 0 && kernelIndex < (int)table.size()) {
+                    y += in[idx].second * table[kernelIndex];
+                }
+            }
+        }
+        for (ptrdiff_t idx = inIdx - 1; idx >= 0; idx--) {
+            if (in[idx].second > NEAR_ZERO) {
+                if (in[idx].first < startConvolution) {
+                    break;
+                }
+                const ptrdiff_t kernelIndex = count + myRound((in[idx].first - x) * countPerStdev);
+                if (kernelIndex >= 0 && kernelIndex < (int)table.size()) {
+                    y += in[idx].second * table[kernelIndex];
+                }
+            }
+        }
+        smoothed.push_back(y);
+    }
+    return smoothed;
+}
+
+std::vector<std::pair<int, double>> computeMaxIndexList(const std::vector<double> &smoothed)
+{
+    std::vector<std::pair<int, double>> indexList;
+    if (smoothed.size() < 2) {
+        return indexList;
+    }
+    if (smoothed[0] > smoothed[1]) {
+        indexList.push_back(std::make_pair(0, smoothed[0]));
+    }
+    for (int i = 1; i < (int)smoothed.size() - 1; i++) {
+        const double b = smoothed[i];
+        if (b > smoothed[i + 1]) {
+            const double a = smoothed[i - 1];
+            if (a < b) {
+                indexList.push_back(std::make_pair(i, b));
+            } else if (a == b) {
+                for (int j = i - 2; j >= 0; j--) {
+                    if (smoothed[j] < b) {
+                        indexList.push_back(std::make_pair(i, b));
+                        break;
+                    } else if (smoothed[j] > b) {
+                        break;
+                    }
+                }
+            }
+        }
+    }
+    const int last = static_cast<int>(smoothed.size()) - 1;
+    const double b = smoothed[last];
+    if (b > smoothed[last - 1]) {
+        indexList.push_back(std::make_pair(last, b));
+    } else if (b == smoothed[last - 1]) {
+        for (int j = last - 2; j >= 0; j--) {
+            if (smoothed[j] < b) {
+                indexList.push_back(std::make_pair(last, b));
+                break;
+            } else if (smoothed[j] > b) {
+                break;
+            }
+        }
+    }
+    return indexList;
+}
+
+void consolidateMergeRadius(const PairList &data, double mergeRadius,
+                            std::vector<std::pair<int, double>> &maxList)
+{
+    std::vector<std::pair<int, double>> sortedList;
+    for (unsigned int ii = 0; ii < maxList.size(); ii++) {
+        sortedList.push_back(std::make_pair(static_cast<int>(ii), maxList[ii].second));
+    }
+    std::sort(sortedList.begin(), sortedList.end(), byIntensity);
+
+    std::vector<int> remove(maxList.size());
+    for (unsigned int ii = 0; ii < sortedList.size(); ii++) {
+        const int idxi = sortedList[ii].first;
+        const double vali = sortedList[ii].second;
+        const double mzi = data[maxList[idxi].first].first;
+        if (remove[idxi] != 0) {
+            continue;
+        }
+        for (unsigned int jj = idxi + 1; jj < maxList.size(); jj++) {
+            const int idj = maxList[jj].first;
+            if (data[idj].first - mzi > mergeRadius) {
+                break;
+            }
+            if (remove[jj] == 0 && data[idj].second < vali - MERGE_INTENSITY_THR) {
+                remove[jj] = 1;
+            }
+        }
+        for (int jj = idxi - 1; jj >= 0; jj--) {
+            const int idj = maxList[jj].first;
+            if (mzi - data[idj].first > mergeRadius) {
+                break;
+            }
+            if (remove[jj] == 0 && data[idj].second < vali - MERGE_INTENSITY_THR) {
+                remove[jj] = 1;
+            }
+        }
+    }
+    std::vector<std::pair<int, double>> updatedList;
+    for (unsigned int ii = 0; ii < maxList.size(); ii++) {
+        if (remove[ii] == 0) {
+            updatedList.push_back(maxList[ii]);
+        }
+    }
+    maxList.swap(updatedList);
+}
+
+void retainIntensePoints(const PairList &data, std::vector<std::pair<int, double>> &indexList,
+                         int topK, PairList &out)
+{
+    if (topK > 0 && topK < (int)indexList.size()) {
+        std::partial_sort(indexList.begin(), indexList.begin() + topK, indexList.end(),
+                          byIntensity);
+        indexList.resize(topK);
+        std::sort(indexList.begin(), indexList.end(),
+                  [](const std::pair<int, double> &left, const std::pair<int, double> &right) {
+                      return left.first < right.first;
+                  });
+    }
+    for (unsigned int ii = 0; ii < indexList.size(); ii++) {
+        const int index = indexList[ii].first;
+        if (index > 0 && index < int(data.size()) - 1) {
+            std::pair<double, double> left = data[index - 1];
+            std::pair<double, double> mid = data[index];
+            std::pair<double, double> right = data[index + 1];
+            left.second = std::max(left.second, 0.0);
+            mid.second = std::max(mid.second, 0.0);
+            right.second = std::max(right.second, 0.0);
+
+            const double pmin = std::min(std::min(left.second, mid.second), right.second);
+            const double denominator = left.second + mid.second + right.second - 3 * pmin;
+            if (denominator > 1e-05) {
+                mid.first = (left.first * (left.second - pmin) + mid.first * (mid.second - pmin)
+                             + right.first * (right.second - pmin))
+                    / denominator;
+                mid.second = indexList[ii].second;
+                out.push_back(mid);
+                continue;
+            }
+        }
+        out.push_back(std::make_pair(data[index].first, indexList[ii].second));
+    }
+}
+
+void restoreIntensity(PairList &out, const PairList &data, double startSigma, double endSigma,
+                      pico::UncertaintyScaling uncertaintyType)
+{
+    double stddevSlope = 0;
+    const double xStart = data[0].first;
+    if (uncertaintyType == pico::LinearUncertainty) {
+        stddevSlope = (endSigma - startSigma) / (data[data.size() - 1].first - xStart);
+    }
+    double stdDev = startSigma;
+
+    unsigned int idx = 0;
+    double prvX = 0, xPos = 0, nxtX = out[0].first;
+    for (unsigned int ii = 0; ii < out.size(); ii++) {
+        prvX = xPos;
+        xPos = nxtX;
+        nxtX = (ii < out.size() - 1) ? out[ii + 1].first : out[out.size() - 1].first + 8.0 * SIGMA_FACTOR;
+        if (uncertaintyType == pico::LinearUncertainty) {
+            stdDev = startSigma + (xPos - xStart) * stddevSlope;
+        }
+        const double kernelWidth = stdDev * SIGMA_FACTOR;
+        double startMz = xPos - kernelWidth, endMz = xPos + kernelWidth;
+        if (prvX > startMz) {
+            startMz = (startMz + prvX) / 2;
+        }
+        if (nxtX < endMz) {
+            endMz = (endMz + nxtX) / 2;
+        }
+        while (data[idx].first < xPos) {
+            idx++;
+        }
+        const double max1 = data[idx].second;
+        double max = max1, last = max;
+        bool prv = false, cur = false;
+        const double thr = max * RESTORE_INTENSITY_THR;
+        for (unsigned int jj = idx + 1; jj < data.size(); jj++) {
+            const double yy = data[jj].second;
+            if (yy <= thr || data[jj].first > endMz) {
+                break;
+            }
+            prv = cur;
+            cur = last > yy;
+            last = yy;
+            if (prv && cur) {
+                break;
+            }
+            max = std::max(max, yy);
+        }
+        last = max1;
+        prv = false;
+        cur = false;
+        for (int jj = idx - 1; jj >= 0; jj--) {
+            const double yy = data[jj].second;
+            if (yy <= thr || data[jj].first < startMz) {
+                break;
+            }
+            prv = cur;
+            cur = last > yy;
+            last = yy;
+            if (prv && cur) {
+                break;
+            }
+            max = std::max(max, yy);
+        }
+        out[ii].second = max;
+    }
+}
+
+PairList smoothAndCentroid(const PairList &data, const pico::CentroidOptions &options)
+{
+    PairList out;
+    if (data.size() < MIN_CENTROID_POINTS) {
+        for (const std::pair<double, double> &point : data) {
+            if (point.second > 0.0) {
+                out.push_back(point);
+            }
+        }
+        return out;
+    }
+
+    const std::vector<double> table = makeUnitGaussianTable(3.0, 101);
+    const std::vector<double> smoothed
+        = gaussianSmooth(data, options.startSigma, options.endSigma, options.uncertaintyType, table);
+    std::vector<std::pair<int, double>> maxList = computeMaxIndexList(smoothed);
+    consolidateMergeRadius(data, options.mergeRadius, maxList);
+    retainIntensePoints(data, maxList, options.topK, out);
+    if (options.adjustIntencity && !out.empty()) {
+        restoreIntensity(out, data, options.startSigma, options.endSigma, options.uncertaintyType);
+    }
+    if (options.sortMz) {
+        std::sort(out.begin(), out.end(),
+                  [](const std::pair<double, double> &left, const std::pair<double, double> &right) {
+                      return left.first < right.first;
+                  });
+    }
+    return out;
+}
+
+} // namespace legacy
+
+// profile scan with gaussian peaks on noise, runs of zeros and some negative intensities
+PairList createScan(int pointCount, int seed)
+{
+    std::mt19937 generator(seed);
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+
+    PairList scan;
+    double mz = 300.0 + seed % 100;
+    for (int i = 0; i < pointCount; ++i) {
+        mz += 0.001 + 0.01 * uniform(generator);
+        double intensity = 0.0;
+        const double r = uniform(generator);
+        if (i % 60 < 12) {
+            intensity = 1000.0 * std::exp(-std::pow((i % 60 - 6) / 2.0, 2)) + r;
+        } else if (r < 0.3) {
+            intensity = 0.0;
+        } else if (r < 0.35) {
+            intensity = -r;
+        } else {
+            intensity = 100.0 * r * r * r;
+        }
+        scan.push_back(std::make_pair(mz, intensity));
+    }
+    return scan;
+}
+
+bool bitwiseEqual(const PairList &a, const PairList &b)
+{
+    return a.size() == b.size()
+        && (a.empty() || std::memcmp(a.data(), b.data(), a.size() * sizeof(a[0])) == 0);
+}
+
+} // namespace
+
+void CentroidTest::testFewPoints()
+{
+    PairList data = { { 100.0, 5.0 }, { 100.1, 0.0 }, { 100.2, -1.0 }, { 100.3, 7.0 } };
+    const PairList expected = { { 100.0, 5.0 }, { 100.3, 7.0 } };
+
+    pico::Centroid centroid;
+    PairList out;
+    QVERIFY(centroid.smooth_and_centroid(data, pico::CentroidOptions(), out));
+    QVERIFY(out == expected);
+    // too few points to centroid, the input is kept
+    QCOMPARE(static_cast<int>(data.size()), 4);
+
+    const std::vector<double> mz = { 100.0, 100.1, 100.2, 100.3 };
+    const std::vector<double> intensity = { 5.0, 0.0, -1.0, 7.0 };
+    QVERIFY(centroid.smooth_and_centroid(mz.data(), intensity.data(), mz.size(),
+                                         pico::CentroidOptions(), out));
+    QVERIFY(out == expected);
+}
+
+void CentroidTest::testLegacyOutput_data()
+{
+    QTest::addColumn<int>("uncertaintyType");
+    QTest::addColumn<int>("topK");
+    QTest::addColumn<double>("mergeRadius");
+    QTest::addColumn<bool>("adjustIntensity");
+    QTest::addColumn<bool>("sortMz");
+
+    QTest::newRow("byspec2") << int(pico::ConstantUncertainty) << 1000 << 0.08 << false << true;
+    QTest::newRow("bruker") << int(pico::ConstantUncertainty) << -1 << 0.04 << true << true;
+    QTest::newRow("topK") << int(pico::ConstantUncertainty) << 20 << 0.0 << true << false;
+    QTest::newRow("linear") << int(pico::LinearUncertainty) << 0 << 0.02 << true << true;
+}
+
+void CentroidTest::testLegacyOutput()
+{
+    QFETCH(int, uncertaintyType);
+    QFETCH(int, topK);
+    QFETCH(double, mergeRadius);
+    QFETCH(bool, adjustIntensity);
+    QFETCH(bool, sortMz);
+
+    pico::CentroidOptions options;
+    options.startSigma = 0.01;
+    options.endSigma = 0.03;
+    options.uncertaintyType = static_cast<pico::UncertaintyScaling>(uncertaintyType);
+    options.topK = topK;
+    options.mergeRadius = mergeRadius;
+    options.adjustIntencity = adjustIntensity;
+    options.sortMz = sortMz;
+
+    // one object for all scans, so scratch buffers of larger scans are reused by smaller ones
+    pico::Centroid centroid;
+    for (int seed = 0; seed < 50; ++seed) {
+        const PairList scan = createScan((seed * 397) % 5000, seed);
+        const PairList expected = legacy::smoothAndCentroid(scan, options);
+
+        PairList data = scan;
+        PairList out;
+        QVERIFY(centroid.smooth_and_centroid(data, options, out));
+        QVERIFY2(bitwiseEqual(out, expected), qPrintable(QString("seed %1").arg(seed)));
+
+        std::vector<double> mz;
+        std::vector<double> intensity;
+        for (const std::pair<double, double> &point : scan) {
+            mz.push_back(point.first);
+            intensity.push_back(point.second);
+        }
+        QVERIFY(centroid.smooth_and_centroid(mz.data(), intensity.data(), mz.size(), options, out));
+        QVERIFY2(bitwiseEqual(out, expected), qPrintable(QString("seed %1").arg(seed)));
+    }
+}
+
+void CentroidTest::benchmarkSmoothAndCentroid_data()
+{
+    QTest::addColumn<QString>("mode");
+
+    QTest::newRow("legacy") << QString("legacy");
+    QTest::newRow("pairs") << QString("pairs");
+    QTest::newRow("arrays") << QString("arrays");
+}
+
+void CentroidTest::benchmarkSmoothAndCentroid()
+{
+    QFETCH(QString, mode);
+
+    std::vector<PairList> scans;
+    std::vector<std::vector<double>> mzs(SCAN_COUNT);
+    std::vector<std::vector<double>> intensities(SCAN_COUNT);
+    for (int i = 0; i < SCAN_COUNT; ++i) {
+        scans.push_back(createScan(20000, i));
+        for (const std::pair<double, double> &point : scans.back()) {
+            mzs[i].push_back(point.first);
+            intensities[i].push_back(point.second);
+        }
+    }
+
+    pico::CentroidOptions options;
+    options.topK = -1;
+    options.mergeRadius = 0.04;
+    options.adjustIntencity = true;
+
+    pico::Centroid centroid;
+    PairList out;
+    QBENCHMARK {
+        for (int i = 0; i < SCAN_COUNT; ++i) {
+            if (mode == "legacy") {
+                out = legacy::smoothAndCentroid(scans[i], options);
+            } else if (mode == "pairs") {
+                PairList data = scans[i];
+                centroid.smooth_and_centroid(data, options, out);
+            } else {
+                centroid.smooth_and_centroid(mzs[i].data(), intensities[i].data(), mzs[i].size(),
+                                             options, out);
+            }
+        }
+    }
+    QVERIFY(!out.empty());
+}
+
+_PMI_END
+
+QTEST_GUILESS_MAIN(pmi::CentroidTest)
+
+#include "CentroidTest.moc"
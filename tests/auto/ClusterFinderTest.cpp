@@ -11,11 +11,15 @@
 #include <PMiTestUtils.h>
 
 #include "ClusterFinder.h"
+#include "FinderFeaturesKdTree.h"
+#include "FinderSamplesDao.h"
 #include "ProgressBarInterface.h"
 #include "QtSqlUtils.h"
 #include <QDir>
 #include <QtTest>
 
+#include <random>
+
 _PMI_BEGIN
 
 class ClusterFinderTest : public QObject
@@ -29,6 +33,12 @@ public:
 
     private Q_SLOTS :
         void testFindGroupNumber();
+        void testKdTreeNeighbors();
+        void benchmarkFindGroupNumber();
+
+private:
+    Err openEmptyDatabase(const QString &connectionName, const QString &fileName,
+                          QSqlDatabase *db) const;
 
 private:
     QDir m_testDataBasePath;
@@ -110,6 +120,181 @@ void ClusterFinderTest::testFindGroupNumber()
 
 }
 
+// Every sample gets a jittered copy of the same peptides, each peptide is one expected group.
+// Peptides are spaced by far more than the mass epsilon, jitter stays within the epsilons.
+// Every groupedStep-th feature is stored as already grouped.
+static Err createSyntheticFeatures(QSqlDatabase *db, int sampleCount, int peptideCount,
+                                   int groupedStep)
+{
+    Err e = kNoErr;
+
+    FinderSamplesDao samplesDao(db);
+    e = samplesDao.createTable(); ree;
+
+    QStringList sampleNames;
+    for (int i = 0; i < sampleCount; ++i) {
+        sampleNames.push_back(QString("sample_%1.raw").arg(i));
+    }
+    e = samplesDao.insertSamples(sampleNames); ree;
+
+    QList<int> sampleIds;
+    e = samplesDao.uniqueIds(&sampleIds); ree;
+
+    FinderFeaturesDao featuresDao(db);
+    e = featuresDao.createTable(); ree;
+
+    std::mt19937 eng(11);
+    std::uniform_real_distribution<> time(1.0, 120.0);
+    std::uniform_real_distribution<> intensity(1e5, 1e8);
+    std::uniform_real_distribution<> jitter(-0.5, 0.5);
+
+    const NeighborSettings settings;
+    QVector<FinderFeaturesDaoEntry> peptides(peptideCount);
+    for (int i = 0; i < peptideCount; ++i) {
+        FinderFeaturesDaoEntry &peptide = peptides[i];
+        peptide.unchargedMass = 300.0 + 0.25 * i;
+        peptide.apexTime = time(eng);
+        peptide.intensity = intensity(eng);
+    }
+
+    if (!db->transaction()) {
+        rrr(kError);
+    }
+
+    QSqlQuery q = makeQuery(db, true);
+    e = QPREPARE(q, R"(INSERT INTO FinderFeatures(SamplesId, UnchargedMass, StartTime, EndTime,
+                                                  ApexTime, Intensity, GroupNumber)
+                       VALUES(:SamplesId, :UnchargedMass, :StartTime, :EndTime,
+                              :ApexTime, :Intensity, :GroupNumber))"); ree;
+
+    int featureCounter = 0;
+    for (int sampleId : sampleIds) {
+        for (const FinderFeaturesDaoEntry &peptide : qAsConst(peptides)) {
+            const double apexTime = peptide.apexTime + jitter(eng) * settings.apexTimeEpsilon;
+            q.bindValue(":SamplesId", sampleId);
+            q.bindValue(":UnchargedMass",
+                        peptide.unchargedMass + jitter(eng) * settings.unchargedMassEpsilon);
+            q.bindValue(":StartTime", apexTime - 0.2);
+            q.bindValue(":EndTime", apexTime + 0.2);
+            q.bindValue(":ApexTime", apexTime);
+            q.bindValue(":Intensity", peptide.intensity + jitter(eng) * settings.intensityEpsilon);
+            q.bindValue(":GroupNumber", (++featureCounter % groupedStep) == 0 ? 0 : -1);
+            e = QEXEC_NOARG(q); ree;
+        }
+    }
+
+    if (!db->commit()) {
+        rrr(kError);
+    }
+
+    return e;
+}
+
+static bool lessSampleAndId(const FinderFeaturesDaoEntry &left, const FinderFeaturesDaoEntry &right)
+{
+    return left.samplesId < right.samplesId
+        || (left.samplesId == right.samplesId && left.id < right.id);
+}
+
+Err ClusterFinderTest::openEmptyDatabase(const QString &connectionName, const QString &fileName,
+                                         QSqlDatabase *db) const
+{
+    const QString filePath = m_testDataBasePath.filePath(fileName);
+    if (QFileInfo::exists(filePath) && !QFile::remove(filePath)) {
+        qWarning() << "Failed to remove" << filePath;
+        rrr(kError);
+    }
+
+    return pmi::addDatabaseAndOpen(connectionName, filePath, *db);
+}
+
+void ClusterFinderTest::testKdTreeNeighbors()
+{
+    QSqlDatabase db;
+    Err e = openEmptyDatabase("kdTree", "ClusterFinderTest_kdTree.db3", &db);
+    QCOMPARE(e, kNoErr);
+
+    e = createSyntheticFeatures(&db, 7, 400, 5);
+    QCOMPARE(e, kNoErr);
+
+    FinderFeaturesDao dao(&db);
+    QVector<FinderFeaturesDaoEntry> features;
+    e = dao.loadFeatures(&features);
+    QCOMPARE(e, kNoErr);
+    QCOMPARE(features.size(), 7 * 400);
+
+    const FinderFeaturesKdTree tree(features);
+    QCOMPARE(tree.size(), features.size());
+
+    // wide box so that neighbors of many peptides overlap
+    NeighborSettings settings;
+    settings.unchargedMassEpsilon = 40.0;
+    settings.apexTimeEpsilon = 5.0;
+    settings.intensityEpsilon = 2e7;
+
+    int neighborCount = 0;
+    for (const FinderFeaturesDaoEntry &entry : qAsConst(features)) {
+        QVector<FinderFeaturesDaoEntry> expected;
+        e = dao.loadNeighborFeatures(entry, settings, &expected);
+        QCOMPARE(e, kNoErr);
+        std::sort(expected.begin(), expected.end(), lessSampleAndId);
+
+        QVector<int> indices;
+        tree.neighbors(entry, settings, &indices);
+
+        QVector<FinderFeaturesDaoEntry> actual;
+        for (int index : qAsConst(indices)) {
+            const FinderFeaturesDaoEntry &feature = features.at(index);
+            if (feature.samplesId != entry.samplesId && feature.groupNumber == -1) {
+                actual.push_back(feature);
+            }
+        }
+        std::sort(actual.begin(), actual.end(), lessSampleAndId);
+
+        QCOMPARE(actual.size(), expected.size());
+        for (int i = 0; i < actual.size(); ++i) {
+            QCOMPARE(actual.at(i).id, expected.at(i).id);
+        }
+        neighborCount += actual.size();
+    }
+    QVERIFY(neighborCount > features.size());
+}
+
+void ClusterFinderTest::benchmarkFindGroupNumber()
+{
+    const int sampleCount = 100;
+    const int peptideCount = 10000;
+
+    QSqlDatabase db;
+    Err e = openEmptyDatabase("benchmark", "ClusterFinderTest_benchmark.db3", &db);
+    QCOMPARE(e, kNoErr);
+
+    e = createSyntheticFeatures(&db, sampleCount, peptideCount, sampleCount * peptideCount + 1);
+    QCOMPARE(e, kNoErr);
+
+    ClusterFinder finder(&db);
+    QBENCHMARK_ONCE {
+        e = finder.run();
+    }
+    QCOMPARE(e, kNoErr);
+
+    FinderFeaturesDao dao(&db);
+    int ungrouped = -1;
+    e = dao.ungroupedFeatureCount(&ungrouped);
+    QCOMPARE(e, kNoErr);
+    QCOMPARE(ungrouped, 0);
+
+    // each peptide forms exactly one group
+    QVector<FinderFeaturesDaoEntry> features;
+    e = dao.loadFeatures(&features);
+    QCOMPARE(e, kNoErr);
+    QSet<int> groupNumbers;
+    for (const FinderFeaturesDaoEntry &feature : qAsConst(features)) {
+        groupNumbers.insert(feature.groupNumber);
+    }
+    QCOMPARE(groupNumbers.size(), peptideCount);
+}
+
 _PMI_END
 
 PMI_TEST_GUILESS_MAIN_WITH_ARGS(pmi::ClusterFinderTest, QStringList() << "Remote Data Folder")
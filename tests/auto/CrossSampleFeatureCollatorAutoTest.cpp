@@ -13,6 +13,8 @@
 
 #include <QtTest>
 
+#include <random>
+
 _PMI_BEGIN
 
 class CrossSampleFeatureCollatorAutoTest : public QObject
@@ -23,6 +25,10 @@ private Q_SLOTS:
     void testCollationParameterMWThresholdValidity();
     void testCollationAmbiguity();
     void testDuplicateRemoval();
+    void testGroupingMatchesReference_data();
+    void testGroupingMatchesReference();
+    void benchmarkCollation_data();
+    void benchmarkCollation();
 
 private:
     SettableFeatureFinderParameters m_ffUserParams;
@@ -246,6 +252,143 @@ void CrossSampleFeatureCollatorAutoTest::testDuplicateRemoval()
     QCOMPARE(results[3].masterFeature, 1);
 }
 
+//! Features of @a sampleCount samples measuring the same compounds with a small mass and time error
+static QVector<CrossSampleFeatureTurbo> createSyntheticFeatures(int sampleCount,
+                                                                int featuresPerSample)
+{
+    std::mt19937 generator(sampleCount * 7919 + featuresPerSample);
+    std::uniform_real_distribution<double> compoundMass(500.0, 8000.0);
+    std::uniform_real_distribution<double> compoundTime(5.0, 60.0);
+    std::uniform_real_distribution<double> massError(-10e-6, 10e-6);
+    std::uniform_real_distribution<double> timeError(-0.06, 0.06);
+    std::uniform_real_distribution<double> intensity(1e3, 1e7);
+
+    QVector<double> masses(featuresPerSample);
+    QVector<double> times(featuresPerSample);
+    for (int i = 0; i < featuresPerSample; ++i) {
+        masses[i] = compoundMass(generator);
+        times[i] = compoundTime(generator);
+    }
+
+    QVector<CrossSampleFeatureTurbo> features;
+    features.reserve(sampleCount * featuresPerSample);
+    for (int sample = 1; sample <= sampleCount; ++sample) {
+        for (int i = 0; i < featuresPerSample; ++i) {
+            // some compounds are seen twice in a sample
+            const int compound = (i % 50 == 49) ? i - 1 : i;
+
+            CrossSampleFeatureTurbo feature;
+            feature.sampleId = sample;
+            feature.feature = i;
+            feature.mwMonoisotopic
+                = std::round(masses[compound] * (1.0 + massError(generator)) * 1000) / 1000;
+            feature.rt = std::round((times[compound] + timeError(generator)) * 10000) / 10000;
+            feature.rtWarped = feature.rt;
+            feature.xicStart = feature.rt - 0.1;
+            feature.xicEnd = feature.rt + 0.1;
+            feature.maxIntensity = intensity(generator);
+            features.push_back(feature);
+        }
+    }
+
+    return features;
+}
+
+//! Grouping as it was done by comparing every feature with all later features
+static void referenceGrouping(QVector<CrossSampleFeatureTurbo> *features, int ppm,
+                              double timeTolerance)
+{
+    std::sort(features->begin(), features->end(),
+              [](const CrossSampleFeatureTurbo &a, const CrossSampleFeatureTurbo &b) {
+                  return a.rtWarped < b.rtWarped;
+              });
+
+    int masterFeature = 0;
+    for (int i = 0; i < features->size(); ++i) {
+        CrossSampleFeatureTurbo &row = (*features)[i];
+        if (row.masterFeature != -1) {
+            continue;
+        }
+
+        row.masterFeature = masterFeature;
+        const double massTolerance = (row.mwMonoisotopic * ppm) / 1000000;
+        for (int j = i + 1; j < features->size(); ++j) {
+            CrossSampleFeatureTurbo &other = (*features)[j];
+            if (other.masterFeature == -1
+                && std::abs(other.mwMonoisotopic - row.mwMonoisotopic) <= massTolerance
+                && std::abs(other.rtWarped - row.rtWarped) <= timeTolerance) {
+                other.masterFeature = masterFeature;
+            }
+        }
+        masterFeature++;
+    }
+
+    std::sort(features->begin(), features->end(),
+              [](const CrossSampleFeatureTurbo &left, const CrossSampleFeatureTurbo &right) {
+                  return (left.masterFeature < right.masterFeature);
+              });
+}
+
+void CrossSampleFeatureCollatorAutoTest::testGroupingMatchesReference_data()
+{
+    QTest::addColumn<int>("sampleCount");
+    QTest::addColumn<int>("featuresPerSample");
+
+    QTest::newRow("1x500") << 1 << 500;
+    QTest::newRow("5x2000") << 5 << 2000;
+    QTest::newRow("30x1000") << 30 << 1000;
+}
+
+void CrossSampleFeatureCollatorAutoTest::testGroupingMatchesReference()
+{
+    QFETCH(int, sampleCount);
+    QFETCH(int, featuresPerSample);
+
+    const QVector<CrossSampleFeatureTurbo> features
+        = createSyntheticFeatures(sampleCount, featuresPerSample);
+
+    QVector<CrossSampleFeatureTurbo> expected = features;
+    referenceGrouping(&expected, m_ffUserParams.ppm, m_ffImmutables.maxTimeToleranceWarped);
+
+    CrossSampleFeatureCollatorTurbo crossSampleCollatorTurbo(QVector<SampleFeaturesTurbo>(),
+                                                             m_ffUserParams);
+    QCOMPARE(crossSampleCollatorTurbo.testCollation(features), kNoErr);
+    const QVector<CrossSampleFeatureTurbo> results
+        = crossSampleCollatorTurbo.consolidatedCrossSampleFeatures();
+
+    QCOMPARE(results.size(), expected.size());
+    for (int i = 0; i < results.size(); ++i) {
+        QCOMPARE(results[i].masterFeature, expected[i].masterFeature);
+        QCOMPARE(results[i].sampleId, expected[i].sampleId);
+        QCOMPARE(results[i].feature, expected[i].feature);
+    }
+}
+
+void CrossSampleFeatureCollatorAutoTest::benchmarkCollation_data()
+{
+    QTest::addColumn<int>("sampleCount");
+
+    QTest::newRow("10") << 10;
+    QTest::newRow("100") << 100;
+    QTest::newRow("1000") << 1000;
+}
+
+void CrossSampleFeatureCollatorAutoTest::benchmarkCollation()
+{
+    QFETCH(int, sampleCount);
+
+    const QVector<CrossSampleFeatureTurbo> features = createSyntheticFeatures(sampleCount, 500);
+
+    CrossSampleFeatureCollatorTurbo crossSampleCollatorTurbo(QVector<SampleFeaturesTurbo>(),
+                                                             m_ffUserParams);
+    const bool removeDuplicates = true;
+    QBENCHMARK_ONCE {
+        QCOMPARE(crossSampleCollatorTurbo.testCollation(features, removeDuplicates), kNoErr);
+    }
+
+    QVERIFY(!crossSampleCollatorTurbo.consolidatedCrossSampleFeatures().isEmpty());
+}
+
 _PMI_END
 
 QTEST_MAIN(pmi::CrossSampleFeatureCollatorAutoTest)
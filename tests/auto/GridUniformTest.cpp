@@ -1,4 +1,5 @@
 #include <QtTest>
+#include <cmath>
 #include <random>
 #include <time.h>
 
@@ -11,8 +12,33 @@ class GridUniformTest : public QObject
     Q_OBJECT
 private Q_SLOTS:
     void Accumulate_ReturnsSameResultMoreQuicklyThanOldAccumulate_GivenSamePlotBase();
+    void testAccumulateSorted_data();
+    void testAccumulateSorted();
+    void testAccumulateSortedScans();
+    void benchmarkAccumulateScans_data();
+    void benchmarkAccumulateScans();
 };
 
+static const int SCAN_COUNT = 5000;
+
+//! sorted MS1 like scans between 300 and 2000 m/z
+static QVector<point2dList> createScans(int scanCount, unsigned int seed)
+{
+    std::mt19937 eng(seed);
+    std::uniform_real_distribution<> spacing(0.001, 12.0);
+    std::uniform_real_distribution<> intensity(0.0, 1e5);
+
+    QVector<point2dList> scans(scanCount);
+    for (point2dList &scan : scans) {
+        double mz = 300.0 + spacing(eng);
+        while (mz < 2000.0) {
+            scan.push_back(point2d(mz, intensity(eng)));
+            mz += spacing(eng);
+        }
+    }
+    return scans;
+}
+
 bool point2d_unique(point2d x, point2d y) {
     return x.x() == y.x();
 }
@@ -95,6 +121,144 @@ void GridUniformTest::Accumulate_ReturnsSameResultMoreQuicklyThanOldAccumulate_G
     }
 }
 
+void GridUniformTest::testAccumulateSorted_data()
+{
+    QTest::addColumn<double>("startX");
+    QTest::addColumn<double>("endX");
+    QTest::addColumn<int>("type");
+
+    QTest::newRow("inside") << 5.0 << 15.0 << int(GridUniform::ArithmeticType_Add);
+    QTest::newRow("wider") << -5.0 << 25.0 << int(GridUniform::ArithmeticType_Add);
+    QTest::newRow("left") << -5.0 << 12.0 << int(GridUniform::ArithmeticType_Add);
+    QTest::newRow("right") << 8.0 << 25.0 << int(GridUniform::ArithmeticType_Add);
+    QTest::newRow("outside") << 30.0 << 40.0 << int(GridUniform::ArithmeticType_Add);
+    QTest::newRow("subtract") << -5.0 << 25.0 << int(GridUniform::ArithmeticType_Subtract);
+}
+
+void GridUniformTest::testAccumulateSorted()
+{
+    QFETCH(double, startX);
+    QFETCH(double, endX);
+    QFETCH(int, type);
+
+    // points from 0 to 20, some on grid positions and some with the same x
+    PlotBase plot;
+    std::mt19937 eng(7);
+    std::uniform_real_distribution<> distr(0.0, 20.0);
+    for (int i = 0; i < 300; ++i) {
+        const double x = (i % 5 == 0) ? 0.25 * (i % 80) : distr(eng);
+        plot.addPoint(point2d(x, distr(eng)));
+        if (i % 17 == 0) {
+            plot.addPoint(point2d(x, distr(eng)));
+        }
+    }
+    plot.sortPointListByX();
+
+    GridUniform expected;
+    QCOMPARE(expected.initGridByMzBinSpace(startX, endX, 0.25), kNoErr);
+    expected.setAllYTo(1.0);
+    GridUniform actual = expected;
+
+    std::vector<double> xs;
+    for (int i = 0; i < expected.size(); ++i) {
+        xs.push_back(expected.ix(i));
+    }
+    const GridUniform::ArithmeticType arithmeticType = GridUniform::ArithmeticType(type);
+    expected.accumulate_with_xlist(plot, xs, arithmeticType);
+    actual.accumulate_sorted(plot.getPointList(), arithmeticType);
+
+    QCOMPARE(actual.size(), expected.size());
+    for (int i = 0; i < expected.size(); ++i) {
+        // bitwise equality
+        QVERIFY2(actual.y_array[i] == expected.y_array[i], qPrintable(QString::number(i)));
+    }
+
+    // empty and single point scans do not change the grid
+    actual.accumulate_sorted(point2dList(), arithmeticType);
+    actual.accumulate_sorted(point2dList(1, point2d(10.0, 1.0)), arithmeticType);
+    QCOMPARE(actual.y_array, expected.y_array);
+}
+
+void GridUniformTest::testAccumulateSortedScans()
+{
+    const QVector<point2dList> scans = createScans(50, 1);
+
+    GridUniform expected;
+    QCOMPARE(expected.initGridByMzBinSpace(300.0, 2000.0, 0.005), kNoErr);
+    for (const point2dList &scan : scans) {
+        expected.accumulate(PlotBase(scan));
+    }
+
+    GridUniform serial;
+    QCOMPARE(serial.initGridByMzBinSpace(300.0, 2000.0, 0.005), kNoErr);
+    serial.accumulate_sorted(scans, GridUniform::ArithmeticType_Add, 1, 4);
+    QCOMPARE(serial.y_array, expected.y_array);
+
+    // partial grids are summed in another order
+    for (int chunkCount : { 2, 3, 8 }) {
+        GridUniform chunked;
+        QCOMPARE(chunked.initGridByMzBinSpace(300.0, 2000.0, 0.005), kNoErr);
+        chunked.accumulate_sorted(scans, GridUniform::ArithmeticType_Add, chunkCount, 1);
+        QCOMPARE(chunked.size(), expected.size());
+        for (int i = 0; i < expected.size(); ++i) {
+            QVERIFY(std::fabs(chunked.y_array[i] - expected.y_array[i])
+                    <= 1e-9 * std::fabs(expected.y_array[i]));
+        }
+
+        // the thread count doesn't change the rounding
+        for (int threadCount : { 2, 3, 0 }) {
+            GridUniform parallel;
+            QCOMPARE(parallel.initGridByMzBinSpace(300.0, 2000.0, 0.005), kNoErr);
+            parallel.accumulate_sorted(scans, GridUniform::ArithmeticType_Add, chunkCount,
+                                       threadCount);
+            QCOMPARE(parallel.y_array, chunked.y_array);
+        }
+
+        chunked.accumulate_sorted(scans, GridUniform::ArithmeticType_Subtract, chunkCount);
+        QVERIFY(std::fabs(chunked.getSum()) <= 1e-6 * expected.getSum());
+    }
+}
+
+void GridUniformTest::benchmarkAccumulateScans_data()
+{
+    QTest::addColumn<QString>("method");
+
+    QTest::newRow("evaluateLinear") << QString("evaluateLinear");
+    QTest::newRow("sorted") << QString("sorted");
+    QTest::newRow("sortedScans") << QString("sortedScans");
+}
+
+void GridUniformTest::benchmarkAccumulateScans()
+{
+    QFETCH(QString, method);
+
+    const QVector<point2dList> scans = createScans(SCAN_COUNT, 2);
+
+    GridUniform grid;
+    QCOMPARE(grid.initGridByMzBinSpace(300.0, 2000.0, 0.005), kNoErr);
+
+    // the previous implementation of accumulate(plot)
+    std::vector<double> xs;
+    for (int i = 0; i < grid.size(); ++i) {
+        xs.push_back(grid.ix(i));
+    }
+
+    QBENCHMARK {
+        if (method == "evaluateLinear") {
+            for (const point2dList &scan : scans) {
+                grid.accumulate_with_xlist(PlotBase(scan), xs);
+            }
+        } else if (method == "sorted") {
+            for (const point2dList &scan : scans) {
+                grid.accumulate_sorted(scan);
+            }
+        } else {
+            grid.accumulate_sorted(scans, GridUniform::ArithmeticType_Add,
+                                   QThread::idealThreadCount());
+        }
+    }
+}
+
 _PMI_END
 
 QTEST_GUILESS_MAIN(pmi::GridUniformTest)
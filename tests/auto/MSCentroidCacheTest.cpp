@@ -0,0 +1,209 @@
+/*
+ * Copyright (C) 2019 Protein Metrics Inc. - All Rights Reserved.
+ * Unauthorized copying or distribution of this file, via any medium is strictly prohibited.
+ * Confidential.
+ */
+
+#include "MSCentroidCache.h"
+
+#include <pmi_core_defs.h>
+
+#include <QtTest>
+
+#include <cmath>
+
+_PMI_BEGIN
+
+class MSCentroidCacheTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void init();
+    void cleanup();
+
+    void testRoundTrip();
+    void testReopen();
+    void testIncompleteRecord();
+    void testOtherSmoothingWidth();
+    void testInvalidFile();
+    void testMemoryOnly();
+
+private:
+    static point2dList createScan(int pointCount, int seed);
+
+private:
+    QString m_filePath;
+};
+
+static const double SMOOTHING_WIDTH = 0.02;
+static const int SCAN_COUNT = 20;
+
+void MSCentroidCacheTest::init()
+{
+    QDir dir(QFile::decodeName(PMI_TEST_FILES_OUTPUT_DIR));
+    QVERIFY(dir.mkpath("MSCentroidCacheTest"));
+    m_filePath = dir.filePath("MSCentroidCacheTest/sample.centroid.cache");
+    QFile::remove(m_filePath);
+}
+
+void MSCentroidCacheTest::cleanup()
+{
+    QFile::remove(m_filePath);
+}
+
+void MSCentroidCacheTest::testRoundTrip()
+{
+    MSCentroidCache cache;
+    QCOMPARE(cache.open(m_filePath, SMOOTHING_WIDTH), kNoErr);
+    QVERIFY(cache.isOpen());
+    QCOMPARE(cache.count(), 0);
+
+    point2dList actual;
+    QVERIFY(!cache.find(1, &actual));
+
+    for (int scan = 1; scan <= SCAN_COUNT; ++scan) {
+        QCOMPARE(cache.insert(scan, createScan(scan * 11 % 17, scan)), kNoErr);
+    }
+    QCOMPARE(cache.count(), SCAN_COUNT);
+
+    // no memory front, all scans come from the file
+    cache.setMemoryLimit(0);
+    for (int scan = 1; scan <= SCAN_COUNT; ++scan) {
+        QVERIFY(cache.find(scan, &actual));
+        QVERIFY(actual == createScan(scan * 11 % 17, scan));
+    }
+}
+
+void MSCentroidCacheTest::testReopen()
+{
+    {
+        MSCentroidCache cache;
+        QCOMPARE(cache.open(m_filePath, SMOOTHING_WIDTH), kNoErr);
+        for (int scan = 1; scan <= SCAN_COUNT; ++scan) {
+            QCOMPARE(cache.insert(scan, createScan(100, scan)), kNoErr);
+        }
+    }
+
+    MSCentroidCache cache;
+    QCOMPARE(cache.open(m_filePath, SMOOTHING_WIDTH), kNoErr);
+    QCOMPARE(cache.count(), SCAN_COUNT);
+
+    point2dList actual;
+    for (int scan = 1; scan <= SCAN_COUNT; ++scan) {
+        QVERIFY(cache.find(scan, &actual));
+        QVERIFY(actual == createScan(100, scan));
+    }
+    QVERIFY(!cache.find(SCAN_COUNT + 1, &actual));
+
+    // scans added later are appended to the file
+    QCOMPARE(cache.insert(SCAN_COUNT + 1, createScan(5, 0)), kNoErr);
+    cache.close();
+    QCOMPARE(cache.open(m_filePath, SMOOTHING_WIDTH), kNoErr);
+    QCOMPARE(cache.count(), SCAN_COUNT + 1);
+}
+
+void MSCentroidCacheTest::testIncompleteRecord()
+{
+    {
+        MSCentroidCache cache;
+        QCOMPARE(cache.open(m_filePath, SMOOTHING_WIDTH), kNoErr);
+        QCOMPARE(cache.insert(1, createScan(50, 1)), kNoErr);
+        QCOMPARE(cache.insert(2, createScan(50, 2)), kNoErr);
+    }
+
+    // cut the last record as if the process crashed during writing
+    {
+        QFile file(m_filePath);
+        QVERIFY(file.resize(file.size() - 8));
+    }
+
+    MSCentroidCache cache;
+    QCOMPARE(cache.open(m_filePath, SMOOTHING_WIDTH), kNoErr);
+    QCOMPARE(cache.count(), 1);
+
+    point2dList actual;
+    QVERIFY(cache.find(1, &actual));
+    QVERIFY(actual == createScan(50, 1));
+    QVERIFY(!cache.find(2, &actual));
+
+    QCOMPARE(cache.insert(2, createScan(50, 2)), kNoErr);
+    cache.close();
+    QCOMPARE(cache.open(m_filePath, SMOOTHING_WIDTH), kNoErr);
+    QVERIFY(cache.find(2, &actual));
+    QVERIFY(actual == createScan(50, 2));
+}
+
+void MSCentroidCacheTest::testOtherSmoothingWidth()
+{
+    {
+        MSCentroidCache cache;
+        QCOMPARE(cache.open(m_filePath, SMOOTHING_WIDTH), kNoErr);
+        QCOMPARE(cache.insert(1, createScan(50, 1)), kNoErr);
+    }
+
+    QVERIFY(MSCentroidCache::cacheSuffix(SMOOTHING_WIDTH)
+            != MSCentroidCache::cacheSuffix(2 * SMOOTHING_WIDTH));
+
+    // scans centroided with other options are not used
+    MSCentroidCache cache;
+    QCOMPARE(cache.open(m_filePath, 2 * SMOOTHING_WIDTH), kNoErr);
+    QCOMPARE(cache.smoothingWidth(), 2 * SMOOTHING_WIDTH);
+    QCOMPARE(cache.count(), 0);
+
+    point2dList actual;
+    QVERIFY(!cache.find(1, &actual));
+}
+
+void MSCentroidCacheTest::testInvalidFile()
+{
+    {
+        QFile file(m_filePath);
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        QVERIFY(file.write(QByteArray(1000, 'x')) == 1000);
+    }
+
+    MSCentroidCache cache;
+    QCOMPARE(cache.open(m_filePath, SMOOTHING_WIDTH), kNoErr);
+    QCOMPARE(cache.count(), 0);
+    QCOMPARE(cache.insert(1, createScan(10, 1)), kNoErr);
+
+    cache.close();
+    QCOMPARE(cache.open(m_filePath, SMOOTHING_WIDTH), kNoErr);
+    QCOMPARE(cache.count(), 1);
+}
+
+void MSCentroidCacheTest::testMemoryOnly()
+{
+    MSCentroidCache cache;
+    QVERIFY(!cache.isOpen());
+
+    QCOMPARE(cache.insert(1, createScan(10, 1)), kNoErr);
+    point2dList actual;
+    QVERIFY(cache.find(1, &actual));
+    QVERIFY(actual == createScan(10, 1));
+
+    // the least recently used scan is dropped first
+    cache.setMemoryLimit(static_cast<int>(25 * sizeof(point2d)));
+    QCOMPARE(cache.insert(2, createScan(10, 2)), kNoErr);
+    QVERIFY(cache.find(1, &actual));
+    QCOMPARE(cache.insert(3, createScan(10, 3)), kNoErr);
+    QVERIFY(cache.find(1, &actual));
+    QVERIFY(!cache.find(2, &actual));
+    QVERIFY(cache.find(3, &actual));
+}
+
+point2dList MSCentroidCacheTest::createScan(int pointCount, int seed)
+{
+    point2dList points;
+    for (int i = 0; i < pointCount; ++i) {
+        points.push_back(point2d(300.0 + seed + i * 0.37, std::fabs(std::sin(i + seed)) * 1e5));
+    }
+    return points;
+}
+
+_PMI_END
+
+QTEST_GUILESS_MAIN(pmi::MSCentroidCacheTest)
+
+#include "MSCentroidCacheTest.moc"
@@ -9,6 +9,7 @@
 #include <utility>
 
 #include "PMiTestUtils.h"
+#include "NonUniformTileStoreMmap.h"
 #include "NonUniformTileStoreSqlite.h"
 #include <QScopedPointer>
 #include "db\NonUniformTilesInfoDao.h"
@@ -23,7 +24,7 @@ static const QString DM_Av_BYSPEC2 = QStringLiteral("020215_DM_Av.byspec2");
 
 _PMI_BEGIN
 
-enum Store { StoreMemory, StoreSqlite };
+enum Store { StoreMemory, StoreSqlite, StoreMmap };
 
 class MSDataNonUniformTest : public QObject
 {
@@ -65,6 +66,10 @@ private Q_SLOTS :
     // this test tests latest version of getXICData for particular MS File+existing NonUniform cache and particular XIC window
     void testGetXICDataNG();
 
+    // compares XIC latency of the sqlite and the memory mapped store when tiles are not cached
+    void benchmarkGetXICDataNG_data();
+    void benchmarkGetXICDataNG();
+
 private:
     NonUniformTileStore * fetchStore(Store type, const QString& filePath);
     NonUniformTileRange createTestRange(const MSReaderInfo &info, const QString &fileName);
@@ -297,6 +302,77 @@ void MSDataNonUniformTest::testGetXICDataNG()
 }
 
 
+void MSDataNonUniformTest::benchmarkGetXICDataNG_data()
+{
+    QTest::addColumn<int>("storeType");
+    QTest::newRow("GetXICDataNG-Sqlite") << int(StoreSqlite);
+    QTest::newRow("GetXICDataNG-Mmap") << int(StoreMmap);
+}
+
+void MSDataNonUniformTest::benchmarkGetXICDataNG()
+{
+    QFETCH(int, storeType);
+
+    QString filePath = QDir(PMI_TEST_FILES_OUTPUT_DIR).filePath("benchmarkGetXICDataNG.db3");
+    QString mmapFilePath = QDir(PMI_TEST_FILES_OUTPUT_DIR).filePath("benchmarkGetXICDataNG.mmap");
+    if (QFileInfo(filePath).exists()) {
+        QVERIFY(QFile::remove(filePath));
+    }
+
+    QScopedPointer<NonUniformTileStoreSqlite> sqliteStore(
+        static_cast<NonUniformTileStoreSqlite *>(fetchStore(StoreSqlite, filePath)));
+    QVERIFY(sqliteStore != nullptr);
+
+    NonUniformTileRange range = m_testRange;
+    ScanIndexNumberConverter converter = ScanIndexNumberConverter::fromMSReader(m_reader);
+    QVERIFY(createTileStore(range, converter, NonUniformTileStore::ContentMS1Centroided, sqliteStore.data()));
+    QVERIFY(NonUniformTileStoreMmap::exportFromSqlite(sqliteStore.data(), mmapFilePath));
+
+    NonUniformTileStoreMmap mmapStore;
+    QVERIFY(mmapStore.open(mmapFilePath));
+
+    // narrow windows over the whole time range, as the XICs of peptides are
+    const int windowCount = 50;
+    const double mzStep = (range.mzMax() - range.mzMin()) / (windowCount + 1);
+    QVector<msreader::XICWindow> windows;
+    for (int i = 0; i < windowCount; ++i) {
+        msreader::XICWindow window;
+        window.mz_start = range.mzMin() + (i + 1) * mzStep;
+        window.mz_end = window.mz_start + 0.02;
+        window.time_start = converter.toScanTime(converter.toScanNumber(range.scanIndexMin()));
+        window.time_end = converter.toScanTime(converter.toScanNumber(range.scanIndexMax()));
+        windows.push_back(window);
+    }
+
+    MSDataNonUniform sqliteData(sqliteStore.data(), range, converter);
+    MSDataNonUniform mmapData(&mmapStore, range, converter);
+    MSDataNonUniform &data = (Store(storeType) == StoreMmap) ? mmapData : sqliteData;
+    // every tile is fetched from the store
+    data.tileManager()->setCacheSizeBytes(0);
+
+    // both stores provide the same XICs
+    for (const msreader::XICWindow &window : windows) {
+        point2dList expected;
+        QCOMPARE(sqliteData.getXICDataNG(window, &expected), kNoErr);
+        point2dList actual;
+        QCOMPARE(mmapData.getXICDataNG(window, &actual), kNoErr);
+        QCOMPARE(actual, expected);
+    }
+
+    point2dList points;
+    QBENCHMARK {
+        for (const msreader::XICWindow &window : windows) {
+            data.getXICDataNG(window, &points);
+        }
+    }
+
+    mmapStore.close();
+    QVERIFY(QFile::remove(mmapFilePath));
+    sqliteStore.reset();
+    m_db.close();
+    QVERIFY(QFile::remove(filePath));
+}
+
 pmi::NonUniformTileRange MSDataNonUniformTest::createTestRange(const MSReaderInfo &info, const QString &fileName)
 {
     NonUniformTileRange range;
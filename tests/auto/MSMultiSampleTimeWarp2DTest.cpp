@@ -29,6 +29,11 @@ private Q_SLOTS:
     /*! \brief Exercise all filename-addressed APIs */
     void testMonotonyWithSimpleAPI();
 
+    /*! \brief Parallel construction reads the same scans and produces the same warps */
+    void testThreadCount();
+
+    void benchmarkConstructTimeWarp_data();
+    void benchmarkConstructTimeWarp();
 
 private:
     const int m_numberOfPointsToWarp = 10;
@@ -172,6 +177,87 @@ void MSMultiSampleTimeWarp2DTest::testMonotonyWithSimpleAPI()
     } // end per-sample loop
 }
 
+void MSMultiSampleTimeWarp2DTest::testThreadCount()
+{
+    MSMultiSampleTimeWarp2D serial;
+    serial.setThreadCount(1);
+    QVERIFY(serial.constructTimeWarp(m_msFilenamesReal, m_msids) == kNoErr);
+
+    MSMultiSampleTimeWarp2D parallel;
+    parallel.setThreadCount(4);
+    QCOMPARE(parallel.threadCount(), 4);
+    QVERIFY(parallel.constructTimeWarp(m_msFilenamesReal, m_msids) == kNoErr);
+
+    QCOMPARE(parallel.pivotFilename(), serial.pivotFilename());
+
+    for (const MSMultiSampleTimeWarp2D::MSID &msid : m_msids) {
+        TimedWarpElementList serialPlot;
+        QVERIFY(serial.getTimedWarpElementList(msid, &serialPlot) == kNoErr);
+        TimedWarpElementList parallelPlot;
+        QVERIFY(parallel.getTimedWarpElementList(msid, &parallelPlot) == kNoErr);
+
+        QCOMPARE(parallelPlot.size(), serialPlot.size());
+        for (int i = 0; i < static_cast<int>(serialPlot.size()); i++) {
+            const TimedWarpElement &serialElement = serialPlot.at(i);
+            const TimedWarpElement &parallelElement = parallelPlot.at(i);
+            QVERIFY(parallelElement.timeInMinutes == serialElement.timeInMinutes);
+            QVERIFY(parallelElement.warpElement.intensity() == serialElement.warpElement.intensity());
+            QVERIFY(parallelElement.warpElement.dominantMz() == serialElement.warpElement.dominantMz());
+        }
+
+        TimeWarp2D serialWarp;
+        QVERIFY(serial.getTimeWarp(msid, &serialWarp) == kNoErr);
+        TimeWarp2D parallelWarp;
+        QVERIFY(parallel.getTimeWarp(msid, &parallelWarp) == kNoErr);
+
+        std::vector<double> serialAnchorsA;
+        std::vector<double> serialAnchorsB;
+        std::vector<double> parallelAnchorsA;
+        std::vector<double> parallelAnchorsB;
+        QVERIFY(serialWarp.getAnchors(&serialAnchorsA, &serialAnchorsB) == kNoErr);
+        QVERIFY(parallelWarp.getAnchors(&parallelAnchorsA, &parallelAnchorsB) == kNoErr);
+        QVERIFY(parallelAnchorsA == serialAnchorsA);
+        QVERIFY(parallelAnchorsB == serialAnchorsB);
+
+        for (const TimedWarpElement &element : serialPlot) {
+            double serialWarped = 0.0;
+            QVERIFY(serial.warp(msid, element.timeInMinutes, &serialWarped) == kNoErr);
+            double parallelWarped = 0.0;
+            QVERIFY(parallel.warp(msid, element.timeInMinutes, &parallelWarped) == kNoErr);
+            QVERIFY(parallelWarped == serialWarped);
+        }
+
+        const QVector<double> timesOriginal = getNTimes(serialPlot, m_numberOfPointsToWarp);
+        QVector<double> timesWarped;
+        for (const double t : timesOriginal) {
+            double tWarped = 0.0;
+            QVERIFY(parallel.warp(msid, t, &tWarped) == kNoErr);
+            timesWarped.push_back(tWarped);
+        }
+        QVERIFY(monotonic(timesWarped));
+    }
+}
+
+void MSMultiSampleTimeWarp2DTest::benchmarkConstructTimeWarp_data()
+{
+    QTest::addColumn<int>("threadCount");
+
+    QTest::newRow("1") << 1;
+    QTest::newRow("2") << 2;
+    QTest::newRow("4") << 4;
+    QTest::newRow("8") << 8;
+}
+
+void MSMultiSampleTimeWarp2DTest::benchmarkConstructTimeWarp()
+{
+    QFETCH(int, threadCount);
+
+    QBENCHMARK {
+        MSMultiSampleTimeWarp2D w;
+        w.setThreadCount(threadCount);
+        QVERIFY(w.constructTimeWarp(m_msFilenamesReal, m_msids) == kNoErr);
+    }
+}
 
 _PMI_END
 
@@ -27,6 +27,9 @@ public:
 private Q_SLOTS:
     void testAPI();
     void testAPIOverloads();
+    void testThreadCount();
+    void benchmarkConstructTimeWarp_data();
+    void benchmarkConstructTimeWarp();
 
 private:
     const int m_numberOfPointsToWarp = 10;
@@ -231,6 +234,81 @@ void MSMultiSampleTimeWarpTest::testAPIOverloads()
     } // end per-sample loop
 }
 
+/*!
+    \brief Parallel construction reads the same base peak plots, reports the same progress and
+        produces the same time warps as the serial one, bit for bit.
+*/
+void MSMultiSampleTimeWarpTest::testThreadCount()
+{
+    QSharedPointer<ProgressBar> serialProgress(new ProgressBar());
+    MSMultiSampleTimeWarp serial;
+    serial.setThreadCount(1);
+    QVERIFY(serial.constructTimeWarp(m_msFilenames, m_msids, serialProgress) == kNoErr);
+
+    QSharedPointer<ProgressBar> parallelProgress(new ProgressBar());
+    MSMultiSampleTimeWarp parallel;
+    parallel.setThreadCount(4);
+    QCOMPARE(parallel.threadCount(), 4);
+    QVERIFY(parallel.constructTimeWarp(m_msFilenames, m_msids, parallelProgress) == kNoErr);
+
+    QCOMPARE(parallelProgress->jobCount, serialProgress->jobCount);
+    QCOMPARE(parallelProgress->jobCompletedCount, parallelProgress->jobCount);
+
+    for (const MSMultiSampleTimeWarp::MSID &msid : m_msids) {
+        PlotBase serialPlot;
+        QVERIFY(serial.getBasePeakPlot(msid, &serialPlot) == kNoErr);
+        PlotBase parallelPlot;
+        QVERIFY(parallel.getBasePeakPlot(msid, &parallelPlot) == kNoErr);
+
+        const point2dList &serialPoints = serialPlot.getPointList();
+        const point2dList &parallelPoints = parallelPlot.getPointList();
+        QCOMPARE(parallelPoints.size(), serialPoints.size());
+        for (int i = 0; i < static_cast<int>(serialPoints.size()); i++) {
+            QVERIFY(parallelPoints.at(i).x() == serialPoints.at(i).x());
+            QVERIFY(parallelPoints.at(i).y() == serialPoints.at(i).y());
+        }
+
+        // every scan time warps to the same time, so the same central plot was chosen
+        for (const point2d &point : serialPoints) {
+            double serialWarped = 0.0;
+            QVERIFY(serial.warp(msid, point.x(), &serialWarped) == kNoErr);
+            double parallelWarped = 0.0;
+            QVERIFY(parallel.warp(msid, point.x(), &parallelWarped) == kNoErr);
+            QVERIFY(parallelWarped == serialWarped);
+        }
+
+        const QVector<double> timesOriginal = getNTimes(serialPlot, m_numberOfPointsToWarp);
+        QVector<double> timesWarped;
+        for (const double t : timesOriginal) {
+            double tWarped = 0.0;
+            QVERIFY(parallel.warp(msid, t, &tWarped) == kNoErr);
+            timesWarped.push_back(tWarped);
+        }
+        QVERIFY(monotonic(timesWarped));
+    }
+}
+
+void MSMultiSampleTimeWarpTest::benchmarkConstructTimeWarp_data()
+{
+    QTest::addColumn<int>("threadCount");
+
+    QTest::newRow("1") << 1;
+    QTest::newRow("2") << 2;
+    QTest::newRow("4") << 4;
+    QTest::newRow("8") << 8;
+}
+
+void MSMultiSampleTimeWarpTest::benchmarkConstructTimeWarp()
+{
+    QFETCH(int, threadCount);
+
+    QBENCHMARK {
+        MSMultiSampleTimeWarp w;
+        w.setThreadCount(threadCount);
+        QVERIFY(w.constructTimeWarp(m_msFilenames, m_msids) == kNoErr);
+    }
+}
+
 _PMI_END
 
 PMI_TEST_GUILESS_MAIN_WITH_ARGS(pmi::MSMultiSampleTimeWarpTest,
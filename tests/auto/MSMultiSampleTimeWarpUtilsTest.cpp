@@ -0,0 +1,108 @@
+/*
+ * Copyright (C) 2019 Protein Metrics Inc. - All Rights Reserved.
+ * Unauthorized copying or distribution of this file, via any medium is strictly prohibited.
+ * Confidential.
+ */
+
+#include "pmi_core_defs.h"
+#include <QtTest>
+
+#include "MSMultiSampleTimeWarpUtils.h"
+#include "ProgressBarInterface.h"
+#include "ProgressContext.h"
+
+#include <numeric>
+#include <random>
+
+_PMI_BEGIN
+
+class MSMultiSampleTimeWarpUtilsTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    /*! \brief The similarity matrix is symmetric and does not depend on the thread count. */
+    void testDotSimilarityMatrix();
+
+    /*! \brief Every task runs once and the first error in index order is returned. */
+    void testRunIndexedTasks();
+};
+
+static QVector<QVector<double>> randomPlots(int plotCount, int pointCount)
+{
+    std::mt19937 eng(5);
+    std::uniform_real_distribution<> intensity(0.0, 1.0);
+
+    QVector<QVector<double>> plots(plotCount);
+    for (QVector<double> &plot : plots) {
+        for (int i = 0; i < pointCount; i++) {
+            plot.push_back(intensity(eng));
+        }
+    }
+
+    return plots;
+}
+
+void MSMultiSampleTimeWarpUtilsTest::testDotSimilarityMatrix()
+{
+    const QVector<QVector<double>> plots = randomPlots(9, 2000);
+
+    const std::vector<std::vector<double>> serial = dotSimilarityMatrix(plots, 1);
+    QCOMPARE(static_cast<int>(serial.size()), plots.size());
+    for (int i = 0; i < plots.size(); i++) {
+        QVERIFY(serial[i][i] == 0.0);
+        for (int j = 0; j < plots.size(); j++) {
+            QVERIFY(serial[i][j] == serial[j][i]);
+        }
+    }
+
+    const QVector<double> &a = plots[2];
+    const QVector<double> &b = plots[7];
+    QVERIFY(serial[2][7] == std::inner_product(a.begin(), a.end(), b.begin(), 0.0));
+
+    for (int threadCount : { 2, 4, 16 }) {
+        QVERIFY(dotSimilarityMatrix(plots, threadCount) == serial);
+    }
+
+    const std::vector<double> total = totalSimilarity(serial);
+    double expected = 0.0;
+    for (int j = 0; j < plots.size(); j++) {
+        if (j != 3) {
+            expected += serial[3][j];
+        }
+    }
+    QVERIFY(total[3] == expected);
+}
+
+void MSMultiSampleTimeWarpUtilsTest::testRunIndexedTasks()
+{
+    const QVector<int> indices = { 0, 2, 3, 5, 8 };
+
+    for (int threadCount : { 1, 4 }) {
+        QVector<QAtomicInt> runs(10);
+        auto task = [&runs](int index) {
+            runs[index].ref();
+            if (index == 3) {
+                return kBadParameterError;
+            }
+            return (index == 8) ? kError : kNoErr;
+        };
+
+        ProgressContext progressContext(indices.size(), NoProgress);
+        const Err e = runIndexedTasks(indices, threadCount, task, &progressContext);
+        QCOMPARE(e, kBadParameterError);
+
+        for (int index : { 0, 2, 3 }) {
+            QCOMPARE(runs[index].load(), 1);
+        }
+        // the calling thread stops at the first error, the pool runs every task
+        QCOMPARE(runs[5].load(), threadCount == 1 ? 0 : 1);
+        QCOMPARE(runs[1].load(), 0);
+    }
+}
+
+_PMI_END
+
+QTEST_MAIN(pmi::MSMultiSampleTimeWarpUtilsTest)
+
+#include "MSMultiSampleTimeWarpUtilsTest.moc"
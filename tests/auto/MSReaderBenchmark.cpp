@@ -11,6 +11,8 @@
 #include "MSReader.h"
 
 #include "CsvReader.h"
+#include "CacheFileManagerInterface.h"
+#include "MSReaderTesting.h"
 #include "MSReaderTypes.h"
 #include "PMiTestUtils.h"
 
@@ -25,6 +27,7 @@ _PMI_BEGIN
 // vendor files 
 static const QString CONA_RAW = QStringLiteral("cona_tmt0saxpdetd.raw");
 static const QString PFITZER_LT4211_RAW = QStringLiteral("ES_15Jan19_NGHer2_T0_30min_pH8.raw");
+static const QString DM_AV_BYSPEC = QStringLiteral("020215_DM_Av.byspec2");
 
 // CSV files with XICs 
 static const QString CONA_XIC_CSV = QStringLiteral("cona_tmt0saxpdetd.csv");
@@ -46,9 +49,24 @@ private Q_SLOTS:
     void testGetXICDataFromList_data();
     void testGetXICDataFromList();
 
+    void testGetChromatogramsSinglePassDecodeCount();
+    void testGetChromatogramsSinglePass_data();
+    void testGetChromatogramsSinglePass();
+
+    void testGetXICDataBatchDecodeCount();
+
+    void testGetXICDataByspec_data();
+    void testGetXICDataByspec();
+
 private:
     QVector<msreader::XICWindow> xicsFromCSV(const QString &filePath);
 
+    QVector<msreader::ChromatogramRequest> makeChromatogramRequests(MSReader *reader,
+                                                                  int xicCount) const;
+    MSReaderTesting *openTestingReader(MSReader *reader, int scanCount) const;
+    void closeTestingReader(MSReader *reader) const;
+    static void setTestingReaderEnabled(MSReader *reader, bool enabled);
+
 private:
     MSReader * initReader();
     void cleanUpReader(MSReader * ms);
@@ -221,6 +239,295 @@ void MSReaderBenchmark::testGetXICDataFromList()
     ms->closeFile();
 }
 
+QVector<msreader::ChromatogramRequest>
+MSReaderBenchmark::makeChromatogramRequests(MSReader *reader, int xicCount) const
+{
+    QVector<msreader::ChromatogramRequest> requests;
+    requests.push_back(msreader::ChromatogramRequest(msreader::ChromatogramRequest::TypeTIC));
+    requests.push_back(msreader::ChromatogramRequest(msreader::ChromatogramRequest::TypeBasePeak));
+
+    double minTime = 0;
+    double maxTime = 0;
+    reader->getTimeDomain(&minTime, &maxTime);
+
+    double minMz = 0;
+    double maxMz = 0;
+    reader->getDomainInterval_sampleContent(reader->bestMSLevelOne(), &minMz, &maxMz);
+
+    // deterministic windows spread over the whole domain, each covering a third of the gradient
+    const double timeLength = (maxTime - minTime) / 3.0;
+    for (int i = 0; i < xicCount; ++i) {
+        const double fraction = static_cast<double>(i) / std::max(1, xicCount - 1);
+        const double mz = minMz + (maxMz - minMz) * fraction;
+        const double timeStart = minTime + (maxTime - minTime - timeLength) * fraction;
+        requests.push_back(msreader::ChromatogramRequest(
+            msreader::XICWindow(mz - 0.01, mz + 0.01, timeStart, timeStart + timeLength)));
+    }
+
+    return requests;
+}
+
+void MSReaderBenchmark::setTestingReaderEnabled(MSReader *reader, bool enabled)
+{
+    for (QSharedPointer<MSReaderBase> item : reader->m_vendorList) {
+        MSReaderTesting *testReader = dynamic_cast<MSReaderTesting *>(item.data());
+        if (testReader) {
+            testReader->setEnableCanOpen(enabled);
+            break;
+        }
+    }
+}
+
+MSReaderTesting *MSReaderBenchmark::openTestingReader(MSReader *reader, int scanCount) const
+{
+    setTestingReaderEnabled(reader, true);
+
+    const QString virtualFileName
+        = QString(PMI_TEST_FILES_OUTPUT_DIR) + "/" + MSReaderTesting::MAGIC_FILENAME;
+    if (!QFileInfo(virtualFileName).exists()) {
+        QDir dir(PMI_TEST_FILES_OUTPUT_DIR);
+        if (!dir.mkpath(MSReaderTesting::MAGIC_FILENAME)) {
+            return nullptr;
+        }
+    }
+
+    if (reader->openFile(virtualFileName) != kNoErr) {
+        return nullptr;
+    }
+
+    // openFile makes a new reader, the one in the vendor list only decides who opens the file
+    MSReaderTesting *testReader = dynamic_cast<MSReaderTesting *>(reader->m_openReader.data());
+    if (testReader) {
+        testReader->setScanCount(scanCount);
+        testReader->setScanData(
+            { QPointF(400.0, 10.0), QPointF(500.0, 30.0), QPointF(600.0, 20.0) });
+    }
+    return testReader;
+}
+
+void MSReaderBenchmark::closeTestingReader(MSReader *reader) const
+{
+    reader->closeFile();
+    setTestingReaderEnabled(reader, false);
+}
+
+void MSReaderBenchmark::testGetChromatogramsSinglePassDecodeCount()
+{
+    // uses the mock reader so that the number of scan decodes can be counted
+    const int scanCount = 200;
+    const int xicCount = 20;
+
+    MSReader *reader = initReader();
+    MSReaderTesting *testReader = openTestingReader(reader, scanCount);
+    QVERIFY(testReader != nullptr);
+
+    QVector<msreader::ChromatogramRequest> requests;
+    requests.push_back(msreader::ChromatogramRequest(msreader::ChromatogramRequest::TypeTIC));
+    requests.push_back(msreader::ChromatogramRequest(msreader::ChromatogramRequest::TypeBasePeak));
+    for (int i = 0; i < xicCount; ++i) {
+        const double timeStart = 0.02 + i * 0.05;
+        requests.push_back(msreader::ChromatogramRequest(
+            msreader::XICWindow(450.0, 550.0, timeStart, timeStart + 0.5)));
+    }
+
+    // one request at a time, the way callers used to do it
+    testReader->resetScanDataCallCount();
+    point2dList tic;
+    point2dList basePeak;
+    QCOMPARE(reader->_getTICManual(&tic), kNoErr);
+    QCOMPARE(reader->_getBasePeakManual(&basePeak), kNoErr);
+    QVector<point2dList> xics(xicCount);
+    for (int i = 0; i < xicCount; ++i) {
+        QCOMPARE(reader->_getXICManual(requests[i + 2].window, &xics[i], 1), kNoErr);
+    }
+    const int separateDecodes = testReader->scanDataCallCount();
+
+    testReader->resetScanDataCallCount();
+    QCOMPARE(reader->getChromatogramsSinglePass(&requests), kNoErr);
+    const int singlePassDecodes = testReader->scanDataCallCount();
+
+    qDebug() << "Decodes per scan, separate:" << double(separateDecodes) / scanCount
+             << "single pass:" << double(singlePassDecodes) / scanCount;
+
+    QCOMPARE(singlePassDecodes, scanCount);
+    QVERIFY(separateDecodes > singlePassDecodes);
+
+    QCOMPARE(requests[0].points, tic);
+    QCOMPARE(requests[1].points, basePeak);
+    for (int i = 0; i < xicCount; ++i) {
+        QCOMPARE(requests[i + 2].points, xics[i]);
+    }
+
+    closeTestingReader(reader);
+}
+
+void MSReaderBenchmark::testGetXICDataBatchDecodeCount()
+{
+    // uses the mock reader, it has no native XIC so the batch falls back to a single sweep
+    const int scanCount = 200;
+    const int xicCount = 1000;
+
+    MSReader *reader = initReader();
+    MSReaderTesting *testReader = openTestingReader(reader, scanCount);
+    QVERIFY(testReader != nullptr);
+    reader->setXICDataMode(MSReader::XICModeManual);
+
+    QVector<msreader::XICWindow> windows;
+    for (int i = 0; i < xicCount; ++i) {
+        // unsorted on purpose
+        const double timeStart = 0.02 + ((i * 7) % xicCount) * 0.001;
+        const double mz = (i % 2 == 0) ? 500.0 : 400.0;
+        windows.push_back(msreader::XICWindow(mz - 0.5, mz + 0.5, timeStart, timeStart + 0.3));
+    }
+
+    testReader->resetScanDataCallCount();
+    QVector<point2dList> expected(xicCount);
+    for (int i = 0; i < xicCount; ++i) {
+        QCOMPARE(reader->getXICData(windows[i], &expected[i], 1), kNoErr);
+    }
+    const int separateDecodes = testReader->scanDataCallCount();
+
+    testReader->resetScanDataCallCount();
+    QVector<point2dList> actual;
+    QCOMPARE(reader->getXICDataBatch(windows, &actual, 1), kNoErr);
+    const int batchDecodes = testReader->scanDataCallCount();
+
+    qDebug() << "Decodes, separate:" << separateDecodes << "batch:" << batchDecodes;
+
+    QVERIFY(batchDecodes <= scanCount);
+    QVERIFY(separateDecodes > batchDecodes);
+    QCOMPARE(actual.size(), xicCount);
+    for (int i = 0; i < xicCount; ++i) {
+        QCOMPARE(actual[i], expected[i]);
+    }
+
+    reader->setXICDataMode(MSReader::XICModeVendor);
+    closeTestingReader(reader);
+}
+
+void MSReaderBenchmark::testGetChromatogramsSinglePass_data()
+{
+    QTest::addColumn<QString>("msDatafilePath");
+    QTest::addColumn<bool>("singlePass");
+
+    QTest::newRow("CONA-separate") << m_testDataBasePath.filePath(CONA_RAW) << false;
+    QTest::newRow("CONA-singlePass") << m_testDataBasePath.filePath(CONA_RAW) << true;
+}
+
+void MSReaderBenchmark::testGetChromatogramsSinglePass()
+{
+    QFETCH(QString, msDatafilePath);
+    QFETCH(bool, singlePass);
+
+    const int xicCount = 50;
+
+    MSReader *reader = initReader();
+    QVERIFY(QFileInfo(msDatafilePath).exists());
+    QCOMPARE(reader->openFile(msDatafilePath), kNoErr);
+
+    QVector<msreader::ChromatogramRequest> requests = makeChromatogramRequests(reader, xicCount);
+
+    QBENCHMARK {
+        if (singlePass) {
+            QCOMPARE(reader->getChromatogramsSinglePass(&requests), kNoErr);
+        } else {
+            QCOMPARE(reader->_getTICManual(&requests[0].points), kNoErr);
+            QCOMPARE(reader->_getBasePeakManual(&requests[1].points), kNoErr);
+            for (int i = 2; i < requests.size(); ++i) {
+                QCOMPARE(reader->_getXICManual(requests[i].window, &requests[i].points, 1),
+                         kNoErr);
+            }
+        }
+    }
+
+    cleanUpReader(reader);
+}
+
+void MSReaderBenchmark::testGetXICDataByspec_data()
+{
+    QTest::addColumn<QString>("msDatafilePath");
+    QTest::addColumn<int>("xicMode");
+    QTest::addColumn<bool>("batched");
+
+    const QString byspecPath = m_testDataBasePath.filePath(DM_AV_BYSPEC);
+    QTest::newRow("DM_Av-byspec-manual")
+        << byspecPath << static_cast<int>(MSReader::XICModeManual) << false;
+    QTest::newRow("DM_Av-byspec-manual-batch")
+        << byspecPath << static_cast<int>(MSReader::XICModeManual) << true;
+    QTest::newRow("DM_Av-byspec-native")
+        << byspecPath << static_cast<int>(MSReader::XICModeVendor) << false;
+    QTest::newRow("DM_Av-byspec-native-batch")
+        << byspecPath << static_cast<int>(MSReader::XICModeVendor) << true;
+}
+
+void MSReaderBenchmark::testGetXICDataByspec()
+{
+    QFETCH(QString, msDatafilePath);
+    QFETCH(int, xicMode);
+    QFETCH(bool, batched);
+
+    const int xicCount = 200;
+
+    MSReader *reader = initReader();
+    QVERIFY(QFileInfo(msDatafilePath).exists());
+    // the XIC index is a cache file, keep it out of the test data folder
+    const QString savePath = reader->cacheFileManager()->savePath();
+    const QString outputPath = QString(PMI_TEST_FILES_OUTPUT_DIR) + "/MSReaderBenchmark";
+    QVERIFY(QDir().mkpath(outputPath));
+    reader->cacheFileManager()->setSavePath(outputPath);
+    const QFileInfo inputInfo(msDatafilePath);
+    QCOMPARE(reader->openFile(msDatafilePath), kNoErr);
+
+    QVector<msreader::XICWindow> windows;
+    for (const msreader::ChromatogramRequest &request : makeChromatogramRequests(reader, xicCount)) {
+        if (request.type == msreader::ChromatogramRequest::TypeXIC) {
+            windows.push_back(request.window);
+        }
+    }
+
+    // reference from the manual path; the first pass below also builds the byspec XIC index
+    // outside of the measured block
+    QVector<point2dList> expected(windows.size());
+    for (int i = 0; i < windows.size(); ++i) {
+        QCOMPARE(reader->_getXICManual(windows[i], &expected[i], 1), kNoErr);
+    }
+
+    reader->setXICDataMode(static_cast<MSReader::XICMode>(xicMode));
+
+    QElapsedTimer et;
+    et.start();
+    for (int i = 0; i < windows.size(); ++i) {
+        point2dList points;
+        QCOMPARE(reader->getXICData(windows[i], &points, 1), kNoErr);
+        QCOMPARE(points, expected[i]);
+    }
+    qDebug() << "First pass (includes index build)" << et.elapsed() << "ms";
+
+    QVector<point2dList> batch;
+    QCOMPARE(reader->getXICDataBatch(windows, &batch, 1), kNoErr);
+    QCOMPARE(batch, expected);
+
+    // the index is written to its own cache file, the byspec2 is left as it is
+    const QFileInfo inputInfoAfter(msDatafilePath);
+    QCOMPARE(inputInfoAfter.size(), inputInfo.size());
+    QCOMPARE(inputInfoAfter.lastModified(), inputInfo.lastModified());
+
+    QBENCHMARK {
+        if (batched) {
+            QCOMPARE(reader->getXICDataBatch(windows, &batch, 1), kNoErr);
+        } else {
+            for (const msreader::XICWindow &win : windows) {
+                point2dList points;
+                QCOMPARE(reader->getXICData(win, &points, 1), kNoErr);
+            }
+        }
+    }
+
+    reader->setXICDataMode(MSReader::XICModeVendor);
+    reader->cacheFileManager()->setSavePath(savePath);
+    cleanUpReader(reader);
+}
+
 QVector<msreader::XICWindow> MSReaderBenchmark::xicsFromCSV(const QString &filePath)
 {
     QVector<msreader::XICWindow> result;
@@ -46,6 +46,7 @@ private:
 
 private Q_SLOTS:
     void testGetXICDataFuzzy();
+    void testGetXICDataBatchTiledCache();
     void testSwitchFiles();
     void testThermoVsManualXICWindow();
     void testGetScanDataMS1Sum_SingleScan();
@@ -234,6 +235,41 @@ void MSReaderTest::testGetXICDataFuzzy()
     reader->releaseInstance();
 }
 
+void MSReaderTest::testGetXICDataBatchTiledCache()
+{
+    MSReader *reader = MSReader::Instance();
+    QVERIFY(QFileInfo(m_rawFilePath).exists());
+    QCOMPARE(reader->openFile(m_rawFilePath), kNoErr);
+
+    const QVector<msreader::XICWindow> xicWindows = xicFromReader(reader, 5);
+    QVERIFY(!xicWindows.isEmpty());
+
+    reader->setXICDataMode(MSReader::XICModeTiledCache);
+
+    // the tiled cache only has ms level 1, both calls return the same error for other levels
+    for (int msLevel : { 1, 2 }) {
+        QVector<point2dList> expected(xicWindows.size());
+        Err expectedError = kNoErr;
+        for (int i = 0; i < xicWindows.size() && expectedError == kNoErr; ++i) {
+            expectedError = reader->getXICData(xicWindows[i], &expected[i], msLevel);
+        }
+
+        QVector<point2dList> actual;
+        const Err actualError = reader->getXICDataBatch(xicWindows, &actual, msLevel);
+        QCOMPARE(actualError, expectedError);
+        if (msLevel == 1) {
+            QCOMPARE(actualError, kNoErr);
+            QCOMPARE(actual, expected);
+        } else {
+            QVERIFY(actualError != kNoErr);
+            QVERIFY(actual.isEmpty());
+        }
+    }
+
+    reader->setXICDataMode(MSReader::XICModeVendor);
+    reader->closeFile();
+}
+
 void MSReaderTest::testCompareXICData_data()
 {
     // Dumps are binary files in LittleEndian format with doubles:
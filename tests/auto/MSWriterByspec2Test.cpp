@@ -0,0 +1,327 @@
+/*
+ * Copyright (C) 2019 Protein Metrics Inc. - All Rights Reserved.
+ * Unauthorized copying or distribution of this file, via any medium is strictly prohibited.
+ * Confidential.
+ */
+
+#include "MSWriterByspec2.h"
+
+#include "MSReader.h"
+#include "MSReaderTesting.h"
+
+#include <PmiQtStablesConstants.h>
+#include <pmi_core_defs.h>
+
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QSqlRecord>
+#include <QtTest>
+
+_PMI_BEGIN
+
+class MSWriterByspec2Test : public QObject
+{
+    Q_OBJECT
+public:
+    MSWriterByspec2Test();
+
+private Q_SLOTS:
+    void initTestCase();
+
+    void testParallelMatchesSerial_data();
+    void testParallelMatchesSerial();
+
+    void testExpectedRows_data();
+    void testExpectedRows();
+
+    void benchmarkMakeByspec2_data();
+    void benchmarkMakeByspec2();
+
+private:
+    Err makeByspec2(const QString &sourceFile, const QString &outputFile, int threadCount,
+                    bool onlyCentroided);
+    static QVector<QVariantList> readTable(const QString &filePath, const QString &command);
+    static QVector<QStringList> toStrings(const QVector<QVariantList> &rows);
+
+private:
+    QDir m_testOutputDir;
+    QString m_sourceFile;
+};
+
+static const int PEPTIDE_COUNT = 200;
+
+MSWriterByspec2Test::MSWriterByspec2Test()
+{
+    const QString testName = "MSWriterByspec2Test";
+    m_testOutputDir = QString(PMI_TEST_FILES_OUTPUT_DIR) + "/" + testName;
+    if (!m_testOutputDir.exists()) {
+        m_testOutputDir.mkpath(m_testOutputDir.absolutePath());
+    }
+}
+
+void MSWriterByspec2Test::initTestCase()
+{
+    // simulated MS1 data read by MSReaderSimulated
+    m_sourceFile = m_testOutputDir.filePath("sample.msfaux");
+    {
+        QFile file(m_sourceFile);
+        QVERIFY(file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text));
+        QTextStream out(&file);
+        out << "MassObject,RetTimeMinutes,Intensity,PeakWidthMinutes,MSLevel,ChargesOrder,"
+               "ChargesRatios,ExtraMzIons,FragmentationType,ModificationPositions,"
+               "ModificationNames\n";
+        for (int i = 0; i < PEPTIDE_COUNT; ++i) {
+            const double mass = 800.0 + (i * 37 % 101) * 23.17;
+            const double retTimeMinutes = 0.5 + (i * 13 % 97) * 0.05;
+            const double intensity = 1e5 * (1 + i % 7);
+            out << mass << "," << retTimeMinutes << "," << intensity << ",0.2,1,3;2,1;0.5,,,,\n";
+        }
+    }
+    {
+        QFile file(m_sourceFile + ".params");
+        QVERIFY(file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text));
+        QTextStream out(&file);
+        out << "fauxScanParameter,fauxScanParameterValue\n";
+        out << "ScansPerSecond,4\n";
+    }
+}
+
+void MSWriterByspec2Test::testParallelMatchesSerial_data()
+{
+    QTest::addColumn<bool>("onlyCentroided");
+
+    QTest::newRow("all") << false;
+    QTest::newRow("onlyCentroided") << true;
+}
+
+void MSWriterByspec2Test::testParallelMatchesSerial()
+{
+    QFETCH(bool, onlyCentroided);
+
+    const QString serialFile = m_testOutputDir.filePath("serial.byspec2");
+    const QString parallelFile = m_testOutputDir.filePath("parallel.byspec2");
+    QCOMPARE(makeByspec2(m_sourceFile, serialFile, 1, onlyCentroided), kNoErr);
+    QCOMPARE(makeByspec2(m_sourceFile, parallelFile, 4, onlyCentroided), kNoErr);
+
+    const QStringList commands = {
+        QStringLiteral("SELECT * FROM Peaks ORDER BY Id"),
+        QStringLiteral("SELECT * FROM Spectra ORDER BY Id"),
+    };
+    for (const QString &command : commands) {
+        const QVector<QVariantList> expected = readTable(serialFile, command);
+        QVERIFY(!expected.isEmpty());
+        QCOMPARE(readTable(parallelFile, command), expected);
+    }
+    if (!onlyCentroided) {
+        const QString command = QStringLiteral("SELECT * FROM Peaks_MS1Centroided ORDER BY Id");
+        QCOMPARE(readTable(parallelFile, command), readTable(serialFile, command));
+    }
+}
+
+void MSWriterByspec2Test::testExpectedRows_data()
+{
+    QTest::addColumn<bool>("onlyCentroided");
+    QTest::addColumn<int>("threadCount");
+
+    QTest::newRow("all-serial") << false << 1;
+    QTest::newRow("all-parallel") << false << 4;
+    QTest::newRow("onlyCentroided-serial") << true << 1;
+    QTest::newRow("onlyCentroided-parallel") << true << 4;
+}
+
+// Expected rows are written out by hand the way the writer produced them before the scans were
+// read in parallel and inserted by multi-row statements
+void MSWriterByspec2Test::testExpectedRows()
+{
+    QFETCH(bool, onlyCentroided);
+    QFETCH(int, threadCount);
+
+    const point2dList points = { QPointF(400.0, 10.0), QPointF(500.0, 30.0),
+                                 QPointF(600.0, 20.0) };
+
+    MSReader *reader = MSReader::Instance();
+    for (QSharedPointer<MSReaderBase> item : reader->m_vendorList) {
+        MSReaderTesting *testReader = dynamic_cast<MSReaderTesting *>(item.data());
+        if (testReader) {
+            testReader->setEnableCanOpen(true);
+            break;
+        }
+    }
+
+    const QString sourceFile
+        = QString(PMI_TEST_FILES_OUTPUT_DIR) + "/" + MSReaderTesting::MAGIC_FILENAME;
+    if (!QFileInfo(sourceFile).exists()) {
+        QDir dir(PMI_TEST_FILES_OUTPUT_DIR);
+        QVERIFY(dir.mkpath(MSReaderTesting::MAGIC_FILENAME));
+    }
+
+    // makeByspec2 opens the same file again and gets the reader configured here
+    QCOMPARE(reader->openFile(sourceFile), kNoErr);
+    MSReaderTesting *testReader = dynamic_cast<MSReaderTesting *>(reader->m_openReader.data());
+    QVERIFY(testReader);
+    // scan 1 can't be read, MS2 scan 3 has no precursor
+    testReader->setScanCount(6);
+    testReader->setScanData(points);
+    testReader->setMS2Scans({ 2, 3, 5 });
+    testReader->setBrokenScans({ 1 });
+    testReader->setPrecursorErrorScans({ 3 });
+    reader->closeFile();
+
+    const QString outputFile = m_testOutputDir.filePath("expected.byspec2");
+    QCOMPARE(makeByspec2(sourceFile, outputFile, threadCount, onlyCentroided), kNoErr);
+
+    const QVector<QVariantList> files
+        = readTable(outputFile, QStringLiteral("SELECT Id FROM Files"));
+    QCOMPARE(files.size(), 1);
+    const int fileId = files.front().front().toInt();
+
+    // uncompressed blobs, m/z as double and intensity as float
+    QByteArray mzBlob;
+    QByteArray intensityBlob;
+    for (const QPointF &point : points) {
+        const double x = point.x();
+        const float y = static_cast<float>(point.y());
+        mzBlob.append(reinterpret_cast<const char *>(&x), sizeof(x));
+        intensityBlob.append(reinterpret_cast<const char *>(&y), sizeof(y));
+    }
+
+    // valid scans 0, 2, 4 and 5 get the peaks ids 1 to 4
+    QVector<QVariantList> expectedPeaks;
+    for (int peaksId = 1; peaksId <= 4; ++peaksId) {
+        // Id, PeaksMz, PeaksIntensity, SpectraIdList, PeaksCount, MetaText, Comment,
+        // IntensitySum, CompressionInfoId
+        expectedPeaks.push_back({ peaksId, mzBlob, intensityBlob, QVariant(), 3, QVariant(),
+                                  QVariant(), 60.0, 0 });
+    }
+
+    const QString rawReadingError = QString::fromStdString(convertErrToString(kRawReadingError));
+    QString brokenScanComment;
+    if (!onlyCentroided) {
+        brokenScanComment = QStringLiteral("getScanData with scanNo=1, centroided=0 returns error: ")
+            + rawReadingError + QStringLiteral(", ");
+    }
+    brokenScanComment
+        += QStringLiteral("getScanData with scanNo=1, centroided=1 returns error: ") + rawReadingError;
+    const QString precursorErrorComment
+        = QStringLiteral("getScanPrecursorInfo with scanNo=3 returns error: ") + rawReadingError;
+    const QString metaText = QStringLiteral(
+        "<RetentionTimeUnit>second</RetentionTimeUnit><PeakMode>unknown spectrum</PeakMode>");
+    auto retentionTime = [](int scan) { return (0.02 + scan * 0.01) * 60; };
+    const QVariant null;
+
+    // Id, FilesId, MSLevel, ObservedMz, IsolationWindowLowerOffset, IsolationWindowUpperOffset,
+    // RetentionTime, ScanNumber, NativeId, ChargeList, PeaksId, PrecursorIntensity,
+    // FragmentationType, ParentScanNumber, ParentNativeId, Comment, MetaText, DebugText, Valid,
+    // MobilityValue
+    const QVector<QVariantList> expectedSpectra = {
+        { 1, fileId, 1, null, null, null, retentionTime(0), 0, "scan=0", null, 1, null, null, null,
+          null, null, metaText, null, 1, null },
+        { 2, fileId, null, null, null, null, null, 1, null, null, null, null, null, null, null,
+          brokenScanComment, null, null, 0, null },
+        { 3, fileId, 2, 402.0, 1.0, 1.5, retentionTime(2), 2, "scan=2", "2", 2, null, "CID", 1,
+          "scan=1", null, metaText, null, 1, null },
+        { 4, fileId, null, null, null, null, null, 3, null, null, null, null, null, null, null,
+          precursorErrorComment, null, null, 0, null },
+        { 5, fileId, 1, null, null, null, retentionTime(4), 4, "scan=4", null, 3, null, null, null,
+          null, null, metaText, null, 1, null },
+        { 6, fileId, 2, 405.0, 1.0, 1.5, retentionTime(5), 5, "scan=5", "2", 4, null, "CID", 4,
+          "scan=4", null, metaText, null, 1, null },
+    };
+
+    QCOMPARE(toStrings(readTable(outputFile, QStringLiteral("SELECT * FROM Peaks ORDER BY Id"))),
+             toStrings(expectedPeaks));
+    QCOMPARE(toStrings(readTable(outputFile,
+                                 QStringLiteral("SELECT * FROM Peaks_MS1Centroided ORDER BY Id"))),
+             toStrings(onlyCentroided ? QVector<QVariantList>() : expectedPeaks));
+    QCOMPARE(toStrings(readTable(outputFile, QStringLiteral("SELECT * FROM Spectra ORDER BY Id"))),
+             toStrings(expectedSpectra));
+    QCOMPARE(toStrings(readTable(
+                 outputFile,
+                 QStringLiteral("SELECT FilesId, Value FROM FilesInfo WHERE Key = "
+                                "'ConversionErrorMessage'"))),
+             toStrings({ { fileId, QStringLiteral("There were 2 scan(s) with errors.") } }));
+}
+
+void MSWriterByspec2Test::benchmarkMakeByspec2_data()
+{
+    QTest::addColumn<int>("threadCount");
+
+    QTest::newRow("serial") << 1;
+    QTest::newRow("parallel") << 0;
+}
+
+void MSWriterByspec2Test::benchmarkMakeByspec2()
+{
+    QFETCH(int, threadCount);
+
+    const QString outputFile = m_testOutputDir.filePath("benchmark.byspec2");
+    QBENCHMARK {
+        QCOMPARE(makeByspec2(m_sourceFile, outputFile, threadCount, false), kNoErr);
+    }
+}
+
+Err MSWriterByspec2Test::makeByspec2(const QString &sourceFile, const QString &outputFile,
+                                     int threadCount, bool onlyCentroided)
+{
+    QFile::remove(outputFile);
+
+    MSWriterByspec2 writer;
+    writer.setThreadCount(threadCount);
+    return writer.makeByspec2(sourceFile, outputFile,
+                              msreader::ConvertWithCentroidButNoPeaksBlobs, onlyCentroided, msreader::IonMobilityOptions(), QStringList());
+}
+
+QVector<QVariantList> MSWriterByspec2Test::readTable(const QString &filePath,
+                                                     const QString &command)
+{
+    QVector<QVariantList> rows;
+    const QString connectionName = QStringLiteral("MSWriterByspec2Test");
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase(kQSQLITE, connectionName);
+        db.setDatabaseName(filePath);
+        if (!db.open()) {
+            return rows;
+        }
+
+        QSqlQuery query(db);
+        if (query.exec(command)) {
+            while (query.next()) {
+                QVariantList row;
+                for (int i = 0; i < query.record().count(); ++i) {
+                    row.push_back(query.value(i));
+                }
+                rows.push_back(row);
+            }
+        }
+        db.close();
+    }
+    QSqlDatabase::removeDatabase(connectionName);
+    return rows;
+}
+
+QVector<QStringList> MSWriterByspec2Test::toStrings(const QVector<QVariantList> &rows)
+{
+    QVector<QStringList> strings;
+    for (const QVariantList &row : rows) {
+        QStringList values;
+        for (const QVariant &value : row) {
+            if (value.isNull()) {
+                values.push_back(QStringLiteral("NULL"));
+            } else if (value.type() == QVariant::ByteArray) {
+                values.push_back(QString::fromLatin1(value.toByteArray().toHex()));
+            } else if (value.type() == QVariant::Double) {
+                values.push_back(QString::number(value.toDouble(), 'g', 17));
+            } else {
+                values.push_back(value.toString());
+            }
+        }
+        strings.push_back(values);
+    }
+    return strings;
+}
+
+_PMI_END
+
+QTEST_MAIN(pmi::MSWriterByspec2Test)
+
+#include "MSWriterByspec2Test.moc"
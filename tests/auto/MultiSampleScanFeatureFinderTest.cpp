@@ -7,12 +7,19 @@
  */
 
 #include "MultiSampleScanFeatureFinder.h"
+#include "MSReader.h"
+#include "ScanIterator.h"
 
+#include <CentroidOptions.h>
 #include <CsvReader.h>
+#include <MzCalibrationOptions.h>
 #include <PMiTestUtils.h>
 #include <PmiMemoryInfo.h>
 #include <pmi_core_defs.h>
 
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QSqlRecord>
 #include <QtTest>
 
 // remote data filenames
@@ -31,22 +38,48 @@ public:
     }
 
 private Q_SLOTS:
+    void cleanup();
+
     void testFindFeaturesInSamples_data();
     void testFindFeaturesInSamples();
+    void testScanIteratorThreadCount();
+
+    // samples processed in parallel give the same features as samples processed one by one
+    void testThreadCount_data();
+    void testThreadCount();
+
+    void testSameFeaturesFilePath_data();
+    void testSameFeaturesFilePath();
 
 private:
     QDir m_testDataBasePath;
 };
 
+void MultiSampleScanFeatureFinderTest::cleanup()
+{
+    // testThreadCount changes the centroiding and the calibration of the singleton
+    MSReader::Instance()->clearCalibrationCentroidOptions();
+}
+
 void MultiSampleScanFeatureFinderTest::testFindFeaturesInSamples_data()
 {
     QTest::addColumn<QStringList>("vendorFilePaths");
     QTest::addColumn<QString>("expectedCsvFileName");
+    QTest::addColumn<int>("threadCount");
+    QTest::addColumn<qulonglong>("memoryLimit");
+
+    const QStringList avastinFilePaths({ m_testDataBasePath.filePath(DM_AvastinEu_IA_LysN),
+                                         m_testDataBasePath.filePath(DM_AvastinUS_IA_LysN) });
 
     QTest::newRow("MS_AVAS-2-samples")
-        << QStringList({ m_testDataBasePath.filePath(DM_AvastinEu_IA_LysN),
-                         m_testDataBasePath.filePath(DM_AvastinUS_IA_LysN) })
-        << QStringLiteral("MS-AVAS_MS-2-samples.csv");
+        << avastinFilePaths << QStringLiteral("MS-AVAS_MS-2-samples.csv") << 1 << qulonglong(0);
+
+    QTest::newRow("MS_AVAS-2-samples-parallel")
+        << avastinFilePaths << QStringLiteral("MS-AVAS_MS-2-samples.csv") << 2 << qulonglong(0);
+
+    // always over the limit, samples are processed one at a time
+    QTest::newRow("MS_AVAS-2-samples-memory-limit")
+        << avastinFilePaths << QStringLiteral("MS-AVAS_MS-2-samples.csv") << 2 << qulonglong(1);
 }
 
 QVector<SampleSearch> fromStringList(const QStringList &vendorFilePaths)
@@ -101,8 +134,13 @@ void MultiSampleScanFeatureFinderTest::testFindFeaturesInSamples()
     QString neuralNetworkDbFilePath = QDir(qApp->applicationDirPath()).filePath("nn_weights.db");
     QVERIFY(QFileInfo::exists(neuralNetworkDbFilePath));
 
+    QFETCH(int, threadCount);
+    QFETCH(qulonglong, memoryLimit);
+
     // here we go
     MultiSampleScanFeatureFinder finder(msFiles, neuralNetworkDbFilePath, ffUserParams);
+    finder.setThreadCount(threadCount);
+    finder.setMemoryLimit(memoryLimit);
 
     Err e = finder.init();
     if (e != kNoErr) {
@@ -116,6 +154,12 @@ void MultiSampleScanFeatureFinderTest::testFindFeaturesInSamples()
         QCOMPARE(e, kNoErr);
     }
 
+    const QVector<SampleStageTimings> timings = finder.sampleStageTimings();
+    QCOMPARE(timings.size(), msFiles.size());
+    for (int i = 0; i < msFiles.size(); ++i) {
+        QCOMPARE(timings.at(i).sampleFilePath, msFiles.at(i).sampleFilePath);
+    }
+
     // compare the CSV outputs
     QString actualCsvFilePath = finder.insilicoPeptideCsvFile();
     QVERIFY(QFileInfo(actualCsvFilePath).exists());
@@ -138,6 +182,210 @@ void MultiSampleScanFeatureFinderTest::testFindFeaturesInSamples()
     qDebug() << "Process peak memory" << pmi::MemoryInfo::peakProcessMemory();
 }
 
+static QList<QVariantList> readChargeClusters(const QString &ftrsFilePath)
+{
+    QList<QVariantList> result;
+    {
+        QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", "readChargeClusters");
+        db.setDatabaseName(ftrsFilePath);
+        if (!db.open()) {
+            qWarning() << "Cannot open file" << ftrsFilePath;
+        } else {
+            QSqlQuery q(db);
+            q.exec("SELECT * FROM ChargeClusters ORDER BY ID");
+            while (q.next()) {
+                QVariantList row;
+                for (int i = 0; i < q.record().count(); ++i) {
+                    row.push_back(q.value(i));
+                }
+                result.push_back(row);
+            }
+            db.close();
+        }
+    }
+    QSqlDatabase::removeDatabase("readChargeClusters");
+    return result;
+}
+
+void MultiSampleScanFeatureFinderTest::testScanIteratorThreadCount()
+{
+    const QString vendorFilePath = m_testDataBasePath.filePath(DM_AvastinEu_IA_LysN);
+    QVERIFY(QFileInfo::exists(vendorFilePath));
+
+    QString neuralNetworkDbFilePath = QDir(qApp->applicationDirPath()).filePath("nn_weights.db");
+    QVERIFY(QFileInfo::exists(neuralNetworkDbFilePath));
+
+    const QDir outputDir(QFile::decodeName(PMI_TEST_FILES_OUTPUT_DIR)
+                         + QStringLiteral("/MultiSampleScanFeatureFinderTest"));
+
+    // the scans analyzed in parallel are written in the same order as with one thread
+    QList<QList<QVariantList>> chargeClusters;
+    for (int threadCount : { 1, 4 }) {
+        const QDir workingDir(outputDir.filePath(QString("threads-%1").arg(threadCount)));
+        QVERIFY(workingDir.mkpath(workingDir.absolutePath()));
+
+        ScanIterator iterator(neuralNetworkDbFilePath, SettableFeatureFinderParameters());
+        iterator.setWorkingDirectory(workingDir);
+        iterator.setThreadCount(threadCount);
+        QCOMPARE(iterator.init(), kNoErr);
+
+        QString ftrsFilePath;
+        QCOMPARE(iterator.iterateMSFileLinearDBSCANSelect(vendorFilePath, &ftrsFilePath), kNoErr);
+
+        chargeClusters.push_back(readChargeClusters(ftrsFilePath));
+        QVERIFY(!chargeClusters.last().isEmpty());
+    }
+
+    QCOMPARE(chargeClusters.at(1).size(), chargeClusters.at(0).size());
+    QVERIFY(chargeClusters.at(1) == chargeClusters.at(0));
+}
+
+void MultiSampleScanFeatureFinderTest::testThreadCount_data()
+{
+    QTest::addColumn<bool>("customCentroiding");
+    QTest::addColumn<bool>("calibrated");
+
+    // profile scans centroided by MSReader instead of the vendor
+    QTest::newRow("profile") << true << false;
+    QTest::newRow("calibrated") << false << true;
+}
+
+void MultiSampleScanFeatureFinderTest::testThreadCount()
+{
+    QFETCH(bool, customCentroiding);
+    QFETCH(bool, calibrated);
+
+    const QStringList vendorFilePaths({ m_testDataBasePath.filePath(DM_AvastinEu_IA_LysN),
+                                        m_testDataBasePath.filePath(DM_AvastinUS_IA_LysN) });
+    const QVector<SampleSearch> msFiles = fromStringList(vendorFilePaths);
+    QCOMPARE(msFiles.size(), vendorFilePaths.size());
+
+    QString neuralNetworkDbFilePath = QDir(qApp->applicationDirPath()).filePath("nn_weights.db");
+    QVERIFY(QFileInfo::exists(neuralNetworkDbFilePath));
+
+    MSReader *ms = MSReader::Instance();
+    ms->clearCalibrationCentroidOptions();
+
+    if (customCentroiding) {
+        CentroidOptions centroidOptions;
+        centroidOptions.set(CentroidOptions::CentroidMethod_UseCustom,
+                            CentroidOptions::CentroidSmoothingType_Constant, 0.02, 1000);
+        ms->setCentroidOptions(centroidOptions);
+    }
+
+    if (calibrated) {
+        MzCalibrationOptions calibrationOptions;
+        calibrationOptions.lock_mass_list = "445.12003";
+        calibrationOptions.lock_mass_debug_output = 0;
+
+        bool changed = false;
+        for (int i = 0; i < msFiles.size(); ++i) {
+            QCOMPARE(ms->openFile(msFiles.at(i).sampleFilePath), kNoErr);
+            QList<msreader::ScanInfoWrapper> scanInfoList;
+            QCOMPARE(ms->getScanInfoListAtLevel(1, &scanInfoList), kNoErr);
+            QVERIFY(!scanInfoList.isEmpty());
+            const long scanNumber = scanInfoList.at(scanInfoList.size() / 2).scanNumber;
+
+            point2dList uncalibratedPoints;
+            QCOMPARE(ms->getScanData(scanNumber, &uncalibratedPoints, true), kNoErr);
+            QCOMPARE(ms->computeLockMass(i + 1, calibrationOptions), kNoErr);
+            point2dList calibratedPoints;
+            QCOMPARE(ms->getScanData(scanNumber, &calibratedPoints, true), kNoErr);
+            changed = changed || calibratedPoints != uncalibratedPoints;
+
+            ms->closeFile();
+        }
+
+        if (!changed) {
+            QSKIP("The lock mass calibration does not change the scans");
+        }
+    }
+
+    const QDir outputDir(QFile::decodeName(PMI_TEST_FILES_OUTPUT_DIR)
+                         + QStringLiteral("/MultiSampleScanFeatureFinderTest/")
+                         + QString::fromLatin1(QTest::currentDataTag()));
+
+    QList<QList<QStringList>> insilicoRows;
+    QList<QList<QList<QVariantList>>> chargeClusters;
+    for (int threadCount : { 1, 2 }) {
+        const QDir workingDir(outputDir.filePath(QString("threads-%1").arg(threadCount)));
+        QVERIFY(workingDir.mkpath(workingDir.absolutePath()));
+
+        MultiSampleScanFeatureFinder finder(msFiles, neuralNetworkDbFilePath,
+                                            SettableFeatureFinderParameters());
+        finder.setWorkingDirectory(workingDir);
+        finder.setThreadCount(threadCount);
+        QCOMPARE(finder.init(), kNoErr);
+
+        const Err e = finder.findFeatures();
+        if (e != kNoErr) {
+            qDebug() << finder.errorMessage();
+            QCOMPARE(e, kNoErr);
+        }
+
+        QList<QList<QVariantList>> sampleChargeClusters;
+        for (const SampleSearch &item : msFiles) {
+            const QString ftrsFilePath = workingDir.filePath(
+                QFileInfo(item.sampleFilePath).completeBaseName() + QStringLiteral(".ftrs"));
+            sampleChargeClusters.push_back(readChargeClusters(ftrsFilePath));
+            QVERIFY(!sampleChargeClusters.last().isEmpty());
+        }
+        chargeClusters.push_back(sampleChargeClusters);
+
+        insilicoRows.push_back(fromCsvFile(finder.insilicoPeptideCsvFile()));
+        QVERIFY(!insilicoRows.last().isEmpty());
+    }
+
+    for (int i = 0; i < msFiles.size(); ++i) {
+        QCOMPARE(chargeClusters.at(1).at(i).size(), chargeClusters.at(0).at(i).size());
+        QVERIFY(chargeClusters.at(1).at(i) == chargeClusters.at(0).at(i));
+    }
+    QCOMPARE(insilicoRows.at(1), insilicoRows.at(0));
+}
+
+void MultiSampleScanFeatureFinderTest::testSameFeaturesFilePath_data()
+{
+    QTest::addColumn<int>("threadCount");
+
+    QTest::newRow("serial") << 1;
+    QTest::newRow("parallel") << 2;
+}
+
+void MultiSampleScanFeatureFinderTest::testSameFeaturesFilePath()
+{
+    QFETCH(int, threadCount);
+
+    QString neuralNetworkDbFilePath = QDir(qApp->applicationDirPath()).filePath("nn_weights.db");
+    QVERIFY(QFileInfo::exists(neuralNetworkDbFilePath));
+
+    const QDir outputDir(QFile::decodeName(PMI_TEST_FILES_OUTPUT_DIR)
+                         + QStringLiteral("/MultiSampleScanFeatureFinderTest")
+                         + QStringLiteral("/SameFeaturesFilePath"));
+
+    // samples are not read, the file paths are checked before
+    QVector<SampleSearch> msFiles;
+    for (const QString &folder : { QStringLiteral("a"), QStringLiteral("b") }) {
+        QVERIFY(outputDir.mkpath(folder));
+        QFile file(QDir(outputDir.filePath(folder)).filePath(QStringLiteral("sample.raw")));
+        QVERIFY(file.open(QIODevice::WriteOnly));
+        file.close();
+
+        SampleSearch item;
+        item.sampleFilePath = file.fileName();
+        msFiles.push_back(item);
+    }
+
+    MultiSampleScanFeatureFinder finder(msFiles, neuralNetworkDbFilePath,
+                                        SettableFeatureFinderParameters());
+    finder.setWorkingDirectory(outputDir);
+    finder.setThreadCount(threadCount);
+    QCOMPARE(finder.init(), kNoErr);
+
+    QCOMPARE(finder.findFeatures(), kBadParameterError);
+    QVERIFY(finder.errorMessage().contains(QStringLiteral("sample.ftrs")));
+    QVERIFY(!QFileInfo::exists(outputDir.filePath(QStringLiteral("sample.ftrs"))));
+}
+
 _PMI_END
 
 PMI_TEST_GUILESS_MAIN_WITH_ARGS(pmi::MultiSampleScanFeatureFinderTest,
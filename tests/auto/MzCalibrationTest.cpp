@@ -8,6 +8,7 @@
 #include <MzCalibration.h>
 
 #include <CacheFileManager.h>
+#include <MSReader.h>
 #include <PMiTestUtils.h>
 
 #include <pmi_core_defs.h>
@@ -65,8 +66,24 @@ private Q_SLOTS:
     void testReadFromDB();
     void testWriteToDBFile();
     void testWriteToDBSqlite();
+    void testScanCalibration();
+
+    // coefficients are the same for any number of threads finding lock mass peaks
+    void testThreadCount_data();
+    void testThreadCount();
+
+    // one iteration calibrates SCAN_COUNT scans
+    void benchmarkCalibrate_data();
+    void benchmarkCalibrate();
+
+    // one iteration opens the file and finds the lock mass peaks of all its calibration scans
+    void benchmarkComputeCoefficients_data();
+    void benchmarkComputeCoefficients();
+
 private:
     void readFromDB(const QString &filename, MzCalibration *cal, bool *ok);
+    Err computeCoefficients(bool fromScanList, int threadCount, MzCalibration *cal) const;
+    static point2dList createScan(int pointCount, int seed);
 
 private:
     const QString m_fname;
@@ -181,6 +198,200 @@ void MzCalibrationTest::testWriteToDBSqlite()
     QCOMPARE(sqlite3_close(db), SQLITE_OK);
 }
 
+static const int SCAN_COUNT = 100;
+
+void MzCalibrationTest::testScanCalibration()
+{
+    QList<MzCalibration> calibrations;
+
+    MzCalibration preview;
+    preview.setupPreviewCoeffs(1e-3, -2e-6, 3e-10);
+    calibrations.push_back(preview);
+
+    if (m_isValid) {
+        MzCalibration cal(*m_cacheFileManager.data());
+        QCOMPARE(cal.readFromDB(m_fname, 1), kNoErr);
+        calibrations.push_back(cal);
+    }
+
+    QVERIFY(MzCalibration().scanCalibration(1.0).isIdentity());
+
+    for (const MzCalibration &cal : calibrations) {
+        for (double time : { -1.0, 0.0, 0.5, 12.3, 60.0, 1e4 }) {
+            point2dList scan = createScan(1000, static_cast<int>(time));
+            // not calibrated
+            scan[0].rx() = 0.0;
+            scan[1].rx() = -1.0;
+
+            std::vector<double> mz;
+            for (const point2d &p : scan) {
+                mz.push_back(p.x());
+            }
+
+            const MzScanCalibration scanCalibration = cal.scanCalibration(time);
+            point2dList calibrated = scan;
+            scanCalibration.apply(calibrated);
+            scanCalibration.apply(mz.data(), static_cast<int>(mz.size()));
+
+            // same values as point by point calibration
+            for (size_t i = 0; i < scan.size(); ++i) {
+                const double expected = cal.calibrate(scan[i].x(), time);
+                QVERIFY(calibrated[i].x() == expected);
+                QVERIFY(calibrated[i].y() == scan[i].y());
+                QVERIFY(mz[i] == expected);
+            }
+        }
+    }
+}
+
+Err MzCalibrationTest::computeCoefficients(bool fromScanList, int threadCount,
+                                           MzCalibration *cal) const
+{
+    Err e = kNoErr;
+
+    // lock mass options stored with the calibration of the file
+    MzCalibration stored(*m_cacheFileManager.data());
+    e = stored.readFromDB(m_fname, 1); ree;
+    cal->setup(stored.options());
+    cal->setThreadCount(threadCount);
+
+    if (!fromScanList) {
+        return cal->computeCoefficientsFromByspec(m_fname);
+    }
+
+#ifdef PMI_MS_MZCALIBRATION_USE_MSREADER_TO_READ
+    MSReader *reader = MSReader::Instance();
+    e = reader->openFile(m_fname); ree;
+
+    QList<msreader::ScanInfoWrapper> scans;
+    e = reader->getLockmassScans(&scans);
+    if (e == kNoErr) {
+        e = cal->computeCoefficientsFromScanList(reader, scans);
+    }
+    reader->closeFile();
+#endif
+    return e;
+}
+
+void MzCalibrationTest::testThreadCount_data()
+{
+    QTest::addColumn<bool>("fromScanList");
+
+    QTest::newRow("byspecDB") << false;
+#ifdef PMI_MS_MZCALIBRATION_USE_MSREADER_TO_READ
+    QTest::newRow("scanList") << true;
+#endif
+}
+
+void MzCalibrationTest::testThreadCount()
+{
+    QFETCH(bool, fromScanList);
+
+    if (!m_isValid) {
+        QSKIP("Calibration of the file is needed");
+    }
+
+    MzCalibration serial(*m_cacheFileManager.data());
+    QCOMPARE(computeCoefficients(fromScanList, 1, &serial), kNoErr);
+
+    for (int threadCount : { 2, 4, 0 }) {
+        MzCalibration parallel(*m_cacheFileManager.data());
+        QCOMPARE(computeCoefficients(fromScanList, threadCount, &parallel), kNoErr);
+
+        const QList<PlotBase> &expected = serial.coefficientPlots();
+        const QList<PlotBase> &actual = parallel.coefficientPlots();
+        QCOMPARE(actual.size(), expected.size());
+        for (int i = 0; i < expected.size(); ++i) {
+            const point2dList &expectedPoints = expected[i].getPointList();
+            const point2dList &actualPoints = actual[i].getPointList();
+            QCOMPARE(actualPoints.size(), expectedPoints.size());
+            // QPointF compares fuzzily
+            for (size_t j = 0; j < expectedPoints.size(); ++j) {
+                QVERIFY(actualPoints[j].x() == expectedPoints[j].x());
+                QVERIFY(actualPoints[j].y() == expectedPoints[j].y());
+            }
+        }
+    }
+}
+
+void MzCalibrationTest::benchmarkCalibrate_data()
+{
+    QTest::addColumn<bool>("perPoint");
+
+    QTest::newRow("perPoint") << true;
+    QTest::newRow("perScan") << false;
+}
+
+void MzCalibrationTest::benchmarkCalibrate()
+{
+    QFETCH(bool, perPoint);
+
+    if (!m_isValid) {
+        QSKIP("Calibration of the file is needed");
+    }
+
+    MzCalibration cal(*m_cacheFileManager.data());
+    QCOMPARE(cal.readFromDB(m_fname, 1), kNoErr);
+
+    QVector<point2dList> scans;
+    for (int i = 0; i < SCAN_COUNT; ++i) {
+        scans.push_back(createScan(20000, i));
+    }
+
+    QBENCHMARK {
+        for (int i = 0; i < scans.size(); ++i) {
+            point2dList &scan = scans[i];
+            const double time = i * 0.5;
+            if (perPoint) {
+                for (point2d &p : scan) {
+                    p.rx() = cal.calibrate(p.x(), time);
+                }
+            } else {
+                cal.calibrate(time, scan);
+            }
+        }
+    }
+}
+
+void MzCalibrationTest::benchmarkComputeCoefficients_data()
+{
+    QTest::addColumn<bool>("fromScanList");
+    QTest::addColumn<int>("threadCount");
+
+    for (int threadCount : { 1, 0 }) {
+        QTest::newRow(qPrintable(QString("byspecDB_threads%1").arg(threadCount)))
+            << false << threadCount;
+#ifdef PMI_MS_MZCALIBRATION_USE_MSREADER_TO_READ
+        QTest::newRow(qPrintable(QString("scanList_threads%1").arg(threadCount)))
+            << true << threadCount;
+#endif
+    }
+}
+
+void MzCalibrationTest::benchmarkComputeCoefficients()
+{
+    QFETCH(bool, fromScanList);
+    QFETCH(int, threadCount);
+
+    if (!m_isValid) {
+        QSKIP("Calibration of the file is needed");
+    }
+
+    QBENCHMARK {
+        MzCalibration cal(*m_cacheFileManager.data());
+        QCOMPARE(computeCoefficients(fromScanList, threadCount, &cal), kNoErr);
+    }
+}
+
+point2dList MzCalibrationTest::createScan(int pointCount, int seed)
+{
+    point2dList points;
+    for (int i = 0; i < pointCount; ++i) {
+        points.push_back(point2d(300.0 + seed + i * 0.0937, (i * 7919 + seed) % 1000));
+    }
+    return points;
+}
+
 _PMI_END
 
 PMI_TEST_GUILESS_MAIN_WITH_ARGS(pmi::MzCalibrationTest, QStringList() << "file.byspec2" << "valid[0|1]")
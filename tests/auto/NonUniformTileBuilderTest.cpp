@@ -12,6 +12,7 @@
 #include "NonUniformTileStoreSqlite.h"
 #include "db\NonUniformTilesInfoDao.h"
 #include <PmiQtStablesConstants.h>
+#include "QtSqlUtils.h"
 
 _PMI_BEGIN
 
@@ -25,7 +26,9 @@ private Q_SLOTS:
     void testBuildNonUniformTiles();
 
     void testBuildNonUniformTilesNG();
-
+    void testBuildNonUniformTilesParallel();
+    void benchmarkBuildNonUniformTilesParallel_data();
+    void benchmarkBuildNonUniformTilesParallel();
 
     void testTileContentBorderValues();
 
@@ -46,6 +49,65 @@ private:
     ComInitializer comInitializer;
 };
 
+static NonUniformTileRange createNGTestRange()
+{
+    NonUniformTileRange range;
+    // we are using usually minium and maximum mz found in the input MS file (*.raw)
+    range.setMz(380.001, 1706.6299979999999);
+    range.setMzTileLength(2.95);
+
+    range.setScanIndex(0, 63);
+    range.setScanIndexLength(4);
+    return range;
+}
+
+//! \brief creates new tile database in TileBuilderTest output folder
+static Err createTileDatabase(const QString &fileName, const NonUniformTileRange &range,
+                              QSqlDatabase *db)
+{
+    QString dbFilePath = QDir(QFile::decodeName(PMI_TEST_FILES_OUTPUT_DIR "/TileBuilderTest/")).filePath(fileName);
+    if (QFileInfo(dbFilePath).exists() && !QFile::remove(dbFilePath)) {
+        return kFileOpenError;
+    }
+
+    static int instances = 0;
+    *db = QSqlDatabase::addDatabase(kQSQLITE, QString("NonUniformTileBuilderTest_db_%1").arg(instances++));
+    db->setDatabaseName(dbFilePath);
+    if (!db->open()) {
+        qWarning() << "Could not open db file:" << dbFilePath;
+        return kFileOpenError;
+    }
+
+    NonUniformTilesInfoDao rangeDao(db);
+    Err e = rangeDao.createTable(); ree;
+    e = rangeDao.save(range); ree;
+    return e;
+}
+
+//! \brief all stored tiles as they are in the database, sorted by position and content
+static QStringList tileBlobs(QSqlDatabase *db)
+{
+    QStringList result;
+    QSqlQuery q = makeQuery(db, true);
+    if (!q.exec(QStringLiteral("SELECT PositionX, PositionY, ContentType, PointCount, Indexes, Mz, Intensity "
+                               "FROM NonUniformTiles ORDER BY PositionY, PositionX, ContentType;"))) {
+        qWarning() << q.lastError();
+        return result;
+    }
+
+    while (q.next()) {
+        result.push_back(QString("%1 %2 %3 %4 %5 %6 %7")
+                             .arg(q.value(0).toInt())
+                             .arg(q.value(1).toInt())
+                             .arg(q.value(2).toString())
+                             .arg(q.value(3).toInt())
+                             .arg(QString::fromLatin1(q.value(4).toByteArray().toHex()))
+                             .arg(QString::fromLatin1(q.value(5).toByteArray().toHex()))
+                             .arg(QString::fromLatin1(q.value(6).toByteArray().toHex())));
+    }
+    return result;
+}
+
 void NonUniformTileBuilderTest::testBuildNonUniformTiles()
 {
     QDir testDataBasePath = QDir(QFile::decodeName(PMI_TEST_FILES_OUTPUT_DIR "/TileBuilderTest/remoteData/"));
@@ -126,6 +188,97 @@ void NonUniformTileBuilderTest::testBuildNonUniformTilesNG()
     
 }
 
+void NonUniformTileBuilderTest::testBuildNonUniformTilesParallel()
+{
+    QDir testDataBasePath = QDir(QFile::decodeName(PMI_TEST_FILES_OUTPUT_DIR "/TileBuilderTest/remoteData/"));
+
+    QString rawFilePath = testDataBasePath.filePath(CONA_RAW);
+    QVERIFY(QFileInfo(rawFilePath).isReadable());
+
+    MSReader * reader = initReader();
+    QCOMPARE(reader->openFile(rawFilePath), kNoErr);
+    ScanIndexNumberConverter converter = ScanIndexNumberConverter::fromMSReader(reader);
+
+    const NonUniformTileRange range = createNGTestRange();
+
+    for (NonUniformTileStore::ContentType type : { NonUniformTileStore::ContentMS1Raw, NonUniformTileStore::ContentMS1Centroided }) {
+        QSqlDatabase serialDb;
+        QCOMPARE(createTileDatabase("TilesSerial.db3", range, &serialDb), kNoErr);
+        NonUniformTileStoreSqlite serialStore(&serialDb);
+        QVERIFY(serialStore.init());
+        serialStore.setEncoding(NonUniformTilesEncoding::compact());
+
+        QSqlDatabase parallelDb;
+        QCOMPARE(createTileDatabase("TilesParallel.db3", range, &parallelDb), kNoErr);
+        NonUniformTileStoreSqlite parallelStore(&parallelDb);
+        QVERIFY(parallelStore.init());
+        parallelStore.setEncoding(NonUniformTilesEncoding::compact());
+
+        NonUniformTileBuilder serialBuilder(range);
+        serialBuilder.buildNonUniformTilesNG(reader, converter, &serialStore, type);
+
+        NonUniformTileBuilder parallelBuilder(range);
+        parallelBuilder.setThreadCount(4);
+        parallelBuilder.buildNonUniformTilesParallel(reader, converter, &parallelStore, type);
+
+        // every tile of the range is built, with the same bytes as the serial builder wrote
+        const QStringList expected = tileBlobs(&serialDb);
+        QCOMPARE(expected.size(), range.tileCountX() * range.tileCountY());
+        const QStringList actual = tileBlobs(&parallelDb);
+        QCOMPARE(actual.size(), expected.size());
+        for (int i = 0; i < expected.size(); ++i) {
+            QVERIFY2(actual.at(i) == expected.at(i), qPrintable(expected.at(i).left(40)));
+        }
+
+        serialDb.close();
+        parallelDb.close();
+    }
+}
+
+void NonUniformTileBuilderTest::benchmarkBuildNonUniformTilesParallel_data()
+{
+    QTest::addColumn<int>("threadCount");
+
+    // one thread is the serial builder
+    QTest::newRow("1") << 1;
+    QTest::newRow("2") << 2;
+    QTest::newRow("4") << 4;
+    QTest::newRow("8") << 8;
+}
+
+void NonUniformTileBuilderTest::benchmarkBuildNonUniformTilesParallel()
+{
+    QFETCH(int, threadCount);
+
+    QDir testDataBasePath = QDir(QFile::decodeName(PMI_TEST_FILES_OUTPUT_DIR "/TileBuilderTest/remoteData/"));
+
+    QString rawFilePath = testDataBasePath.filePath(CONA_RAW);
+    QVERIFY(QFileInfo(rawFilePath).isReadable());
+
+    MSReader * reader = initReader();
+    QCOMPARE(reader->openFile(rawFilePath), kNoErr);
+    ScanIndexNumberConverter converter = ScanIndexNumberConverter::fromMSReader(reader);
+
+    const NonUniformTileRange range = createNGTestRange();
+    const NonUniformTileStore::ContentType type = NonUniformTileStore::ContentMS1Centroided;
+
+    QSqlDatabase db;
+    QCOMPARE(createTileDatabase(QString("TilesBenchmark_%1.db3").arg(threadCount), range, &db), kNoErr);
+    NonUniformTileStoreSqlite store(&db);
+    QVERIFY(store.init());
+
+    NonUniformTileBuilder builder(range);
+    builder.setThreadCount(threadCount);
+
+    // tiles can be inserted just once
+    QBENCHMARK_ONCE {
+        builder.buildNonUniformTilesParallel(reader, converter, &store, type);
+    }
+
+    QCOMPARE(store.count(type), range.tileCountX() * range.tileCountY());
+    db.close();
+}
+
 void NonUniformTileBuilderTest::testTileContentBorderValues()
 {
     NonUniformTileRange range;
@@ -0,0 +1,662 @@
+/*
+ * Copyright (C) 2019 Protein Metrics Inc. - All Rights Reserved.
+ * Unauthorized copying or distribution of this file, via any medium is strictly prohibited.
+ * Confidential.
+ */
+
+#include "PicoDecodeKernels.h"
+#include "PicoLocalCompress.h"
+#include "PicoLocalDecompress.h"
+
+#include <pmi_core_defs.h>
+
+#include <QtTest>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+
+_PMI_BEGIN
+
+// Type0 is not covered, its compressor frees the output and can't be used to produce test data
+enum PicoType { PicoType02, PicoTypeCentroided1, PicoType4, PicoTypeWaters1_N };
+
+// blobs kept in the test data
+enum StoredBlobType { StoredWatersType1_N, StoredCentroidedType1, StoredType1 };
+
+struct CompressedScan
+{
+    QByteArray mz;
+    QByteArray intensity;
+};
+
+struct DecodedScan
+{
+    std::vector<double> mz;
+    std::vector<float> intensity;
+};
+
+class PicoLocalDecompressTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    // buffer decoders output the same points as the malloc'ed ones
+    void testBufferMatchesLegacy_data();
+    void testBufferMatchesLegacy();
+
+    // a reused buffer does not keep points of the previous scan
+    void testBufferReuse_data();
+    void testBufferReuse();
+
+    // decoders return the same points as the decoders before vectorization did for the blobs in
+    // the test data
+    void testMatchesStoredPoints_data();
+    void testMatchesStoredPoints();
+
+    // scans per second: one iteration decodes SCAN_COUNT scans
+    void benchmarkDecompress_data();
+    void benchmarkDecompress();
+
+    // every instruction set decodes Waters m/z codes bit exact to decodeAndCalibrateMzType1()
+    void testDecodeMzKernel_data();
+    void testDecodeMzKernel();
+
+    // every instruction set evaluates the centroided m/z polynomial bit exact
+    void testCentroidedMzKernel_data();
+    void testCentroidedMzKernel();
+
+    // codes per second: one iteration decodes KERNEL_CODE_COUNT codes, the throughput is logged
+    // in MB/s of decoded m/z
+    void benchmarkDecodeMzKernel_data();
+    void benchmarkDecodeMzKernel();
+
+private:
+    static void addTypeColumns();
+    static CompressedScan compress(PicoType type, int pointCount);
+    static bool decompressLegacy(PicoType type, const CompressedScan &scan, DecodedScan *decoded);
+    static bool decompressBuffer(PicoType type, const CompressedScan &scan,
+                                 pico::DecompressBuffer *buffer);
+    static void addIsaRows(const QString &name);
+    static QByteArray readTestData(const QString &fileName);
+    static std::vector<unsigned int> mzCodes();
+    static std::vector<double> calibration(int calibrationCount);
+    static pico::WatersCalibration::Coefficents calibrationModification(int type);
+};
+
+static const int SCAN_COUNT = 100;
+static const int POINT_COUNT = 20000;
+static const int CENTROID_COUNT = 2000;
+static const int KERNEL_CODE_COUNT = 100000;
+
+void PicoLocalDecompressTest::addTypeColumns()
+{
+    QTest::addColumn<int>("type");
+    QTest::addColumn<int>("pointCount");
+
+    QTest::newRow("Type02") << int(PicoType02) << POINT_COUNT;
+    QTest::newRow("CentroidedType1") << int(PicoTypeCentroided1) << CENTROID_COUNT;
+    QTest::newRow("Type4") << int(PicoType4) << POINT_COUNT;
+    QTest::newRow("WatersType1_N") << int(PicoTypeWaters1_N) << POINT_COUNT;
+}
+
+void PicoLocalDecompressTest::testBufferMatchesLegacy_data()
+{
+    addTypeColumns();
+}
+
+void PicoLocalDecompressTest::testBufferMatchesLegacy()
+{
+    QFETCH(int, type);
+    QFETCH(int, pointCount);
+
+    const CompressedScan scan = compress(PicoType(type), pointCount);
+    QVERIFY(!scan.mz.isEmpty());
+
+    DecodedScan expected;
+    QVERIFY(decompressLegacy(PicoType(type), scan, &expected));
+    QVERIFY(!expected.mz.empty());
+
+    pico::DecompressBuffer buffer;
+    QVERIFY(decompressBuffer(PicoType(type), scan, &buffer));
+    QCOMPARE(buffer.length(), int(expected.mz.size()));
+    QVERIFY(buffer.capacity() >= expected.mz.size());
+    QVERIFY(std::equal(expected.mz.begin(), expected.mz.end(), buffer.mz()));
+    QVERIFY(std::equal(expected.intensity.begin(), expected.intensity.end(), buffer.intensity()));
+}
+
+void PicoLocalDecompressTest::testBufferReuse_data()
+{
+    addTypeColumns();
+}
+
+void PicoLocalDecompressTest::testBufferReuse()
+{
+    QFETCH(int, type);
+    QFETCH(int, pointCount);
+
+    const CompressedScan large = compress(PicoType(type), pointCount);
+    const CompressedScan small = compress(PicoType(type), pointCount / 4);
+
+    DecodedScan expected;
+    QVERIFY(decompressLegacy(PicoType(type), small, &expected));
+
+    pico::DecompressBuffer buffer;
+    QVERIFY(decompressBuffer(PicoType(type), large, &buffer));
+    const size_t capacity = buffer.capacity();
+    QVERIFY(decompressBuffer(PicoType(type), small, &buffer));
+
+    QCOMPARE(buffer.length(), int(expected.mz.size()));
+    QVERIFY(buffer.capacity() >= capacity);
+    QVERIFY(std::equal(expected.mz.begin(), expected.mz.end(), buffer.mz()));
+    QVERIFY(std::equal(expected.intensity.begin(), expected.intensity.end(), buffer.intensity()));
+}
+
+void PicoLocalDecompressTest::testMatchesStoredPoints_data()
+{
+    QTest::addColumn<int>("type");
+    QTest::addColumn<QString>("blob");
+    QTest::addColumn<QString>("points");
+    QTest::addColumn<int>("modificationType");
+    QTest::addColumn<bool>("restoreZeroPeaks");
+
+    // the Waters blobs cover the 512 m/z code range boundary, the short one is not compressed
+    const QList<QPair<QString, int>> watersBlobs = {
+        qMakePair(QString("WatersType1_N"), int(pico::WatersCalibration::CoefficentsType_None)),
+        qMakePair(QString("WatersType1_N_calibrated"),
+                  int(pico::WatersCalibration::CoefficentsType_T1)),
+        qMakePair(QString("WatersType1_N_sqd"), int(pico::WatersCalibration::CoefficentsType_T0)),
+        qMakePair(QString("WatersType1_N_short"), int(pico::WatersCalibration::CoefficentsType_T1)),
+    };
+    for (const auto &blob : watersBlobs) {
+        QTest::newRow(qPrintable(blob.first + " decoded"))
+            << int(StoredWatersType1_N) << blob.first << blob.first + ".decoded" << blob.second
+            << false;
+        QTest::newRow(qPrintable(blob.first + " restored"))
+            << int(StoredWatersType1_N) << blob.first << blob.first + ".restored" << blob.second
+            << true;
+    }
+    QTest::newRow("CentroidedType1")
+        << int(StoredCentroidedType1) << QString("CentroidedType1") << QString("CentroidedType1")
+        << int(pico::WatersCalibration::CoefficentsType_None) << false;
+    QTest::newRow("Type1") << int(StoredType1) << QString("Type1") << QString("Type1")
+                           << int(pico::WatersCalibration::CoefficentsType_None) << false;
+}
+
+// The stored points were written by the decoders before the m/z decoding was vectorized and the
+// dictionaries became vectors, for blobs written by PicoLocalCompress. A Waters blob holds both m/z
+// and intensity, the other types keep them in <blob>.mz.blob and <blob>.intensity.blob.
+void PicoLocalDecompressTest::testMatchesStoredPoints()
+{
+    QFETCH(int, type);
+    QFETCH(QString, blob);
+    QFETCH(QString, points);
+    QFETCH(int, modificationType);
+    QFETCH(bool, restoreZeroPeaks);
+
+    const QByteArray mzBlob
+        = readTestData(blob + (type == StoredWatersType1_N ? ".blob" : ".mz.blob"));
+    const QByteArray intensityBlob
+        = type == StoredWatersType1_N ? QByteArray() : readTestData(blob + ".intensity.blob");
+    const QByteArray expectedMz = readTestData(points + ".mz");
+    const QByteArray expectedIntensity = readTestData(points + ".intensity");
+    QVERIFY(!mzBlob.isEmpty());
+    QVERIFY(!expectedMz.isEmpty());
+
+    const pico::PicoLocalDecompress decompressor;
+    const unsigned char *compressedMz = reinterpret_cast<const unsigned char *>(mzBlob.constData());
+    const unsigned char *compressedIntensity
+        = reinterpret_cast<const unsigned char *>(intensityBlob.constData());
+    QByteArray mz;
+    QByteArray intensity;
+    switch (type) {
+    case StoredWatersType1_N:
+    case StoredCentroidedType1: {
+        pico::DecompressBuffer buffer;
+        if (type == StoredWatersType1_N) {
+            const pico::WatersCalibration::Coefficents modification
+                = calibrationModification(modificationType);
+            QVERIFY(decompressor.decompressRawType1_N(compressedMz, &modification, &buffer,
+                                                      restoreZeroPeaks));
+        } else {
+            QVERIFY(decompressor.decompressSpectraCentroidedType1(compressedMz, compressedIntensity,
+                                                                  &buffer));
+        }
+        mz = QByteArray(reinterpret_cast<const char *>(buffer.mz()),
+                        buffer.length() * int(sizeof(double)));
+        intensity = QByteArray(reinterpret_cast<const char *>(buffer.intensity()),
+                               buffer.length() * int(sizeof(float)));
+        break;
+    }
+    case StoredType1: {
+        // the decoders of the Type1 file conversion only
+        unsigned char *mzData = const_cast<unsigned char *>(compressedMz);
+        unsigned char *intensityData = const_cast<unsigned char *>(compressedIntensity);
+        double *restoredMz = nullptr;
+        float *restoredIntensity = nullptr;
+        int mzLength = 0;
+        int intensityLength = 0;
+        const bool ok = decompressor.decompressMzType1(&mzData, &restoredMz, &mzLength)
+            && decompressor.decompressIntensityType1(&intensityData, &restoredIntensity,
+                                                     &intensityLength);
+        if (ok) {
+            mz = QByteArray(reinterpret_cast<const char *>(restoredMz),
+                            mzLength * int(sizeof(double)));
+            intensity = QByteArray(reinterpret_cast<const char *>(restoredIntensity),
+                                   intensityLength * int(sizeof(float)));
+        }
+        free(restoredMz);
+        free(restoredIntensity);
+        QVERIFY(ok);
+        break;
+    }
+    }
+
+    QCOMPARE(mz.size(), expectedMz.size());
+    QVERIFY(mz == expectedMz);
+    QCOMPARE(intensity.size(), expectedIntensity.size());
+    QVERIFY(intensity == expectedIntensity);
+}
+
+void PicoLocalDecompressTest::benchmarkDecompress_data()
+{
+    QTest::addColumn<int>("type");
+    QTest::addColumn<int>("pointCount");
+    QTest::addColumn<bool>("useBuffer");
+
+    const QList<QPair<QString, PicoType>> types = {
+        qMakePair(QString("Type02"), PicoType02),
+        qMakePair(QString("CentroidedType1"), PicoTypeCentroided1),
+        qMakePair(QString("Type4"), PicoType4),
+        qMakePair(QString("WatersType1_N"), PicoTypeWaters1_N),
+    };
+    for (const auto &type : types) {
+        const int pointCount = type.second == PicoTypeCentroided1 ? CENTROID_COUNT : POINT_COUNT;
+        QTest::newRow(qPrintable(type.first + " malloc")) << int(type.second) << pointCount << false;
+        QTest::newRow(qPrintable(type.first + " buffer")) << int(type.second) << pointCount << true;
+    }
+}
+
+void PicoLocalDecompressTest::benchmarkDecompress()
+{
+    QFETCH(int, type);
+    QFETCH(int, pointCount);
+    QFETCH(bool, useBuffer);
+
+    const CompressedScan scan = compress(PicoType(type), pointCount);
+    pico::DecompressBuffer buffer;
+    DecodedScan decoded;
+
+    QBENCHMARK {
+        for (int i = 0; i < SCAN_COUNT; ++i) {
+            if (useBuffer) {
+                QVERIFY(decompressBuffer(PicoType(type), scan, &buffer));
+            } else {
+                QVERIFY(decompressLegacy(PicoType(type), scan, &decoded));
+            }
+        }
+    }
+}
+
+void PicoLocalDecompressTest::testDecodeMzKernel_data()
+{
+    QTest::addColumn<int>("isa");
+    QTest::addColumn<int>("calibrationCount");
+    QTest::addColumn<int>("modificationType");
+
+    const QList<QPair<QString, int>> calibrations
+        = { qMakePair(QString("uncalibrated"), 0), qMakePair(QString("SQD"), 5),
+            qMakePair(QString("calibrated"), 6) };
+    const QList<QPair<QString, int>> modifications
+        = { qMakePair(QString("no cal_mod"), -1),
+            qMakePair(QString("cal_mod T0"), int(pico::WatersCalibration::CoefficentsType_T0)),
+            qMakePair(QString("cal_mod T1"), int(pico::WatersCalibration::CoefficentsType_T1)),
+            qMakePair(QString("cal_mod None"),
+                      int(pico::WatersCalibration::CoefficentsType_None)) };
+    for (int isa = pico::DecodeKernelSse2; isa <= pico::DecodeKernelAvx; ++isa) {
+        const QString isaName = isa == pico::DecodeKernelAvx ? "AVX" : "SSE2";
+        for (const auto &calibration : calibrations) {
+            for (const auto &modification : modifications) {
+                const QString name = isaName + " " + calibration.first + " " + modification.first;
+                QTest::newRow(qPrintable(name)) << isa << calibration.second << modification.second;
+            }
+        }
+    }
+}
+
+void PicoLocalDecompressTest::testDecodeMzKernel()
+{
+    QFETCH(int, isa);
+    QFETCH(int, calibrationCount);
+    QFETCH(int, modificationType);
+
+    if (isa > pico::supportedDecodeKernelIsa()) {
+        QSKIP("instruction set not supported by this cpu");
+    }
+
+    const pico::PicoLocalDecompress decompressor;
+    const std::vector<unsigned int> codes = mzCodes();
+    const std::vector<double> calib = calibration(calibrationCount);
+    const pico::WatersCalibration::Coefficents modification
+        = calibrationModification(modificationType);
+    const pico::WatersCalibration::Coefficents *calMod = modificationType < 0 ? nullptr : &modification;
+
+    // odd lengths cover the tails shorter than a vector
+    for (size_t count : { codes.size(), size_t(1), size_t(3), size_t(7) }) {
+        std::vector<double> decoded(codes.begin(), codes.begin() + count);
+        QVERIFY(pico::decodeAndCalibrateMzType1Kernel(decoded.data(), count, calib, calMod,
+                                                      decoded.data(), pico::DecodeKernelIsa(isa)));
+        for (size_t i = 0; i < count; ++i) {
+            const double expected = decompressor.decodeAndCalibrateMzType1(codes[i], calib, calMod);
+            if (std::memcmp(&expected, &decoded[i], sizeof(double)) != 0) {
+                QFAIL(qPrintable(QString("code 0x%1 decoded to %2 instead of %3")
+                                     .arg(codes[i], 0, 16)
+                                     .arg(decoded[i], 0, 'g', 17)
+                                     .arg(expected, 0, 'g', 17)));
+            }
+        }
+    }
+}
+
+void PicoLocalDecompressTest::testCentroidedMzKernel_data()
+{
+    addIsaRows(QString());
+}
+
+void PicoLocalDecompressTest::testCentroidedMzKernel()
+{
+    QFETCH(int, isa);
+
+    if (isa > pico::supportedDecodeKernelIsa()) {
+        QSKIP("instruction set not supported by this cpu");
+    }
+
+    const double aa = 1.3e-28;
+    const double bb = -2.1e-19;
+    const double cc = 3.7e-9;
+    const double dd = 101.5;
+    std::mt19937 random(7);
+    std::vector<double> values;
+    for (int i = 0; i < KERNEL_CODE_COUNT + 3; ++i) {
+        values.push_back(double(random() >> (i % 32)));
+    }
+
+    std::vector<double> evaluated(values.size());
+    pico::centroidedMzType1Kernel(values.data(), values.size(), aa, bb, cc, dd, evaluated.data(),
+                                  pico::DecodeKernelIsa(isa));
+    for (size_t i = 0; i < values.size(); ++i) {
+        // decompressMzCentroidedType1() before it used the kernel
+        const unsigned int cur = static_cast<unsigned int>(values[i]);
+        const double k2 = (double)cur * cur;
+        const double expected = aa * cur * k2 + bb * k2 + cc * cur + dd;
+        QVERIFY(std::memcmp(&expected, &evaluated[i], sizeof(double)) == 0);
+    }
+}
+
+void PicoLocalDecompressTest::benchmarkDecodeMzKernel_data()
+{
+    addIsaRows(" decode");
+}
+
+void PicoLocalDecompressTest::benchmarkDecodeMzKernel()
+{
+    QFETCH(int, isa);
+
+    if (isa > pico::supportedDecodeKernelIsa()) {
+        QSKIP("instruction set not supported by this cpu");
+    }
+
+    const pico::PicoLocalDecompress decompressor;
+    std::vector<unsigned int> codes = mzCodes();
+    codes.resize(KERNEL_CODE_COUNT);
+    const std::vector<double> calib = calibration(6);
+    const pico::WatersCalibration::Coefficents modification
+        = calibrationModification(pico::WatersCalibration::CoefficentsType_T1);
+    std::vector<double> decoded(codes.size());
+
+    QElapsedTimer timer;
+    qint64 elapsedNs = 0;
+    int iterations = 0;
+    QBENCHMARK {
+        timer.start();
+        if (isa == pico::DecodeKernelScalar) {
+            for (size_t i = 0; i < codes.size(); ++i) {
+                decoded[i] = decompressor.decodeAndCalibrateMzType1(codes[i], calib, &modification);
+            }
+        } else {
+            std::copy(codes.begin(), codes.end(), decoded.begin());
+            pico::decodeAndCalibrateMzType1Kernel(decoded.data(), decoded.size(), calib,
+                                                  &modification, decoded.data(),
+                                                  pico::DecodeKernelIsa(isa));
+        }
+        elapsedNs += timer.nsecsElapsed();
+        ++iterations;
+    }
+
+    // the decoded m/z are doubles
+    const double megabytes = decoded.size() * sizeof(double) / 1e6;
+    qDebug() << "Decoded" << megabytes << "MB of m/z per iteration,"
+             << megabytes * iterations / (elapsedNs / 1e9) << "MB/s";
+}
+
+void PicoLocalDecompressTest::addIsaRows(const QString &name)
+{
+    QTest::addColumn<int>("isa");
+
+    QTest::newRow(qPrintable("scalar" + name)) << int(pico::DecodeKernelScalar);
+    QTest::newRow(qPrintable("SSE2" + name)) << int(pico::DecodeKernelSse2);
+    QTest::newRow(qPrintable("AVX" + name)) << int(pico::DecodeKernelAvx);
+}
+
+QByteArray PicoLocalDecompressTest::readTestData(const QString &fileName)
+{
+    QFile file(QString(PMI_TEST_FILES_DATA_DIR) + "/PicoLocalDecompressTest/" + fileName);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QByteArray();
+    }
+    return file.readAll();
+}
+
+// the boundaries of the m/z code ranges, see decodeAndCalibrateMzType1(), followed by random codes
+std::vector<unsigned int> PicoLocalDecompressTest::mzCodes()
+{
+    std::vector<unsigned int> codes = { 0u, 1u, 0x33FFFFFFu, 0xFFFFFFFFu };
+    for (unsigned int code = 0x34000000u; code <= 0x84000000u; code += 0x08000000u) {
+        codes.push_back(code - 1);
+        codes.push_back(code);
+        codes.push_back(code + 1);
+    }
+
+    std::mt19937 random(11);
+    std::uniform_int_distribution<unsigned int> anyCode(0u, 0xFFFFFFFFu);
+    std::uniform_int_distribution<unsigned int> rangeCode(0x34000000u, 0x84000000u);
+    for (int i = 0; i < KERNEL_CODE_COUNT; ++i) {
+        codes.push_back(i % 3 == 0 ? anyCode(random) : rangeCode(random));
+    }
+    return codes;
+}
+
+// decompressRawType1_N() reads 5 coefficients for SQD, where the linear one is negative, and 6
+// otherwise
+std::vector<double> PicoLocalDecompressTest::calibration(int calibrationCount)
+{
+    switch (calibrationCount) {
+    case 5:
+        return { 0.01, -1.0001, 1e-7, 2e-11, -3e-15 };
+    case 6:
+        return { 0.001, 0.99995, 1e-6, -2e-9, 3e-12, 1e-14 };
+    }
+    return std::vector<double>();
+}
+
+pico::WatersCalibration::Coefficents PicoLocalDecompressTest::calibrationModification(int type)
+{
+    pico::WatersCalibration::Coefficents coefficients;
+    switch (type) {
+    case pico::WatersCalibration::CoefficentsType_T0:
+        coefficients.type = pico::WatersCalibration::CoefficentsType_T0;
+        coefficients.coeffients = { 0.002, 1.00001, -1e-8 };
+        break;
+    case pico::WatersCalibration::CoefficentsType_T1:
+        coefficients.type = pico::WatersCalibration::CoefficentsType_T1;
+        coefficients.coeffients = { 0.0001, 0.99999, 1e-6, 2e-9 };
+        break;
+    }
+    return coefficients;
+}
+
+// profile scan with a gaussian peak every 40 points separated by zeros, centroided scans keep
+// only the apexes
+CompressedScan PicoLocalDecompressTest::compress(PicoType type, int pointCount)
+{
+    CompressedScan scan;
+
+    std::vector<double> mz;
+    std::vector<float> intensity;
+    std::vector<unsigned int> watersData;
+    for (int i = 0; i < pointCount; ++i) {
+        const int peak = i / 40;
+        const int offset = i % 40 - 20;
+        const float height = float(1000 + (peak * 7919) % 50000);
+        const float value
+            = std::abs(offset) < 8 ? std::floor(height * std::exp(-offset * offset / 8.0f)) : 0.0f;
+        if (type == PicoTypeCentroided1) {
+            mz.push_back(200.0 + i * 0.7 + (i % 3) * 0.01);
+            intensity.push_back(height);
+            continue;
+        }
+        mz.push_back(520.0 + i * 0.004 + i * i * 1e-8);
+        intensity.push_back(value);
+        // Waters m/z code of the 512-1024 range, see decodeAndCalibrateMzType1()
+        watersData.push_back(static_cast<unsigned int>(value));
+        watersData.push_back(static_cast<unsigned int>((mz.back() + 10240.0) * 131072.0));
+    }
+
+    pico::PicoLocalCompress compressor;
+    unsigned long long intensitySum = 0;
+    switch (type) {
+    case PicoType02: {
+        unsigned char *compressed = nullptr;
+        unsigned int length = 0;
+        if (compressor.compressRawType02(mz.data(), intensity.data(), pointCount, &compressed,
+                                         &length, &intensitySum)) {
+            scan.mz = QByteArray(reinterpret_cast<const char *>(compressed), length);
+        }
+        free(compressed);
+        break;
+    }
+    case PicoTypeCentroided1: {
+        unsigned char *compressedMz = nullptr;
+        unsigned char *compressedIntensity = nullptr;
+        unsigned int mzLength = 0;
+        unsigned int intensityLength = 0;
+        if (compressor.compressRawTypeCentroided1(mz.data(), intensity.data(), pointCount,
+                                                  &compressedMz, &mzLength, &compressedIntensity,
+                                                  &intensityLength, &intensitySum, true)) {
+            scan.mz = QByteArray(reinterpret_cast<const char *>(compressedMz), mzLength);
+            scan.intensity
+                = QByteArray(reinterpret_cast<const char *>(compressedIntensity), intensityLength);
+        }
+        free(compressedMz);
+        free(compressedIntensity);
+        break;
+    }
+    case PicoType4: {
+        // worst case size used by PicoLocalCompress::compress()
+        std::vector<unsigned char> compressed((pointCount + pointCount / 2) * sizeof(double));
+        unsigned int length = 0;
+        if (compressor.compressRawType4(mz.data(), intensity.data(), pointCount,
+                                        compressed.data(), &length, &intensitySum)) {
+            scan.mz = QByteArray(reinterpret_cast<const char *>(compressed.data()), length);
+        }
+        break;
+    }
+    case PicoTypeWaters1_N: {
+        // worst case size used by Reader
+        std::vector<unsigned char> compressed(180 + 8 * pointCount);
+        unsigned int length = 0;
+        if (compressor.compressRawType1_N(watersData, pointCount, compressed.data(), &length,
+                                          &intensitySum, std::vector<double>(), false)) {
+            scan.mz = QByteArray(reinterpret_cast<const char *>(compressed.data()), length);
+        }
+        break;
+    }
+    }
+    return scan;
+}
+
+bool PicoLocalDecompressTest::decompressLegacy(PicoType type, const CompressedScan &scan,
+                                               DecodedScan *decoded)
+{
+    pico::PicoLocalDecompress decompressor;
+    unsigned char *compressedMz = reinterpret_cast<unsigned char *>(const_cast<char *>(scan.mz.constData()));
+    unsigned char *compressedIntensity
+        = reinterpret_cast<unsigned char *>(const_cast<char *>(scan.intensity.constData()));
+    double *restoredMz = nullptr;
+    float *restoredIntensity = nullptr;
+    int length = 0;
+
+    bool ok = false;
+    switch (type) {
+    case PicoType02:
+        ok = decompressor.decompressSpectraType02(&compressedMz, &restoredMz, &restoredIntensity,
+                                                  &length);
+        break;
+    case PicoTypeCentroided1:
+        ok = decompressor.decompressSpectraCentroidedType1(
+            &compressedMz, &compressedIntensity, &restoredMz, &restoredIntensity, &length);
+        break;
+    case PicoType4:
+        ok = decompressor.decompressRawType4(compressedMz, scan.mz.size(), &restoredMz,
+                                             &restoredIntensity, &length, true);
+        break;
+    case PicoTypeWaters1_N: {
+        const pico::WatersCalibration::Coefficents coef;
+        ok = decompressor.decompressRawType1_N(compressedMz, &coef, &restoredMz,
+                                               &restoredIntensity, &length, true, false);
+        break;
+    }
+    }
+
+    if (ok && restoredMz != nullptr && restoredIntensity != nullptr) {
+        decoded->mz.assign(restoredMz, restoredMz + length);
+        decoded->intensity.assign(restoredIntensity, restoredIntensity + length);
+    } else {
+        ok = false;
+    }
+    free(restoredMz);
+    free(restoredIntensity);
+    return ok;
+}
+
+bool PicoLocalDecompressTest::decompressBuffer(PicoType type, const CompressedScan &scan,
+                                               pico::DecompressBuffer *buffer)
+{
+    const pico::PicoLocalDecompress decompressor;
+    const unsigned char *compressedMz = reinterpret_cast<const unsigned char *>(scan.mz.constData());
+    const unsigned char *compressedIntensity
+        = reinterpret_cast<const unsigned char *>(scan.intensity.constData());
+
+    switch (type) {
+    case PicoType02:
+        return decompressor.decompressSpectraType02(compressedMz, buffer);
+    case PicoTypeCentroided1:
+        return decompressor.decompressSpectraCentroidedType1(compressedMz, compressedIntensity,
+                                                             buffer);
+    case PicoType4:
+        return decompressor.decompressRawType4(compressedMz, scan.mz.size(), buffer, true);
+    case PicoTypeWaters1_N: {
+        const pico::WatersCalibration::Coefficents coef;
+        return decompressor.decompressRawType1_N(compressedMz, &coef, buffer, true);
+    }
+    }
+    return false;
+}
+
+_PMI_END
+
+QTEST_MAIN(pmi::PicoLocalDecompressTest)
+
+#include "PicoLocalDecompressTest.moc"
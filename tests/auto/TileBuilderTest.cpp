@@ -3,6 +3,7 @@
 #include <QFile>
 #include <QPainter>
 #include <QStringList>
+#include <QtMath>
 
 #include <ComInitializer.h>
 
@@ -27,6 +28,8 @@ static const QString FLOWER_IMAGE("pictures-of-flowers17.jpg");
 static const QString FLOWER_TILES("pictures-of-flowers17.db3");
 static const QString IMAGE_PATTERN_TILES("image-pattern.db3");
 static const QString CHECKER_PATTERN_TILES("checker-pattern.db3");
+static const QString CHECKER_LEVEL_1_TILES("checker-level-1.db3");
+static const QString CHECKER_RIP_TILES("checker-rip-%1.db3");
 
 static const QString PIXEL_TILE_RANGE_PRESET("pixelTileRangePreset.json");
 
@@ -42,10 +45,20 @@ private:
 
     void compareTileDocuments(const QString &actualFileName, const QString &expectedFileName, int startLevel, int endLevel, bool * ok);
 
+    // level 1 of a checker document, 4096x4096 values
+    static TileRange checkerRange();
+    void createCheckerLevel1(const QString &fileName);
+    // copies the level 1 document and builds the RIP levels with threadCount threads
+    void buildCheckerRipTilePyramid(const QString &fileName, int threadCount);
+
 private Q_SLOTS:
     void testBuildLevel1();
     void testBuildTilePyramid();
     void testBuildRipTilePyramid();
+    void testBuildRipTilePyramidThreads();
+    // one iteration builds all RIP levels up to 8x8 of the checker document
+    void benchmarkBuildRipTilePyramid_data();
+    void benchmarkBuildRipTilePyramid();
 
     void testBuildLevel1fromImage();
     void testBuildLevel1fromImagePattern();
@@ -238,6 +251,107 @@ void TileBuilderTest::testBuildRipTilePyramid()
     //TODO: compare rendered document with reference!
 }
 
+TileRange TileBuilderTest::checkerRange()
+{
+    TileRange range;
+    range.initXRange(0, 64 * Tile::WIDTH - 1, 1);
+    range.initYRange(0, 64 * Tile::HEIGHT - 1, 1);
+    range.setMinIntensity(0.0);
+    range.setMaxIntensity(1.0);
+    return range;
+}
+
+void TileBuilderTest::createCheckerLevel1(const QString &fileName)
+{
+    if (QFileInfo(fileName).exists()) {
+        QVERIFY(QFile::remove(fileName));
+    }
+
+    TileStoreSqlite tileStore(fileName);
+    QCOMPARE(tileStore.createTable(), kNoErr);
+    const TileRange range = checkerRange();
+    QCOMPARE(TileRange::createTable(&tileStore.db()), kNoErr);
+    QCOMPARE(TileRange::saveRange(range, &tileStore.db()), kNoErr);
+
+    CheckerDataProvider checker(QSize(Tile::WIDTH / 3, Tile::HEIGHT / 5), 0.5, 0.5);
+    TileBuilder ir(range);
+    tileStore.start();
+    ir.buildLevel1Tiles(&tileStore, &checker);
+    tileStore.end();
+}
+
+void TileBuilderTest::buildCheckerRipTilePyramid(const QString &fileName, int threadCount)
+{
+    const QString level1FilePath = QDir(PMI_TEST_FILES_OUTPUT_DIR).filePath(CHECKER_LEVEL_1_TILES);
+    if (!QFileInfo(level1FilePath).exists()) {
+        createCheckerLevel1(level1FilePath);
+    }
+    if (QFileInfo(fileName).exists()) {
+        QVERIFY(QFile::remove(fileName));
+    }
+    QVERIFY(QFile::copy(level1FilePath, fileName));
+
+    TileStoreSqlite tileStore(fileName);
+    TileBuilder ir(checkerRange());
+    ir.setThreadCount(threadCount);
+    ir.buildRipTilePyramid(QPoint(8, 8), &tileStore);
+}
+
+void TileBuilderTest::testBuildRipTilePyramidThreads()
+{
+    const QDir outputDir(PMI_TEST_FILES_OUTPUT_DIR);
+    const QString serialFilePath = outputDir.filePath(CHECKER_RIP_TILES.arg(1));
+    const QString parallelFilePath = outputDir.filePath(CHECKER_RIP_TILES.arg(4));
+    buildCheckerRipTilePyramid(serialFilePath, 1);
+    buildCheckerRipTilePyramid(parallelFilePath, 4);
+    QVERIFY(!QTest::currentTestFailed());
+
+    {
+        TileStoreSqlite serial(serialFilePath);
+        TileStoreSqlite parallel(parallelFilePath);
+        const QVector<QPoint> levels = serial.availableLevels();
+        QCOMPARE(levels.size(), 64);
+        QCOMPARE(parallel.availableLevels(), levels);
+
+        const TileRange range = checkerRange();
+        for (const QPoint &level : levels) {
+            const int tileCountX = qCeil(qreal(range.levelWidth(level)) / Tile::WIDTH);
+            const int tileCountY = qCeil(qreal(range.levelHeigth(level)) / Tile::HEIGHT);
+            for (int y = 0; y < tileCountY; ++y) {
+                for (int x = 0; x < tileCountX; ++x) {
+                    const QPoint tilePos(x * Tile::WIDTH, y * Tile::HEIGHT);
+                    const Tile expected = serial.loadTile(level, tilePos);
+                    QVERIFY(!expected.isNull());
+                    QVERIFY(parallel.loadTile(level, tilePos) == expected);
+                }
+            }
+        }
+    }
+
+    QVERIFY(QFile::remove(serialFilePath));
+    QVERIFY(QFile::remove(parallelFilePath));
+}
+
+void TileBuilderTest::benchmarkBuildRipTilePyramid_data()
+{
+    QTest::addColumn<int>("threadCount");
+
+    QTest::newRow("1 thread") << 1;
+    QTest::newRow("ideal thread count") << 0;
+}
+
+void TileBuilderTest::benchmarkBuildRipTilePyramid()
+{
+    QFETCH(int, threadCount);
+
+    const QString fileName = QDir(PMI_TEST_FILES_OUTPUT_DIR).filePath(CHECKER_RIP_TILES.arg(threadCount));
+    // the pyramid skips existing tiles, so it's built once into a fresh copy of level 1
+    QBENCHMARK_ONCE {
+        buildCheckerRipTilePyramid(fileName, threadCount);
+    }
+    QVERIFY(QFile::remove(fileName));
+}
+
 void TileBuilderTest::testBuildLevel1fromImage()
 {
     // db file
@@ -38,6 +38,17 @@ private Q_SLOTS:
         This test proves that the new warp creates equal or better warps when in 2D mode.
     */
     void testRandomizedNew();
+
+    /*!
+        \brief Test with random generated plots. /see referenceConstructWarp below.
+        This test proves that the column score kernel and the parallel dynamic programming produce
+        exactly the knots of the straightforward implementation.
+    */
+    void testReferenceKnots_data();
+    void testReferenceKnots();
+
+    void benchmarkConstructWarp_data();
+    void benchmarkConstructWarp();
 };
 
 /*! \brief Takes a list of intensities per minute and expands to arbitrary sample rate, linearly
@@ -288,19 +299,15 @@ static std::vector<double> randomizeWarp(const std::vector<double> &knotsA, int
 }
 
 /*!
-   \brief Runs a randomized test using \a seed.
-   \param [out] sqDistLegacy Summed square distance of the knots produced by legacy to the
-        optimal knots.
-   \param [out] sqDist2D Summed square distance of the knots produced by legacy to
-        the optimal knots.
+   \brief Samples a random model twice, the second time with a random time distortion.
+   \param [out] knotsAIndexSpace Knots in index space of the signals.
+   \param [out] knotsB Time distortion applied to the second signal, in minutes.
 */
-static Err testRandomData(int seed, bool legacyMode, double *sqDistLegacy, double *sqDist2D)
+static void randomWarpInput(int seed, bool legacyMode, std::vector<WarpElement> *warpElementsA,
+                            std::vector<WarpElement> *warpElementsB,
+                            std::vector<int> *knotsAIndexSpace, std::vector<double> *knotsA,
+                            std::vector<double> *knotsB)
 {
-    Err e = kNoErr;
-
-    *sqDistLegacy = 0.0;
-    *sqDist2D = 0.0;
-
     std::default_random_engine randomEngine(seed);
 
     // create a random model
@@ -308,20 +315,20 @@ static Err testRandomData(int seed, bool legacyMode, double *sqDistLegacy, doubl
 
     // Create knots 10 minutes apart
     const double knotDuration = 10.0;
-    std::vector<double> knotsA;
+    knotsA->clear();
     for (double t = 0.0; t < totalDuration; t += knotDuration) {
-        knotsA.push_back(t);
+        knotsA->push_back(t);
     }
-    knotsA.push_back(totalDuration);
+    knotsA->push_back(totalDuration);
 
     // convert to index space
-    std::vector<int> knotsAIndexSpace;
-    for (const double &t : knotsA) {
-        knotsAIndexSpace.push_back(qRound(t * sampleRate));
+    knotsAIndexSpace->clear();
+    for (const double &t : *knotsA) {
+        knotsAIndexSpace->push_back(qRound(t * sampleRate));
     }
 
     // Create a distortion time warp by randomizing knotsA
-    std::vector<double> knotsB = randomizeWarp(knotsA, randomEngine());
+    *knotsB = randomizeWarp(*knotsA, randomEngine());
 
     // Create two samplers of the same model, with different signal/noise ratios.
     // First sampler will get a null time distortion.
@@ -329,14 +336,12 @@ static Err testRandomData(int seed, bool legacyMode, double *sqDistLegacy, doubl
 
     // Second sampler will get a time distortion
     RandomMSSampler samplerB(randomEngine(), 500.0, 100.0);
-    samplerB.timeDistortion.setAnchors(knotsA, knotsB);
+    samplerB.timeDistortion.setAnchors(*knotsA, *knotsB);
 
     // produce plots to align
-    double maxDuration = std::max(knotsA.back(), knotsB.back());
-    std::vector<double> bpiA;
-    std::vector<double> bpiB;
-    std::vector<WarpElement> warpElementsA;
-    std::vector<WarpElement> warpElementsB;
+    double maxDuration = std::max(knotsA->back(), knotsB->back());
+    warpElementsA->clear();
+    warpElementsB->clear();
     for (double t = 0.0; t <= maxDuration; t += 1.0 / sampleRate) {
         WarpElement a = samplerA.sample(model, t);
         WarpElement b = samplerB.sample(model, t);
@@ -349,10 +354,38 @@ static Err testRandomData(int seed, bool legacyMode, double *sqDistLegacy, doubl
             }
         }
 
-        bpiA.push_back(a.mzIntensityPairs[0].intensity);
-        bpiB.push_back(b.mzIntensityPairs[0].intensity);
-        warpElementsA.push_back(a);
-        warpElementsB.push_back(b);
+        warpElementsA->push_back(a);
+        warpElementsB->push_back(b);
+    }
+}
+
+/*!
+   \brief Runs a randomized test using \a seed.
+   \param [out] sqDistLegacy Summed square distance of the knots produced by legacy to the
+        optimal knots.
+   \param [out] sqDist2D Summed square distance of the knots produced by legacy to
+        the optimal knots.
+*/
+static Err testRandomData(int seed, bool legacyMode, double *sqDistLegacy, double *sqDist2D)
+{
+    Err e = kNoErr;
+
+    *sqDistLegacy = 0.0;
+    *sqDist2D = 0.0;
+
+    std::vector<WarpElement> warpElementsA;
+    std::vector<WarpElement> warpElementsB;
+    std::vector<int> knotsAIndexSpace;
+    std::vector<double> knotsA;
+    std::vector<double> knotsB;
+    randomWarpInput(seed, legacyMode, &warpElementsA, &warpElementsB, &knotsAIndexSpace, &knotsA,
+                    &knotsB);
+
+    std::vector<double> bpiA;
+    std::vector<double> bpiB;
+    for (int i = 0; i < static_cast<int>(warpElementsA.size()); i++) {
+        bpiA.push_back(warpElementsA[i].mzIntensityPairs[0].intensity);
+        bpiB.push_back(warpElementsB[i].mzIntensityPairs[0].intensity);
     }
 
     // Common options for both legacy and 2D warp
@@ -437,6 +470,216 @@ void WarpCore2DTest::testRandomizedNew()
     }
 }
 
+/*! \brief Integral of the scores of A segment and interpolated B segment, one WarpElement at a time. */
+static double referenceSegmentMatchScore(const std::vector<WarpElement> &a, int beginA, int endA,
+                                         const std::vector<WarpElement> &b, int beginB, int endB,
+                                         double mzMatchPpm)
+{
+    if (endB <= beginB || endA <= beginA) {
+        return 0.0;
+    }
+
+    int durationA = endA - beginA;
+    int durationB = endB - beginB;
+    if (durationB < durationA / 2 || durationA < durationB / 2) {
+        return 0.0;
+    }
+
+    // b has its last element repeated, so that b[indexB + 1] is valid
+    double stepB = static_cast<double>(durationB) / static_cast<double>(durationA);
+    double integral = 0.0;
+    for (int indexA = beginA; indexA < endA; indexA++) {
+        double indexBDouble = beginB + (indexA - beginA) * stepB;
+        int indexB = qFloor(indexBDouble);
+        indexB = std::min(indexB, static_cast<int>(b.size()) - 2);
+        double lerpFactor = indexBDouble - indexB;
+        WarpElement sampleB
+            = WarpElement::interpolate(b[indexB], b[indexB + 1], mzMatchPpm, lerpFactor);
+        integral += WarpElement::scoreFunction(a[indexA], sampleB, mzMatchPpm);
+    }
+
+    return integral;
+}
+
+/*!
+   \brief Straightforward implementation of the dynamic programming of WarpCore2D::constructWarp,
+        with a full table and serial evaluation of all cells.
+*/
+static std::vector<int> referenceConstructWarp(const std::vector<WarpElement> &a,
+                                               const std::vector<WarpElement> &b,
+                                               const std::vector<int> &knotsA,
+                                               double stretchPenalty, int globalSkew,
+                                               double mzMatchPpm)
+{
+    const double lowest = std::numeric_limits<double>::lowest();
+    const double stretch = 0.51;
+    const int segmentCount = static_cast<int>(knotsA.size()) - 1;
+    const int nB = static_cast<int>(b.size());
+
+    std::vector<WarpElement> paddedB = b;
+    paddedB.push_back(b.back());
+
+    const double stretchPenaltyFactor = stretchPenalty * WarpElement::averageIntensity(a);
+
+    std::vector<int> rowStart(segmentCount);
+    std::vector<int> rowEnd(segmentCount);
+    const int firstSegmentDuration = knotsA[1] - knotsA[0];
+    rowStart[0] = qFloor((1.0 - stretch) * firstSegmentDuration);
+    rowEnd[0] = qCeil((1.0 + stretch) * firstSegmentDuration);
+    for (int i = 1; i < segmentCount; i++) {
+        int jOffset = std::min(globalSkew, static_cast<int>(stretch * knotsA[i + 1]));
+        rowStart[i] = std::min(nB, knotsA[i + 1] - jOffset);
+        rowEnd[i] = std::min(nB, knotsA[i + 1] + jOffset);
+    }
+
+    const int columnCount = std::max(nB, rowEnd[0]);
+    std::vector<std::vector<double>> scores(segmentCount, std::vector<double>(columnCount, lowest));
+    std::vector<std::vector<int>> segmentStarts(segmentCount, std::vector<int>(columnCount, 0));
+
+    for (int j = rowStart[0]; j < rowEnd[0]; j++) {
+        double stretchDiff = std::abs(j - firstSegmentDuration);
+        scores[0][j] = referenceSegmentMatchScore(a, 0, firstSegmentDuration, paddedB, 0, j,
+                                                  mzMatchPpm)
+            - stretchPenaltyFactor * stretchDiff * stretchDiff;
+    }
+
+    for (int i = 1; i < segmentCount; i++) {
+        int startA = knotsA[i];
+        int endA = knotsA[i + 1];
+        double durationA = std::abs(endA - startA);
+        for (int j = rowStart[i]; j < rowEnd[i]; j++) {
+            int maxk = std::max(0, j - qFloor((1.0 - stretch) * durationA));
+            int mink = std::max(0, j - qCeil((1.0 + stretch) * durationA));
+            for (int k = mink; k < maxk; k++) {
+                double accumulatedScore = lowest;
+                if (k >= rowStart[i - 1] && k < rowEnd[i - 1]) {
+                    accumulatedScore = scores[i - 1][k];
+                }
+                double score = accumulatedScore
+                    + referenceSegmentMatchScore(a, startA, endA, paddedB, k, j, mzMatchPpm);
+                double durationDiff = std::abs((j - k) - durationA);
+                score -= stretchPenaltyFactor * durationDiff * durationDiff;
+                if (score > scores[i][j]) {
+                    scores[i][j] = score;
+                    segmentStarts[i][j] = k;
+                }
+            }
+        }
+    }
+
+    std::vector<int> knotsB(segmentCount + 1);
+    knotsB[segmentCount] = nB;
+    int currentSegmentStart = nB - 1;
+    for (int i = segmentCount - 1; i >= 0; i--) {
+        currentSegmentStart = segmentStarts[i][currentSegmentStart];
+        knotsB[i] = currentSegmentStart;
+    }
+
+    return knotsB;
+}
+
+void WarpCore2DTest::testReferenceKnots_data()
+{
+    QTest::addColumn<bool>("legacyMode");
+    QTest::addColumn<double>("stretchPenalty");
+
+    QTest::newRow("legacy") << true << 0.0;
+    QTest::newRow("legacy penalty") << true << 0.01;
+    QTest::newRow("2D") << false << 0.0;
+    QTest::newRow("2D penalty") << false << 0.01;
+}
+
+void WarpCore2DTest::testReferenceKnots()
+{
+    QFETCH(bool, legacyMode);
+    QFETCH(double, stretchPenalty);
+
+    const int globalSkew = 500;
+    const double mzMatchPpm = 100.0;
+
+    for (int seed = 0; seed < 5; seed++) {
+        std::vector<WarpElement> warpElementsA;
+        std::vector<WarpElement> warpElementsB;
+        std::vector<int> knotsAIndexSpace;
+        std::vector<double> knotsA;
+        std::vector<double> knotsB;
+        randomWarpInput(seed, legacyMode, &warpElementsA, &warpElementsB, &knotsAIndexSpace,
+                        &knotsA, &knotsB);
+
+        const std::vector<int> expected
+            = referenceConstructWarp(warpElementsA, warpElementsB, knotsAIndexSpace,
+                                     stretchPenalty, globalSkew, mzMatchPpm);
+
+        for (int threadCount : { 1, 4 }) {
+            WarpCore2D warpCore2D;
+            warpCore2D.setStretchPenalty(stretchPenalty);
+            warpCore2D.setGlobalSkew(globalSkew);
+            warpCore2D.setMzMatchPpm(mzMatchPpm);
+            warpCore2D.setThreadCount(threadCount);
+
+            std::vector<int> knotsB2DIndexSpace;
+            QVERIFY(warpCore2D.constructWarp(warpElementsA, warpElementsB, knotsAIndexSpace,
+                                             &knotsB2DIndexSpace)
+                    == kNoErr);
+            QCOMPARE(knotsB2DIndexSpace, expected);
+        }
+    }
+}
+
+void WarpCore2DTest::benchmarkConstructWarp_data()
+{
+    QTest::addColumn<bool>("legacyMode");
+    QTest::addColumn<int>("threadCount");
+
+    // threadCount -1 runs referenceConstructWarp
+    QTest::newRow("legacy reference") << true << -1;
+    QTest::newRow("legacy serial") << true << 1;
+    QTest::newRow("legacy parallel") << true << 0;
+    QTest::newRow("2D reference") << false << -1;
+    QTest::newRow("2D serial") << false << 1;
+    QTest::newRow("2D parallel") << false << 0;
+}
+
+void WarpCore2DTest::benchmarkConstructWarp()
+{
+    QFETCH(bool, legacyMode);
+    QFETCH(int, threadCount);
+
+    const int globalSkew = 500;
+    const double mzMatchPpm = 100.0;
+
+    std::vector<WarpElement> warpElementsA;
+    std::vector<WarpElement> warpElementsB;
+    std::vector<int> knotsAIndexSpace;
+    std::vector<double> knotsA;
+    std::vector<double> knotsB;
+    randomWarpInput(0, legacyMode, &warpElementsA, &warpElementsB, &knotsAIndexSpace, &knotsA,
+                    &knotsB);
+
+    const std::vector<int> expected = referenceConstructWarp(
+        warpElementsA, warpElementsB, knotsAIndexSpace, 0.0, globalSkew, mzMatchPpm);
+
+    WarpCore2D warpCore2D;
+    warpCore2D.setGlobalSkew(globalSkew);
+    warpCore2D.setMzMatchPpm(mzMatchPpm);
+    warpCore2D.setThreadCount(threadCount);
+
+    std::vector<int> knotsB2DIndexSpace;
+    QBENCHMARK {
+        if (threadCount < 0) {
+            knotsB2DIndexSpace = referenceConstructWarp(warpElementsA, warpElementsB,
+                                                        knotsAIndexSpace, 0.0, globalSkew,
+                                                        mzMatchPpm);
+        } else {
+            QVERIFY(warpCore2D.constructWarp(warpElementsA, warpElementsB, knotsAIndexSpace,
+                                             &knotsB2DIndexSpace)
+                    == kNoErr);
+        }
+    }
+
+    QCOMPARE(knotsB2DIndexSpace, expected);
+}
+
 _PMI_END
 
 QTEST_MAIN(pmi::WarpCore2DTest)